@@ -1,4 +1,5 @@
 #include "profiler/drogon_adapter.h"
+#include "profiler/http_server.h"
 #include "profiler_manager.h"
 #include "workload.h"
 #include <chrono>
@@ -32,6 +33,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
     // Create ProfilerManager instance (no longer a singleton)
     profiler::ProfilerManager profiler;
 
+    // Load symbol indexes in the background so the first stack/symbol request is fast
+    profiler.startSymbolWarmup();
+
 #ifdef REMOTE_PROFILER_ENABLE_WEB
     // Register all HTTP route handlers with Drogon
     std::cout << "Registering HTTP handlers...\n";
@@ -41,7 +45,15 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
     std::cout << "Starting server on " << host << ":" << port << "...\n";
     drogon::app().addListener(host, port).run();
 #else
-    std::cout << "Web UI disabled. Running in core-only mode.\n";
+    std::cout << "Web UI disabled. Serving the profiler API with the built-in server.\n";
+    profiler::HttpServerOptions server_options;
+    server_options.host = host;
+    server_options.port = static_cast<uint16_t>(port);
+    profiler::ProfilerHttpServer server(profiler, server_options);
+    if (!server.start()) {
+        std::cerr << "Failed to start server: " << server.lastError() << "\n";
+        return 1;
+    }
     // Keep the main thread alive
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
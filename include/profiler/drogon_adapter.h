@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "profiler/http_handlers.h"
 #include "profiler_manager.h"
 
 PROFILER_NAMESPACE_BEGIN
@@ -16,7 +17,14 @@ PROFILER_NAMESPACE_BEGIN
 /// After calling this, start the Drogon server with:
 ///   drogon::app().addListener(host, port).run();
 ///
+/// Profiler handlers run on a dedicated worker pool and complete the Drogon
+/// callback from there, so a 30 s capture or a Perl render never blocks an
+/// event-loop thread shared with the application's own routes.
+///
 /// @param profiler Reference to the ProfilerManager instance to use
-void registerDrogonHandlers(profiler::ProfilerManager& profiler);
+/// @param options Admission limits of the heavy endpoints (429 beyond them)
+/// @param pool Size, queue bound and CPU affinity of the handler worker pool
+void registerDrogonHandlers(profiler::ProfilerManager& profiler, const SchedulerOptions& options = SchedulerOptions(),
+                            const WorkerPoolOptions& pool = WorkerPoolOptions());
 
 PROFILER_NAMESPACE_END
@@ -8,13 +8,20 @@
 #pragma once
 
 #include "profiler_version.h"
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 PROFILER_NAMESPACE_BEGIN
 
 class ProfilerManager;
 
+namespace internal {
+class RequestScheduler;
+} // namespace internal
+
 /// @brief Framework-agnostic HTTP response
 struct HandlerResponse {
     int status = 200;
@@ -42,6 +49,32 @@ struct HandlerResponse {
     }
 };
 
+/// @brief Admission limits for the heavy endpoints (captures, dumps and renders)
+///
+/// Endpoints are grouped into classes that share the same global profiler state:
+/// "cpu", "heap", "growth", "threads" and "symbol". Requests with identical
+/// parameters that arrive while one is running share its response; anything
+/// beyond the limits below gets 429 Too Many Requests with a Retry-After header.
+struct SchedulerOptions {
+    int max_concurrent = 2;                  ///< Heavy requests running at once across all classes
+    int default_class_limit = 1;             ///< Requests running at once per class
+    std::map<std::string, int> class_limits; ///< Per-class overrides of default_class_limit
+    size_t max_rss_bytes = 0;                ///< Reject new work while process RSS exceeds this (0 = no limit)
+    int retry_after_seconds = 5;             ///< Retry-After value of 429 responses
+};
+
+/// @brief Worker threads that run handlers off a web framework's event loop
+///
+/// Handlers block for the whole capture or render (up to minutes for
+/// /pprof/profile), so server adapters hand them to a dedicated pool and
+/// complete the response from there. When the queue is full new requests
+/// get 503 Service Unavailable.
+struct WorkerPoolOptions {
+    size_t threads = 4;            ///< Worker threads (0 = run handlers on the event loop)
+    size_t max_queued = 64;        ///< Requests that may wait for a free worker
+    std::vector<int> cpu_affinity; ///< CPUs the workers may run on (empty = no restriction)
+};
+
 /// @brief Framework-agnostic profiler HTTP endpoint handlers
 ///
 /// Usage example with any framework:
@@ -55,7 +88,14 @@ struct HandlerResponse {
 /// @endcode
 class ProfilerHttpHandlers {
 public:
-    explicit ProfilerHttpHandlers(ProfilerManager& profiler);
+    explicit ProfilerHttpHandlers(ProfilerManager& profiler, const SchedulerOptions& options = SchedulerOptions());
+    ~ProfilerHttpHandlers();
+
+    ProfilerHttpHandlers(const ProfilerHttpHandlers&) = delete;
+    ProfilerHttpHandlers& operator=(const ProfilerHttpHandlers&) = delete;
+
+    /// Change the admission limits; requests already running are not affected.
+    void setSchedulerOptions(const SchedulerOptions& options);
 
     // --- Status ---
     HandlerResponse handleStatus();
@@ -64,16 +104,29 @@ public:
     HandlerResponse handleCpuAnalyze(int duration, const std::string& output_type);
     HandlerResponse handleCpuSvgRaw(int duration);
     HandlerResponse handleCpuFlamegraphRaw(int duration);
+    HandlerResponse handleCpuFolded(int duration);
+    HandlerResponse handleCpuFlamegraphJson(int duration);
+    HandlerResponse handleCpuBundle(int duration);
+    HandlerResponse handleCpuTimeline(int duration);
+    /// Zoom into the last /api/cpu/timeline capture: [from_ms, to_ms) since its start (to_ms < 0 = end)
+    HandlerResponse handleCpuTimelineFolded(double from_ms, double to_ms);
+    HandlerResponse handleCpuTimelineFlamegraphJson(double from_ms, double to_ms);
 
     // --- Heap endpoints ---
     HandlerResponse handleHeapAnalyze(const std::string& output_type);
     HandlerResponse handleHeapSvgRaw();
     HandlerResponse handleHeapFlamegraphRaw();
+    HandlerResponse handleHeapFolded();
+    HandlerResponse handleHeapFlamegraphJson();
+    HandlerResponse handleHeapBundle();
 
     // --- Growth endpoints ---
     HandlerResponse handleGrowthAnalyze(const std::string& output_type);
     HandlerResponse handleGrowthSvgRaw();
     HandlerResponse handleGrowthFlamegraphRaw();
+    HandlerResponse handleGrowthFolded();
+    HandlerResponse handleGrowthFlamegraphJson();
+    HandlerResponse handleGrowthBundle();
 
     // --- Convenience: single dispatch by path ---
     /// Dispatch a request to the appropriate handler based on path.
@@ -89,9 +142,37 @@ public:
 
     // --- Thread stacks ---
     HandlerResponse handleThreadStacks();
+    HandlerResponse handleThreadStacksJson();
+    HandlerResponse handleThreadStacksBundle();
+    /// Threads flagged by the stuck-thread detector (JSON; "running":false when it is not started)
+    HandlerResponse handleThreadStuck();
+
+    // --- Conditional requests ---
+    /// Turn a successful response into 304 Not Modified (empty body, ETag kept)
+    /// when its ETag matches one listed in the request's If-None-Match header.
+    static HandlerResponse conditional(HandlerResponse resp, const std::string& if_none_match);
+
+    // --- Compression ---
+    /// Compress a textual response (SVG, JSON, text, HTML of 1 KiB or more) with
+    /// the best encoding the request's Accept-Encoding header allows: zstd when
+    /// built with REMOTE_PROFILER_WITH_ZSTD, else gzip. Sets Content-Encoding and
+    /// Vary, and weakens the ETag. Other responses are returned unchanged.
+    static HandlerResponse compress(HandlerResponse resp, const std::string& accept_encoding);
 
 private:
+    /// Run a heavy handler under the request scheduler: coalesced with an
+    /// identical in-flight `key`, or rejected with 429 when `endpoint_class`
+    /// or the global budget is saturated.
+    HandlerResponse schedule(const std::string& endpoint_class, const std::string& key,
+                             const std::function<HandlerResponse()>& handler);
+
+    /// Serve an SVG rendered from `data` with `options` from the profiler's render
+    /// cache, running `render` only on a miss. Successful responses carry an ETag.
+    HandlerResponse renderCached(const std::string& data, const std::string& options,
+                                 const std::function<HandlerResponse()>& render);
+
     ProfilerManager& profiler_;
+    std::unique_ptr<internal::RequestScheduler> scheduler_;
 };
 
 PROFILER_NAMESPACE_END
@@ -0,0 +1,92 @@
+/// @file http_server.h
+/// @brief Built-in HTTP/1.1 server for the profiler endpoints (no web framework needed)
+
+#pragma once
+
+#include "profiler/http_handlers.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+class ProfilerManager;
+
+/// @brief Listener and resource limits of ProfilerHttpServer
+struct HttpServerOptions {
+    std::string host = "0.0.0.0";            ///< IPv4 address to bind ("" = no TCP listener)
+    uint16_t port = 8080;                    ///< TCP port (0 = pick a free one, see ProfilerHttpServer::port())
+    std::string unix_socket;                 ///< Also listen on this Unix socket ("@name" = abstract namespace)
+    std::vector<uint32_t> unix_allowed_uids; ///< Users besides root and our own that may use the Unix socket
+    size_t max_connections = 64;             ///< Connections beyond this are closed on accept
+    size_t max_request_bytes = 1 << 20;      ///< Request head plus body; larger requests get 413
+    int idle_timeout_seconds = 30;           ///< Idle keep-alive connections are closed after this
+};
+
+/// @class ProfilerHttpServer
+/// @brief Serves every profiler endpoint over HTTP/1.1 without Drogon
+///
+/// One epoll thread owns the listeners and all connections (non-blocking
+/// sockets, keep-alive, pipelined requests answered in order). Requests are
+/// routed with ProfilerHttpHandlers::dispatch() and run on a bounded worker
+/// pool, so a 30 s capture never stalls other connections; responses get the
+/// same 304 and compression handling as the Drogon adapter. Memory is bounded
+/// by the connection and request size limits. The HTML pages of the web UI
+/// are not served; use the Drogon adapter for those.
+///
+/// For a node-local agent scraping many processes, a Unix socket listener
+/// avoids TCP and per-process port management. Peers are checked with
+/// SO_PEERCRED; other users get 403 unless listed in unix_allowed_uids.
+///
+/// @code
+///   ProfilerManager profiler;
+///   HttpServerOptions options;
+///   options.port = 6060;
+///   ProfilerHttpServer server(profiler, options);
+///   if (!server.start()) {
+///       std::cerr << server.lastError() << std::endl;
+///   }
+///   // go tool pprof http://localhost:6060/pprof/profile?seconds=10
+///
+///   options.host.clear(); // Unix socket only
+///   options.unix_socket = "@profiler-" + std::to_string(getpid());
+///   // curl --abstract-unix-socket profiler-<pid> http://localhost/pprof/heap
+/// @endcode
+class ProfilerHttpServer {
+public:
+    ProfilerHttpServer(ProfilerManager& profiler, const HttpServerOptions& options = HttpServerOptions(),
+                       const SchedulerOptions& scheduler = SchedulerOptions(),
+                       const WorkerPoolOptions& pool = WorkerPoolOptions());
+
+    /// @brief Stops the server if it is running
+    ~ProfilerHttpServer();
+
+    ProfilerHttpServer(const ProfilerHttpServer&) = delete;
+    ProfilerHttpServer& operator=(const ProfilerHttpServer&) = delete;
+
+    /// @brief Bind the listener and start the event-loop thread
+    /// @return false if already running or the socket could not be set up (see lastError())
+    bool start();
+
+    /// @brief Close the listener and all connections
+    ///
+    /// Waits for handlers that are already running (a capture in progress
+    /// finishes first); their responses are discarded.
+    void stop();
+
+    bool isRunning() const;
+
+    /// @brief Port actually bound (useful with HttpServerOptions::port = 0), 0 when not running
+    uint16_t port() const;
+
+    /// @brief Why the last start() failed
+    std::string lastError() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_; ///< Pimpl pointer for implementation hiding
+};
+
+PROFILER_NAMESPACE_END
@@ -6,11 +6,15 @@
 #include "profiler/log_sink.h"
 #include "profiler_version.h"
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <signal.h>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -21,6 +25,15 @@ class Symbolizer;
 
 namespace internal {
 class LogManager;
+class ModuleMap;
+class NameScope;
+class RenderCache;
+struct CpuTimeline;
+struct ParsedProfile;
+struct SymbolBundle;
+class ThreadCpuSampler;
+class ThreadMetadataReader;
+class WorkerPool;
 } // namespace internal
 
 /// @enum ProfilerType
@@ -31,6 +44,20 @@ enum class ProfilerType {
     HEAP_GROWTH ///< Heap growth stack analysis
 };
 
+/// @enum CpuProfilerBackend
+/// @brief Sampling mechanism behind CPU profiles
+enum class CpuProfilerBackend {
+    Gperftools,  ///< gperftools ProfilerStart(): one process-wide ITIMER_PROF
+    ThreadTimers ///< One CPU-time timer per thread (see internal::ThreadCpuSampler); same output format
+};
+
+/// @enum StackUnwinder
+/// @brief How the profiler's signal handlers walk the interrupted thread's stack
+enum class StackUnwinder {
+    Backtrace,   ///< glibc backtrace(): DWARF unwind tables, works for any code (default)
+    FramePointer ///< Frame pointer chain from the interrupted registers; needs -fno-omit-frame-pointer
+};
+
 /// @struct ProfilerState
 /// @brief Current state of a profiling session
 struct ProfilerState {
@@ -40,27 +67,99 @@ struct ProfilerState {
     uint64_t duration;       ///< Configured duration in seconds
 };
 
-/// @struct ThreadStackTrace
+/// @struct SymbolWarmupOptions
+/// @brief CPU budget of the background symbol warmup thread
+struct SymbolWarmupOptions {
+    int nice_level = 19;  ///< Nice value of the warmup thread (0-19, higher yields more)
+    int cpu_percent = 10; ///< Average share of one core the thread may use (1-100)
+};
+
+/// @struct SymbolWarmupState
+/// @brief Progress of the background symbol warmup
+struct SymbolWarmupState {
+    bool running = false;       ///< Whether the warmup thread is active
+    bool finished = false;      ///< Whether every module was processed (false if stopped early)
+    size_t modules_total = 0;   ///< Modules mapped when the warmup started
+    size_t modules_done = 0;    ///< Modules whose symbol indexes are loaded
+    uint64_t cpu_ms = 0;        ///< CPU time used by the warmup thread
+    uint64_t elapsed_ms = 0;    ///< Wall time since the warmup started
+    std::string current_module; ///< Module being loaded, empty when idle
+};
+
+/// @struct StuckThread
+/// @brief A thread whose stack stayed the same across the stuck-thread detector's captures
+struct StuckThread {
+    pid_t tid = 0;                   ///< Thread ID
+    std::string name;                ///< Thread name (comm)
+    char state = '?';                ///< Single-letter scheduler state
+    std::string wchan;               ///< Kernel wait channel
+    uint64_t stuck_ms = 0;           ///< Time since the stack was first captured unchanged
+    int samples = 0;                 ///< Consecutive identical captures
+    std::vector<std::string> frames; ///< Symbolized stack, innermost first
+};
+
+/// @struct StuckThreadOptions
+/// @brief Sampling rate and idle rules of the stuck-thread detector
+struct StuckThreadOptions {
+    int interval_ms = 5000; ///< Time between two captures of all thread stacks (at least 10)
+    int samples = 5;        ///< Identical consecutive captures before a thread is reported (at least 2)
+    /// Substrings of function names that mark a blocked thread as idle (waiting for work, not stuck)
+    std::vector<std::string> idle_frames = {"poll", "select", "nanosleep", "pthread_cond_",
+                                            "sigwait", "sigtimedwait", "accept", "pause"};
+    int idle_frame_depth = 6;                          ///< Innermost frames searched for idle_frames
+    std::function<void(const StuckThread&)> on_stuck; ///< Called on the detector thread when a thread gets stuck
+};
+
+/// @struct RenderCacheState
+/// @brief Usage of the rendered-output cache
+struct RenderCacheState {
+    size_t entries = 0;   ///< Rendered outputs held
+    size_t bytes = 0;     ///< Total size of the held outputs
+    size_t max_bytes = 0; ///< Byte budget (0 = caching disabled)
+    uint64_t hits = 0;    ///< Lookups served from the cache
+    uint64_t misses = 0;  ///< Lookups that had to render
+};
+
+/// @brief Frame depth of thread stack capture unless setThreadStackDepth() changes it
+inline constexpr int kDefaultThreadStackDepth = 64;
+
+/// @brief Outermost frame of a captured stack that was deeper than its capture depth
+///
+/// Symbolized as "[truncated]"; the frames below it are the innermost ones.
+inline constexpr uintptr_t kTruncatedStackFrame = ~static_cast<uintptr_t>(0);
+
+/// @struct BasicThreadStackTrace
 /// @brief Structure to hold captured stack trace for a thread
+/// @tparam MaxDepth Frames kept; a deeper stack ends with kTruncatedStackFrame
 /// @note Uses fixed-size array for signal-safety
-struct ThreadStackTrace {
-    pid_t tid;           ///< Thread ID
-    void* addresses[64]; ///< Array of instruction pointers (fixed size for signal-safety)
-    int depth;           ///< Number of valid addresses in the array
-    bool captured;       ///< Whether the trace was successfully captured
+template <int MaxDepth>
+struct BasicThreadStackTrace {
+    static constexpr int kMaxDepth = MaxDepth;
+
+    pid_t tid;                     ///< Thread ID
+    void* addresses[MaxDepth + 1]; ///< Instruction pointers, plus room for the truncation marker
+    int depth;                     ///< Number of valid addresses in the array
+    bool captured;                 ///< Whether the trace was successfully captured
+    bool truncated;                ///< Whether addresses[depth - 1] is kTruncatedStackFrame
 };
 
-/// @struct SharedStackTrace
+using ThreadStackTrace = BasicThreadStackTrace<kDefaultThreadStackDepth>;
+
+/// @struct BasicSharedStackTrace
 /// @brief Shared memory structure for inter-thread communication
+/// @tparam MaxDepth Frames kept, so a slot costs about (MaxDepth + 10) * 8 bytes
 /// @note Used for coordinating stack capture between threads
-struct SharedStackTrace {
+template <int MaxDepth>
+struct BasicSharedStackTrace {
     std::atomic<bool> ready;                      ///< Set by thread after capturing
     char padding[64 - sizeof(std::atomic<bool>)]; ///< Padding to avoid false sharing
     pid_t tid;                                    ///< Thread ID
-    int depth;                                    ///< Stack depth
-    void* addresses[64];                          ///< Stack addresses
+    int depth;                                    ///< Stack depth, including the truncation marker
+    void* addresses[MaxDepth + 1];                ///< Stack addresses; one more than MaxDepth detects truncation
 };
 
+using SharedStackTrace = BasicSharedStackTrace<kDefaultThreadStackDepth>;
+
 /// @class ProfilerManager
 /// @brief Main manager class for profiling operations
 ///
@@ -96,6 +195,19 @@ public:
     /// @return true if profiling started successfully
     bool startCPUProfiler(const std::string& output_path = "cpu.prof");
 
+    /// @brief Start CPU profiling session with an explicit sampling backend
+    /// @param output_path Path to save the profile output
+    /// @param backend Sampler to use; both write a gperftools CPU profile on stopCPUProfiler()
+    /// @return true if profiling started successfully
+    bool startCPUProfiler(const std::string& output_path, CpuProfilerBackend backend);
+
+    /// @brief Choose the backend used by startCPUProfiler(path) and the /pprof/profile family
+    /// @param backend Gperftools (default) or ThreadTimers
+    void setCPUProfilerBackend(CpuProfilerBackend backend);
+
+    /// @brief Get the configured CPU profiler backend
+    CpuProfilerBackend getCPUProfilerBackend() const;
+
     /// @brief Stop CPU profiling session
     /// @return true if profiling stopped successfully
     bool stopCPUProfiler();
@@ -119,11 +231,63 @@ public:
     /// @return true if the specified profiler is running
     bool isProfilerRunning(ProfilerType type) const;
 
+    /// @brief Pre-load the symbol indexes of all mapped modules on a low-priority thread
+    /// @param options Nice level and CPU budget of the thread
+    /// @return false if a warmup is already running
+    /// @note Optional. Moves the one-off cost of the first /pprof/symbol or thread stack
+    ///       request (abseil symbolizer, backward-cpp resolver, ELF/DWARF indexes) to startup
+    bool startSymbolWarmup(const SymbolWarmupOptions& options = SymbolWarmupOptions());
+
+    /// @brief Stop the warmup thread and wait for it to exit (no-op if not running)
+    void stopSymbolWarmup();
+
+    /// @brief Get the progress of the symbol warmup (for /api/status)
+    SymbolWarmupState getSymbolWarmupState() const;
+
+    /// @brief Watch for threads that hang (deadlocked mutex, lost wakeup, endless wait)
+    /// @param options Capture interval, how many identical captures count as stuck, idle rules and callback
+    /// @return false if the detector is already running
+    /// @note A background thread captures the stacks of all threads every interval through the
+    ///       signal-based capture (32 frames) and hashes them. A thread whose stack hash stays the
+    ///       same for `samples` captures and has no idle frame is reported once through
+    ///       `on_stuck`, a warning on the log sink and /api/thread/stuck. Only those stacks are
+    ///       symbolized, so a round costs one signal and one hash per thread.
+    /// @note Every round interrupts every thread with the capture signal. SA_RESTART restarts
+    ///       read()/write() and the like, but poll(), epoll_wait(), select(), nanosleep() and
+    ///       other timed waits fail with EINTR instead, so the application must retry them;
+    ///       keep the interval long. A thread that blocks the signal times out one capture
+    ///       (2 s) and is skipped while the signal stays pending on it.
+    bool startStuckThreadDetector(const StuckThreadOptions& options = StuckThreadOptions());
+
+    /// @brief Stop the detector thread and wait for it to exit (no-op if not running)
+    void stopStuckThreadDetector();
+
+    /// @brief Whether the stuck-thread detector is running
+    bool isStuckThreadDetectorRunning() const;
+
+    /// @brief Threads currently considered stuck, by tid
+    std::vector<StuckThread> getStuckThreads() const;
+
+    /// @brief Detector state and stuck threads as JSON (for /api/thread/stuck)
+    /// @return {"running":bool,"interval_ms":N,"samples":N,"threads":[{"tid","name","state","wchan",
+    ///         "stuck_ms","samples","frames":[...]}]}
+    std::string getStuckThreadsJson() const;
+
     /// @brief Resolve an address to its symbol name using backward-cpp
     /// @param address The instruction pointer to resolve
     /// @return Human-readable symbol string
     std::string resolveSymbolWithBackward(void* address);
 
+    /// @brief Resolve many addresses at once (for /pprof/symbol)
+    ///
+    /// Duplicates are resolved once. Unique addresses are partitioned by module
+    /// and spread over a persistent bounded worker pool, whose symbolizers are
+    /// kept across requests; anything they cannot resolve goes to that module's
+    /// cached addr2line resolver.
+    /// @param addresses Instruction pointers to resolve
+    /// @return One symbol per input address, in input order (same format as resolveSymbolWithBackward)
+    std::vector<std::string> resolveSymbolsBatch(const std::vector<uintptr_t>& addresses);
+
     /// @brief Analyze CPU profile and return SVG flame graph
     /// @param duration Sampling duration in seconds
     /// @param output_type Output graph type: "flamegraph" (default), "iciclegraph", etc.
@@ -149,14 +313,127 @@ public:
     /// @return Heap growth stacks in text format (compatible with pprof)
     std::string getRawHeapGrowthStacks();
 
+    /// @brief Capture a CPU profile and return it as folded stacks (for /api/cpu/folded endpoint)
+    /// @param seconds Sampling duration in seconds
+    /// @return One "root;...;leaf count" line per distinct stack, empty on failure
+    /// @note Symbolized in-process; does not run pprof or flamegraph.pl
+    std::string getFoldedCPUProfile(int seconds);
+
+    /// @brief Get the current heap sample as folded stacks (for /api/heap/folded endpoint)
+    /// @return One "root;...;leaf bytes" line per distinct stack, empty on failure
+    std::string getFoldedHeapSample();
+
+    /// @brief Get heap growth stacks as folded stacks (for /api/growth/folded endpoint)
+    /// @return One "root;...;leaf bytes" line per distinct stack, empty on failure
+    std::string getFoldedHeapGrowthStacks();
+
+    /// @brief Capture a CPU profile as hierarchical flame graph JSON (for /api/cpu/flamegraph_json endpoint)
+    /// @param seconds Sampling duration in seconds
+    /// @return {"type","unit","total","names":[...],"tree":[name,value,[children]]}, empty on failure
+    /// @note Only aggregates; rendering is left to the client (see /flamegraph.html)
+    std::string getCPUFlameGraphJson(int seconds);
+
+    /// @brief Get the current heap sample as flame graph JSON (for /api/heap/flamegraph_json endpoint)
+    /// @return Flame graph JSON with values in bytes, empty on failure
+    std::string getHeapFlameGraphJson();
+
+    /// @brief Get heap growth stacks as flame graph JSON (for /api/growth/flamegraph_json endpoint)
+    /// @return Flame graph JSON with values in bytes, empty on failure
+    std::string getHeapGrowthFlameGraphJson();
+
+    /// @brief Record a CPU timeline: every sample with its time and thread (for /api/cpu/timeline endpoint)
+    /// @param seconds Capture duration in seconds
+    /// @return Chrome trace event JSON (chrome://tracing, Perfetto), empty on failure
+    /// @note The capture is kept, so getTimelineFolded() and getTimelineFlameGraphJson() can zoom into it later
+    std::string getCPUTimelineTrace(int seconds);
+
+    /// @brief Whether getCPUTimelineTrace() has captured a timeline
+    bool hasCPUTimeline() const;
+
+    /// @brief Folded stacks of a window of the last timeline (for /api/cpu/folded?from=&to=)
+    /// @param from_ms Start of the window in milliseconds since the capture started
+    /// @param to_ms End of the window (exclusive), negative for the end of the capture
+    /// @return One "root;...;leaf count" line per distinct stack, empty without a timeline or samples
+    std::string getTimelineFolded(double from_ms, double to_ms);
+
+    /// @brief Flame graph JSON of a window of the last timeline (for /api/cpu/flamegraph_json?from=&to=)
+    /// @return Flame graph JSON with sample counts, empty without a timeline or samples
+    std::string getTimelineFlameGraphJson(double from_ms, double to_ms);
+
     /// @brief Get all thread stacks (for /api/thread/stacks endpoint)
     /// @return Thread stacks in text format
     std::string getThreadStacks();
 
+    /// @brief Set the frame depth of thread stack capture
+    /// @param depth Frames per thread; rounded up to 32, 64, 128 or 256 (the capture buffers are
+    ///        instantiated per depth), larger values are clamped to 256
+    /// @note Deeper stacks end with a "[truncated]" frame. Each thread slot costs about 8 bytes per frame.
+    void setThreadStackDepth(int depth);
+
+    /// @brief Get the frame depth of thread stack capture (default kDefaultThreadStackDepth)
+    int getThreadStackDepth() const;
+
     /// @brief Get thread callstack with full backtrace using signal handler
     /// @return Thread callstack information
     std::string getThreadCallStacks();
 
+    /// @brief Get thread callstacks as prefix-compressed JSON (for /api/thread/stacks?format=json)
+    /// @return JSON document with an interned frame table, a shared-prefix node tree and per-thread leaves
+    ///
+    /// Layout:
+    /// @code
+    /// {"frames":["start_thread","worker",...],       // each symbol appears once
+    ///  "nodes":[[-1,0],[0,1],...],                     // [parent_node, frame], root first
+    ///  "threads":[{"tid":1,"name":"..","state":"S","wchan":"..","node":1},...]}
+    /// @endcode
+    /// A thread's stack is recovered by following "node" up through parents to -1.
+    std::string getThreadCallStacksJson();
+
+    /// @brief Capture a CPU profile as an unsymbolized bundle (for /api/cpu/bundle endpoint)
+    /// @param seconds Sampling duration in seconds
+    /// @return Binary bundle of raw addresses and the module table, empty on failure
+    /// @note Nothing is symbolized in-process; use the profiler_symbolize tool offline
+    std::string getCPUProfileBundle(int seconds);
+
+    /// @brief Get the current heap sample as an unsymbolized bundle (for /api/heap/bundle endpoint)
+    /// @return Binary bundle with values in bytes, empty on failure
+    std::string getHeapSampleBundle();
+
+    /// @brief Get heap growth stacks as an unsymbolized bundle (for /api/growth/bundle endpoint)
+    /// @return Binary bundle with values in bytes, empty on failure
+    std::string getHeapGrowthBundle();
+
+    /// @brief Capture all thread stacks as an unsymbolized bundle (for /api/thread/stacks?format=bundle)
+    /// @return Binary bundle with one sample per thread (tid and name attached), empty on failure
+    std::string getThreadStacksBundle();
+
+    /// @brief Merge bundles from the functions above into one
+    ///
+    /// The bundles may come from different time slices or different processes;
+    /// modules are matched by build-id across load addresses (see
+    /// internal::mergeSymbolBundles() for the details).
+    /// @param bundles Encoded bundles, all of the same kind
+    /// @return Encoded merged bundle, empty if a bundle is corrupt or the kinds differ
+    std::string mergeProfileBundles(const std::vector<std::string>& bundles);
+
+    /// @brief Look up an output previously rendered from this profile data
+    /// @param data Profile the output is rendered from (hashed, not stored)
+    /// @param options Renderer and its options, e.g. "pprof-svg" or "flamegraph:CPU Flame Graph"
+    /// @param etag Receives the ETag of the output, on a hit or a miss
+    /// @return The cached bytes, shared with the cache rather than copied; nullptr on a miss
+    std::shared_ptr<const std::string> findRenderedOutput(const std::string& data, const std::string& options,
+                                                          std::string& etag);
+
+    /// @brief Keep a rendered output for later findRenderedOutput() calls
+    /// @note Least recently used outputs are dropped to stay within the byte budget
+    void storeRenderedOutput(const std::string& data, const std::string& options, const std::string& output);
+
+    /// @brief Set the byte budget of the rendered-output cache (default 32 MiB, 0 disables it)
+    void setRenderCacheBudget(size_t max_bytes);
+
+    /// @brief Get the usage of the rendered-output cache (for /api/status)
+    RenderCacheState getRenderCacheState() const;
+
     /// @brief Set the signal to use for stack capture
     /// @param signal Signal number to use (e.g., SIGUSR1, SIGUSR2, SIGRTMIN+n)
     /// @note Must be called before first use of stack capture functionality
@@ -167,6 +444,17 @@ public:
     /// @return Current signal number
     static int getStackCaptureSignal();
 
+    /// @brief Select the unwinder used by thread stack capture and the timeline and thread-timer samplers
+    /// @param unwinder Backtrace (default) or FramePointer
+    /// @note FramePointer is much cheaper per sample but only sees frames that keep a frame pointer
+    ///       (build with REMOTE_PROFILER_FRAME_POINTERS=ON); stacks where not even the caller of the
+    ///       interrupted function is found are captured with backtrace() instead. gperftools CPU
+    ///       profiles use gperftools' own unwinder.
+    static void setStackUnwinder(StackUnwinder unwinder);
+
+    /// @brief Get the selected stack unwinder
+    static StackUnwinder getStackUnwinder();
+
     /// @brief Enable/disable signal chaining
     /// @param enable true to enable chaining, false to disable
     /// @note When enabled, the old signal handler will be called after ours
@@ -179,6 +467,10 @@ public:
     /// @note This is a signal-safe function used internally
     static void signalHandler(int signum, siginfo_t* info, void* context);
 
+    /// @brief Wait until no signal handler can still read or write the capture slots
+    /// @note Call after clearing capture_in_progress_ and before freeing the slots
+    static void waitForCaptureHandlers();
+
     /// @brief Execute a shell command and capture output
     /// @param cmd Command to execute
     /// @param output Reference to store command output
@@ -205,13 +497,107 @@ private:
     std::string generateFlameGraph(const std::string& collapsed_file, const std::string& title);
 
     /// @brief Capture stack traces from all threads using signals
-    /// @return Vector of ThreadStackTrace structures
-    std::vector<ThreadStackTrace> captureAllThreadStacks();
+    /// @tparam MaxDepth Frames per thread
+    /// @return Vector of BasicThreadStackTrace structures
+    template <int MaxDepth>
+    std::vector<BasicThreadStackTrace<MaxDepth>> captureAllThreadStacks();
 
-    /// @brief Symbolize an address using abseil
+    /// @brief Capture at the configured depth and pass the traces to `fn`
+    /// @return What `fn` returns
+    template <typename Fn>
+    auto withThreadStacks(Fn&& fn);
+
+    /// @brief Text report of captured stacks (getThreadCallStacks())
+    template <int MaxDepth>
+    std::string formatThreadCallStacks(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks);
+
+    /// @brief Prefix-compressed JSON of captured stacks (getThreadCallStacksJson())
+    template <int MaxDepth>
+    std::string formatThreadCallStacksJson(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks);
+
+    /// @brief Unsymbolized bundle of captured stacks (getThreadStacksBundle())
+    template <int MaxDepth>
+    std::string encodeThreadStacksBundle(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks);
+
+    /// @brief Threads of resolveSymbolsBatch(), started on first use
+    internal::WorkerPool& symbolizePool();
+
+    /// @brief Take an idle batch symbolizer, creating one if there is none
+    /// @return nullptr if no symbolizer can be created
+    std::unique_ptr<Symbolizer> acquireBatchSymbolizer();
+
+    /// @brief Keep a batch symbolizer for the next resolveSymbolsBatch() worker
+    void releaseBatchSymbolizer(std::unique_ptr<Symbolizer> symbolizer);
+
+    /// @brief Symbolize an address (abseil, then backward-cpp) into the process-wide symbol name pool
     /// @param addr Address to symbolize
-    /// @return Human-readable symbol string
-    std::string symbolizeAddress(void* addr);
+    /// @param scope Holds the hex address if it cannot be resolved
+    /// @return ID of the name, to be viewed through `scope`
+    uint32_t symbolizeAddressId(void* addr, internal::NameScope& scope);
+
+    /// @brief Resolve frame names for folded output without spawning addr2line
+    /// @param address Caller-adjusted program counter
+    /// @param scope Holds the names made up for this render ("_[i]" marked
+    ///        inlined calls, hex addresses)
+    /// @return IDs of the function names, innermost first, or of the hex
+    ///         address if it cannot be resolved
+    std::vector<uint32_t> resolveFrameName(uintptr_t address, internal::NameScope& scope);
+
+    /// @brief Source position of an address from the module's DWARF line table
+    /// @param address Program counter (callers should pass return address - 1)
+    /// @return "file:line", or an empty string if there is no line information
+    std::string sourceLocation(uintptr_t address);
+
+    /// @brief Capture (CPU) or fetch (heap, growth) a profile in its raw format
+    /// @param seconds CPU sampling duration in seconds (ignored for heap types)
+    /// @return The profile, empty on failure
+    std::string collectProfileData(ProfilerType type, int seconds);
+
+    /// @brief Capture (CPU) or fetch (heap, growth) a profile and fold its stacks
+    /// @param type Which profile to collect
+    /// @param seconds CPU sampling duration in seconds (ignored for heap types)
+    /// @param folded Receives root-first folded stack -> value
+    /// @return true if at least one stack was collected
+    bool collectFoldedStacks(ProfilerType type, int seconds, std::map<std::string, uint64_t>& folded);
+
+    /// @brief getRawCPUProfile() body for the ThreadTimers backend
+    /// @return gperftools CPU profile of all threads, empty on failure
+    std::string captureThreadTimerProfile(int seconds);
+
+    /// @brief Samples of the last timeline within [from_ms, to_ms) (to_ms < 0 = up to the end)
+    /// @return false if there is no timeline
+    bool timelineSamples(double from_ms, double to_ms, internal::ParsedProfile& profile);
+
+    /// @brief Fold the samples of the last timeline within [from_ms, to_ms) (to_ms < 0 = up to the end)
+    /// @return true if at least one stack was collected
+    bool foldTimeline(double from_ms, double to_ms, std::map<std::string, uint64_t>& folded);
+
+    /// @brief Parse raw profile data (CPU binary or heap text format)
+    bool parseProfileData(ProfilerType type, const std::string& data, internal::ParsedProfile& profile);
+
+    /// @brief Parse and fold raw profile data (CPU binary or heap text format)
+    bool foldProfileData(ProfilerType type, const std::string& data, std::map<std::string, uint64_t>& folded);
+
+    /// @brief Symbolize a profile straight into a flame graph tree, as name IDs (no folded text)
+    /// @return FlameTree::toJson() of the tree, empty if the profile has no stack
+    std::string flameGraphJson(const internal::ParsedProfile& profile, const std::string& type,
+                               const std::string& unit);
+
+    /// @brief Fold a profile file into a collapsed-stack file for flamegraph.pl
+    /// @return false if the profile cannot be read, parsed or written
+    bool writeCollapsedStacks(ProfilerType type, const std::string& profile_path, const std::string& collapsed_file);
+
+    /// @brief Capture (CPU) or fetch (heap, growth) a profile as an unsymbolized bundle
+    std::string getProfileBundle(ProfilerType type, int seconds);
+
+    /// @brief Attach the modules the bundle's addresses fall into and serialize it
+    std::string encodeBundle(internal::SymbolBundle& bundle);
+
+    /// @brief Body of the warmup thread started by startSymbolWarmup()
+    void runSymbolWarmup(SymbolWarmupOptions options);
+
+    /// @brief Body of the detector thread started by startStuckThreadDetector()
+    void runStuckThreadDetector(StuckThreadOptions options);
 
     /// @brief Install signal handler (saves old handler)
     void installSignalHandler();
@@ -226,11 +612,45 @@ private:
     std::unique_ptr<internal::LogManager> log_manager_;  ///< Per-instance log manager (PIMPL)
     std::atomic<bool> cpu_profiling_in_progress_{false}; ///< CPU profiling concurrency control
     std::unique_ptr<Symbolizer> symbolizer_;             ///< Symbolizer instance
+    std::shared_ptr<internal::ModuleMap> module_map_;    ///< Loaded modules and per-module resolvers
     bool signal_handler_installed_{false};               ///< Whether signal handler has been installed
 
+    std::thread warmup_thread_;         ///< Background symbol warmup (see startSymbolWarmup)
+    mutable std::mutex warmup_mutex_;   ///< Guards warmup_state_ and warmup_stop_
+    std::condition_variable warmup_cv_; ///< Wakes the warmup thread from its budget pause
+    bool warmup_stop_{false};           ///< Set to ask the warmup thread to exit
+    SymbolWarmupState warmup_state_;    ///< Progress reported by /api/status
+
+    std::thread watchdog_thread_;                ///< Stuck-thread detector (see startStuckThreadDetector)
+    mutable std::mutex watchdog_mutex_;          ///< Guards the watchdog_ fields and stuck_threads_
+    std::condition_variable watchdog_cv_;        ///< Wakes the detector from its interval wait
+    bool watchdog_stop_{false};                  ///< Set to ask the detector to exit
+    bool watchdog_running_{false};               ///< Whether the detector thread is active
+    StuckThreadOptions watchdog_options_;        ///< Options of the running detector
+    std::map<pid_t, StuckThread> stuck_threads_; ///< Threads reported and still stuck
+
+    std::unique_ptr<internal::RenderCache> render_cache_;             ///< Rendered SVGs by profile digest and options
+    std::unique_ptr<internal::ThreadMetadataReader> thread_metadata_; ///< Thread names and states from /proc
+
+    std::mutex symbolize_mutex_;                                ///< Guards symbolize_pool_ and idle_symbolizers_
+    std::vector<std::unique_ptr<Symbolizer>> idle_symbolizers_; ///< Batch symbolizers kept between requests
+    std::unique_ptr<internal::WorkerPool> symbolize_pool_;      ///< See symbolizePool()
+
+    mutable std::mutex timeline_mutex_;                          ///< Guards last_timeline_
+    std::shared_ptr<const internal::CpuTimeline> last_timeline_; ///< Last capture of getCPUTimelineTrace()
+
+    std::atomic<CpuProfilerBackend> cpu_backend_{CpuProfilerBackend::Gperftools}; ///< See setCPUProfilerBackend()
+    std::unique_ptr<internal::ThreadCpuSampler> thread_sampler_;                   ///< Running ThreadTimers session
+    std::atomic<int> thread_stack_depth_{kDefaultThreadStackDepth};                ///< See setThreadStackDepth()
+
+    static std::mutex capture_mutex_;              ///< Serializes captures (the slots below are shared)
     static std::atomic<bool> capture_in_progress_; ///< Stack capture in progress flag
-    static SharedStackTrace* shared_stacks_;       ///< Shared stack trace array
-    static int stack_array_size_;                  ///< Size of stack array
+    static std::atomic<int> capture_handlers_;     ///< Handlers that passed the flag check and may use the slots
+    static std::vector<pid_t> unanswered_tids_;    ///< Timed out on the signal; skipped while it is pending
+    static void* shared_stacks_;                   ///< BasicSharedStackTrace<shared_stack_depth_> array
+    static int shared_stack_depth_;                ///< MaxDepth of the shared_stacks_ slots
+    static int stack_array_size_;                  ///< Number of slots in shared_stacks_
+    static const pid_t* slot_tids_;                ///< Sorted tids, mapped after the slots; slot i is slot_tids_[i]
     static std::atomic<pid_t> excluded_tid_;       ///< Thread ID to exclude from capture
     static std::atomic<int> completed_count_;      ///< Count of completed captures
     static int expected_count_;                    ///< Expected number of threads to capture
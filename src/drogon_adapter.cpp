@@ -2,7 +2,9 @@
 /// @brief Drogon integration: registers profiler routes via ProfilerHttpHandlers
 
 #include "profiler/drogon_adapter.h"
+#include "internal/http_compression.h"
 #include "internal/web_resources.h"
+#include "internal/worker_pool.h"
 #include "profiler/http_handlers.h"
 #include <drogon/drogon.h>
 #include <iostream>
@@ -10,7 +12,13 @@
 PROFILER_NAMESPACE_BEGIN
 
 /// Helper: adapt HandlerResponse to Drogon HttpResponse
-static void sendResponse(const HandlerResponse& hr, std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+/// (304 Not Modified if the request's If-None-Match holds the response's ETag,
+/// otherwise compressed as the request's Accept-Encoding allows)
+static void sendResponse(const drogon::HttpRequestPtr& req, HandlerResponse hr,
+                         std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+    hr = ProfilerHttpHandlers::conditional(std::move(hr), req->getHeader("If-None-Match"));
+    hr = ProfilerHttpHandlers::compress(std::move(hr), req->getHeader("Accept-Encoding"));
+
     auto resp = drogon::HttpResponse::newHttpResponse();
     resp->setStatusCode(static_cast<drogon::HttpStatusCode>(hr.status));
     resp->setBody(hr.body);
@@ -34,60 +42,104 @@ static void sendResponse(const HandlerResponse& hr, std::function<void(const dro
     callback(resp);
 }
 
-void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
-    auto handlers = std::make_shared<ProfilerHttpHandlers>(profiler);
+/// Helper: run a handler on the worker pool and send its response from there
+/// (503 if every worker is busy and the queue is full)
+static void respondAsync(internal::WorkerPool& pool, const drogon::HttpRequestPtr& req,
+                         std::function<HandlerResponse()> handler,
+                         std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+    // Shared so the callback is still here if the pool refuses the task
+    auto shared_callback = std::make_shared<std::function<void(const drogon::HttpResponsePtr&)>>(std::move(callback));
+    bool queued = pool.submit([req, handler = std::move(handler), shared_callback] {
+        sendResponse(req, handler(), std::move(*shared_callback));
+    });
+    if (!queued) {
+        auto resp = HandlerResponse::error(503, "Profiler workers are busy, retry later");
+        resp.headers["Retry-After"] = "5";
+        sendResponse(req, resp, std::move(*shared_callback));
+    }
+}
+
+/// Helper: read the from/to window (milliseconds into the last CPU timeline)
+/// @return false if the request has neither parameter
+static bool timeRange(const drogon::HttpRequestPtr& req, double& from_ms, double& to_ms) {
+    auto from = req->getParameter("from");
+    auto to = req->getParameter("to");
+    if (from.empty() && to.empty()) {
+        return false;
+    }
+    from_ms = 0;
+    to_ms = -1;
+    try {
+        if (!from.empty()) {
+            from_ms = std::stod(from);
+        }
+        if (!to.empty()) {
+            to_ms = std::stod(to);
+        }
+    } catch (...) {}
+    return true;
+}
+
+void registerDrogonHandlers(profiler::ProfilerManager& profiler, const SchedulerOptions& options,
+                            const WorkerPoolOptions& pool_options) {
+    auto handlers = std::make_shared<ProfilerHttpHandlers>(profiler, options);
+    auto pool = std::make_shared<internal::WorkerPool>(pool_options.threads, pool_options.max_queued,
+                                                       pool_options.cpu_affinity, "profiler-http");
 
     // --- GET routes ---
     auto registerGet = [&](const std::string& path, auto fn) {
         drogon::app().registerHandler(
             path,
-            [handlers, fn = std::move(fn)]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                           std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                sendResponse(((*handlers).*fn)(), std::move(callback));
+            [handlers, pool, fn = std::move(fn)]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                 std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                respondAsync(*pool, req, [handlers, fn] { return ((*handlers).*fn)(); }, std::move(callback));
             },
             {drogon::Get});
     };
 
-    // --- Static pages (served directly via WebResources) ---
-    drogon::app().registerHandler("/",
-                                  []([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                     std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                                      sendResponse(HandlerResponse::html(WebResources::getIndexPage()),
-                                                   std::move(callback));
-                                  },
-                                  {drogon::Get});
-    drogon::app().registerHandler("/show_svg.html",
-                                  []([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                     std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                                      sendResponse(HandlerResponse::html(WebResources::getCpuSvgViewerPage()),
-                                                   std::move(callback));
-                                  },
-                                  {drogon::Get});
-    drogon::app().registerHandler("/show_heap_svg.html",
-                                  []([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                     std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                                      sendResponse(HandlerResponse::html(WebResources::getHeapSvgViewerPage()),
-                                                   std::move(callback));
-                                  },
-                                  {drogon::Get});
-    drogon::app().registerHandler("/show_growth_svg.html",
-                                  []([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                     std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                                      sendResponse(HandlerResponse::html(WebResources::getGrowthSvgViewerPage()),
-                                                   std::move(callback));
-                                  },
-                                  {drogon::Get});
+    // --- Static pages (compressed once here, then served from memory) ---
+    auto registerPage = [&](const std::string& path, const std::string& html) {
+        auto page = std::make_shared<const internal::PrecompressedResponse>(HandlerResponse::html(html));
+        drogon::app().registerHandler(
+            path,
+            [page](const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                sendResponse(req, page->select(req->getHeader("Accept-Encoding")), std::move(callback));
+            },
+            {drogon::Get});
+    };
+    registerPage("/", WebResources::getIndexPage());
+    registerPage("/show_svg.html", WebResources::getCpuSvgViewerPage());
+    registerPage("/show_heap_svg.html", WebResources::getHeapSvgViewerPage());
+    registerPage("/show_growth_svg.html", WebResources::getGrowthSvgViewerPage());
+    registerPage("/flamegraph.html", WebResources::getFlameGraphViewerPage());
 
     // --- Status ---
     registerGet("/api/status", &ProfilerHttpHandlers::handleStatus);
 
     // --- Thread stacks ---
-    registerGet("/api/thread/stacks", &ProfilerHttpHandlers::handleThreadStacks);
+    drogon::app().registerHandler("/api/thread/stacks",
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      auto format = req->getParameter("format");
+                                      if (format == "json") {
+                                          auto handler = [=] { return handlers->handleThreadStacksJson(); };
+                                          respondAsync(*pool, req, handler, std::move(callback));
+                                      } else if (format == "bundle") {
+                                          auto handler = [=] { return handlers->handleThreadStacksBundle(); };
+                                          respondAsync(*pool, req, handler, std::move(callback));
+                                      } else {
+                                          auto handler = [=] { return handlers->handleThreadStacks(); };
+                                          respondAsync(*pool, req, handler, std::move(callback));
+                                      }
+                                  },
+                                  {drogon::Get});
+
+    registerGet("/api/thread/stuck", &ProfilerHttpHandlers::handleThreadStuck);
 
     // --- Standard pprof: /pprof/profile ---
     drogon::app().registerHandler("/pprof/profile",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       int seconds = 30;
                                       auto p = req->getParameter("seconds");
                                       if (!p.empty()) {
@@ -99,7 +151,8 @@ void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
                                           if (seconds > 300)
                                               seconds = 300;
                                       }
-                                      sendResponse(handlers->handlePprofProfile(seconds), std::move(callback));
+                                      auto handler = [=] { return handlers->handlePprofProfile(seconds); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get});
 
@@ -111,17 +164,18 @@ void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
 
     // --- /pprof/symbol (POST) ---
     drogon::app().registerHandler("/pprof/symbol",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
-                                      sendResponse(handlers->handlePprofSymbol(std::string(req->body())),
-                                                   std::move(callback));
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      std::string body(req->body());
+                                      auto handler = [=] { return handlers->handlePprofSymbol(body); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Post});
 
     // --- CPU analyze ---
     drogon::app().registerHandler("/api/cpu/analyze",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       int duration = 10;
                                       auto dp = req->getParameter("duration");
                                       if (!dp.empty()) {
@@ -132,15 +186,15 @@ void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
                                       std::string output_type = req->getParameter("output_type");
                                       if (output_type.empty())
                                           output_type = "pprof";
-                                      sendResponse(handlers->handleCpuAnalyze(duration, output_type),
-                                                   std::move(callback));
+                                      auto handler = [=] { return handlers->handleCpuAnalyze(duration, output_type); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get, drogon::Post});
 
     // --- CPU raw SVG ---
     drogon::app().registerHandler("/api/cpu/svg_raw",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       int duration = 10;
                                       auto dp = req->getParameter("duration");
                                       if (!dp.empty()) {
@@ -148,14 +202,97 @@ void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
                                               duration = std::stoi(dp);
                                           } catch (...) {}
                                       }
-                                      sendResponse(handlers->handleCpuSvgRaw(duration), std::move(callback));
+                                      auto handler = [=] { return handlers->handleCpuSvgRaw(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get});
 
     // --- CPU FlameGraph raw ---
     drogon::app().registerHandler("/api/cpu/flamegraph_raw",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      int duration = 10;
+                                      auto dp = req->getParameter("duration");
+                                      if (!dp.empty()) {
+                                          try {
+                                              duration = std::stoi(dp);
+                                          } catch (...) {}
+                                      }
+                                      auto handler = [=] { return handlers->handleCpuFlamegraphRaw(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
+                                  },
+                                  {drogon::Get});
+
+    // --- CPU folded stacks ---
+    drogon::app().registerHandler("/api/cpu/folded",
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      int duration = 10;
+                                      auto dp = req->getParameter("duration");
+                                      if (!dp.empty()) {
+                                          try {
+                                              duration = std::stoi(dp);
+                                          } catch (...) {}
+                                      }
+                                      double from_ms = 0;
+                                      double to_ms = -1;
+                                      if (timeRange(req, from_ms, to_ms)) {
+                                          auto handler = [=] {
+                                              return handlers->handleCpuTimelineFolded(from_ms, to_ms);
+                                          };
+                                          respondAsync(*pool, req, handler, std::move(callback));
+                                          return;
+                                      }
+                                      auto handler = [=] { return handlers->handleCpuFolded(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
+                                  },
+                                  {drogon::Get});
+
+    // --- CPU flame graph JSON (rendered client-side by /flamegraph.html) ---
+    drogon::app().registerHandler("/api/cpu/flamegraph_json",
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      int duration = 10;
+                                      auto dp = req->getParameter("duration");
+                                      if (!dp.empty()) {
+                                          try {
+                                              duration = std::stoi(dp);
+                                          } catch (...) {}
+                                      }
+                                      double from_ms = 0;
+                                      double to_ms = -1;
+                                      if (timeRange(req, from_ms, to_ms)) {
+                                          auto handler = [=] {
+                                              return handlers->handleCpuTimelineFlamegraphJson(from_ms, to_ms);
+                                          };
+                                          respondAsync(*pool, req, handler, std::move(callback));
+                                          return;
+                                      }
+                                      auto handler = [=] { return handlers->handleCpuFlamegraphJson(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
+                                  },
+                                  {drogon::Get});
+
+    // --- CPU unsymbolized bundle (symbolized offline by profiler_symbolize) ---
+    drogon::app().registerHandler("/api/cpu/bundle",
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                      int duration = 10;
+                                      auto dp = req->getParameter("duration");
+                                      if (!dp.empty()) {
+                                          try {
+                                              duration = std::stoi(dp);
+                                          } catch (...) {}
+                                      }
+                                      auto handler = [=] { return handlers->handleCpuBundle(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
+                                  },
+                                  {drogon::Get});
+
+    // --- CPU timeline (Chrome trace JSON; kept for /api/cpu/folded and flamegraph_json ?from=&to=) ---
+    drogon::app().registerHandler("/api/cpu/timeline",
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       int duration = 10;
                                       auto dp = req->getParameter("duration");
                                       if (!dp.empty()) {
@@ -163,39 +300,48 @@ void registerDrogonHandlers(profiler::ProfilerManager& profiler) {
                                               duration = std::stoi(dp);
                                           } catch (...) {}
                                       }
-                                      sendResponse(handlers->handleCpuFlamegraphRaw(duration), std::move(callback));
+                                      auto handler = [=] { return handlers->handleCpuTimeline(duration); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get});
 
     // --- Heap analyze ---
     drogon::app().registerHandler("/api/heap/analyze",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       std::string output_type = req->getParameter("output_type");
                                       if (output_type.empty())
                                           output_type = "pprof";
-                                      sendResponse(handlers->handleHeapAnalyze(output_type), std::move(callback));
+                                      auto handler = [=] { return handlers->handleHeapAnalyze(output_type); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get});
 
     // --- Heap raw / FlameGraph ---
     registerGet("/api/heap/svg_raw", &ProfilerHttpHandlers::handleHeapSvgRaw);
     registerGet("/api/heap/flamegraph_raw", &ProfilerHttpHandlers::handleHeapFlamegraphRaw);
+    registerGet("/api/heap/folded", &ProfilerHttpHandlers::handleHeapFolded);
+    registerGet("/api/heap/flamegraph_json", &ProfilerHttpHandlers::handleHeapFlamegraphJson);
+    registerGet("/api/heap/bundle", &ProfilerHttpHandlers::handleHeapBundle);
 
     // --- Growth analyze ---
     drogon::app().registerHandler("/api/growth/analyze",
-                                  [handlers]([[maybe_unused]] const drogon::HttpRequestPtr& req,
-                                             std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+                                  [handlers, pool]([[maybe_unused]] const drogon::HttpRequestPtr& req,
+                                                   std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
                                       std::string output_type = req->getParameter("output_type");
                                       if (output_type.empty())
                                           output_type = "pprof";
-                                      sendResponse(handlers->handleGrowthAnalyze(output_type), std::move(callback));
+                                      auto handler = [=] { return handlers->handleGrowthAnalyze(output_type); };
+                                      respondAsync(*pool, req, handler, std::move(callback));
                                   },
                                   {drogon::Get});
 
     // --- Growth raw / FlameGraph ---
     registerGet("/api/growth/svg_raw", &ProfilerHttpHandlers::handleGrowthSvgRaw);
     registerGet("/api/growth/flamegraph_raw", &ProfilerHttpHandlers::handleGrowthFlamegraphRaw);
+    registerGet("/api/growth/folded", &ProfilerHttpHandlers::handleGrowthFolded);
+    registerGet("/api/growth/flamegraph_json", &ProfilerHttpHandlers::handleGrowthFlamegraphJson);
+    registerGet("/api/growth/bundle", &ProfilerHttpHandlers::handleGrowthBundle);
 }
 
 PROFILER_NAMESPACE_END
@@ -2,10 +2,19 @@
 /// @brief Framework-agnostic HTTP endpoint handlers implementation
 
 #include "profiler/http_handlers.h"
+#include "internal/http_compression.h"
+#include "internal/json_util.h"
+#include "internal/render_cache.h"
+#include "internal/request_scheduler.h"
 #include "profiler_manager.h"
+#include <cctype>
+#include <charconv>
 #include <chrono>
 #include <fstream>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 PROFILER_NAMESPACE_BEGIN
 
@@ -21,6 +30,14 @@ static bool validateOutputType(const std::string& output_type) {
     return output_type == "flamegraph" || output_type == "pprof";
 }
 
+// Entity tag without its weak indicator
+static std::string_view opaqueTag(std::string_view tag) {
+    if (tag.starts_with("W/")) {
+        tag.remove_prefix(2);
+    }
+    return tag;
+}
+
 static int clampDuration(int duration, int lo, int hi) {
     if (duration < lo)
         return lo;
@@ -33,7 +50,37 @@ static int clampDuration(int duration, int lo, int hi) {
 // ProfilerHttpHandlers
 // ---------------------------------------------------------------------------
 
-ProfilerHttpHandlers::ProfilerHttpHandlers(ProfilerManager& profiler) : profiler_(profiler) {}
+ProfilerHttpHandlers::ProfilerHttpHandlers(ProfilerManager& profiler, const SchedulerOptions& options)
+    : profiler_(profiler), scheduler_(std::make_unique<internal::RequestScheduler>(options)) {}
+
+ProfilerHttpHandlers::~ProfilerHttpHandlers() = default;
+
+void ProfilerHttpHandlers::setSchedulerOptions(const SchedulerOptions& options) {
+    scheduler_->setOptions(options);
+}
+
+HandlerResponse ProfilerHttpHandlers::schedule(const std::string& endpoint_class, const std::string& key,
+                                               const std::function<HandlerResponse()>& handler) {
+    return scheduler_->run(endpoint_class, key, handler);
+}
+
+HandlerResponse ProfilerHttpHandlers::renderCached(const std::string& data, const std::string& options,
+                                                   const std::function<HandlerResponse()>& render) {
+    std::string etag;
+    if (auto cached = profiler_.findRenderedOutput(data, options, etag)) {
+        // The one copy of a hit: HandlerResponse owns its body
+        auto resp = HandlerResponse::svg(*cached);
+        resp.headers["ETag"] = etag;
+        return resp;
+    }
+
+    auto resp = render();
+    if (resp.status == 200) {
+        profiler_.storeRenderedOutput(data, options, resp.body);
+        resp.headers["ETag"] = etag;
+    }
+    return resp;
+}
 
 // --- Status ---
 
@@ -41,6 +88,12 @@ HandlerResponse ProfilerHttpHandlers::handleStatus() {
     auto cpu = profiler_.getProfilerState(ProfilerType::CPU);
     auto heap = profiler_.getProfilerState(ProfilerType::HEAP);
     auto growth = profiler_.getProfilerState(ProfilerType::HEAP_GROWTH);
+    auto warmup = profiler_.getSymbolWarmupState();
+    auto cache = profiler_.getRenderCacheState();
+    auto scheduler = scheduler_->stats();
+
+    std::string current_module;
+    internal::appendJsonString(current_module, warmup.current_module);
 
     std::ostringstream json;
     json << "{";
@@ -49,7 +102,16 @@ HandlerResponse ProfilerHttpHandlers::handleStatus() {
     json << "\"heap\":{\"running\":" << (heap.is_running ? "true" : "false") << ",\"output_path\":\""
          << heap.output_path << "\"" << ",\"duration_ms\":" << heap.duration << "},";
     json << "\"growth\":{\"running\":" << (growth.is_running ? "true" : "false") << ",\"output_path\":\""
-         << growth.output_path << "\"" << ",\"duration_ms\":" << growth.duration << "}";
+         << growth.output_path << "\"" << ",\"duration_ms\":" << growth.duration << "},";
+    json << "\"symbol_warmup\":{\"running\":" << (warmup.running ? "true" : "false")
+         << ",\"finished\":" << (warmup.finished ? "true" : "false") << ",\"modules_done\":" << warmup.modules_done
+         << ",\"modules_total\":" << warmup.modules_total << ",\"cpu_ms\":" << warmup.cpu_ms
+         << ",\"elapsed_ms\":" << warmup.elapsed_ms << ",\"current_module\":" << current_module << "},";
+    json << "\"render_cache\":{\"entries\":" << cache.entries << ",\"bytes\":" << cache.bytes
+         << ",\"max_bytes\":" << cache.max_bytes << ",\"hits\":" << cache.hits << ",\"misses\":" << cache.misses
+         << "},";
+    json << "\"scheduler\":{\"running\":" << scheduler.running << ",\"admitted\":" << scheduler.admitted
+         << ",\"coalesced\":" << scheduler.coalesced << ",\"rejected\":" << scheduler.rejected << "}";
     json << "}";
 
     return HandlerResponse::json(json.str());
@@ -64,101 +126,198 @@ HandlerResponse ProfilerHttpHandlers::handleCpuAnalyze(int duration, const std::
         return errorResp(400, "Invalid output_type. Must be 'flamegraph' or 'pprof'");
     }
 
-    std::string svg = profiler_.analyzeCPUProfile(duration, output_type);
+    return schedule("cpu", "cpu/analyze?duration=" + std::to_string(duration) + "&output_type=" + output_type, [&] {
+        std::string svg = profiler_.analyzeCPUProfile(duration, output_type);
 
-    if (svg.size() > 10 && svg[0] == '{' && svg[1] == '"') {
-        return errorResp(500, svg);
-    }
+        if (svg.size() > 10 && svg[0] == '{' && svg[1] == '"') {
+            return errorResp(500, svg);
+        }
 
-    return HandlerResponse::svg(svg);
+        return HandlerResponse::svg(svg);
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleCpuSvgRaw(int duration) {
     duration = clampDuration(duration, 1, 300);
 
-    std::string profile_data = profiler_.getRawCPUProfile(duration);
-    if (profile_data.empty()) {
-        return errorResp(500, "Failed to generate CPU profile");
-    }
+    return schedule("cpu", "cpu/svg_raw?duration=" + std::to_string(duration), [&] {
+        std::string profile_data = profiler_.getRawCPUProfile(duration);
+        if (profile_data.empty()) {
+            return errorResp(500, "Failed to generate CPU profile");
+        }
 
-    std::string temp_file = "/tmp/cpu_raw.prof";
-    {
-        std::ofstream out(temp_file, std::ios::binary);
-        out.write(profile_data.data(), profile_data.size());
-    }
+        auto resp = renderCached(profile_data, "pprof-svg", [&] {
+            std::string temp_file = "/tmp/cpu_raw.prof";
+            {
+                std::ofstream out(temp_file, std::ios::binary);
+                out.write(profile_data.data(), profile_data.size());
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(cmd, svg);
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(cmd, svg);
 
-    size_t pos = svg.find("<?xml");
-    if (pos == std::string::npos)
-        pos = svg.find("<svg");
-    if (pos != std::string::npos && pos > 0)
-        svg = svg.substr(pos);
+            size_t pos = svg.find("<?xml");
+            if (pos == std::string::npos)
+                pos = svg.find("<svg");
+            if (pos != std::string::npos && pos > 0)
+                svg = svg.substr(pos);
 
-    if (svg.empty() || svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate SVG: insufficient CPU samples collected.");
-    }
+            if (svg.empty() || svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate SVG: insufficient CPU samples collected.");
+            }
+            return HandlerResponse::svg(svg);
+        });
 
-    auto resp = HandlerResponse::svg(svg);
-    resp.headers["Content-Disposition"] = "attachment; filename=cpu_profile.svg";
-    return resp;
+        if (resp.status == 200)
+            resp.headers["Content-Disposition"] = "attachment; filename=cpu_profile.svg";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleCpuFlamegraphRaw(int duration) {
     duration = clampDuration(duration, 1, 300);
 
-    std::string profile_data = profiler_.getRawCPUProfile(duration);
-    if (profile_data.empty()) {
-        return errorResp(500, "Failed to generate CPU profile");
-    }
+    return schedule("cpu", "cpu/flamegraph_raw?duration=" + std::to_string(duration), [&] {
+        std::string profile_data = profiler_.getRawCPUProfile(duration);
+        if (profile_data.empty()) {
+            return errorResp(500, "Failed to generate CPU profile");
+        }
 
-    std::string temp_file = "/tmp/cpu_raw.prof";
-    {
-        std::ofstream out(temp_file, std::ios::binary);
-        out.write(profile_data.data(), profile_data.size());
-    }
+        auto resp = renderCached(profile_data, "flamegraph:CPU Flame Graph", [&] {
+            std::string temp_file = "/tmp/cpu_raw.prof";
+            {
+                std::ofstream out(temp_file, std::ios::binary);
+                out.write(profile_data.data(), profile_data.size());
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string collapsed_file = "/tmp/cpu_collapsed.prof";
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string collapsed_file = "/tmp/cpu_collapsed.prof";
 
-    std::ostringstream cmd;
-    cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
-    std::string out;
-    if (!profiler_.executeCommand(cmd.str(), out)) {
-        return errorResp(500, "Failed to execute pprof --collapsed command");
-    }
+            std::ostringstream cmd;
+            cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
+            std::string out;
+            if (!profiler_.executeCommand(cmd.str(), out)) {
+                return errorResp(500, "Failed to execute pprof --collapsed command");
+            }
+
+            // Verify collapsed data
+            std::ifstream in(collapsed_file);
+            if (!in.is_open())
+                return errorResp(500, "Failed to create collapsed file");
+            std::string line;
+            bool has_data = false;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    has_data = true;
+                    break;
+                }
+            }
+            in.close();
+            if (!has_data)
+                return errorResp(500, "pprof --collapsed produced no data.");
+
+            std::string fg_cmd =
+                "perl ./flamegraph.pl --title=\"CPU Flame Graph\" --width=1200 " + collapsed_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(fg_cmd, svg);
+
+            if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate FlameGraph: insufficient CPU samples.");
+            }
+            return HandlerResponse::svg(svg);
+        });
+
+        if (resp.status == 200)
+            resp.headers["Content-Disposition"] =
+                "attachment; filename=cpu_flamegraph_" + std::to_string(duration) + "s.svg";
+        return resp;
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleCpuFolded(int duration) {
+    duration = clampDuration(duration, 1, 300);
+
+    return schedule("cpu", "cpu/folded?duration=" + std::to_string(duration), [&] {
+        std::string folded = profiler_.getFoldedCPUProfile(duration);
+        if (folded.empty()) {
+            return errorResp(500, "Failed to generate folded CPU stacks: insufficient CPU samples collected.");
+        }
+
+        return HandlerResponse::text(folded);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleCpuFlamegraphJson(int duration) {
+    duration = clampDuration(duration, 1, 300);
+
+    return schedule("cpu", "cpu/flamegraph_json?duration=" + std::to_string(duration), [&] {
+        std::string json = profiler_.getCPUFlameGraphJson(duration);
+        if (json.empty()) {
+            return errorResp(500, "Failed to generate CPU flame graph data: insufficient CPU samples collected.");
+        }
+
+        return HandlerResponse::json(json);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleCpuBundle(int duration) {
+    duration = clampDuration(duration, 1, 300);
+
+    return schedule("cpu", "cpu/bundle?duration=" + std::to_string(duration), [&] {
+        std::string bundle = profiler_.getCPUProfileBundle(duration);
+        if (bundle.empty()) {
+            return errorResp(500, "Failed to generate CPU bundle: insufficient CPU samples collected.");
+        }
+
+        return HandlerResponse::binary(bundle, "cpu.bundle");
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleCpuTimeline(int duration) {
+    duration = clampDuration(duration, 1, 300);
 
-    // Verify collapsed data
-    std::ifstream in(collapsed_file);
-    if (!in.is_open())
-        return errorResp(500, "Failed to create collapsed file");
-    std::string line;
-    bool has_data = false;
-    while (std::getline(in, line)) {
-        if (!line.empty() && line[0] != '#') {
-            has_data = true;
-            break;
+    return schedule("cpu", "cpu/timeline?duration=" + std::to_string(duration), [&] {
+        std::string trace = profiler_.getCPUTimelineTrace(duration);
+        if (trace.empty()) {
+            return errorResp(500, "Failed to record CPU timeline: insufficient CPU samples collected.");
         }
+
+        return HandlerResponse::json(trace);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleCpuTimelineFolded(double from_ms, double to_ms) {
+    if (!profiler_.hasCPUTimeline()) {
+        return errorResp(404, "No CPU timeline recorded yet; capture one with /api/cpu/timeline first.");
     }
-    in.close();
-    if (!has_data)
-        return errorResp(500, "pprof --collapsed produced no data.");
 
-    std::string fg_cmd =
-        "perl ./flamegraph.pl --title=\"CPU Flame Graph\" --width=1200 " + collapsed_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(fg_cmd, svg);
+    std::string key = "cpu/timeline/folded?from=" + std::to_string(from_ms) + "&to=" + std::to_string(to_ms);
+    return schedule("symbol", key, [&] {
+        std::string folded = profiler_.getTimelineFolded(from_ms, to_ms);
+        if (folded.empty()) {
+            return errorResp(404, "No CPU timeline samples in the requested range.");
+        }
+
+        return HandlerResponse::text(folded);
+    });
+}
 
-    if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate FlameGraph: insufficient CPU samples.");
+HandlerResponse ProfilerHttpHandlers::handleCpuTimelineFlamegraphJson(double from_ms, double to_ms) {
+    if (!profiler_.hasCPUTimeline()) {
+        return errorResp(404, "No CPU timeline recorded yet; capture one with /api/cpu/timeline first.");
     }
 
-    auto resp = HandlerResponse::svg(svg);
-    resp.headers["Content-Disposition"] = "attachment; filename=cpu_flamegraph_" + std::to_string(duration) + "s.svg";
-    return resp;
+    std::string key = "cpu/timeline/flamegraph_json?from=" + std::to_string(from_ms) + "&to=" + std::to_string(to_ms);
+    return schedule("symbol", key, [&] {
+        std::string json = profiler_.getTimelineFlameGraphJson(from_ms, to_ms);
+        if (json.empty()) {
+            return errorResp(404, "No CPU timeline samples in the requested range.");
+        }
+
+        return HandlerResponse::json(json);
+    });
 }
 
 // --- Heap endpoints ---
@@ -168,98 +327,144 @@ HandlerResponse ProfilerHttpHandlers::handleHeapAnalyze(const std::string& outpu
         return errorResp(400, "Invalid output_type. Must be 'flamegraph' or 'pprof'");
     }
 
-    std::string svg = profiler_.analyzeHeapProfile(1, output_type);
+    return schedule("heap", "heap/analyze?output_type=" + output_type, [&] {
+        std::string svg = profiler_.analyzeHeapProfile(1, output_type);
 
-    if (svg.size() > 10 && svg[0] == '{' && svg[1] == '"') {
-        return errorResp(500, "Failed to generate heap flame graph");
-    }
+        if (svg.size() > 10 && svg[0] == '{' && svg[1] == '"') {
+            return errorResp(500, "Failed to generate heap flame graph");
+        }
 
-    return HandlerResponse::svg(svg);
+        return HandlerResponse::svg(svg);
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleHeapSvgRaw() {
-    std::string heap_sample = profiler_.getRawHeapSample();
-    if (heap_sample.empty()) {
-        return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
-    }
+    return schedule("heap", "heap/svg_raw", [&] {
+        std::string heap_sample = profiler_.getRawHeapSample();
+        if (heap_sample.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
 
-    std::string temp_file = "/tmp/heap_raw.prof";
-    {
-        std::ofstream out(temp_file);
-        out << heap_sample;
-    }
+        auto resp = renderCached(heap_sample, "pprof-svg", [&] {
+            std::string temp_file = "/tmp/heap_raw.prof";
+            {
+                std::ofstream out(temp_file);
+                out << heap_sample;
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(cmd, svg);
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(cmd, svg);
 
-    size_t pos = svg.find("<?xml");
-    if (pos == std::string::npos)
-        pos = svg.find("<svg");
-    if (pos != std::string::npos && pos > 0)
-        svg = svg.substr(pos);
+            size_t pos = svg.find("<?xml");
+            if (pos == std::string::npos)
+                pos = svg.find("<svg");
+            if (pos != std::string::npos && pos > 0)
+                svg = svg.substr(pos);
 
-    if (svg.empty() || svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate SVG");
-    }
+            if (svg.empty() || svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate SVG");
+            }
+            return HandlerResponse::svg(svg);
+        });
 
-    auto resp = HandlerResponse::svg(svg);
-    resp.headers["Content-Disposition"] = "attachment; filename=heap_profile.svg";
-    return resp;
+        if (resp.status == 200)
+            resp.headers["Content-Disposition"] = "attachment; filename=heap_profile.svg";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleHeapFlamegraphRaw() {
-    std::string heap_sample = profiler_.getRawHeapSample();
-    if (heap_sample.empty()) {
-        return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
-    }
+    return schedule("heap", "heap/flamegraph_raw", [&] {
+        std::string heap_sample = profiler_.getRawHeapSample();
+        if (heap_sample.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
 
-    std::string temp_file = "/tmp/heap_raw.prof";
-    {
-        std::ofstream out(temp_file);
-        out << heap_sample;
-    }
+        auto resp = renderCached(heap_sample, "flamegraph:Heap Flame Graph", [&] {
+            std::string temp_file = "/tmp/heap_raw.prof";
+            {
+                std::ofstream out(temp_file);
+                out << heap_sample;
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string collapsed_file = "/tmp/heap_collapsed.prof";
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string collapsed_file = "/tmp/heap_collapsed.prof";
 
-    std::ostringstream cmd;
-    cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
-    std::string out;
-    if (!profiler_.executeCommand(cmd.str(), out)) {
-        return errorResp(500, "Failed to execute pprof --collapsed command");
-    }
+            std::ostringstream cmd;
+            cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
+            std::string out;
+            if (!profiler_.executeCommand(cmd.str(), out)) {
+                return errorResp(500, "Failed to execute pprof --collapsed command");
+            }
 
-    std::ifstream in(collapsed_file);
-    if (!in.is_open())
-        return errorResp(500, "Failed to create collapsed file");
-    std::string line;
-    bool has_data = false;
-    while (std::getline(in, line)) {
-        if (!line.empty() && line[0] != '#') {
-            has_data = true;
-            break;
+            std::ifstream in(collapsed_file);
+            if (!in.is_open())
+                return errorResp(500, "Failed to create collapsed file");
+            std::string line;
+            bool has_data = false;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    has_data = true;
+                    break;
+                }
+            }
+            in.close();
+            if (!has_data)
+                return errorResp(500, "pprof --collapsed produced no data");
+
+            std::string fg_cmd =
+                "perl ./flamegraph.pl --title=\"Heap Flame Graph\" --width=1200 " + collapsed_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(fg_cmd, svg);
+
+            if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate FlameGraph");
+            }
+            return HandlerResponse::svg(svg);
+        });
+
+        if (resp.status == 200) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            std::string ts = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(now).count());
+            resp.headers["Content-Disposition"] = "attachment; filename=heap_flamegraph_" + ts + ".svg";
         }
-    }
-    in.close();
-    if (!has_data)
-        return errorResp(500, "pprof --collapsed produced no data");
+        return resp;
+    });
+}
 
-    std::string fg_cmd =
-        "perl ./flamegraph.pl --title=\"Heap Flame Graph\" --width=1200 " + collapsed_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(fg_cmd, svg);
+HandlerResponse ProfilerHttpHandlers::handleHeapFolded() {
+    return schedule("heap", "heap/folded", [&] {
+        std::string folded = profiler_.getFoldedHeapSample();
+        if (folded.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
 
-    if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate FlameGraph");
-    }
+        return HandlerResponse::text(folded);
+    });
+}
 
-    auto resp = HandlerResponse::svg(svg);
-    std::string ts = std::to_string(
-        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-    resp.headers["Content-Disposition"] = "attachment; filename=heap_flamegraph_" + ts + ".svg";
-    return resp;
+HandlerResponse ProfilerHttpHandlers::handleHeapFlamegraphJson() {
+    return schedule("heap", "heap/flamegraph_json", [&] {
+        std::string json = profiler_.getHeapFlameGraphJson();
+        if (json.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
+
+        return HandlerResponse::json(json);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleHeapBundle() {
+    return schedule("heap", "heap/bundle", [&] {
+        std::string bundle = profiler_.getHeapSampleBundle();
+        if (bundle.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
+
+        return HandlerResponse::binary(bundle, "heap.bundle");
+    });
 }
 
 // --- Growth endpoints ---
@@ -269,145 +474,196 @@ HandlerResponse ProfilerHttpHandlers::handleGrowthAnalyze(const std::string& out
         return errorResp(400, "Invalid output_type. Must be 'flamegraph' or 'pprof'");
     }
 
-    std::string growth = profiler_.getRawHeapGrowthStacks();
-    if (growth.empty()) {
-        return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
-    }
+    return schedule("growth", "growth/analyze?output_type=" + output_type, [&] {
+        std::string growth = profiler_.getRawHeapGrowthStacks();
+        if (growth.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
 
-    std::string temp_file = "/tmp/growth_sample.prof";
-    {
-        std::ofstream out(temp_file);
-        out << growth;
-    }
+        // Same options as the raw flame graph download, so viewing then downloading renders once
+        const char* options = output_type == "flamegraph" ? "flamegraph:Heap Growth Flame Graph" : "pprof-svg-viewbox";
+        return renderCached(growth, options, [&] {
+            std::string temp_file = "/tmp/growth_sample.prof";
+            {
+                std::ofstream out(temp_file);
+                out << growth;
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string svg;
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string svg;
 
-    if (output_type == "flamegraph") {
-        std::string collapsed_file = "/tmp/growth_collapsed.prof";
-        std::ostringstream cmd;
-        cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>/dev/null";
+            if (output_type == "flamegraph") {
+                std::string collapsed_file = "/tmp/growth_collapsed.prof";
+                std::ostringstream cmd;
+                cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file
+                    << " 2>/dev/null";
 
-        std::string out;
-        if (!profiler_.executeCommand(cmd.str(), out)) {
-            return errorResp(500, "Failed to generate collapsed format");
-        }
+                std::string out;
+                if (!profiler_.executeCommand(cmd.str(), out)) {
+                    return errorResp(500, "Failed to generate collapsed format");
+                }
 
-        std::ostringstream fg;
-        fg << "perl ./flamegraph.pl --title=\"Heap Growth Flame Graph\" --width=1200 " << collapsed_file
-           << " 2>/dev/null";
-        if (!profiler_.executeCommand(fg.str(), svg)) {
-            return errorResp(500, "Failed to execute flamegraph.pl command");
-        }
+                std::ostringstream fg;
+                fg << "perl ./flamegraph.pl --title=\"Heap Growth Flame Graph\" --width=1200 " << collapsed_file
+                   << " 2>/dev/null";
+                if (!profiler_.executeCommand(fg.str(), svg)) {
+                    return errorResp(500, "Failed to execute flamegraph.pl command");
+                }
 
-        if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
-            return errorResp(500, "flamegraph.pl did not generate valid SVG");
-        }
-    } else {
-        std::ostringstream cmd;
-        cmd << "./pprof --svg " << exe_path << " " << temp_file << " 2>&1";
-        if (!profiler_.executeCommand(cmd.str(), svg)) {
-            return errorResp(500, "Failed to execute pprof command");
-        }
+                if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
+                    return errorResp(500, "flamegraph.pl did not generate valid SVG");
+                }
+            } else {
+                std::ostringstream cmd;
+                cmd << "./pprof --svg " << exe_path << " " << temp_file << " 2>&1";
+                if (!profiler_.executeCommand(cmd.str(), svg)) {
+                    return errorResp(500, "Failed to execute pprof command");
+                }
 
-        size_t svg_start = svg.find("<svg");
-        if (svg_start != std::string::npos) {
-            size_t tag_end = svg.find(">", svg_start);
-            if (tag_end != std::string::npos) {
-                std::string tag = svg.substr(svg_start, tag_end - svg_start);
-                if (tag.find("viewBox") == std::string::npos) {
-                    svg.insert(tag_end, " viewBox=\"0 -1000 2000 1000\"");
+                size_t svg_start = svg.find("<svg");
+                if (svg_start != std::string::npos) {
+                    size_t tag_end = svg.find(">", svg_start);
+                    if (tag_end != std::string::npos) {
+                        std::string tag = svg.substr(svg_start, tag_end - svg_start);
+                        if (tag.find("viewBox") == std::string::npos) {
+                            svg.insert(tag_end, " viewBox=\"0 -1000 2000 1000\"");
+                        }
+                    }
                 }
             }
-        }
-    }
 
-    return HandlerResponse::svg(svg);
+            return HandlerResponse::svg(svg);
+        });
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleGrowthSvgRaw() {
-    std::string growth = profiler_.getRawHeapGrowthStacks();
-    if (growth.empty()) {
-        return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
-    }
+    return schedule("growth", "growth/svg_raw", [&] {
+        std::string growth = profiler_.getRawHeapGrowthStacks();
+        if (growth.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
 
-    std::string temp_file = "/tmp/growth_raw.prof";
-    {
-        std::ofstream out(temp_file);
-        out << growth;
-    }
+        auto resp = renderCached(growth, "pprof-svg", [&] {
+            std::string temp_file = "/tmp/growth_raw.prof";
+            {
+                std::ofstream out(temp_file);
+                out << growth;
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(cmd, svg);
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string cmd = "./pprof --svg " + exe_path + " " + temp_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(cmd, svg);
 
-    size_t pos = svg.find("<?xml");
-    if (pos == std::string::npos)
-        pos = svg.find("<svg");
-    if (pos != std::string::npos && pos > 0)
-        svg = svg.substr(pos);
+            size_t pos = svg.find("<?xml");
+            if (pos == std::string::npos)
+                pos = svg.find("<svg");
+            if (pos != std::string::npos && pos > 0)
+                svg = svg.substr(pos);
 
-    if (svg.empty() || svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate SVG");
-    }
+            if (svg.empty() || svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate SVG");
+            }
+            return HandlerResponse::svg(svg);
+        });
 
-    auto resp = HandlerResponse::svg(svg);
-    resp.headers["Content-Disposition"] = "attachment; filename=growth_profile.svg";
-    return resp;
+        if (resp.status == 200)
+            resp.headers["Content-Disposition"] = "attachment; filename=growth_profile.svg";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handleGrowthFlamegraphRaw() {
-    std::string growth = profiler_.getRawHeapGrowthStacks();
-    if (growth.empty()) {
-        return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
-    }
+    return schedule("growth", "growth/flamegraph_raw", [&] {
+        std::string growth = profiler_.getRawHeapGrowthStacks();
+        if (growth.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
 
-    std::string temp_file = "/tmp/growth_raw.prof";
-    {
-        std::ofstream out(temp_file);
-        out << growth;
-    }
+        auto resp = renderCached(growth, "flamegraph:Heap Growth Flame Graph", [&] {
+            std::string temp_file = "/tmp/growth_raw.prof";
+            {
+                std::ofstream out(temp_file);
+                out << growth;
+            }
 
-    std::string exe_path = profiler_.getExecutablePath();
-    std::string collapsed_file = "/tmp/growth_collapsed.prof";
+            std::string exe_path = profiler_.getExecutablePath();
+            std::string collapsed_file = "/tmp/growth_collapsed.prof";
 
-    std::ostringstream cmd;
-    cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
-    std::string out;
-    if (!profiler_.executeCommand(cmd.str(), out)) {
-        return errorResp(500, "Failed to execute pprof --collapsed command");
-    }
+            std::ostringstream cmd;
+            cmd << "./pprof --collapsed " << exe_path << " " << temp_file << " > " << collapsed_file << " 2>&1";
+            std::string out;
+            if (!profiler_.executeCommand(cmd.str(), out)) {
+                return errorResp(500, "Failed to execute pprof --collapsed command");
+            }
+
+            std::ifstream in(collapsed_file);
+            if (!in.is_open())
+                return errorResp(500, "Failed to create collapsed file");
+            std::string line;
+            bool has_data = false;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    has_data = true;
+                    break;
+                }
+            }
+            in.close();
+            if (!has_data)
+                return errorResp(500, "pprof --collapsed produced no data");
 
-    std::ifstream in(collapsed_file);
-    if (!in.is_open())
-        return errorResp(500, "Failed to create collapsed file");
-    std::string line;
-    bool has_data = false;
-    while (std::getline(in, line)) {
-        if (!line.empty() && line[0] != '#') {
-            has_data = true;
-            break;
+            std::string fg_cmd = "perl ./flamegraph.pl --title=\"Heap Growth Flame Graph\" --width=1200 " +
+                                 collapsed_file + " 2>/dev/null";
+            std::string svg;
+            profiler_.executeCommand(fg_cmd, svg);
+
+            if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
+                return errorResp(500, "Failed to generate FlameGraph");
+            }
+            return HandlerResponse::svg(svg);
+        });
+
+        if (resp.status == 200) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            std::string ts = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(now).count());
+            resp.headers["Content-Disposition"] = "attachment; filename=growth_flamegraph_" + ts + ".svg";
+        }
+        return resp;
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleGrowthFolded() {
+    return schedule("growth", "growth/folded", [&] {
+        std::string folded = profiler_.getFoldedHeapGrowthStacks();
+        if (folded.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
         }
-    }
-    in.close();
-    if (!has_data)
-        return errorResp(500, "pprof --collapsed produced no data");
 
-    std::string fg_cmd =
-        "perl ./flamegraph.pl --title=\"Heap Growth Flame Graph\" --width=1200 " + collapsed_file + " 2>/dev/null";
-    std::string svg;
-    profiler_.executeCommand(fg_cmd, svg);
+        return HandlerResponse::text(folded);
+    });
+}
 
-    if (svg.find("<?xml") == std::string::npos && svg.find("<svg") == std::string::npos) {
-        return errorResp(500, "Failed to generate FlameGraph");
-    }
+HandlerResponse ProfilerHttpHandlers::handleGrowthFlamegraphJson() {
+    return schedule("growth", "growth/flamegraph_json", [&] {
+        std::string json = profiler_.getHeapGrowthFlameGraphJson();
+        if (json.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
 
-    auto resp = HandlerResponse::svg(svg);
-    std::string ts = std::to_string(
-        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-    resp.headers["Content-Disposition"] = "attachment; filename=growth_flamegraph_" + ts + ".svg";
-    return resp;
+        return HandlerResponse::json(json);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleGrowthBundle() {
+    return schedule("growth", "growth/bundle", [&] {
+        std::string bundle = profiler_.getHeapGrowthBundle();
+        if (bundle.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
+
+        return HandlerResponse::binary(bundle, "growth.bundle");
+    });
 }
 
 // --- Standard pprof ---
@@ -415,98 +671,352 @@ HandlerResponse ProfilerHttpHandlers::handleGrowthFlamegraphRaw() {
 HandlerResponse ProfilerHttpHandlers::handlePprofProfile(int seconds) {
     seconds = clampDuration(seconds, 1, 300);
 
-    std::string data = profiler_.getRawCPUProfile(seconds);
-    if (data.empty()) {
-        return errorResp(500, "Failed to generate CPU profile");
-    }
+    return schedule("cpu", "pprof/profile?seconds=" + std::to_string(seconds), [&] {
+        std::string data = profiler_.getRawCPUProfile(seconds);
+        if (data.empty()) {
+            return errorResp(500, "Failed to generate CPU profile");
+        }
 
-    auto resp = HandlerResponse::binary(data, "profile");
-    resp.content_type = "application/octet-stream";
-    return resp;
+        auto resp = HandlerResponse::binary(data, "profile");
+        resp.content_type = "application/octet-stream";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handlePprofHeap() {
-    std::string data = profiler_.getRawHeapSample();
-    if (data.empty()) {
-        return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
-    }
+    return schedule("heap", "pprof/heap", [&] {
+        std::string data = profiler_.getRawHeapSample();
+        if (data.empty()) {
+            return errorResp(500, "Failed to get heap sample. Make sure TCMALLOC_SAMPLE_PARAMETER is set.");
+        }
 
-    HandlerResponse resp;
-    resp.status = 200;
-    resp.content_type = "text/plain";
-    resp.body = data;
-    resp.headers["Content-Disposition"] = "attachment; filename=heap";
-    return resp;
+        HandlerResponse resp;
+        resp.status = 200;
+        resp.content_type = "text/plain";
+        resp.body = data;
+        resp.headers["Content-Disposition"] = "attachment; filename=heap";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handlePprofGrowth() {
-    std::string data = profiler_.getRawHeapGrowthStacks();
-    if (data.empty()) {
-        return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
-    }
+    return schedule("growth", "pprof/growth", [&] {
+        std::string data = profiler_.getRawHeapGrowthStacks();
+        if (data.empty()) {
+            return errorResp(500, "Failed to get heap growth stacks. No heap growth data available.");
+        }
 
-    HandlerResponse resp;
-    resp.status = 200;
-    resp.content_type = "text/plain";
-    resp.body = data;
-    resp.headers["Content-Disposition"] = "attachment; filename=growth";
-    return resp;
+        HandlerResponse resp;
+        resp.status = 200;
+        resp.content_type = "text/plain";
+        resp.body = data;
+        resp.headers["Content-Disposition"] = "attachment; filename=growth";
+        return resp;
+    });
 }
 
 HandlerResponse ProfilerHttpHandlers::handlePprofSymbol(const std::string& body) {
-    // Go pprof (symbolz protocol) sends addresses separated by '+'
-    // and expects tab-separated response: "0xaddr\tsymbol_name\n"
-    // Also support newline-separated addresses for backward compatibility.
-
-    std::vector<std::string> addresses;
-
-    // Split by '+' first (Go pprof format)
-    // If no '+' found, fall back to newline splitting
-    if (body.find('+') != std::string::npos) {
-        std::istringstream iss(body);
-        std::string addr;
-        while (std::getline(iss, addr, '+')) {
-            if (!addr.empty()) {
-                addresses.push_back(addr);
+    // Identical symbol batches (e.g. several pprof clients on one profile) coalesce by content
+    std::string key = "pprof/symbol#" + std::to_string(internal::contentDigest(body)) + "-" +
+                      std::to_string(body.size());
+    return schedule("symbol", key, [&] {
+        // Go pprof (symbolz protocol) sends addresses separated by '+'
+        // and expects tab-separated response: "0xaddr\tsymbol_name\n"
+        // Also support newline-separated addresses for backward compatibility.
+
+        std::string_view input(body);
+        const char separator = input.find('+') != std::string_view::npos ? '+' : '\n';
+
+        // Tokens are views into body; invalid ones are echoed back unchanged
+        constexpr size_t kInvalid = static_cast<size_t>(-1);
+        std::vector<std::string_view> tokens;
+        std::vector<size_t> token_addr;
+        std::vector<uintptr_t> addresses;
+
+        size_t pos = 0;
+        while (pos < input.size()) {
+            size_t end = input.find(separator, pos);
+            if (end == std::string_view::npos) {
+                end = input.size();
             }
-        }
-    } else {
-        std::istringstream iss(body);
-        std::string addr;
-        while (std::getline(iss, addr)) {
-            if (!addr.empty() && addr[0] != '#') {
+            std::string_view token = input.substr(pos, end - pos);
+            pos = end + 1;
+
+            while (!token.empty() && std::isspace(static_cast<unsigned char>(token.back()))) {
+                token.remove_suffix(1);
+            }
+            while (!token.empty() && std::isspace(static_cast<unsigned char>(token.front()))) {
+                token.remove_prefix(1);
+            }
+            if (token.empty() || (separator == '\n' && token[0] == '#')) {
+                continue;
+            }
+
+            std::string_view digits = token;
+            if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+                digits.remove_prefix(2);
+            }
+            uintptr_t addr = 0;
+            auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), addr, 16);
+
+            tokens.push_back(token);
+            if (ec == std::errc() && ptr == digits.data() + digits.size()) {
+                token_addr.push_back(addresses.size());
                 addresses.push_back(addr);
+            } else {
+                token_addr.push_back(kInvalid);
             }
         }
-    }
 
-    std::ostringstream result;
-    for (const auto& address : addresses) {
-        std::string addr_str = address;
-        if (addr_str.size() > 2 && addr_str[0] == '0' && addr_str[1] == 'x') {
-            addr_str = addr_str.substr(2);
+        std::vector<std::string> symbols = profiler_.resolveSymbolsBatch(addresses);
+
+        size_t total = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            total += tokens[i].size() * 2 + 2;
+            if (token_addr[i] != kInvalid) {
+                total += symbols[token_addr[i]].size();
+            }
         }
 
-        try {
-            uintptr_t addr = std::stoull(addr_str, nullptr, 16);
-            std::string symbol = profiler_.resolveSymbolWithBackward(reinterpret_cast<void*>(addr));
-            result << address << "\t" << symbol << "\n";
-        } catch (...) {
-            result << address << "\t" << address << "\n";
+        std::string result;
+        result.reserve(total);
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            result += tokens[i];
+            result += '\t';
+            if (token_addr[i] != kInvalid) {
+                result += symbols[token_addr[i]];
+            } else {
+                result += tokens[i];
+            }
+            result += '\n';
         }
-    }
 
-    return HandlerResponse::text(result.str());
+        return HandlerResponse::text(result);
+    });
 }
 
 // --- Thread stacks ---
 
 HandlerResponse ProfilerHttpHandlers::handleThreadStacks() {
-    std::string stacks = profiler_.getThreadCallStacks();
-    if (stacks.empty()) {
-        return errorResp(500, "Failed to get thread call stacks");
+    return schedule("threads", "thread/stacks", [&] {
+        std::string stacks = profiler_.getThreadCallStacks();
+        if (stacks.empty()) {
+            return errorResp(500, "Failed to get thread call stacks");
+        }
+        return HandlerResponse::text(stacks);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleThreadStacksJson() {
+    return schedule("threads", "thread/stacks?format=json", [&] {
+        std::string stacks = profiler_.getThreadCallStacksJson();
+        if (stacks.empty()) {
+            return errorResp(500, "Failed to get thread call stacks");
+        }
+        return HandlerResponse::json(stacks);
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleThreadStacksBundle() {
+    return schedule("threads", "thread/stacks?format=bundle", [&] {
+        std::string bundle = profiler_.getThreadStacksBundle();
+        if (bundle.empty()) {
+            return errorResp(500, "Failed to get thread call stacks");
+        }
+        return HandlerResponse::binary(bundle, "threads.bundle");
+    });
+}
+
+HandlerResponse ProfilerHttpHandlers::handleThreadStuck() {
+    // Reads the detector's last result: cheap, so not scheduled
+    return HandlerResponse::json(profiler_.getStuckThreadsJson());
+}
+
+// --- Dispatch ---
+
+namespace {
+
+using Params = std::map<std::string, std::string>;
+
+int intParam(const Params& params, const char* name, int fallback) {
+    auto it = params.find(name);
+    int value = fallback;
+    if (it == params.end() ||
+        std::from_chars(it->second.data(), it->second.data() + it->second.size(), value).ec != std::errc()) {
+        return fallback;
     }
-    return HandlerResponse::text(stacks);
+    return value;
+}
+
+double doubleParam(const Params& params, const char* name, double fallback) {
+    auto it = params.find(name);
+    double value = fallback;
+    if (it == params.end() ||
+        std::from_chars(it->second.data(), it->second.data() + it->second.size(), value).ec != std::errc()) {
+        return fallback;
+    }
+    return value;
+}
+
+// /api/cpu/folded and /api/cpu/flamegraph_json zoom into the last timeline when given a range
+bool hasTimeRange(const Params& params) {
+    return params.count("from") > 0 || params.count("to") > 0;
+}
+
+std::string stringParam(const Params& params, const char* name, const char* fallback) {
+    auto it = params.find(name);
+    return it == params.end() || it->second.empty() ? fallback : it->second;
+}
+
+struct Route {
+    bool post; ///< POST only (GET and HEAD otherwise)
+    HandlerResponse (*handle)(ProfilerHttpHandlers& handlers, const Params& params, const std::string& body);
+};
+
+// Built once; the same paths and defaults as the Drogon adapter
+const std::unordered_map<std::string_view, Route>& routeTable() {
+    static const std::unordered_map<std::string_view, Route> routes = {
+        {"/api/status", {false, [](auto& h, auto&, auto&) { return h.handleStatus(); }}},
+        {"/api/thread/stacks",
+         {false,
+          [](auto& h, auto& p, auto&) {
+              auto format = stringParam(p, "format", "");
+              if (format == "json") {
+                  return h.handleThreadStacksJson();
+              }
+              return format == "bundle" ? h.handleThreadStacksBundle() : h.handleThreadStacks();
+          }}},
+        {"/api/thread/stuck", {false, [](auto& h, auto&, auto&) { return h.handleThreadStuck(); }}},
+        {"/pprof/profile",
+         {false, [](auto& h, auto& p, auto&) { return h.handlePprofProfile(intParam(p, "seconds", 30)); }}},
+        {"/pprof/heap", {false, [](auto& h, auto&, auto&) { return h.handlePprofHeap(); }}},
+        {"/pprof/growth", {false, [](auto& h, auto&, auto&) { return h.handlePprofGrowth(); }}},
+        {"/pprof/symbol", {true, [](auto& h, auto&, auto& body) { return h.handlePprofSymbol(body); }}},
+        {"/api/cpu/analyze",
+         {false,
+          [](auto& h, auto& p, auto&) {
+              return h.handleCpuAnalyze(intParam(p, "duration", 10), stringParam(p, "output_type", "pprof"));
+          }}},
+        {"/api/cpu/svg_raw",
+         {false, [](auto& h, auto& p, auto&) { return h.handleCpuSvgRaw(intParam(p, "duration", 10)); }}},
+        {"/api/cpu/flamegraph_raw",
+         {false, [](auto& h, auto& p, auto&) { return h.handleCpuFlamegraphRaw(intParam(p, "duration", 10)); }}},
+        {"/api/cpu/folded",
+         {false,
+          [](auto& h, auto& p, auto&) {
+              if (hasTimeRange(p)) {
+                  return h.handleCpuTimelineFolded(doubleParam(p, "from", 0), doubleParam(p, "to", -1));
+              }
+              return h.handleCpuFolded(intParam(p, "duration", 10));
+          }}},
+        {"/api/cpu/flamegraph_json",
+         {false,
+          [](auto& h, auto& p, auto&) {
+              if (hasTimeRange(p)) {
+                  return h.handleCpuTimelineFlamegraphJson(doubleParam(p, "from", 0), doubleParam(p, "to", -1));
+              }
+              return h.handleCpuFlamegraphJson(intParam(p, "duration", 10));
+          }}},
+        {"/api/cpu/bundle",
+         {false, [](auto& h, auto& p, auto&) { return h.handleCpuBundle(intParam(p, "duration", 10)); }}},
+        {"/api/cpu/timeline",
+         {false, [](auto& h, auto& p, auto&) { return h.handleCpuTimeline(intParam(p, "duration", 10)); }}},
+        {"/api/heap/analyze",
+         {false, [](auto& h, auto& p, auto&) { return h.handleHeapAnalyze(stringParam(p, "output_type", "pprof")); }}},
+        {"/api/heap/svg_raw", {false, [](auto& h, auto&, auto&) { return h.handleHeapSvgRaw(); }}},
+        {"/api/heap/flamegraph_raw", {false, [](auto& h, auto&, auto&) { return h.handleHeapFlamegraphRaw(); }}},
+        {"/api/heap/folded", {false, [](auto& h, auto&, auto&) { return h.handleHeapFolded(); }}},
+        {"/api/heap/flamegraph_json", {false, [](auto& h, auto&, auto&) { return h.handleHeapFlamegraphJson(); }}},
+        {"/api/heap/bundle", {false, [](auto& h, auto&, auto&) { return h.handleHeapBundle(); }}},
+        {"/api/growth/analyze",
+         {false,
+          [](auto& h, auto& p, auto&) { return h.handleGrowthAnalyze(stringParam(p, "output_type", "pprof")); }}},
+        {"/api/growth/svg_raw", {false, [](auto& h, auto&, auto&) { return h.handleGrowthSvgRaw(); }}},
+        {"/api/growth/flamegraph_raw", {false, [](auto& h, auto&, auto&) { return h.handleGrowthFlamegraphRaw(); }}},
+        {"/api/growth/folded", {false, [](auto& h, auto&, auto&) { return h.handleGrowthFolded(); }}},
+        {"/api/growth/flamegraph_json", {false, [](auto& h, auto&, auto&) { return h.handleGrowthFlamegraphJson(); }}},
+        {"/api/growth/bundle", {false, [](auto& h, auto&, auto&) { return h.handleGrowthBundle(); }}},
+    };
+    return routes;
+}
+
+} // namespace
+
+HandlerResponse ProfilerHttpHandlers::dispatch(const std::string& method, const std::string& path,
+                                               const std::map<std::string, std::string>& params,
+                                               const std::string& body) {
+    const auto& routes = routeTable();
+    auto route = routes.find(path);
+    if (route == routes.end()) {
+        return errorResp(404, "Not found");
+    }
+
+    bool allowed = route->second.post ? method == "POST" : method == "GET" || method == "HEAD";
+    if (!allowed) {
+        auto resp = errorResp(405, "Method not allowed");
+        resp.headers["Allow"] = route->second.post ? "POST" : "GET, HEAD";
+        return resp;
+    }
+    return route->second.handle(*this, params, body);
+}
+
+// --- Conditional requests ---
+
+HandlerResponse ProfilerHttpHandlers::conditional(HandlerResponse resp, const std::string& if_none_match) {
+    auto etag = resp.headers.find("ETag");
+    if (resp.status != 200 || etag == resp.headers.end() || if_none_match.empty()) {
+        return resp;
+    }
+
+    // If-None-Match: "*" or a comma-separated list of (possibly weak) entity tags
+    std::string_view list(if_none_match);
+    bool matched = false;
+    while (!list.empty() && !matched) {
+        size_t comma = list.find(',');
+        std::string_view tag = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        while (!tag.empty() && std::isspace(static_cast<unsigned char>(tag.front()))) {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && std::isspace(static_cast<unsigned char>(tag.back()))) {
+            tag.remove_suffix(1);
+        }
+        // Weak comparison: compressed representations carry the weak form of the tag
+        matched = tag == "*" || opaqueTag(tag) == opaqueTag(etag->second);
+    }
+    if (!matched) {
+        return resp;
+    }
+
+    HandlerResponse not_modified;
+    not_modified.status = 304;
+    not_modified.content_type = resp.content_type;
+    not_modified.headers["ETag"] = etag->second;
+    return not_modified;
+}
+
+// --- Compression ---
+
+HandlerResponse ProfilerHttpHandlers::compress(HandlerResponse resp, const std::string& accept_encoding) {
+    if (!internal::isCompressible(resp)) {
+        return resp;
+    }
+    auto encoding = internal::negotiateEncoding(accept_encoding);
+    std::string body;
+    if (encoding == internal::ContentEncoding::Identity || !internal::compressBody(resp.body, encoding, body) ||
+        body.size() >= resp.body.size()) {
+        return resp;
+    }
+
+    resp.body = std::move(body);
+    resp.headers["Content-Encoding"] = internal::contentEncodingName(encoding);
+    resp.headers["Vary"] = "Accept-Encoding";
+    auto etag = resp.headers.find("ETag");
+    if (etag != resp.headers.end()) {
+        etag->second = internal::weakEtag(etag->second);
+    }
+    return resp;
 }
 
 PROFILER_NAMESPACE_END
@@ -0,0 +1,589 @@
+/// @file http_server.cpp
+/// @brief Built-in HTTP/1.1 server: one epoll thread, handlers on a worker pool
+
+#include "profiler/http_server.h"
+#include "internal/http_message.h"
+#include "internal/worker_pool.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// One client connection, owned by the event-loop thread
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;          ///< Distinguishes a reused fd from the one a finished handler answers
+    std::string in;           ///< Received bytes not yet parsed
+    std::string out_head;     ///< Status line and headers of the response being sent
+    std::string out_body;     ///< Its body, moved out of the handler's response
+    size_t out_pos = 0;       ///< Bytes of head then body already sent
+    bool busy = false;        ///< A handler is running for this connection's current request
+    bool close_after = false; ///< Close once the response is sent
+    bool peer_closed = false; ///< The client shut down its side; answer what was received, then close
+    Clock::time_point last_active;
+
+    bool sending() const {
+        return out_pos < out_head.size() + out_body.size();
+    }
+};
+
+/// Response produced on a worker thread, handed back to the event loop
+struct Completion {
+    uint64_t id;
+    int fd;
+    std::string head;
+    std::string body;
+    bool close_after;
+};
+
+std::string errnoMessage(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+} // namespace
+
+class ProfilerHttpServer::Impl {
+public:
+    Impl(ProfilerManager& profiler, const HttpServerOptions& options, const SchedulerOptions& scheduler,
+         const WorkerPoolOptions& pool)
+        : options_(options), pool_options_(pool), handlers_(profiler, scheduler) {}
+
+    ~Impl() {
+        stop();
+    }
+
+    bool start() {
+        if (running_) {
+            error_ = "Server is already running";
+            return false;
+        }
+        if (!openListeners()) {
+            closeDescriptors();
+            return false;
+        }
+
+        pool_ = std::make_unique<internal::WorkerPool>(pool_options_.threads, pool_options_.max_queued,
+                                                       pool_options_.cpu_affinity, "profiler-http");
+        running_ = true;
+        loop_ = std::thread(&Impl::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        wake();
+        loop_.join();
+        // Handlers still running finish here; their completions are never read
+        pool_.reset();
+        for (auto& [fd, conn] : connections_) {
+            ::close(fd);
+        }
+        connections_.clear();
+        completions_.clear();
+        closeDescriptors();
+        port_ = 0;
+    }
+
+    bool isRunning() const {
+        return running_;
+    }
+
+    uint16_t port() const {
+        return port_;
+    }
+
+    std::string lastError() const {
+        return error_;
+    }
+
+private:
+    bool openListeners() {
+        if (options_.host.empty() && options_.unix_socket.empty()) {
+            error_ = "No listener configured (empty host and unix_socket)";
+            return false;
+        }
+        if ((!options_.host.empty() && !openTcpListener()) || (!options_.unix_socket.empty() && !openUnixListener())) {
+            return false;
+        }
+
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (wake_fd_ < 0 || epoll_fd_ < 0) {
+            error_ = errnoMessage("epoll");
+            return false;
+        }
+        for (int fd : {tcp_fd_, unix_fd_, wake_fd_}) {
+            if (fd >= 0) {
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            }
+        }
+        return true;
+    }
+
+    bool openTcpListener() {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options_.port);
+        if (inet_pton(AF_INET, options_.host.c_str(), &addr.sin_addr) != 1) {
+            error_ = "Invalid listen address: " + options_.host;
+            return false;
+        }
+
+        tcp_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (tcp_fd_ < 0) {
+            error_ = errnoMessage("socket");
+            return false;
+        }
+        int one = 1;
+        setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(tcp_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error_ = errnoMessage("bind " + options_.host + ":" + std::to_string(options_.port));
+            return false;
+        }
+        if (::listen(tcp_fd_, SOMAXCONN) != 0) {
+            error_ = errnoMessage("listen");
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(tcp_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        return true;
+    }
+
+    // "@name" binds in the abstract namespace (no file, gone with the process),
+    // anything else is a filesystem path
+    bool openUnixListener() {
+        const std::string& path = options_.unix_socket;
+        bool abstract = path.front() == '@';
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            error_ = "Unix socket path too long: " + path;
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.data(), path.size());
+        if (abstract) {
+            addr.sun_path[0] = '\0';
+        }
+        auto len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (abstract ? 0 : 1));
+
+        unix_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (unix_fd_ < 0) {
+            error_ = errnoMessage("socket");
+            return false;
+        }
+        if (!abstract && !removeStaleSocket(reinterpret_cast<sockaddr*>(&addr), len)) {
+            return false;
+        }
+        if (::bind(unix_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+            error_ = errnoMessage("bind " + path);
+            return false;
+        }
+        unix_file_ = abstract ? std::string() : path;
+        if (::listen(unix_fd_, SOMAXCONN) != 0) {
+            error_ = errnoMessage("listen");
+            return false;
+        }
+        return true;
+    }
+
+    // A socket file left behind by a process that died is replaced; one that
+    // still accepts connections belongs to a live server and is not
+    bool removeStaleSocket(const sockaddr* addr, socklen_t len) {
+        struct stat st;
+        if (lstat(options_.unix_socket.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+            return true;
+        }
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && ::connect(probe, addr, len) == 0;
+        if (probe >= 0) {
+            ::close(probe);
+        }
+        if (live) {
+            error_ = options_.unix_socket + " is in use by another server";
+            return false;
+        }
+        ::unlink(options_.unix_socket.c_str());
+        return true;
+    }
+
+    void closeDescriptors() {
+        for (int* fd : {&tcp_fd_, &unix_fd_, &wake_fd_, &epoll_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        if (!unix_file_.empty()) {
+            ::unlink(unix_file_.c_str());
+            unix_file_.clear();
+        }
+    }
+
+    // Root and the process's own user may always connect over the Unix socket
+    bool peerAllowed(int fd) const {
+        ucred cred{};
+        socklen_t len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+            return false;
+        }
+        const auto& allowed = options_.unix_allowed_uids;
+        return cred.uid == 0 || cred.uid == geteuid() ||
+               std::find(allowed.begin(), allowed.end(), cred.uid) != allowed.end();
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "profiler-epoll");
+        epoll_event events[64];
+        auto last_sweep = Clock::now();
+        while (running_) {
+            int n = epoll_wait(epoll_fd_, events, 64, 1000);
+            if (n < 0 && errno != EINTR) {
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == tcp_fd_ || fd == unix_fd_) {
+                    acceptConnections(fd);
+                } else if (fd == wake_fd_) {
+                    uint64_t count;
+                    [[maybe_unused]] ssize_t r = ::read(wake_fd_, &count, sizeof(count));
+                    deliverCompletions();
+                } else {
+                    handleEvent(fd, events[i].events);
+                }
+            }
+            if (Clock::now() - last_sweep >= std::chrono::seconds(1)) {
+                closeIdleConnections();
+                last_sweep = Clock::now();
+            }
+        }
+    }
+
+    void acceptConnections(int listen_fd) {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return; // EAGAIN, or out of descriptors until a connection closes
+            }
+            if (connections_.size() >= options_.max_connections) {
+                ::close(fd);
+                continue;
+            }
+            Connection& conn = connections_[fd];
+            conn.fd = fd;
+            conn.id = ++next_id_;
+            conn.last_active = Clock::now();
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            if (listen_fd == unix_fd_ && !peerAllowed(fd)) {
+                reject(conn, 403, "Peer user is not allowed");
+            }
+        }
+    }
+
+    void handleEvent(int fd, uint32_t events) {
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) {
+            return;
+        }
+        Connection& conn = it->second;
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            closeConnection(conn);
+            return;
+        }
+        if (events & EPOLLOUT) {
+            flush(conn);
+            return;
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            receive(conn);
+        }
+    }
+
+    void receive(Connection& conn) {
+        char buffer[16384];
+        for (;;) {
+            ssize_t n = ::recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                conn.in.append(buffer, static_cast<size_t>(n));
+                // Beyond one maximal request plus a little pipelining there is nothing to gain
+                if (conn.in.size() > 2 * options_.max_request_bytes) {
+                    break;
+                }
+                continue;
+            }
+            if (n == 0 && (!conn.in.empty() || conn.busy)) {
+                conn.peer_closed = true;
+                break;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                closeConnection(conn);
+                return;
+            }
+            if (errno != EINTR) {
+                break;
+            }
+        }
+        conn.last_active = Clock::now();
+        processInput(conn);
+    }
+
+    // Start the next complete request of the connection, one at a time so
+    // pipelined responses go out in order
+    void processInput(Connection& conn) {
+        if (conn.busy || conn.sending() || conn.close_after) {
+            updateInterest(conn);
+            return;
+        }
+
+        internal::HttpRequest request;
+        size_t consumed = 0;
+        auto status = internal::parseHttpRequest(conn.in, options_.max_request_bytes, request, consumed);
+        switch (status) {
+        case internal::HttpParseStatus::Incomplete:
+            if (conn.peer_closed) {
+                closeConnection(conn);
+                return;
+            }
+            updateInterest(conn);
+            return;
+        case internal::HttpParseStatus::Invalid:
+            reject(conn, 400, "Malformed request");
+            return;
+        case internal::HttpParseStatus::TooLarge:
+            reject(conn, 413, "Request too large");
+            return;
+        case internal::HttpParseStatus::Unsupported:
+            reject(conn, 501, "Chunked request bodies are not supported");
+            return;
+        case internal::HttpParseStatus::Complete:
+            break;
+        }
+        conn.in.erase(0, consumed);
+
+        conn.busy = true;
+        updateInterest(conn);
+        uint64_t id = conn.id;
+        int fd = conn.fd;
+        auto task = [this, id, fd, request = std::move(request)] {
+            auto resp = handlers_.dispatch(request.method, request.path, request.params, request.body);
+            resp = ProfilerHttpHandlers::conditional(std::move(resp), request.header("if-none-match"));
+            resp = ProfilerHttpHandlers::compress(std::move(resp), request.header("accept-encoding"));
+            std::string head = internal::serializeHttpHead(resp, request.keep_alive);
+            if (request.method == "HEAD" || resp.status == 304) {
+                resp.body.clear();
+            }
+            complete({id, fd, std::move(head), std::move(resp.body), !request.keep_alive});
+        };
+        if (!pool_->submit(std::move(task))) {
+            conn.busy = false;
+            auto resp = HandlerResponse::error(503, "Profiler workers are busy, retry later");
+            resp.headers["Retry-After"] = "5";
+            std::string head = internal::serializeHttpHead(resp, true);
+            send(conn, std::move(head), std::move(resp.body), false);
+        }
+    }
+
+    // Answer without running a handler and close: the rest of the input cannot be trusted
+    void reject(Connection& conn, int status, const std::string& message) {
+        conn.in.clear();
+        auto resp = HandlerResponse::error(status, message);
+        std::string head = internal::serializeHttpHead(resp, false);
+        send(conn, std::move(head), std::move(resp.body), true);
+    }
+
+    // Called on worker threads
+    void complete(Completion completion) {
+        {
+            std::lock_guard<std::mutex> lock(completions_mutex_);
+            completions_.push_back(std::move(completion));
+        }
+        wake();
+    }
+
+    void deliverCompletions() {
+        std::vector<Completion> ready;
+        {
+            std::lock_guard<std::mutex> lock(completions_mutex_);
+            ready.swap(completions_);
+        }
+        for (auto& completion : ready) {
+            auto it = connections_.find(completion.fd);
+            if (it == connections_.end() || it->second.id != completion.id) {
+                continue; // The client went away while the handler ran
+            }
+            it->second.busy = false;
+            send(it->second, std::move(completion.head), std::move(completion.body), completion.close_after);
+        }
+    }
+
+    // Only one response is in flight per connection (see processInput)
+    void send(Connection& conn, std::string head, std::string body, bool close_after) {
+        conn.out_head = std::move(head);
+        conn.out_body = std::move(body);
+        conn.out_pos = 0;
+        conn.close_after = conn.close_after || close_after;
+        flush(conn);
+    }
+
+    // Head and body go out in one writev from their own buffers; large profiles
+    // are never copied into a combined response string
+    void flush(Connection& conn) {
+        while (conn.sending()) {
+            iovec iov[2];
+            int count = 0;
+            size_t head_size = conn.out_head.size();
+            if (conn.out_pos < head_size) {
+                iov[count++] = {conn.out_head.data() + conn.out_pos, head_size - conn.out_pos};
+            }
+            size_t body_pos = conn.out_pos > head_size ? conn.out_pos - head_size : 0;
+            if (body_pos < conn.out_body.size()) {
+                iov[count++] = {conn.out_body.data() + body_pos, conn.out_body.size() - body_pos};
+            }
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = static_cast<size_t>(count);
+            ssize_t n = ::sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    updateInterest(conn);
+                    return;
+                }
+                closeConnection(conn);
+                return;
+            }
+            conn.out_pos += static_cast<size_t>(n);
+        }
+        conn.last_active = Clock::now();
+        // Release the response buffers; large SVGs should not stay resident per connection
+        std::string().swap(conn.out_head);
+        std::string().swap(conn.out_body);
+        conn.out_pos = 0;
+        if (conn.close_after) {
+            closeConnection(conn);
+            return;
+        }
+        processInput(conn);
+    }
+
+    void updateInterest(Connection& conn) {
+        epoll_event ev{};
+        ev.data.fd = conn.fd;
+        if (conn.sending()) {
+            ev.events = EPOLLOUT;
+        } else if (!conn.busy && !conn.close_after && !conn.peer_closed) {
+            ev.events = EPOLLIN | EPOLLRDHUP;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+
+    void closeIdleConnections() {
+        auto deadline = Clock::now() - std::chrono::seconds(options_.idle_timeout_seconds);
+        std::vector<int> idle;
+        for (auto& [fd, conn] : connections_) {
+            if (!conn.busy && !conn.sending() && conn.last_active < deadline) {
+                idle.push_back(fd);
+            }
+        }
+        for (int fd : idle) {
+            closeConnection(connections_[fd]);
+        }
+    }
+
+    void closeConnection(Connection& conn) {
+        int fd = conn.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections_.erase(fd);
+    }
+
+    HttpServerOptions options_;
+    WorkerPoolOptions pool_options_;
+    ProfilerHttpHandlers handlers_;
+    std::string error_;
+
+    int tcp_fd_ = -1;
+    int unix_fd_ = -1;
+    std::string unix_file_; ///< Socket file to remove on stop (empty for the abstract namespace)
+    int wake_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<uint16_t> port_{0};
+    std::thread loop_;
+
+    // Event-loop thread only
+    std::unordered_map<int, Connection> connections_;
+    uint64_t next_id_ = 0;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    // Destroyed before the state its tasks use
+    std::unique_ptr<internal::WorkerPool> pool_;
+};
+
+ProfilerHttpServer::ProfilerHttpServer(ProfilerManager& profiler, const HttpServerOptions& options,
+                                       const SchedulerOptions& scheduler, const WorkerPoolOptions& pool)
+    : impl_(std::make_unique<Impl>(profiler, options, scheduler, pool)) {}
+
+ProfilerHttpServer::~ProfilerHttpServer() = default;
+
+bool ProfilerHttpServer::start() {
+    return impl_->start();
+}
+
+void ProfilerHttpServer::stop() {
+    impl_->stop();
+}
+
+bool ProfilerHttpServer::isRunning() const {
+    return impl_->isRunning();
+}
+
+uint16_t ProfilerHttpServer::port() const {
+    return impl_->port();
+}
+
+std::string ProfilerHttpServer::lastError() const {
+    return impl_->lastError();
+}
+
+PROFILER_NAMESPACE_END
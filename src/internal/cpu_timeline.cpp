@@ -0,0 +1,312 @@
+#include "internal/cpu_timeline.h"
+#include "internal/json_util.h"
+#include "internal/signal_unwind.h"
+#include "internal/string_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+std::atomic<TimelineSampler*> TimelineSampler::active_{nullptr};
+std::atomic<int> TimelineSampler::in_flight_{0};
+
+namespace {
+
+constexpr int kMaxDepth = 128; // Fits the 8-bit depth of a sample header
+
+uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Microseconds with three decimals, as the trace format's "ts" and "dur" expect
+void appendMicros(std::string& out, uint64_t ns) {
+    out += std::to_string(ns / 1000);
+    char frac[5] = {'.', static_cast<char>('0' + ns / 100 % 10), static_cast<char>('0' + ns / 10 % 10),
+                    static_cast<char>('0' + ns % 10), '\0'};
+    out += frac;
+}
+
+} // namespace
+
+TimelineSampler::TimelineSampler(const TimelineOptions& options) : options_(options) {
+    options_.frequency_hz = std::clamp(options_.frequency_hz, 1, 10000);
+    options_.max_threads = std::max<size_t>(options_.max_threads, 1);
+    options_.thread_scan_ms = std::max(options_.thread_scan_ms, 1);
+    words_per_thread_ = std::max<size_t>(options_.buffer_bytes_per_thread / sizeof(uintptr_t), kMaxDepth + 1);
+    signal_ = options_.signal > 0 ? options_.signal : SIGRTMIN + 4;
+}
+
+TimelineSampler::~TimelineSampler() {
+    if (running_) {
+        stop();
+    }
+}
+
+bool TimelineSampler::start(std::string& error) {
+    if (running_) {
+        error = "timeline capture already running";
+        return false;
+    }
+    if (signal_ == SIGPROF) {
+        error = "SIGPROF is reserved for the gperftools CPU profiler";
+        return false;
+    }
+
+    threads_.listThreads(known_tids_);
+    prepareSignalUnwind();
+
+    slots_.reset(new Slot[options_.max_threads]);
+    words_.reset(new uintptr_t[options_.max_threads * words_per_thread_]);
+    dropped_ = 0;
+
+    TimelineSampler* expected = nullptr;
+    if (!active_.compare_exchange_strong(expected, this)) {
+        error = "another timeline capture is running";
+        return false;
+    }
+
+    struct sigaction sa {};
+    sa.sa_sigaction = &TimelineSampler::handleSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigevent sev{};
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = signal_;
+    if (sigaction(signal_, &sa, nullptr) != 0 || timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &timer_) != 0) {
+        error = std::string("cannot set up the sampling timer: ") + strerror(errno);
+        active_ = nullptr;
+        return false;
+    }
+
+    long period_ns = 1000000000L / options_.frequency_hz;
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period_ns / 1000000000L;
+    spec.it_interval.tv_nsec = period_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    start_ns_ = monotonicNs();
+    if (timer_settime(timer_, 0, &spec, nullptr) != 0) {
+        error = std::string("cannot start the sampling timer: ") + strerror(errno);
+        timer_delete(timer_);
+        active_ = nullptr;
+        return false;
+    }
+    running_ = true;
+    scan_stop_ = false;
+    scanner_ = std::thread([this] { scanThreads(); });
+    return true;
+}
+
+CpuTimeline TimelineSampler::stop() {
+    CpuTimeline timeline;
+    if (!running_) {
+        return timeline;
+    }
+    {
+        std::lock_guard<std::mutex> lock(scan_mutex_);
+        scan_stop_ = true;
+    }
+    scan_cv_.notify_all();
+    scanner_.join();
+    timer_delete(timer_); // A tick already queued still arrives, and finds active_ cleared
+    active_ = nullptr;
+    while (in_flight_.load() > 0) {
+        std::this_thread::yield();
+    }
+    running_ = false;
+
+    timeline.period_us = 1000000 / static_cast<uint64_t>(options_.frequency_hz);
+    timeline.duration_ns = monotonicNs() - start_ns_;
+    timeline.dropped = dropped_;
+    for (size_t i = 0; i < options_.max_threads; ++i) {
+        const Slot& slot = slots_[i];
+        uint32_t tid = slot.tid.load();
+        if (tid == 0) {
+            continue;
+        }
+        timeline.thread_names[tid] = std::string(slot.name, strnlen(slot.name, sizeof(slot.name)));
+        const uintptr_t* words = &words_[i * words_per_thread_];
+        for (size_t pos = 0; pos < slot.used;) {
+            size_t depth = words[pos] & 0xff;
+            TimelineSample sample;
+            sample.time_ns = words[pos] >> 8;
+            sample.tid = tid;
+            sample.stack.assign(words + pos + 1, words + pos + 1 + depth);
+            timeline.samples.push_back(std::move(sample));
+            pos += 1 + depth;
+        }
+    }
+    std::stable_sort(timeline.samples.begin(), timeline.samples.end(),
+                     [](const TimelineSample& a, const TimelineSample& b) { return a.time_ns < b.time_ns; });
+
+    slots_.reset();
+    words_.reset();
+    return timeline;
+}
+
+void TimelineSampler::handleSignal(int signum, siginfo_t* info, void* context) {
+    (void)signum;
+    int saved_errno = errno;
+    in_flight_.fetch_add(1);
+    TimelineSampler* sampler = active_.load();
+    if (sampler != nullptr && info->si_code == SI_TIMER) {
+        sampler->record(context);
+    }
+    in_flight_.fetch_sub(1);
+    errno = saved_errno;
+}
+
+// The frame-pointer walk only trusts stacks of the last mapping snapshot
+void TimelineSampler::scanThreads() {
+    auto interval = std::chrono::milliseconds(options_.thread_scan_ms);
+    std::vector<pid_t> tids;
+    std::unique_lock<std::mutex> lock(scan_mutex_);
+    while (!scan_cv_.wait_for(lock, interval, [this] { return scan_stop_; })) {
+        if (!threads_.listThreads(tids)) {
+            continue;
+        }
+        if (!std::includes(known_tids_.begin(), known_tids_.end(), tids.begin(), tids.end())) {
+            prepareSignalUnwind(); // A thread has started since the last snapshot
+        }
+        known_tids_.swap(tids);
+    }
+}
+
+TimelineSampler::Slot* TimelineSampler::claimSlot(uint32_t tid) {
+    size_t n = options_.max_threads;
+    for (size_t probe = 0, i = tid * 2654435761u % n; probe < n; ++probe, i = (i + 1) % n) {
+        uint32_t owner = slots_[i].tid.load(std::memory_order_acquire);
+        if (owner == tid) {
+            return &slots_[i];
+        }
+        if (owner == 0 && slots_[i].tid.compare_exchange_strong(owner, tid)) {
+            prctl(PR_GET_NAME, slots_[i].name);
+            return &slots_[i];
+        }
+        // Taken by another thread (possibly just now): keep probing
+    }
+    return nullptr;
+}
+
+// Runs in the signal handler: no locks, no allocation
+void TimelineSampler::record(void* context) {
+    uint64_t now = monotonicNs() - start_ns_;
+    auto tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    Slot* slot = claimSlot(tid);
+    if (slot == nullptr || slot->used + 1 + kMaxDepth > words_per_thread_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uintptr_t* out = &words_[static_cast<size_t>(slot - slots_.get()) * words_per_thread_ + slot->used];
+    auto depth = static_cast<uintptr_t>(captureSignalStack(context, out + 1, kMaxDepth));
+    out[0] = (static_cast<uintptr_t>(now) << 8) | depth;
+    slot->used += 1 + depth;
+}
+
+ParsedProfile timelineProfile(const CpuTimeline& timeline, uint64_t from_ns, uint64_t to_ns) {
+    ParsedProfile profile;
+    profile.period_us = timeline.period_us;
+    auto first = std::lower_bound(timeline.samples.begin(), timeline.samples.end(), from_ns,
+                                  [](const TimelineSample& s, uint64_t t) { return s.time_ns < t; });
+    for (auto it = first; it != timeline.samples.end() && it->time_ns < to_ns; ++it) {
+        profile.samples.push_back({1, it->stack});
+    }
+    return profile;
+}
+
+std::string formatChromeTrace(const CpuTimeline& timeline, const FrameNameResolver& resolve) {
+    NameScope scope;
+    std::unordered_map<uintptr_t, std::vector<uint32_t>> names; // Address -> names, outermost first
+    std::string pid = std::to_string(getpid());
+    uint64_t period_ns = timeline.period_us * 1000;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"period_us\":" +
+                      std::to_string(timeline.period_us) + ",\"samples\":" + std::to_string(timeline.samples.size()) +
+                      ",\"dropped\":" + std::to_string(timeline.dropped) + "},\"traceEvents\":[";
+    out += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + pid;
+    out += ",\"tid\":0,\"args\":{\"name\":\"CPU timeline\"}}";
+    for (const auto& [tid, name] : timeline.thread_names) {
+        out += ",{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid) +
+               ",\"args\":{\"name\":";
+        appendJsonString(out, name.empty() ? std::to_string(tid) : name);
+        out += "}}";
+    }
+
+    /// A slice that is still open on one thread
+    struct Open {
+        uint32_t name;
+        uint64_t begin_ns;
+    };
+    struct ThreadState {
+        std::vector<Open> open;
+        uint64_t last_ns = 0;
+    };
+    std::map<uint32_t, ThreadState> threads;
+    auto close = [&](uint32_t tid, std::vector<Open>& open, size_t keep, uint64_t end_ns) {
+        while (open.size() > keep) {
+            const Open& slice = open.back();
+            out += ",{\"ph\":\"X\",\"cat\":\"cpu\",\"name\":";
+            appendJsonString(out, scope.view(slice.name));
+            out += ",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid) + ",\"ts\":";
+            appendMicros(out, slice.begin_ns);
+            out += ",\"dur\":";
+            appendMicros(out, end_ns - slice.begin_ns);
+            out += '}';
+            open.pop_back();
+        }
+    };
+
+    std::vector<uintptr_t> stack;
+    std::vector<uint32_t> frames;
+    for (const auto& sample : timeline.samples) {
+        stack = sample.stack;
+        fixupCallerAddresses(stack);
+        frames.clear();
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+            if (*it == 0) {
+                continue;
+            }
+            auto [name_it, inserted] = names.try_emplace(*it);
+            if (inserted) {
+                name_it->second = resolve(*it, scope);
+                std::reverse(name_it->second.begin(), name_it->second.end());
+            }
+            frames.insert(frames.end(), name_it->second.begin(), name_it->second.end());
+        }
+
+        auto& state = threads[sample.tid];
+        if (!state.open.empty() && sample.time_ns > state.last_ns + 2 * period_ns) {
+            close(sample.tid, state.open, 0, state.last_ns + period_ns);
+        }
+        size_t common = 0;
+        while (common < state.open.size() && common < frames.size() && state.open[common].name == frames[common]) {
+            ++common;
+        }
+        close(sample.tid, state.open, common, sample.time_ns);
+        for (size_t i = common; i < frames.size(); ++i) {
+            state.open.push_back({frames[i], sample.time_ns});
+        }
+        state.last_ns = sample.time_ns;
+    }
+    for (auto& [tid, state] : threads) {
+        close(tid, state.open, 0, state.last_ns + period_ns);
+    }
+
+    out += "]}";
+    return out;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,135 @@
+/// @file cpu_timeline.h
+/// @brief Timestamped CPU sampling into per-thread buffers, for the timeline (trace) view
+
+#pragma once
+
+#include "internal/folded_stacks.h"
+#include "internal/thread_metadata.h"
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @struct TimelineOptions
+/// @brief Sampling rate and buffer limits of a timeline capture
+struct TimelineOptions {
+    int frequency_hz = 100;                    ///< Samples per second of process CPU time
+    size_t max_threads = 256;                  ///< Threads that get a buffer; samples of further threads are dropped
+    size_t buffer_bytes_per_thread = 1u << 20; ///< Samples beyond this are dropped (pages are touched on use)
+    int signal = 0;                            ///< Sampling signal, 0 = SIGRTMIN + 4 (not SIGPROF: gperftools owns it)
+    int thread_scan_ms = 100;                  ///< How often to look for new threads (see TimelineSampler)
+};
+
+/// @struct TimelineSample
+/// @brief One tick of the sampling timer
+struct TimelineSample {
+    uint64_t time_ns = 0;         ///< Since the start of the capture
+    uint32_t tid = 0;             ///< Thread that was running
+    std::vector<uintptr_t> stack; ///< Program counters, leaf (the interrupted instruction) first
+};
+
+/// @struct CpuTimeline
+/// @brief Result of a timeline capture
+struct CpuTimeline {
+    uint64_t period_us = 0;                       ///< Sampling period in microseconds
+    uint64_t duration_ns = 0;                     ///< Length of the capture
+    uint64_t dropped = 0;                         ///< Samples lost to full buffers or a lack of thread slots
+    std::vector<TimelineSample> samples;          ///< Sorted by time
+    std::map<uint32_t, std::string> thread_names; ///< Name of every sampled thread at its first sample
+};
+
+/// @class TimelineSampler
+/// @brief Samples the running thread on every tick of a process CPU-time timer
+///
+/// gperftools profiles only keep aggregated counts, so short bursts disappear
+/// in a long capture. This sampler keeps every sample with its time and
+/// thread. The signal handler claims a buffer per thread by tid (lock-free,
+/// no allocation) and appends one header word (time << 8 | depth) followed
+/// by the stack, so a sample costs one stack capture and a few stores. Only
+/// one sampler runs at a time per process. While it runs, a helper thread
+/// lists the process's threads every thread_scan_ms and re-snapshots the
+/// mappings the frame-pointer walk trusts when one has started, as
+/// ThreadCpuSampler does, so new threads' stacks can be walked too.
+class TimelineSampler {
+public:
+    explicit TimelineSampler(const TimelineOptions& options = TimelineOptions());
+
+    /// @brief Stops a running capture and discards it
+    ~TimelineSampler();
+
+    TimelineSampler(const TimelineSampler&) = delete;
+    TimelineSampler& operator=(const TimelineSampler&) = delete;
+
+    /// @brief Install the signal handler (kept afterwards, idle outside captures) and start the timer
+    /// @param error Set to the reason on failure
+    /// @return false if another capture is running or the timer could not be created
+    bool start(std::string& error);
+
+    /// @brief Stop the timer and collect the samples of all threads
+    CpuTimeline stop();
+
+    bool isRunning() const {
+        return running_;
+    }
+
+private:
+    /// @brief Buffer of one thread
+    struct Slot {
+        std::atomic<uint32_t> tid{0}; ///< 0 = free
+        size_t used = 0;              ///< Words written, only touched by the owning thread's handler
+        char name[16] = {};           ///< Thread name when the slot was claimed
+    };
+
+    static void handleSignal(int signum, siginfo_t* info, void* context);
+    void record(void* context);
+    Slot* claimSlot(uint32_t tid);
+    void scanThreads();
+
+    TimelineOptions options_;
+    int signal_ = 0;
+    size_t words_per_thread_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<uintptr_t[]> words_; ///< max_threads * words_per_thread_, not initialized
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t start_ns_ = 0;
+    timer_t timer_{};
+    bool running_ = false;
+
+    ThreadMetadataReader threads_;
+    std::vector<pid_t> known_tids_; ///< Threads whose stacks the last mapping snapshot covers
+    std::thread scanner_;           ///< Runs scanThreads() during a capture
+    std::mutex scan_mutex_;
+    std::condition_variable scan_cv_;
+    bool scan_stop_ = false;
+
+    static std::atomic<TimelineSampler*> active_; ///< Sampler the handler records into
+    static std::atomic<int> in_flight_;           ///< Handlers currently running
+};
+
+/// @brief Samples of a timeline within [from_ns, to_ns), one count each, ready for foldProfile()
+ParsedProfile timelineProfile(const CpuTimeline& timeline, uint64_t from_ns, uint64_t to_ns);
+
+/// @brief Render a timeline as Chrome trace event JSON (chrome://tracing, Perfetto, speedscope)
+///
+/// Every thread becomes a flame chart: consecutive samples that share a
+/// frame at the same depth extend one "X" slice, and a gap of more than two
+/// periods without samples of the thread closes all of its slices.
+/// @param timeline Captured samples
+/// @param resolve Frame names of an address (caller-adjusted, as for foldProfile())
+std::string formatChromeTrace(const CpuTimeline& timeline, const FrameNameResolver& resolve);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
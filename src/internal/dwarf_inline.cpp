@@ -0,0 +1,603 @@
+#include "internal/dwarf_inline.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// Range list entry kinds (.debug_rnglists, DWARF 5)
+constexpr uint8_t DW_RLE_end_of_list = 0;
+constexpr uint8_t DW_RLE_base_addressx = 1;
+constexpr uint8_t DW_RLE_startx_endx = 2;
+constexpr uint8_t DW_RLE_startx_length = 3;
+constexpr uint8_t DW_RLE_offset_pair = 4;
+constexpr uint8_t DW_RLE_base_address = 5;
+constexpr uint8_t DW_RLE_start_end = 6;
+constexpr uint8_t DW_RLE_start_length = 7;
+
+// Linkage names may be followed through a few DW_AT_abstract_origin/specification links
+constexpr int kMaxNameHops = 4;
+
+std::string demangle(std::string_view name) {
+    std::string mangled(name);
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status == 0 && demangled) {
+        std::string result(demangled);
+        free(demangled);
+        return result;
+    }
+    free(demangled);
+    return mangled;
+}
+
+} // namespace
+
+DwarfInlineIndex::DwarfInlineIndex(std::shared_ptr<ElfFile> elf, std::shared_ptr<DwarfLineTable> lines)
+    : elf_(std::move(elf)), lines_(std::move(lines)) {}
+
+DwarfInlineIndex::~DwarfInlineIndex() = default;
+
+bool DwarfInlineIndex::load() {
+    using namespace dwarf;
+    if (loaded_) {
+        return !unit_ranges_.empty();
+    }
+    loaded_ = true;
+
+    if (!elf_) {
+        return false;
+    }
+    info_ = elf_->section(".debug_info");
+    abbrev_ = elf_->section(".debug_abbrev");
+    if (info_.empty() || abbrev_.empty()) {
+        return false;
+    }
+    str_ = elf_->section(".debug_str");
+    line_str_ = elf_->section(".debug_line_str");
+    str_offsets_ = elf_->section(".debug_str_offsets");
+    addr_ = elf_->section(".debug_addr");
+    ranges_ = elf_->section(".debug_ranges");
+    rnglists_ = elf_->section(".debug_rnglists");
+
+    DwarfCursor c(info_);
+    while (!c.atEnd()) {
+        Unit unit;
+        unit.offset = c.pos();
+        uint64_t length = c.unitLength(unit.offset_size);
+        unit.end = c.pos() + length;
+        if (!c.ok() || length == 0 || unit.end > info_.size()) {
+            break;
+        }
+        unit.version = c.u16();
+        uint8_t unit_type = DW_UT_compile;
+        if (unit.version >= 5) {
+            unit_type = c.u8();
+            unit.address_size = c.u8();
+            unit.abbrev_offset = c.fixed(unit.offset_size);
+            if (unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile) {
+                c.skip(8); // dwo_id
+            } else if (unit_type == DW_UT_type || unit_type == DW_UT_split_type) {
+                c.skip(8 + unit.offset_size);
+            }
+        } else {
+            unit.abbrev_offset = c.fixed(unit.offset_size);
+            unit.address_size = c.u8();
+        }
+        unit.die_offset = c.pos();
+        c.seek(unit.end);
+        if (unit.version < 2 || unit.version > 5 || unit.address_size == 0 || unit.address_size > 8 ||
+            unit_type == DW_UT_type || unit_type == DW_UT_split_type) {
+            continue;
+        }
+
+        DwarfCursor die(info_, unit.die_offset);
+        const auto& abbrevs = abbrevTable(unit.abbrev_offset);
+        auto abbrev_it = abbrevs.find(die.uleb());
+        if (!die.ok() || abbrev_it == abbrevs.end()) {
+            continue;
+        }
+        const Abbrev& abbrev = abbrev_it->second;
+
+        // First pass: the section bases that addrx/strx/rnglistx values are relative to
+        for (const auto& spec : abbrev.specs) {
+            if ((spec.attr == DW_AT_addr_base || spec.attr == DW_AT_GNU_addr_base || spec.attr == DW_AT_rnglists_base ||
+                 spec.attr == DW_AT_str_offsets_base) &&
+                spec.form == DW_FORM_sec_offset) {
+                uint64_t base = die.fixed(unit.offset_size);
+                if (spec.attr == DW_AT_rnglists_base) {
+                    unit.rnglists_base = base;
+                } else if (spec.attr == DW_AT_str_offsets_base) {
+                    unit.str_offsets_base = base;
+                } else {
+                    unit.addr_base = base;
+                }
+            } else if (!die.skipForm(spec.form, unit.offset_size, unit.address_size, unit.version)) {
+                break;
+            }
+        }
+
+        // Second pass: address ranges and line program of the unit
+        die.seek(unit.die_offset);
+        die.uleb();
+        Value low;
+        Value high;
+        Value ranges;
+        bool has_high = false;
+        bool has_ranges = false;
+        for (const auto& spec : abbrev.specs) {
+            Value value;
+            if (!readValue(die, unit, spec, value)) {
+                break;
+            }
+            if (spec.attr == DW_AT_low_pc) {
+                low = value;
+            } else if (spec.attr == DW_AT_high_pc) {
+                high = value;
+                has_high = true;
+            } else if (spec.attr == DW_AT_ranges) {
+                ranges = value;
+                has_ranges = true;
+            } else if (spec.attr == DW_AT_stmt_list) {
+                unit.stmt_list = value.u;
+            }
+        }
+        unit.low_pc = low.u;
+
+        size_t index = units_.size();
+        units_.push_back(unit);
+        std::vector<std::pair<uint64_t, uint64_t>> unit_ranges;
+        if (has_ranges) {
+            readRanges(unit, ranges.u, ranges.is_index, unit_ranges);
+        } else if (has_high) {
+            unit_ranges.emplace_back(low.u, high.is_offset ? low.u + high.u : high.u);
+        }
+        for (const auto& [begin, end] : unit_ranges) {
+            // Address 0 marks code removed by the linker (--gc-sections, COMDAT)
+            if (begin != 0 && end > begin) {
+                unit_ranges_.push_back(UnitRange{begin, end, index});
+            }
+        }
+    }
+
+    std::sort(unit_ranges_.begin(), unit_ranges_.end(),
+              [](const UnitRange& a, const UnitRange& b) { return a.low < b.low; });
+    return !unit_ranges_.empty();
+}
+
+const std::unordered_map<uint64_t, DwarfInlineIndex::Abbrev>& DwarfInlineIndex::abbrevTable(uint64_t offset) {
+    auto [it, inserted] = abbrevs_.try_emplace(offset);
+    if (!inserted) {
+        return it->second;
+    }
+
+    DwarfCursor a(abbrev_, offset);
+    while (true) {
+        uint64_t code = a.uleb();
+        if (!a.ok() || code == 0) {
+            break;
+        }
+        Abbrev abbrev;
+        abbrev.tag = a.uleb();
+        abbrev.has_children = a.u8() != 0;
+        while (a.ok()) {
+            AttrSpec spec;
+            spec.attr = a.uleb();
+            spec.form = a.uleb();
+            if (spec.form == dwarf::DW_FORM_implicit_const) {
+                spec.implicit_const = a.sleb();
+            }
+            if (spec.attr == 0 && spec.form == 0) {
+                break;
+            }
+            abbrev.specs.push_back(spec);
+        }
+        it->second.emplace(code, std::move(abbrev));
+    }
+    return it->second;
+}
+
+bool DwarfInlineIndex::readValue(DwarfCursor& cursor, const Unit& unit, const AttrSpec& spec, Value& value) {
+    using namespace dwarf;
+    auto strx = [&](uint64_t index) {
+        DwarfCursor offsets(str_offsets_, unit.str_offsets_base + index * unit.offset_size);
+        uint64_t offset = offsets.fixed(unit.offset_size);
+        value.str = offsets.ok() ? stringAt(str_, offset) : std::string_view();
+        value.is_string = true;
+    };
+
+    switch (spec.form) {
+    case DW_FORM_addr:
+        value.u = cursor.fixed(unit.address_size);
+        break;
+    case DW_FORM_addrx:
+    case DW_FORM_GNU_addr_index:
+        value.u = readAddrx(unit, cursor.uleb());
+        break;
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+        value.u = readAddrx(unit, cursor.fixed(spec.form - DW_FORM_addrx1 + 1));
+        break;
+    case DW_FORM_data1:
+    case DW_FORM_data2:
+    case DW_FORM_data4:
+    case DW_FORM_data8:
+        value.u = cursor.fixed(spec.form == DW_FORM_data1   ? 1
+                               : spec.form == DW_FORM_data2 ? 2
+                               : spec.form == DW_FORM_data4 ? 4
+                                                            : 8);
+        value.is_offset = true;
+        break;
+    case DW_FORM_udata:
+        value.u = cursor.uleb();
+        value.is_offset = true;
+        break;
+    case DW_FORM_sdata:
+        value.u = static_cast<uint64_t>(cursor.sleb());
+        value.is_offset = true;
+        break;
+    case DW_FORM_implicit_const:
+        value.u = static_cast<uint64_t>(spec.implicit_const);
+        value.is_offset = true;
+        break;
+    case DW_FORM_flag:
+        value.u = cursor.u8();
+        break;
+    case DW_FORM_flag_present:
+        value.u = 1;
+        break;
+    case DW_FORM_ref1:
+    case DW_FORM_ref2:
+    case DW_FORM_ref4:
+    case DW_FORM_ref8:
+        value.u = unit.offset + cursor.fixed(spec.form == DW_FORM_ref1   ? 1
+                                             : spec.form == DW_FORM_ref2 ? 2
+                                             : spec.form == DW_FORM_ref4 ? 4
+                                                                         : 8);
+        break;
+    case DW_FORM_ref_udata:
+        value.u = unit.offset + cursor.uleb();
+        break;
+    case DW_FORM_ref_addr:
+        value.u = cursor.fixed(unit.version <= 2 ? unit.address_size : unit.offset_size);
+        break;
+    case DW_FORM_sec_offset:
+        value.u = cursor.fixed(unit.offset_size);
+        break;
+    case DW_FORM_rnglistx:
+    case DW_FORM_loclistx:
+        value.u = cursor.uleb();
+        value.is_index = true;
+        break;
+    case DW_FORM_string:
+        value.str = cursor.cstr();
+        value.is_string = true;
+        break;
+    case DW_FORM_strp:
+        value.str = stringAt(str_, cursor.fixed(unit.offset_size));
+        value.is_string = true;
+        break;
+    case DW_FORM_line_strp:
+        value.str = stringAt(line_str_, cursor.fixed(unit.offset_size));
+        value.is_string = true;
+        break;
+    case DW_FORM_strx:
+    case DW_FORM_GNU_str_index:
+        strx(cursor.uleb());
+        break;
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+        strx(cursor.fixed(spec.form - DW_FORM_strx1 + 1));
+        break;
+    case DW_FORM_indirect: {
+        AttrSpec direct = spec;
+        direct.form = cursor.uleb();
+        return cursor.ok() && direct.form != DW_FORM_indirect && readValue(cursor, unit, direct, value);
+    }
+    default:
+        // Blocks, expressions, data16, supplementary-file references: not needed here
+        return cursor.skipForm(spec.form, unit.offset_size, unit.address_size, unit.version);
+    }
+    return cursor.ok();
+}
+
+uint64_t DwarfInlineIndex::readAddrx(const Unit& unit, uint64_t index) {
+    DwarfCursor c(addr_, unit.addr_base + index * unit.address_size);
+    uint64_t address = c.fixed(unit.address_size);
+    return c.ok() ? address : 0;
+}
+
+void DwarfInlineIndex::readRanges(const Unit& unit, uint64_t offset, bool is_index,
+                                  std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+    uint64_t base = unit.low_pc;
+    if (unit.version < 5) {
+        const uint64_t base_selector = unit.address_size == 8 ? UINT64_MAX : (1ull << (8 * unit.address_size)) - 1;
+        DwarfCursor c(ranges_, offset);
+        while (c.ok()) {
+            uint64_t begin = c.fixed(unit.address_size);
+            uint64_t end = c.fixed(unit.address_size);
+            if (!c.ok() || (begin == 0 && end == 0)) {
+                break;
+            }
+            if (begin == base_selector) {
+                base = end;
+            } else if (end > begin) {
+                ranges.emplace_back(base + begin, base + end);
+            }
+        }
+        return;
+    }
+
+    if (is_index) {
+        // rnglistx: an index into the offset array that follows the list table header
+        DwarfCursor offsets(rnglists_, unit.rnglists_base + offset * unit.offset_size);
+        offset = unit.rnglists_base + offsets.fixed(unit.offset_size);
+        if (!offsets.ok()) {
+            return;
+        }
+    }
+    DwarfCursor c(rnglists_, offset);
+    while (c.ok()) {
+        uint8_t kind = c.u8();
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        switch (kind) {
+        case DW_RLE_end_of_list:
+            return;
+        case DW_RLE_base_addressx:
+            base = readAddrx(unit, c.uleb());
+            continue;
+        case DW_RLE_startx_endx:
+            begin = readAddrx(unit, c.uleb());
+            end = readAddrx(unit, c.uleb());
+            break;
+        case DW_RLE_startx_length:
+            begin = readAddrx(unit, c.uleb());
+            end = begin + c.uleb();
+            break;
+        case DW_RLE_offset_pair:
+            begin = base + c.uleb();
+            end = base + c.uleb();
+            break;
+        case DW_RLE_base_address:
+            base = c.fixed(unit.address_size);
+            continue;
+        case DW_RLE_start_end:
+            begin = c.fixed(unit.address_size);
+            end = c.fixed(unit.address_size);
+            break;
+        case DW_RLE_start_length:
+            begin = c.fixed(unit.address_size);
+            end = begin + c.uleb();
+            break;
+        default:
+            return;
+        }
+        if (c.ok() && end > begin) {
+            ranges.emplace_back(begin, end);
+        }
+    }
+}
+
+const std::vector<DwarfInlineIndex::InlineRange>& DwarfInlineIndex::inlineRanges(size_t index) {
+    using namespace dwarf;
+    auto [it, inserted] = inline_ranges_.try_emplace(index);
+    std::vector<InlineRange>& result = it->second;
+    if (!inserted) {
+        return result;
+    }
+
+    const Unit& unit = units_[index];
+    const auto& abbrevs = abbrevTable(unit.abbrev_offset);
+    std::vector<uint32_t> depths; // Inline depth inside each open DIE that has children
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    DwarfCursor c(info_, unit.die_offset);
+    while (c.ok() && c.pos() < unit.end) {
+        uint64_t code = c.uleb();
+        if (code == 0) {
+            if (depths.empty()) {
+                break;
+            }
+            depths.pop_back();
+            continue;
+        }
+        auto abbrev_it = abbrevs.find(code);
+        if (!c.ok() || abbrev_it == abbrevs.end()) {
+            break;
+        }
+        const Abbrev& abbrev = abbrev_it->second;
+        uint32_t depth = depths.empty() ? 0 : depths.back();
+
+        if (abbrev.tag == DW_TAG_inlined_subroutine) {
+            ++depth;
+            InlineRange inlined;
+            inlined.depth = depth;
+            Value low;
+            Value high;
+            Value list;
+            bool has_high = false;
+            bool has_ranges = false;
+            for (const auto& spec : abbrev.specs) {
+                Value value;
+                if (!readValue(c, unit, spec, value)) {
+                    break;
+                }
+                if (spec.attr == DW_AT_abstract_origin) {
+                    inlined.origin = value.u;
+                } else if (spec.attr == DW_AT_call_file) {
+                    inlined.call_file = static_cast<uint32_t>(value.u);
+                } else if (spec.attr == DW_AT_call_line) {
+                    inlined.call_line = static_cast<uint32_t>(value.u);
+                } else if (spec.attr == DW_AT_low_pc) {
+                    low = value;
+                } else if (spec.attr == DW_AT_high_pc) {
+                    high = value;
+                    has_high = true;
+                } else if (spec.attr == DW_AT_ranges) {
+                    list = value;
+                    has_ranges = true;
+                }
+            }
+
+            ranges.clear();
+            if (has_ranges) {
+                readRanges(unit, list.u, list.is_index, ranges);
+            } else if (has_high) {
+                ranges.emplace_back(low.u, high.is_offset ? low.u + high.u : high.u);
+            }
+            for (const auto& [begin, end] : ranges) {
+                if (begin != 0 && end > begin) {
+                    inlined.low = begin;
+                    inlined.high = end;
+                    result.push_back(inlined);
+                }
+            }
+        } else {
+            if (abbrev.tag == DW_TAG_subprogram) {
+                depth = 0; // A nested function starts its own inline chain
+            }
+            for (const auto& spec : abbrev.specs) {
+                if (!c.skipForm(spec.form, unit.offset_size, unit.address_size, unit.version)) {
+                    break;
+                }
+            }
+        }
+        if (abbrev.has_children) {
+            depths.push_back(depth);
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const InlineRange& a, const InlineRange& b) { return a.low < b.low; });
+    uint64_t max_high = 0;
+    for (auto& range : result) {
+        max_high = std::max(max_high, range.high);
+        range.max_high = max_high;
+    }
+    return result;
+}
+
+const DwarfInlineIndex::Unit* DwarfInlineIndex::unitAt(uint64_t die_offset) const {
+    auto it = std::upper_bound(units_.begin(), units_.end(), die_offset,
+                               [](uint64_t offset, const Unit& unit) { return offset < unit.offset; });
+    if (it == units_.begin()) {
+        return nullptr;
+    }
+    --it;
+    return die_offset >= it->die_offset && die_offset < it->end ? &*it : nullptr;
+}
+
+const std::string& DwarfInlineIndex::functionName(uint64_t die_offset) {
+    auto it = names_.find(die_offset);
+    if (it == names_.end()) {
+        it = names_.emplace(die_offset, resolveName(die_offset, 0)).first;
+    }
+    return it->second;
+}
+
+std::string DwarfInlineIndex::resolveName(uint64_t die_offset, int hops) {
+    using namespace dwarf;
+    const Unit* unit = unitAt(die_offset);
+    if (!unit || hops > kMaxNameHops) {
+        return {};
+    }
+
+    DwarfCursor c(info_, die_offset);
+    const auto& abbrevs = abbrevTable(unit->abbrev_offset);
+    auto abbrev_it = abbrevs.find(c.uleb());
+    if (!c.ok() || abbrev_it == abbrevs.end()) {
+        return {};
+    }
+
+    std::string_view linkage_name;
+    std::string_view name;
+    uint64_t next = 0;
+    for (const auto& spec : abbrev_it->second.specs) {
+        Value value;
+        if (!readValue(c, *unit, spec, value)) {
+            break;
+        }
+        if ((spec.attr == DW_AT_linkage_name || spec.attr == DW_AT_MIPS_linkage_name) && value.is_string) {
+            linkage_name = value.str;
+        } else if (spec.attr == DW_AT_name && value.is_string) {
+            name = value.str;
+        } else if ((spec.attr == DW_AT_abstract_origin || spec.attr == DW_AT_specification) && !value.is_string &&
+                   spec.form != DW_FORM_GNU_ref_alt && spec.form != DW_FORM_ref_sig8) {
+            next = value.u;
+        }
+    }
+
+    // The linkage name carries the namespace and class; the plain name does not
+    if (!linkage_name.empty()) {
+        return demangle(linkage_name);
+    }
+    if (next != 0 && next != die_offset) {
+        std::string resolved = resolveName(next, hops + 1);
+        if (!resolved.empty()) {
+            return resolved;
+        }
+    }
+    return std::string(name);
+}
+
+bool DwarfInlineIndex::lookup(uintptr_t address, std::vector<InlineFrame>& frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!load()) {
+        return false;
+    }
+
+    auto unit_it = std::upper_bound(unit_ranges_.begin(), unit_ranges_.end(), address,
+                                    [](uint64_t addr, const UnitRange& range) { return addr < range.low; });
+    // Ranges of different units do not normally overlap, but look a few back
+    for (int checked = 0; unit_it != unit_ranges_.begin() && checked < 8; ++checked) {
+        --unit_it;
+        if (address >= unit_it->high) {
+            continue;
+        }
+
+        const auto& ranges = inlineRanges(unit_it->unit);
+        std::vector<const InlineRange*> hits;
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), address,
+                                   [](uint64_t addr, const InlineRange& range) { return addr < range.low; });
+        while (it != ranges.begin()) {
+            --it;
+            if (it->max_high <= address) {
+                break;
+            }
+            if (address < it->high) {
+                hits.push_back(&*it);
+            }
+        }
+        if (hits.empty()) {
+            return false;
+        }
+
+        std::sort(hits.begin(), hits.end(),
+                  [](const InlineRange* a, const InlineRange* b) { return a->depth < b->depth; });
+        const Unit& unit = units_[unit_it->unit];
+        frames.clear();
+        for (const InlineRange* hit : hits) {
+            InlineFrame frame;
+            frame.function = functionName(hit->origin);
+            if (lines_ && unit.stmt_list != UINT64_MAX) {
+                frame.call_file = lines_->fileName(unit.stmt_list, hit->call_file);
+            }
+            frame.call_line = hit->call_line;
+            frames.push_back(std::move(frame));
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
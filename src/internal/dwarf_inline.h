@@ -0,0 +1,137 @@
+/// @file dwarf_inline.h
+/// @brief Inline expansion of addresses from DWARF DW_TAG_inlined_subroutine entries
+
+#pragma once
+
+#include "internal/dwarf_line.h"
+#include "internal/dwarf_reader.h"
+#include "internal/elf_file.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief One inlined call covering an address
+struct InlineFrame {
+    std::string function;       ///< Demangled name of the inlined function
+    std::string call_file;      ///< Source file of the call site in the enclosing function
+    unsigned int call_line = 0; ///< Line of the call site
+};
+
+/// @class DwarfInlineIndex
+/// @brief Per-module index of inlined-subroutine address ranges
+///
+/// Units are located by their DW_AT_low_pc/high_pc/ranges on first use; the
+/// DIE tree of a unit is walked only when one of its addresses is looked up,
+/// and function names are resolved (through DW_AT_abstract_origin and
+/// DW_AT_specification) once per origin. Supports DWARF 2-5 including
+/// .debug_rnglists and the addrx/strx forms. Thread-safe.
+class DwarfInlineIndex {
+public:
+    /// @param elf The module's ELF file (nullptr if it could not be opened)
+    /// @param lines The module's line table, used to name DW_AT_call_file entries
+    DwarfInlineIndex(std::shared_ptr<ElfFile> elf, std::shared_ptr<DwarfLineTable> lines);
+    ~DwarfInlineIndex();
+
+    DwarfInlineIndex(const DwarfInlineIndex&) = delete;
+    DwarfInlineIndex& operator=(const DwarfInlineIndex&) = delete;
+
+    /// @brief Inlined calls covering a link-time address
+    /// @param address Runtime address minus the module's load bias
+    /// @param frames Receives the calls, outermost first
+    /// @return false if the address is not inside any inlined call
+    bool lookup(uintptr_t address, std::vector<InlineFrame>& frames);
+
+private:
+    struct AttrSpec {
+        uint64_t attr = 0;
+        uint64_t form = 0;
+        int64_t implicit_const = 0;
+    };
+
+    struct Abbrev {
+        uint64_t tag = 0;
+        bool has_children = false;
+        std::vector<AttrSpec> specs;
+    };
+
+    struct Unit {
+        uint64_t offset = 0;     ///< Offset of the unit header in .debug_info
+        uint64_t end = 0;        ///< Offset one past the unit
+        uint64_t die_offset = 0; ///< Offset of the unit DIE
+        uint64_t abbrev_offset = 0;
+        uint16_t version = 0;
+        uint8_t address_size = 0;
+        uint8_t offset_size = 4;
+        uint64_t low_pc = 0; ///< Base address for range lists
+        uint64_t stmt_list = UINT64_MAX;
+        uint64_t addr_base = 0;
+        uint64_t rnglists_base = 0;
+        uint64_t str_offsets_base = 0;
+    };
+
+    struct InlineRange {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        uint64_t max_high = 0; ///< Highest high of this and all earlier ranges
+        uint32_t depth = 0;    ///< 1 for a call inlined into the subprogram itself
+        uint64_t origin = 0;   ///< .debug_info offset of the DIE naming the function
+        uint32_t call_file = 0;
+        uint32_t call_line = 0;
+    };
+
+    struct UnitRange {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        size_t unit = 0;
+    };
+
+    /// @brief A decoded attribute value
+    struct Value {
+        uint64_t u = 0;
+        std::string_view str;
+        bool is_string = false;
+        bool is_offset = false; ///< Constant class (high_pc relative to low_pc)
+        bool is_index = false;  ///< rnglistx/loclistx index rather than a section offset
+    };
+
+    bool load();
+    const std::unordered_map<uint64_t, Abbrev>& abbrevTable(uint64_t offset);
+    bool readValue(DwarfCursor& cursor, const Unit& unit, const AttrSpec& spec, Value& value);
+    uint64_t readAddrx(const Unit& unit, uint64_t index);
+    void readRanges(const Unit& unit, uint64_t offset, bool is_index,
+                    std::vector<std::pair<uint64_t, uint64_t>>& ranges);
+    const std::vector<InlineRange>& inlineRanges(size_t unit);
+    const Unit* unitAt(uint64_t die_offset) const;
+    const std::string& functionName(uint64_t die_offset);
+    std::string resolveName(uint64_t die_offset, int hops);
+
+    std::mutex mutex_;
+    bool loaded_ = false;
+    std::shared_ptr<ElfFile> elf_;
+    std::shared_ptr<DwarfLineTable> lines_;
+    std::string_view info_;
+    std::string_view abbrev_;
+    std::string_view str_;
+    std::string_view line_str_;
+    std::string_view str_offsets_;
+    std::string_view addr_;
+    std::string_view ranges_;
+    std::string_view rnglists_;
+    std::vector<Unit> units_;                                                    ///< Sorted by offset
+    std::vector<UnitRange> unit_ranges_;                                         ///< Sorted by low
+    std::unordered_map<uint64_t, std::unordered_map<uint64_t, Abbrev>> abbrevs_; ///< By table offset
+    std::unordered_map<size_t, std::vector<InlineRange>> inline_ranges_;         ///< By unit index
+    std::unordered_map<uint64_t, std::string> names_;                            ///< By origin DIE offset
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,534 @@
+#include "internal/dwarf_line.h"
+#include "internal/dwarf_reader.h"
+#include <algorithm>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// Line number program opcodes
+constexpr uint8_t DW_LNS_copy = 1;
+constexpr uint8_t DW_LNS_advance_pc = 2;
+constexpr uint8_t DW_LNS_advance_line = 3;
+constexpr uint8_t DW_LNS_set_file = 4;
+constexpr uint8_t DW_LNS_const_add_pc = 8;
+constexpr uint8_t DW_LNS_fixed_advance_pc = 9;
+constexpr uint8_t DW_LNE_end_sequence = 1;
+constexpr uint8_t DW_LNE_set_address = 2;
+constexpr uint8_t DW_LNE_define_file = 3;
+
+// DWARF 5 directory/file entry content types
+constexpr uint64_t DW_LNCT_path = 1;
+constexpr uint64_t DW_LNCT_directory_index = 2;
+
+struct EntryFormat {
+    uint64_t content_type;
+    uint64_t form;
+};
+
+std::string joinPath(std::string_view dir, std::string_view name) {
+    if (name.empty() || name[0] == '/' || dir.empty()) {
+        return std::string(name);
+    }
+    std::string path(dir);
+    if (path.back() != '/') {
+        path += '/';
+    }
+    path += name;
+    return path;
+}
+
+} // namespace
+
+DwarfLineTable::DwarfLineTable(std::shared_ptr<ElfFile> elf) : elf_(std::move(elf)) {}
+
+DwarfLineTable::~DwarfLineTable() = default;
+
+bool DwarfLineTable::load() {
+    if (loaded_) {
+        return valid_;
+    }
+    loaded_ = true;
+
+    if (!elf_) {
+        return false;
+    }
+    debug_line_ = elf_->section(".debug_line");
+    if (debug_line_.empty()) {
+        return false;
+    }
+    debug_line_str_ = elf_->section(".debug_line_str");
+    debug_str_ = elf_->section(".debug_str");
+
+    if (!indexFromAranges()) {
+        indexFromLinePrograms();
+    }
+    valid_ = true;
+    return true;
+}
+
+bool DwarfLineTable::unitLineInfo(uint64_t info_offset, uint64_t& stmt_list, std::string& comp_dir) {
+    using namespace dwarf;
+    std::string_view info = elf_->section(".debug_info");
+    std::string_view abbrev = elf_->section(".debug_abbrev");
+
+    DwarfCursor c(info, info_offset);
+    uint8_t offset_size = 4;
+    c.unitLength(offset_size);
+    uint16_t version = c.u16();
+    uint64_t abbrev_offset = 0;
+    uint8_t address_size = 0;
+    if (version >= 5) {
+        uint8_t unit_type = c.u8();
+        address_size = c.u8();
+        abbrev_offset = c.fixed(offset_size);
+        if (unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile) {
+            c.skip(8); // dwo_id
+        } else if (unit_type == DW_UT_type || unit_type == DW_UT_split_type) {
+            c.skip(8 + offset_size);
+        }
+    } else {
+        abbrev_offset = c.fixed(offset_size);
+        address_size = c.u8();
+    }
+    uint64_t code = c.uleb();
+    if (!c.ok() || version < 2 || version > 5 || code == 0) {
+        return false;
+    }
+
+    // Find the abbreviation of the unit DIE
+    DwarfCursor a(abbrev, abbrev_offset);
+    while (true) {
+        uint64_t entry_code = a.uleb();
+        if (!a.ok() || entry_code == 0) {
+            return false;
+        }
+        a.uleb(); // tag
+        a.u8();   // has children
+        if (entry_code == code) {
+            break;
+        }
+        while (a.ok()) {
+            uint64_t attr = a.uleb();
+            uint64_t form = a.uleb();
+            if (form == DW_FORM_implicit_const) {
+                a.sleb();
+            }
+            if (attr == 0 && form == 0) {
+                break;
+            }
+        }
+    }
+
+    bool found = false;
+    while (a.ok() && c.ok()) {
+        uint64_t attr = a.uleb();
+        uint64_t form = a.uleb();
+        if (form == DW_FORM_implicit_const) {
+            a.sleb();
+        }
+        if (attr == 0 && form == 0) {
+            break;
+        }
+
+        if (attr == DW_AT_stmt_list && (form == DW_FORM_sec_offset || form == DW_FORM_data4 || form == DW_FORM_data8)) {
+            stmt_list = c.fixed(form == DW_FORM_data4 ? 4 : form == DW_FORM_data8 ? 8 : offset_size);
+            found = true;
+        } else if (attr == DW_AT_comp_dir && form == DW_FORM_string) {
+            comp_dir = c.cstr();
+        } else if (attr == DW_AT_comp_dir && form == DW_FORM_strp) {
+            comp_dir = stringAt(debug_str_, c.fixed(offset_size));
+        } else if (attr == DW_AT_comp_dir && form == DW_FORM_line_strp) {
+            comp_dir = stringAt(debug_line_str_, c.fixed(offset_size));
+        } else if (!c.skipForm(form, offset_size, address_size, version)) {
+            break;
+        }
+    }
+    return found && c.ok();
+}
+
+bool DwarfLineTable::indexFromAranges() {
+    std::string_view aranges = elf_->section(".debug_aranges");
+    if (aranges.empty()) {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, uint64_t> stmt_of_unit; // .debug_info offset -> stmt_list
+    DwarfCursor c(aranges);
+    while (!c.atEnd()) {
+        size_t set_start = c.pos();
+        uint8_t offset_size = 4;
+        uint64_t length = c.unitLength(offset_size);
+        size_t set_end = c.pos() + length;
+        if (!c.ok() || length == 0 || set_end > aranges.size()) {
+            break;
+        }
+        c.u16(); // version
+        uint64_t info_offset = c.fixed(offset_size);
+        uint8_t address_size = c.u8();
+        c.u8(); // segment selector size
+        if (address_size == 0 || address_size > 8) {
+            c.seek(set_end);
+            continue;
+        }
+        // Tuples are aligned to twice the address size from the set start
+        size_t tuple_size = 2 * address_size;
+        c.skip((tuple_size - (c.pos() - set_start) % tuple_size) % tuple_size);
+
+        auto [it, inserted] = stmt_of_unit.try_emplace(info_offset, UINT64_MAX);
+        if (inserted) {
+            uint64_t stmt_list = 0;
+            std::string comp_dir;
+            if (unitLineInfo(info_offset, stmt_list, comp_dir)) {
+                it->second = stmt_list;
+                comp_dirs_.emplace(stmt_list, std::move(comp_dir));
+            }
+        }
+
+        while (c.ok() && c.pos() + tuple_size <= set_end) {
+            uint64_t address = c.fixed(address_size);
+            uint64_t size = c.fixed(address_size);
+            if (address == 0 && size == 0) {
+                break;
+            }
+            // Address 0 marks code removed by the linker (--gc-sections, COMDAT)
+            if (address != 0 && size > 0 && it->second != UINT64_MAX) {
+                ranges_.push_back(UnitRange{address, address + size, it->second});
+            }
+        }
+        c.seek(set_end);
+    }
+
+    std::sort(ranges_.begin(), ranges_.end(), [](const UnitRange& a, const UnitRange& b) { return a.low < b.low; });
+    return !ranges_.empty();
+}
+
+void DwarfLineTable::indexFromLinePrograms() {
+    scanned_all_ = true;
+
+    // Without .debug_aranges no unit DIE has been read, yet DWARF 2-4 programs
+    // name files relative to their unit's DW_AT_comp_dir: read it from every unit
+    std::string_view info = elf_->section(".debug_info");
+    DwarfCursor units(info);
+    while (!units.atEnd()) {
+        size_t unit_offset = units.pos();
+        uint8_t offset_size = 4;
+        uint64_t length = units.unitLength(offset_size);
+        if (!units.ok() || length == 0 || length > info.size() - units.pos()) {
+            break;
+        }
+        uint64_t stmt_list = 0;
+        std::string comp_dir;
+        if (unitLineInfo(unit_offset, stmt_list, comp_dir) && !comp_dir.empty()) {
+            comp_dirs_.try_emplace(stmt_list, std::move(comp_dir));
+        }
+        units.seek(units.pos() + length);
+    }
+
+    // Decode every program once just to learn its sequence ranges; the rows are
+    // dropped and decoded again on demand, keeping memory proportional to use.
+    uint64_t offset = 0;
+    LineProgram scratch;
+    while (offset < debug_line_.size()) {
+        uint64_t next_offset = 0;
+        scratch.files.clear();
+        scratch.rows.clear();
+        scratch.sequences.clear();
+        if (!decodeProgram(offset, {}, scratch, next_offset)) {
+            if (next_offset <= offset) {
+                break; // Not even the unit length is readable: the rest cannot be located
+            }
+            // One unit we cannot decode (unknown version, bad header) does not hide the others
+            offset = next_offset;
+            continue;
+        }
+        for (const auto& [low, high] : scratch.sequences) {
+            // Address 0 marks code removed by the linker (--gc-sections)
+            if (low != 0 && high > low) {
+                ranges_.push_back(UnitRange{low, high, offset});
+            }
+        }
+        offset = next_offset;
+    }
+
+    std::sort(ranges_.begin(), ranges_.end(), [](const UnitRange& a, const UnitRange& b) { return a.low < b.low; });
+}
+
+bool DwarfLineTable::decodeProgram(uint64_t offset, std::string_view comp_dir, LineProgram& program,
+                                   uint64_t& next_offset) {
+    using namespace dwarf;
+    DwarfCursor c(debug_line_, offset);
+    uint8_t offset_size = 4;
+    uint64_t unit_length = c.unitLength(offset_size);
+    size_t unit_end = c.pos() + unit_length;
+    if (!c.ok() || unit_end > debug_line_.size()) {
+        return false;
+    }
+    next_offset = unit_end;
+
+    uint16_t version = c.u16();
+    if (version < 2 || version > 5) {
+        return false;
+    }
+    uint8_t address_size = sizeof(void*);
+    if (version >= 5) {
+        address_size = c.u8();
+        c.u8(); // segment selector size
+    }
+    uint64_t header_length = c.fixed(offset_size);
+    size_t program_start = c.pos() + header_length;
+    uint8_t min_inst_length = c.u8();
+    if (version >= 4) {
+        c.u8(); // maximum_operations_per_instruction (VLIW only)
+    }
+    c.u8(); // default_is_stmt
+    int8_t line_base = static_cast<int8_t>(c.u8());
+    uint8_t line_range = c.u8();
+    uint8_t opcode_base = c.u8();
+    std::vector<uint8_t> standard_lengths;
+    for (int i = 1; i < opcode_base; ++i) {
+        standard_lengths.push_back(c.u8());
+    }
+    if (!c.ok() || line_range == 0 || opcode_base == 0 || program_start > unit_end) {
+        return false;
+    }
+
+    std::vector<std::string> dirs;
+    if (version >= 5) {
+        auto readFormats = [&c]() {
+            std::vector<EntryFormat> formats(c.u8());
+            for (auto& format : formats) {
+                format.content_type = c.uleb();
+                format.form = c.uleb();
+            }
+            return formats;
+        };
+        // Read the entries of the directory or file table; returns (path, dir index) pairs
+        auto readEntries = [&](const std::vector<EntryFormat>& formats) {
+            std::vector<std::pair<std::string_view, uint64_t>> entries(c.uleb());
+            for (auto& [path, dir_index] : entries) {
+                for (const auto& format : formats) {
+                    if (format.content_type == DW_LNCT_path) {
+                        if (format.form == DW_FORM_string) {
+                            path = c.cstr();
+                        } else if (format.form == DW_FORM_line_strp) {
+                            path = stringAt(debug_line_str_, c.fixed(offset_size));
+                        } else if (format.form == DW_FORM_strp) {
+                            path = stringAt(debug_str_, c.fixed(offset_size));
+                        } else {
+                            c.skipForm(format.form, offset_size, address_size, version);
+                        }
+                    } else if (format.content_type == DW_LNCT_directory_index) {
+                        if (format.form == DW_FORM_udata) {
+                            dir_index = c.uleb();
+                        } else if (format.form == DW_FORM_data1 || format.form == DW_FORM_data2) {
+                            dir_index = c.fixed(format.form == DW_FORM_data1 ? 1 : 2);
+                        } else {
+                            c.skipForm(format.form, offset_size, address_size, version);
+                        }
+                    } else {
+                        c.skipForm(format.form, offset_size, address_size, version);
+                    }
+                }
+            }
+            return entries;
+        };
+
+        auto dir_formats = readFormats();
+        for (const auto& [path, unused] : readEntries(dir_formats)) {
+            dirs.push_back(dirs.empty() ? joinPath(comp_dir, path) : joinPath(dirs[0], path));
+        }
+        auto file_formats = readFormats();
+        for (const auto& [path, dir_index] : readEntries(file_formats)) {
+            program.files.push_back(joinPath(dir_index < dirs.size() ? dirs[dir_index] : std::string(), path));
+        }
+    } else {
+        // Directory 0 and file 0 are implicit before DWARF 5
+        dirs.emplace_back(comp_dir);
+        while (c.ok()) {
+            std::string_view dir = c.cstr();
+            if (dir.empty()) {
+                break;
+            }
+            dirs.push_back(joinPath(comp_dir, dir));
+        }
+        program.files.emplace_back();
+        while (c.ok()) {
+            std::string_view name = c.cstr();
+            if (name.empty()) {
+                break;
+            }
+            uint64_t dir_index = c.uleb();
+            c.uleb(); // mtime
+            c.uleb(); // length
+            program.files.push_back(joinPath(dir_index < dirs.size() ? dirs[dir_index] : std::string(), name));
+        }
+    }
+    if (!c.ok()) {
+        return false;
+    }
+
+    // Run the line number state machine
+    c.seek(program_start);
+    uint64_t address = 0;
+    uint32_t file = 1;
+    int64_t line = 1;
+    uint64_t sequence_low = 0;
+    bool in_sequence = false;
+    auto emit = [&](bool end_sequence) {
+        program.rows.push_back(Row{address, file, static_cast<uint32_t>(line > 0 ? line : 0), end_sequence});
+        if (!in_sequence) {
+            sequence_low = address;
+            in_sequence = true;
+        }
+        if (end_sequence) {
+            program.sequences.emplace_back(sequence_low, address);
+            in_sequence = false;
+        }
+    };
+
+    while (c.ok() && c.pos() < unit_end) {
+        uint8_t opcode = c.u8();
+        if (opcode >= opcode_base) {
+            uint8_t adjusted = opcode - opcode_base;
+            address += static_cast<uint64_t>(adjusted / line_range) * min_inst_length;
+            line += line_base + adjusted % line_range;
+            emit(false);
+            continue;
+        }
+
+        switch (opcode) {
+        case 0: {
+            uint64_t length = c.uleb();
+            size_t end = c.pos() + length;
+            if (length == 0 || end > unit_end) {
+                c.seek(unit_end);
+                break;
+            }
+            uint8_t sub = c.u8();
+            if (sub == DW_LNE_end_sequence) {
+                emit(true);
+                address = 0;
+                file = 1;
+                line = 1;
+            } else if (sub == DW_LNE_set_address) {
+                address = c.fixed(length - 1);
+            } else if (sub == DW_LNE_define_file) {
+                std::string_view name = c.cstr();
+                uint64_t dir_index = c.uleb();
+                program.files.push_back(joinPath(dir_index < dirs.size() ? dirs[dir_index] : std::string(), name));
+            }
+            c.seek(end);
+            break;
+        }
+        case DW_LNS_copy:
+            emit(false);
+            break;
+        case DW_LNS_advance_pc:
+            address += c.uleb() * min_inst_length;
+            break;
+        case DW_LNS_advance_line:
+            line += c.sleb();
+            break;
+        case DW_LNS_set_file:
+            file = static_cast<uint32_t>(c.uleb());
+            break;
+        case DW_LNS_const_add_pc:
+            address += static_cast<uint64_t>((255 - opcode_base) / line_range) * min_inst_length;
+            break;
+        case DW_LNS_fixed_advance_pc:
+            address += c.u16();
+            break;
+        default:
+            // set_column, negate_stmt, basic_block, prologue_end, ... and
+            // unknown opcodes: skip their ULEB128 operands
+            for (uint8_t i = 0; i < standard_lengths[opcode - 1]; ++i) {
+                c.uleb();
+            }
+            break;
+        }
+    }
+
+    // An end_sequence row must sort before a sequence starting at the same address
+    std::stable_sort(program.rows.begin(), program.rows.end(), [](const Row& a, const Row& b) {
+        return a.address != b.address ? a.address < b.address : a.end_sequence > b.end_sequence;
+    });
+    return true;
+}
+
+const DwarfLineTable::LineProgram* DwarfLineTable::program(uint64_t stmt_list) {
+    auto it = programs_.find(stmt_list);
+    if (it != programs_.end()) {
+        return &it->second;
+    }
+
+    std::string_view comp_dir;
+    auto dir_it = comp_dirs_.find(stmt_list);
+    if (dir_it != comp_dirs_.end()) {
+        comp_dir = dir_it->second;
+    }
+
+    LineProgram decoded;
+    uint64_t next_offset = 0;
+    if (!decodeProgram(stmt_list, comp_dir, decoded, next_offset)) {
+        decoded.rows.clear(); // Cache the failure as an empty program
+    }
+    return &programs_.emplace(stmt_list, std::move(decoded)).first->second;
+}
+
+bool DwarfLineTable::lookupInRanges(uint64_t address, std::string& file, unsigned int& line) {
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), address,
+                               [](uint64_t addr, const UnitRange& range) { return addr < range.low; });
+    // Ranges of different units do not normally overlap, but look a few back
+    for (int checked = 0; it != ranges_.begin() && checked < 8; ++checked) {
+        --it;
+        if (address >= it->high) {
+            continue;
+        }
+        const LineProgram* prog = program(it->stmt_list);
+        auto row = std::upper_bound(prog->rows.begin(), prog->rows.end(), address,
+                                    [](uint64_t addr, const Row& r) { return addr < r.address; });
+        if (row == prog->rows.begin()) {
+            continue;
+        }
+        --row;
+        if (row->end_sequence || row->line == 0 || row->file >= prog->files.size()) {
+            continue;
+        }
+        file = prog->files[row->file];
+        line = row->line;
+        return true;
+    }
+    return false;
+}
+
+bool DwarfLineTable::lookup(uintptr_t address, std::string& file, unsigned int& line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!load()) {
+        return false;
+    }
+    if (lookupInRanges(address, file, line)) {
+        return true;
+    }
+    // Not every unit has aranges (e.g. clang without -gdwarf-aranges, assembly)
+    if (!scanned_all_) {
+        indexFromLinePrograms();
+        return lookupInRanges(address, file, line);
+    }
+    return false;
+}
+
+std::string DwarfLineTable::fileName(uint64_t stmt_list, uint64_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!load()) {
+        return {};
+    }
+    const LineProgram* prog = program(stmt_list);
+    return index < prog->files.size() ? prog->files[index] : std::string();
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,92 @@
+/// @file dwarf_line.h
+/// @brief In-process DWARF .debug_line reader for address -> file:line lookup
+
+#pragma once
+
+#include "internal/elf_file.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class DwarfLineTable
+/// @brief Source positions of one ELF module, decoded from DWARF 2-5 line programs
+///
+/// Nothing is read until the first lookup. The file's compilation units are
+/// then indexed by address range (.debug_aranges, or a one-off scan of all line
+/// programs when aranges are missing or incomplete), and each unit's line
+/// program is decoded the first time one of its addresses is looked up.
+/// Thread-safe.
+class DwarfLineTable {
+public:
+    /// @param elf The module's ELF file, already opened (nullptr if it could not be)
+    explicit DwarfLineTable(std::shared_ptr<ElfFile> elf);
+    ~DwarfLineTable();
+
+    DwarfLineTable(const DwarfLineTable&) = delete;
+    DwarfLineTable& operator=(const DwarfLineTable&) = delete;
+
+    /// @brief Find the source position of a link-time address
+    /// @param address Runtime address minus the module's load bias
+    /// @param file Receives the source file path
+    /// @param line Receives the line number
+    /// @return false if the module has no line information for the address
+    bool lookup(uintptr_t address, std::string& file, unsigned int& line);
+
+    /// @brief Full path of an entry of a unit's file table (e.g. for DW_AT_call_file)
+    /// @param stmt_list Offset of the unit's line program (DW_AT_stmt_list)
+    /// @param index File index as used by the line program
+    /// @return The path, or an empty string if unknown
+    std::string fileName(uint64_t stmt_list, uint64_t index);
+
+private:
+    struct Row {
+        uint64_t address = 0;
+        uint32_t file = 0;
+        uint32_t line = 0;
+        bool end_sequence = false;
+    };
+
+    struct LineProgram {
+        std::vector<std::string> files;                       ///< Full paths, indexed by the file register
+        std::vector<Row> rows;                                ///< Sorted by address
+        std::vector<std::pair<uint64_t, uint64_t>> sequences; ///< [low, high) of each sequence
+    };
+
+    struct UnitRange {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        uint64_t stmt_list = 0; ///< Offset of the unit's line program
+    };
+
+    bool load();
+    bool indexFromAranges();
+    void indexFromLinePrograms();
+    bool unitLineInfo(uint64_t info_offset, uint64_t& stmt_list, std::string& comp_dir);
+    const LineProgram* program(uint64_t stmt_list);
+    bool decodeProgram(uint64_t offset, std::string_view comp_dir, LineProgram& program, uint64_t& next_offset);
+    bool lookupInRanges(uint64_t address, std::string& file, unsigned int& line);
+
+    std::mutex mutex_;
+    bool loaded_ = false;
+    bool valid_ = false;
+    bool scanned_all_ = false; ///< indexFromLinePrograms() already ran
+    std::shared_ptr<ElfFile> elf_;
+    std::string_view debug_line_;
+    std::string_view debug_line_str_;
+    std::string_view debug_str_;
+    std::vector<UnitRange> ranges_;                       ///< Sorted by low
+    std::unordered_map<uint64_t, std::string> comp_dirs_; ///< stmt_list -> DW_AT_comp_dir
+    std::unordered_map<uint64_t, LineProgram> programs_;  ///< stmt_list -> decoded program
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
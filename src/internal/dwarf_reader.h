@@ -0,0 +1,339 @@
+/// @file dwarf_reader.h
+/// @brief Bounds-checked cursor over DWARF section data
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// DWARF constants used by the readers (subset of the DWARF 5 spec)
+namespace dwarf {
+constexpr uint64_t DW_TAG_compile_unit = 0x11;
+constexpr uint64_t DW_TAG_inlined_subroutine = 0x1d;
+constexpr uint64_t DW_TAG_subprogram = 0x2e;
+constexpr uint64_t DW_TAG_partial_unit = 0x3c;
+constexpr uint64_t DW_TAG_skeleton_unit = 0x4a;
+
+constexpr uint64_t DW_AT_name = 0x03;
+constexpr uint64_t DW_AT_stmt_list = 0x10;
+constexpr uint64_t DW_AT_low_pc = 0x11;
+constexpr uint64_t DW_AT_high_pc = 0x12;
+constexpr uint64_t DW_AT_comp_dir = 0x1b;
+constexpr uint64_t DW_AT_abstract_origin = 0x31;
+constexpr uint64_t DW_AT_specification = 0x47;
+constexpr uint64_t DW_AT_ranges = 0x55;
+constexpr uint64_t DW_AT_call_file = 0x58;
+constexpr uint64_t DW_AT_call_line = 0x59;
+constexpr uint64_t DW_AT_linkage_name = 0x6e;
+constexpr uint64_t DW_AT_str_offsets_base = 0x72;
+constexpr uint64_t DW_AT_addr_base = 0x73;
+constexpr uint64_t DW_AT_rnglists_base = 0x74;
+constexpr uint64_t DW_AT_MIPS_linkage_name = 0x2007;
+constexpr uint64_t DW_AT_GNU_addr_base = 0x2133;
+
+constexpr uint8_t DW_UT_compile = 0x01;
+constexpr uint8_t DW_UT_type = 0x02;
+constexpr uint8_t DW_UT_partial = 0x03;
+constexpr uint8_t DW_UT_skeleton = 0x04;
+constexpr uint8_t DW_UT_split_compile = 0x05;
+constexpr uint8_t DW_UT_split_type = 0x06;
+
+constexpr uint64_t DW_FORM_addr = 0x01;
+constexpr uint64_t DW_FORM_block2 = 0x03;
+constexpr uint64_t DW_FORM_block4 = 0x04;
+constexpr uint64_t DW_FORM_data2 = 0x05;
+constexpr uint64_t DW_FORM_data4 = 0x06;
+constexpr uint64_t DW_FORM_data8 = 0x07;
+constexpr uint64_t DW_FORM_string = 0x08;
+constexpr uint64_t DW_FORM_block = 0x09;
+constexpr uint64_t DW_FORM_block1 = 0x0a;
+constexpr uint64_t DW_FORM_data1 = 0x0b;
+constexpr uint64_t DW_FORM_flag = 0x0c;
+constexpr uint64_t DW_FORM_sdata = 0x0d;
+constexpr uint64_t DW_FORM_strp = 0x0e;
+constexpr uint64_t DW_FORM_udata = 0x0f;
+constexpr uint64_t DW_FORM_ref_addr = 0x10;
+constexpr uint64_t DW_FORM_ref1 = 0x11;
+constexpr uint64_t DW_FORM_ref2 = 0x12;
+constexpr uint64_t DW_FORM_ref4 = 0x13;
+constexpr uint64_t DW_FORM_ref8 = 0x14;
+constexpr uint64_t DW_FORM_ref_udata = 0x15;
+constexpr uint64_t DW_FORM_indirect = 0x16;
+constexpr uint64_t DW_FORM_sec_offset = 0x17;
+constexpr uint64_t DW_FORM_exprloc = 0x18;
+constexpr uint64_t DW_FORM_flag_present = 0x19;
+constexpr uint64_t DW_FORM_strx = 0x1a;
+constexpr uint64_t DW_FORM_addrx = 0x1b;
+constexpr uint64_t DW_FORM_ref_sup4 = 0x1c;
+constexpr uint64_t DW_FORM_strp_sup = 0x1d;
+constexpr uint64_t DW_FORM_data16 = 0x1e;
+constexpr uint64_t DW_FORM_line_strp = 0x1f;
+constexpr uint64_t DW_FORM_ref_sig8 = 0x20;
+constexpr uint64_t DW_FORM_implicit_const = 0x21;
+constexpr uint64_t DW_FORM_loclistx = 0x22;
+constexpr uint64_t DW_FORM_rnglistx = 0x23;
+constexpr uint64_t DW_FORM_ref_sup8 = 0x24;
+constexpr uint64_t DW_FORM_strx1 = 0x25;
+constexpr uint64_t DW_FORM_strx2 = 0x26;
+constexpr uint64_t DW_FORM_strx3 = 0x27;
+constexpr uint64_t DW_FORM_strx4 = 0x28;
+constexpr uint64_t DW_FORM_addrx1 = 0x29;
+constexpr uint64_t DW_FORM_addrx2 = 0x2a;
+constexpr uint64_t DW_FORM_addrx3 = 0x2b;
+constexpr uint64_t DW_FORM_addrx4 = 0x2c;
+constexpr uint64_t DW_FORM_GNU_addr_index = 0x1f01;
+constexpr uint64_t DW_FORM_GNU_str_index = 0x1f02;
+constexpr uint64_t DW_FORM_GNU_ref_alt = 0x1f20;
+constexpr uint64_t DW_FORM_GNU_strp_alt = 0x1f21;
+} // namespace dwarf
+
+/// @class DwarfCursor
+/// @brief Little-endian reader that fails soft: reading past the end sets an
+/// error flag and yields zeros, so callers check ok() once per record.
+class DwarfCursor {
+public:
+    DwarfCursor() = default;
+    explicit DwarfCursor(std::string_view data, size_t pos = 0) : data_(data), pos_(pos) {
+        if (pos_ > data_.size()) {
+            fail();
+        }
+    }
+
+    bool ok() const {
+        return ok_;
+    }
+    bool atEnd() const {
+        return !ok_ || pos_ >= data_.size();
+    }
+    size_t pos() const {
+        return pos_;
+    }
+    std::string_view data() const {
+        return data_;
+    }
+
+    void seek(size_t pos) {
+        if (pos > data_.size()) {
+            fail();
+        } else {
+            pos_ = pos;
+        }
+    }
+
+    void skip(uint64_t n) {
+        if (n > data_.size() - pos_) {
+            fail();
+        } else {
+            pos_ += n;
+        }
+    }
+
+    uint64_t fixed(size_t n) {
+        if (n > 8 || n > data_.size() - pos_) {
+            fail();
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < n; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data_[pos_ + i])) << (8 * i);
+        }
+        pos_ += n;
+        return value;
+    }
+
+    uint8_t u8() {
+        return static_cast<uint8_t>(fixed(1));
+    }
+    uint16_t u16() {
+        return static_cast<uint16_t>(fixed(2));
+    }
+    uint32_t u32() {
+        return static_cast<uint32_t>(fixed(4));
+    }
+    uint64_t u64() {
+        return fixed(8);
+    }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        unsigned shift = 0;
+        while (true) {
+            uint8_t byte = u8();
+            if (!ok_) {
+                return 0;
+            }
+            if (shift < 64) {
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+
+    int64_t sleb() {
+        int64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte = 0;
+        do {
+            byte = u8();
+            if (!ok_) {
+                return 0;
+            }
+            if (shift < 64) {
+                value |= static_cast<int64_t>(byte & 0x7f) << shift;
+            }
+            shift += 7;
+        } while (byte & 0x80);
+        if (shift < 64 && (byte & 0x40)) {
+            value |= -(static_cast<int64_t>(1) << shift);
+        }
+        return value;
+    }
+
+    /// @brief NUL-terminated string (without the terminator)
+    std::string_view cstr() {
+        size_t end = data_.find('\0', pos_);
+        if (end == std::string_view::npos) {
+            fail();
+            return {};
+        }
+        std::string_view s = data_.substr(pos_, end - pos_);
+        pos_ = end + 1;
+        return s;
+    }
+
+    /// @brief Initial length field; sets offset_size to 4 or 8 (64-bit DWARF)
+    uint64_t unitLength(uint8_t& offset_size) {
+        uint64_t length = u32();
+        offset_size = 4;
+        if (length == 0xffffffffu) {
+            length = u64();
+            offset_size = 8;
+        }
+        return length;
+    }
+
+    /// @brief Skip the value of an attribute form
+    /// @return false for forms whose size is unknown
+    bool skipForm(uint64_t form, uint8_t offset_size, uint8_t address_size, uint16_t version) {
+        using namespace dwarf;
+        switch (form) {
+        case DW_FORM_flag_present:
+        case DW_FORM_implicit_const:
+            return true;
+        case DW_FORM_data1:
+        case DW_FORM_ref1:
+        case DW_FORM_flag:
+        case DW_FORM_strx1:
+        case DW_FORM_addrx1:
+            skip(1);
+            break;
+        case DW_FORM_data2:
+        case DW_FORM_ref2:
+        case DW_FORM_strx2:
+        case DW_FORM_addrx2:
+            skip(2);
+            break;
+        case DW_FORM_strx3:
+        case DW_FORM_addrx3:
+            skip(3);
+            break;
+        case DW_FORM_data4:
+        case DW_FORM_ref4:
+        case DW_FORM_ref_sup4:
+        case DW_FORM_strx4:
+        case DW_FORM_addrx4:
+            skip(4);
+            break;
+        case DW_FORM_data8:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_sig8:
+        case DW_FORM_ref_sup8:
+            skip(8);
+            break;
+        case DW_FORM_data16:
+            skip(16);
+            break;
+        case DW_FORM_addr:
+            skip(address_size);
+            break;
+        case DW_FORM_ref_addr:
+            skip(version <= 2 ? address_size : offset_size);
+            break;
+        case DW_FORM_strp:
+        case DW_FORM_sec_offset:
+        case DW_FORM_strp_sup:
+        case DW_FORM_line_strp:
+        case DW_FORM_GNU_ref_alt:
+        case DW_FORM_GNU_strp_alt:
+            skip(offset_size);
+            break;
+        case DW_FORM_sdata:
+            sleb();
+            break;
+        case DW_FORM_udata:
+        case DW_FORM_ref_udata:
+        case DW_FORM_strx:
+        case DW_FORM_addrx:
+        case DW_FORM_loclistx:
+        case DW_FORM_rnglistx:
+        case DW_FORM_GNU_addr_index:
+        case DW_FORM_GNU_str_index:
+            uleb();
+            break;
+        case DW_FORM_string:
+            cstr();
+            break;
+        case DW_FORM_block1:
+            skip(u8());
+            break;
+        case DW_FORM_block2:
+            skip(u16());
+            break;
+        case DW_FORM_block4:
+            skip(u32());
+            break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc:
+            skip(uleb());
+            break;
+        case DW_FORM_indirect:
+            return skipForm(uleb(), offset_size, address_size, version);
+        default:
+            fail();
+            return false;
+        }
+        return ok_;
+    }
+
+private:
+    void fail() {
+        ok_ = false;
+        pos_ = data_.size();
+    }
+
+    std::string_view data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+/// @brief NUL-terminated string at an offset of a string section ("" if out of range)
+inline std::string_view stringAt(std::string_view section, uint64_t offset) {
+    if (offset >= section.size()) {
+        return {};
+    }
+    const char* start = section.data() + offset;
+    return std::string_view(start, strnlen(start, section.size() - offset));
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,163 @@
+#include "internal/elf_file.h"
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr unsigned char kNativeClass = sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32;
+
+bool inflateInto(const char* src, size_t src_size, size_t out_size, std::string& out) {
+    out.resize(out_size);
+    uLongf dest_len = static_cast<uLongf>(out_size);
+    if (uncompress(reinterpret_cast<Bytef*>(out.data()), &dest_len, reinterpret_cast<const Bytef*>(src),
+                   static_cast<uLong>(src_size)) != Z_OK ||
+        dest_len != out_size) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string buildIdFromNotes(std::string_view notes) {
+    static const char kHex[] = "0123456789abcdef";
+    size_t pos = 0;
+    while (pos + sizeof(ElfW(Nhdr)) <= notes.size()) {
+        ElfW(Nhdr) note;
+        memcpy(&note, notes.data() + pos, sizeof(note));
+        size_t name_size = (note.n_namesz + 3) & ~static_cast<size_t>(3);
+        size_t desc_size = (note.n_descsz + 3) & ~static_cast<size_t>(3);
+        if (name_size > notes.size() || desc_size > notes.size() ||
+            pos + sizeof(note) + name_size + desc_size > notes.size()) {
+            break;
+        }
+        const char* name = notes.data() + pos + sizeof(note);
+        const auto* desc = reinterpret_cast<const unsigned char*>(name + name_size);
+        if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+            std::string hex;
+            hex.reserve(note.n_descsz * 2);
+            for (size_t i = 0; i < note.n_descsz; ++i) {
+                hex += kHex[desc[i] >> 4];
+                hex += kHex[desc[i] & 0xf];
+            }
+            return hex;
+        }
+        pos += sizeof(note) + name_size + desc_size;
+    }
+    return {};
+}
+
+ElfFile::~ElfFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+bool ElfFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ElfW(Ehdr)))) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<const char*>(mapped);
+    size_ = static_cast<size_t>(st.st_size);
+
+    const auto* ehdr = reinterpret_cast<const ElfW(Ehdr)*>(data_);
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != kNativeClass ||
+        ehdr->e_shentsize != sizeof(ElfW(Shdr)) || ehdr->e_shoff == 0 ||
+        ehdr->e_shoff + static_cast<size_t>(ehdr->e_shnum) * sizeof(ElfW(Shdr)) > size_ ||
+        ehdr->e_shstrndx >= ehdr->e_shnum) {
+        return false;
+    }
+
+    const auto* shdrs = reinterpret_cast<const ElfW(Shdr)*>(data_ + ehdr->e_shoff);
+    const ElfW(Shdr)& strtab = shdrs[ehdr->e_shstrndx];
+    if (strtab.sh_offset + strtab.sh_size > size_) {
+        return false;
+    }
+    const char* names = data_ + strtab.sh_offset;
+
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        const ElfW(Shdr)& shdr = shdrs[i];
+        if (shdr.sh_name >= strtab.sh_size || shdr.sh_type == SHT_NOBITS || shdr.sh_offset + shdr.sh_size > size_) {
+            continue;
+        }
+        std::string name(names + shdr.sh_name, strnlen(names + shdr.sh_name, strtab.sh_size - shdr.sh_name));
+
+        SectionInfo info;
+        info.offset = shdr.sh_offset;
+        info.size = shdr.sh_size;
+        info.flags = shdr.sh_flags;
+        if (name.compare(0, 8, ".zdebug_") == 0) {
+            name = "." + name.substr(2);
+            info.legacy_compressed = true;
+        }
+        sections_.emplace(std::move(name), info);
+    }
+    return true;
+}
+
+std::string_view ElfFile::section(const std::string& name) {
+    auto it = sections_.find(name);
+    if (it == sections_.end()) {
+        return {};
+    }
+    const SectionInfo& info = it->second;
+    const char* raw = data_ + info.offset;
+
+    if (!(info.flags & SHF_COMPRESSED) && !info.legacy_compressed) {
+        return std::string_view(raw, info.size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto cached = decompressed_.find(name);
+    if (cached != decompressed_.end()) {
+        return cached->second;
+    }
+
+    std::string& out = decompressed_[name];
+    if (info.flags & SHF_COMPRESSED) {
+        if (info.size >= sizeof(ElfW(Chdr))) {
+            const auto* chdr = reinterpret_cast<const ElfW(Chdr)*>(raw);
+            if (chdr->ch_type == ELFCOMPRESS_ZLIB) {
+                inflateInto(raw + sizeof(ElfW(Chdr)), info.size - sizeof(ElfW(Chdr)), chdr->ch_size, out);
+            }
+        }
+    } else if (info.size >= 12 && memcmp(raw, "ZLIB", 4) == 0) {
+        // Legacy GNU format: "ZLIB" followed by the big-endian 64-bit size
+        uint64_t out_size = 0;
+        for (int i = 4; i < 12; ++i) {
+            out_size = (out_size << 8) | static_cast<unsigned char>(raw[i]);
+        }
+        inflateInto(raw + 12, info.size - 12, out_size, out);
+    }
+    return out;
+}
+
+std::string ElfFile::buildId() {
+    return buildIdFromNotes(section(".note.gnu.build-id"));
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
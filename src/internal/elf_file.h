@@ -0,0 +1,67 @@
+/// @file elf_file.h
+/// @brief Read-only access to the sections of an ELF file on disk
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class ElfFile
+/// @brief Memory-mapped ELF file with lazily decompressed sections
+///
+/// Only the native ELF class is supported (the one the profiled process runs
+/// as). Sections flagged SHF_COMPRESSED (zlib) and legacy ".zdebug_*" sections
+/// are inflated on first access and kept for the lifetime of the object, so
+/// one instance can be shared by the DWARF readers of a module. Thread-safe
+/// after open().
+class ElfFile {
+public:
+    ElfFile() = default;
+    ~ElfFile();
+
+    ElfFile(const ElfFile&) = delete;
+    ElfFile& operator=(const ElfFile&) = delete;
+
+    /// @brief Map a file and index its section headers
+    /// @return false if the file cannot be read or is not a native ELF file
+    bool open(const std::string& path);
+
+    /// @brief Contents of a section ("" if absent or undecodable)
+    /// @param name Section name, e.g. ".debug_line"
+    std::string_view section(const std::string& name);
+
+    /// @brief GNU build-id from ".note.gnu.build-id" as lowercase hex ("" if absent)
+    std::string buildId();
+
+private:
+    struct SectionInfo {
+        size_t offset = 0;
+        size_t size = 0;
+        uint64_t flags = 0;
+        bool legacy_compressed = false; ///< ".zdebug_*" naming
+    };
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::map<std::string, SectionInfo> sections_;     ///< Keyed by ".debug_*" name
+    std::map<std::string, std::string> decompressed_; ///< Inflated section contents (node-stable)
+    std::mutex mutex_;                                ///< Guards decompressed_
+};
+
+/// @brief Find the GNU build-id in a sequence of ELF notes
+/// @param notes Contents of a PT_NOTE segment or SHT_NOTE section
+/// @return The build-id as lowercase hex, empty if there is none
+std::string buildIdFromNotes(std::string_view notes);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
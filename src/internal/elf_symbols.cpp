@@ -0,0 +1,79 @@
+#include "internal/elf_symbols.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <elf.h>
+#include <link.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+ElfSymbolTable::ElfSymbolTable(std::shared_ptr<ElfFile> elf) : elf_(std::move(elf)) {}
+
+ElfSymbolTable::~ElfSymbolTable() = default;
+
+void ElfSymbolTable::load() {
+    loaded_ = true;
+    if (!elf_) {
+        return;
+    }
+    // The dynamic table only lists exported functions; use it when the full table was stripped
+    std::string_view table = elf_->section(".symtab");
+    std::string_view strings = elf_->section(".strtab");
+    if (table.empty()) {
+        table = elf_->section(".dynsym");
+        strings = elf_->section(".dynstr");
+    }
+
+    for (size_t pos = 0; pos + sizeof(ElfW(Sym)) <= table.size(); pos += sizeof(ElfW(Sym))) {
+        ElfW(Sym) sym;
+        memcpy(&sym, table.data() + pos, sizeof(sym));
+        unsigned char type = ELF64_ST_TYPE(sym.st_info);
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF || sym.st_value == 0 ||
+            sym.st_name >= strings.size()) {
+            continue;
+        }
+        std::string_view name = strings.substr(sym.st_name);
+        name = name.substr(0, name.find('\0'));
+        if (!name.empty()) {
+            symbols_.push_back({sym.st_value, sym.st_size, name});
+        }
+    }
+
+    // Aliases share an address; keep the first one that has a size
+    std::stable_sort(symbols_.begin(), symbols_.end(), [](const Symbol& a, const Symbol& b) {
+        return a.address != b.address ? a.address < b.address : a.size > b.size;
+    });
+    symbols_.erase(std::unique(symbols_.begin(), symbols_.end(),
+                               [](const Symbol& a, const Symbol& b) { return a.address == b.address; }),
+                   symbols_.end());
+}
+
+bool ElfSymbolTable::lookup(uintptr_t address, std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loaded_) {
+        load();
+    }
+    auto it = std::upper_bound(symbols_.begin(), symbols_.end(), address,
+                               [](uintptr_t addr, const Symbol& symbol) { return addr < symbol.address; });
+    if (it == symbols_.begin()) {
+        return false;
+    }
+    const Symbol& symbol = *(it - 1);
+    if (symbol.size > 0 ? address >= symbol.address + symbol.size : it == symbols_.end()) {
+        return false;
+    }
+
+    int status = 0;
+    std::string mangled(symbol.name);
+    char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    name = status == 0 && demangled ? demangled : mangled;
+    free(demangled);
+    return true;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
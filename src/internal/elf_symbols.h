@@ -0,0 +1,56 @@
+/// @file elf_symbols.h
+/// @brief Function lookup in the ELF symbol tables of a module
+
+#pragma once
+
+#include "internal/elf_file.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class ElfSymbolTable
+/// @brief Address -> function name from .symtab (or .dynsym for stripped files)
+///
+/// The table is sorted on first lookup. Symbols without a size are taken to
+/// extend up to the next symbol, as is common for hand-written assembly.
+/// Thread-safe.
+class ElfSymbolTable {
+public:
+    /// @param elf The module's ELF file (nullptr if it could not be opened)
+    explicit ElfSymbolTable(std::shared_ptr<ElfFile> elf);
+    ~ElfSymbolTable();
+
+    ElfSymbolTable(const ElfSymbolTable&) = delete;
+    ElfSymbolTable& operator=(const ElfSymbolTable&) = delete;
+
+    /// @brief Find the function containing a link-time address
+    /// @param address Runtime address minus the module's load bias
+    /// @param name Receives the demangled function name
+    /// @return false if no function symbol covers the address
+    bool lookup(uintptr_t address, std::string& name);
+
+private:
+    struct Symbol {
+        uint64_t address = 0;
+        uint64_t size = 0;
+        std::string_view name; ///< Mangled name, points into the string table
+    };
+
+    void load();
+
+    std::mutex mutex_;
+    bool loaded_ = false;
+    std::shared_ptr<ElfFile> elf_;
+    std::vector<Symbol> symbols_; ///< Sorted by address, one per address
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
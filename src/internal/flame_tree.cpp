@@ -0,0 +1,130 @@
+#include "internal/flame_tree.h"
+#include "internal/json_util.h"
+#include <algorithm>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+FlameTree::FlameTree() {
+    internName("root");
+    nodes_.push_back(Node{});
+}
+
+uint32_t FlameTree::internName(std::string_view name) {
+    uint32_t id = pool_.intern(name);
+    auto [it, inserted] = name_index_.try_emplace(id, static_cast<uint32_t>(names_.size()));
+    if (inserted) {
+        names_.push_back(pool_.view(id));
+    }
+    return it->second;
+}
+
+uint32_t FlameTree::nameOfId(uint32_t id, const NameScope& scope) {
+    if ((id & NameScope::kScopedBit) != 0) {
+        // Made up for this render (hex addresses): copied, as the scope goes away first
+        return internName(scope.view(id));
+    }
+    auto [it, inserted] = symbol_index_.try_emplace(id, static_cast<uint32_t>(names_.size()));
+    if (inserted) {
+        names_.push_back(symbolNames().view(id)); // Never freed: no copy needed
+    }
+    return it->second;
+}
+
+uint32_t FlameTree::childOf(uint32_t parent, uint32_t name) {
+    uint64_t key = (static_cast<uint64_t>(parent) << 32) | name;
+    auto it = child_index_.find(key);
+    if (it != child_index_.end()) {
+        return it->second;
+    }
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{name, 0, {}});
+    nodes_[parent].children.push_back(index);
+    child_index_.emplace(key, index);
+    return index;
+}
+
+void FlameTree::add(std::string_view folded_stack, uint64_t value) {
+    uint32_t node = 0;
+    nodes_[0].value += value;
+
+    size_t pos = 0;
+    while (pos <= folded_stack.size()) {
+        size_t end = folded_stack.find(';', pos);
+        if (end == std::string_view::npos) {
+            end = folded_stack.size();
+        }
+        if (end > pos) {
+            node = childOf(node, internName(folded_stack.substr(pos, end - pos)));
+            nodes_[node].value += value;
+        }
+        pos = end + 1;
+    }
+}
+
+void FlameTree::add(std::span<const uint32_t> frames, uint64_t value, const NameScope& scope) {
+    uint32_t node = 0;
+    nodes_[0].value += value;
+    for (uint32_t id : frames) {
+        node = childOf(node, nameOfId(id, scope));
+        nodes_[node].value += value;
+    }
+}
+
+void FlameTree::addAll(const FoldedStacks& stacks) {
+    for (const auto& [stack, value] : stacks) {
+        add(stack, value);
+    }
+}
+
+void FlameTree::appendNode(std::string& out, uint32_t index) const {
+    const Node& node = nodes_[index];
+    out += '[';
+    out += std::to_string(node.name);
+    out += ',';
+    out += std::to_string(node.value);
+
+    if (!node.children.empty()) {
+        std::vector<uint32_t> children = node.children;
+        std::sort(children.begin(), children.end(),
+                  [this](uint32_t a, uint32_t b) { return names_[nodes_[a].name] < names_[nodes_[b].name]; });
+
+        out += ",[";
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            appendNode(out, children[i]);
+        }
+        out += ']';
+    }
+    out += ']';
+}
+
+std::string FlameTree::toJson(const std::string& type, const std::string& unit) const {
+    std::string out;
+    out.reserve(nodes_.size() * 16 + names_.size() * 32);
+
+    out += "{\"type\":";
+    appendJsonString(out, type);
+    out += ",\"unit\":";
+    appendJsonString(out, unit);
+    out += ",\"total\":";
+    out += std::to_string(total());
+    out += ",\"names\":[";
+    for (size_t i = 0; i < names_.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        appendJsonString(out, names_[i]);
+    }
+    out += "],\"tree\":";
+    appendNode(out, 0);
+    out += '}';
+    return out;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
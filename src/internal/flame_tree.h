@@ -0,0 +1,88 @@
+/// @file flame_tree.h
+/// @brief Hierarchical flame graph data built from folded stacks
+
+#pragma once
+
+#include "internal/folded_stacks.h"
+#include "internal/string_pool.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class FlameTree
+/// @brief Prefix tree of call stacks with per-node inclusive values
+///
+/// Frame names are interned once into a name table and nodes refer to them
+/// by index, so the serialized form stays compact even for deep profiles.
+/// Stacks come either as folded text, whose names are copied into the tree's
+/// own pool, or as symbolNames()/NameScope IDs straight from the symbolizer:
+/// then the table views symbolNames() directly and only scoped names are
+/// copied. Build a tree through one of the two, not both.
+class FlameTree {
+public:
+    /// @brief A node of the tree (index 0 is the synthetic root)
+    struct Node {
+        uint32_t name = 0;              ///< Index into names()
+        uint64_t value = 0;             ///< Inclusive value (self + children)
+        std::vector<uint32_t> children; ///< Child node indexes
+    };
+
+    FlameTree();
+
+    /// @brief Add one folded stack ("root;...;leaf") with its value
+    void add(std::string_view folded_stack, uint64_t value);
+
+    /// @brief Add every stack of a folded map
+    void addAll(const FoldedStacks& stacks);
+
+    /// @brief Add one stack of name IDs, root first, with its value
+    /// @param frames symbolNames() IDs, or IDs of `scope` (see foldProfileIds())
+    /// @param scope Resolves the scoped IDs; the tree keeps copies of those names only
+    void add(std::span<const uint32_t> frames, uint64_t value, const NameScope& scope);
+
+    /// @brief Total value of all stacks
+    uint64_t total() const {
+        return nodes_[0].value;
+    }
+
+    const std::vector<Node>& nodes() const {
+        return nodes_;
+    }
+
+    const std::vector<std::string_view>& names() const {
+        return names_;
+    }
+
+    /// @brief Serialize as compact JSON
+    ///
+    /// Format: {"type":..,"unit":..,"total":N,"names":[..],"tree":NODE}
+    /// where NODE is [name_index, value] or [name_index, value, [NODE, ...]].
+    /// Children are sorted by frame name, matching flamegraph.pl layout.
+    /// @param type Profile type label ("cpu", "heap", "growth")
+    /// @param unit Unit of the values ("samples", "bytes")
+    std::string toJson(const std::string& type, const std::string& unit) const;
+
+private:
+    uint32_t internName(std::string_view name);
+    uint32_t nameOfId(uint32_t id, const NameScope& scope);
+    uint32_t childOf(uint32_t parent, uint32_t name);
+    void appendNode(std::string& out, uint32_t index) const;
+
+    StringPool pool_;
+    std::vector<Node> nodes_;
+    std::vector<std::string_view> names_;                 ///< Views into pool_ or symbolNames()
+    std::unordered_map<uint32_t, uint32_t> name_index_;   ///< pool_ ID -> index into names_
+    std::unordered_map<uint32_t, uint32_t> symbol_index_; ///< symbolNames() ID -> index into names_
+    std::unordered_map<uint64_t, uint32_t> child_index_;  ///< (parent << 32 | name) -> node
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,157 @@
+#include "internal/fleet_merge.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    double upper = values[mid];
+    if (values.size() % 2 == 1) {
+        return upper;
+    }
+    return (*std::max_element(values.begin(), values.begin() + mid) + upper) / 2;
+}
+
+// |z| per value from the median and MAD. When more than half of the values are
+// identical the MAD is 0; the mean absolute deviation then keeps a lone
+// deviating value detectable.
+std::vector<double> robustScores(const std::vector<double>& values) {
+    std::vector<double> scores(values.size(), 0);
+    double center = median(values);
+    std::vector<double> deviations;
+    double mean_deviation = 0;
+    for (double value : values) {
+        deviations.push_back(std::fabs(value - center));
+        mean_deviation += deviations.back() / values.size();
+    }
+    double mad = median(deviations);
+    double scale = mad > 0 ? mad / 0.6745 : mean_deviation * 1.2533;
+    if (scale <= 0) {
+        return scores;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        scores[i] = deviations[i] / scale;
+    }
+    return scores;
+}
+
+} // namespace
+
+bool parseFoldedStacks(std::string_view text, FoldedStacks& out) {
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text = newline == std::string_view::npos ? std::string_view() : text.substr(newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t space = line.rfind(' ');
+        if (space == std::string_view::npos || space == 0) {
+            return false;
+        }
+        uint64_t value = 0;
+        auto [end, ec] = std::from_chars(line.data() + space + 1, line.data() + line.size(), value);
+        if (ec != std::errc() || end != line.data() + line.size()) {
+            return false;
+        }
+        out[std::string(line.substr(0, space))] += value;
+    }
+    return true;
+}
+
+FleetMergeResult mergeFleetProfiles(const std::vector<FleetInstance>& instances, const FleetMergeOptions& options) {
+    FleetMergeResult result;
+    result.instances.resize(instances.size());
+    std::vector<size_t> active; // Non-empty instances
+    for (size_t i = 0; i < instances.size(); ++i) {
+        auto& report = result.instances[i];
+        report.name = instances[i].name;
+        for (const auto& [stack, value] : instances[i].stacks) {
+            report.total += value;
+        }
+        if (report.total > 0) {
+            active.push_back(i);
+        }
+    }
+
+    if (options.outlier_threshold > 0 && active.size() >= 3) {
+        // Fleet-wide stack mix: the mean of the per-instance distributions
+        std::unordered_map<std::string_view, double> mix;
+        for (size_t i : active) {
+            double total = static_cast<double>(result.instances[i].total);
+            for (const auto& [stack, value] : instances[i].stacks) {
+                mix[stack] += value / total / active.size();
+            }
+        }
+
+        std::vector<double> totals;
+        std::vector<double> distances;
+        for (size_t i : active) {
+            auto& report = result.instances[i];
+            double total = static_cast<double>(report.total);
+            // Stacks missing from the instance contribute their whole fleet share
+            double distance = 0;
+            double covered = 0;
+            for (const auto& [stack, value] : instances[i].stacks) {
+                double share = mix[stack];
+                distance += std::fabs(value / total - share);
+                covered += share;
+            }
+            report.distance = std::min(1.0, (distance + std::max(0.0, 1.0 - covered)) / 2);
+            totals.push_back(total);
+            distances.push_back(report.distance);
+        }
+
+        auto total_scores = robustScores(totals);
+        auto distance_scores = robustScores(distances);
+        for (size_t k = 0; k < active.size(); ++k) {
+            auto& report = result.instances[active[k]];
+            report.score = std::max(total_scores[k], distance_scores[k]);
+            report.outlier = report.score > options.outlier_threshold;
+        }
+    }
+
+    std::vector<size_t> merged;
+    std::vector<double> merged_totals;
+    for (size_t i : active) {
+        if (!(options.drop_outliers && result.instances[i].outlier)) {
+            merged.push_back(i);
+            merged_totals.push_back(static_cast<double>(result.instances[i].total));
+        }
+    }
+    double reference = median(merged_totals);
+    for (size_t i : merged) {
+        auto& report = result.instances[i];
+        double factor = instances[i].weight;
+        if (options.normalize) {
+            factor *= reference / static_cast<double>(report.total);
+        }
+        for (const auto& [stack, value] : instances[i].stacks) {
+            auto scaled = static_cast<uint64_t>(std::llround(value * factor));
+            if (scaled > 0) {
+                result.merged[stack] += scaled;
+            }
+        }
+        report.merged = true;
+    }
+    return result;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,68 @@
+/// @file fleet_merge.h
+/// @brief Weighted merge of folded-stack profiles from many instances, with outlier detection
+
+#pragma once
+
+#include "internal/folded_stacks.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief Parse folded-stack text as written by formatFoldedStacks()
+///
+/// Lines are "root;...;leaf value"; values of repeated stacks are summed and
+/// blank lines are skipped.
+/// @return false if a line does not end in a space and an unsigned value
+bool parseFoldedStacks(std::string_view text, FoldedStacks& out);
+
+/// @struct FleetInstance
+/// @brief Profile of one instance, as fetched by the collector
+struct FleetInstance {
+    std::string name;    ///< Endpoint, used in reports
+    FoldedStacks stacks; ///< Symbolized stacks of the instance
+    double weight = 1.0; ///< Relative weight of the instance in the merge
+};
+
+/// @struct FleetMergeOptions
+/// @brief How instances are combined
+struct FleetMergeOptions {
+    bool normalize = true;          ///< Scale every instance to the median total before weighting
+    double outlier_threshold = 3.5; ///< Robust z-score beyond which an instance is an outlier (0 = no detection)
+    bool drop_outliers = true;      ///< Leave outliers out of the merged profile
+};
+
+/// @struct FleetInstanceReport
+/// @brief What the merge found out about one instance
+struct FleetInstanceReport {
+    std::string name;
+    uint64_t total = 0;   ///< Sum of the instance's values
+    double distance = 0;  ///< Total variation distance of its stack mix from the fleet's (0 = same, 1 = disjoint)
+    double score = 0;     ///< Larger robust z-score of total and distance
+    bool outlier = false; ///< score exceeded the threshold
+    bool merged = false;  ///< Contributed to the merged profile
+};
+
+/// @struct FleetMergeResult
+/// @brief Merged profile plus what was found about each instance
+struct FleetMergeResult {
+    FoldedStacks merged;                        ///< Weighted sum of the merged instances
+    std::vector<FleetInstanceReport> instances; ///< In input order
+};
+
+/// @brief Merge the profiles of many instances of the same service
+///
+/// With normalization each instance counts by its stack mix rather than by its
+/// volume, so one busy replica does not dominate the result. An instance is
+/// an outlier when its total or its distance from the fleet-wide mix is far
+/// from the rest (median/MAD robust z-score); detection needs three or more
+/// non-empty instances. Empty instances never contribute.
+FleetMergeResult mergeFleetProfiles(const std::vector<FleetInstance>& instances, const FleetMergeOptions& options);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,122 @@
+#include "internal/folded_stacks.h"
+#include "internal/string_pool.h"
+#include <algorithm>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// ';' separates frames and a trailing space separates the value, so neither
+// may appear inside a frame name (operator; never does, but be safe).
+void appendFrameName(std::string& out, std::string_view name) {
+    for (char c : name) {
+        out += c == ';' || c == '\n' || c == '\r' ? ':' : c;
+    }
+}
+
+} // namespace
+
+FoldedStacks foldProfile(const ParsedProfile& profile, const FrameNameResolver& resolve) {
+    NameScope scope;
+    std::unordered_map<uintptr_t, std::string> names; // Address -> root-first "outer;inner" segment
+    FoldedStacks folded;
+
+    std::vector<uintptr_t> stack;
+    std::string key;
+    for (const auto& sample : profile.samples) {
+        if (sample.value == 0 || sample.stack.empty()) {
+            continue;
+        }
+
+        stack = sample.stack;
+        fixupCallerAddresses(stack);
+
+        key.clear();
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+            if (*it == 0) {
+                continue;
+            }
+            auto [name_it, inserted] = names.try_emplace(*it);
+            if (inserted) {
+                std::vector<uint32_t> frames = resolve(*it, scope);
+                for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+                    if (!name_it->second.empty()) {
+                        name_it->second += ';';
+                    }
+                    appendFrameName(name_it->second, scope.view(*frame));
+                }
+            }
+            if (name_it->second.empty()) {
+                continue;
+            }
+            if (!key.empty()) {
+                key += ';';
+            }
+            key += name_it->second;
+        }
+
+        if (!key.empty()) {
+            folded[key] += sample.value;
+        }
+    }
+
+    return folded;
+}
+
+void foldProfileIds(const ParsedProfile& profile, const FrameNameResolver& resolve, NameScope& scope,
+                    const FrameIdSink& sink) {
+    std::unordered_map<uintptr_t, std::vector<uint32_t>> names; // Address -> root-first frame IDs
+
+    std::vector<uintptr_t> stack;
+    std::vector<uint32_t> frames;
+    for (const auto& sample : profile.samples) {
+        if (sample.value == 0 || sample.stack.empty()) {
+            continue;
+        }
+
+        stack = sample.stack;
+        fixupCallerAddresses(stack);
+
+        frames.clear();
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+            if (*it == 0) {
+                continue;
+            }
+            auto [name_it, inserted] = names.try_emplace(*it);
+            if (inserted) {
+                name_it->second = resolve(*it, scope);
+                std::erase_if(name_it->second, [&](uint32_t id) { return scope.view(id).empty(); });
+                std::reverse(name_it->second.begin(), name_it->second.end());
+            }
+            frames.insert(frames.end(), name_it->second.begin(), name_it->second.end());
+        }
+
+        if (!frames.empty()) {
+            sink(frames, sample.value);
+        }
+    }
+}
+
+std::string formatFoldedStacks(const FoldedStacks& stacks) {
+    size_t total = 0;
+    for (const auto& [stack, value] : stacks) {
+        total += stack.size() + 22;
+    }
+
+    std::string out;
+    out.reserve(total);
+    for (const auto& [stack, value] : stacks) {
+        out += stack;
+        out += ' ';
+        out += std::to_string(value);
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
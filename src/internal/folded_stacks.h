@@ -0,0 +1,56 @@
+/// @file folded_stacks.h
+/// @brief Brendan Gregg folded-stack aggregation for parsed profiles
+
+#pragma once
+
+#include "internal/profile_parser.h"
+#include "internal/string_pool.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// Resolves a (caller-adjusted) program counter to display names, innermost
+/// first: an address inside inlined code yields the inlined calls followed by
+/// the function they were inlined into. Names are IDs in symbolNames(), or in
+/// the render's NameScope for strings made up for this render only
+using FrameNameResolver = std::function<std::vector<uint32_t>(uintptr_t address, NameScope& scope)>;
+
+/// Folded stack ("root;caller;leaf") -> accumulated value
+using FoldedStacks = std::map<std::string, uint64_t>;
+
+/// @brief Symbolize and merge the samples of a profile into folded stacks
+///
+/// Each distinct address is resolved exactly once, and stacks that
+/// symbolize to the same frame sequence are merged. An address that resolves
+/// to several names contributes one frame per name.
+/// @param profile Parsed profile (addresses are leaf first, as recorded)
+/// @param resolve Callback producing the frame name for an address
+/// @return Map from root-first folded stack to summed sample value
+FoldedStacks foldProfile(const ParsedProfile& profile, const FrameNameResolver& resolve);
+
+/// Receives one symbolized stack: name IDs, root first, and its value
+using FrameIdSink = std::function<void(std::span<const uint32_t> frames, uint64_t value)>;
+
+/// @brief Symbolize the samples of a profile as name IDs, without building folded strings
+///
+/// Each distinct address is resolved exactly once, as in foldProfile(), but
+/// stacks are not merged here: every sample goes to `sink`, and
+/// FlameTree::add() merges them in its prefix tree, so a flame graph never
+/// joins, parses or hashes folded text.
+/// @param scope Receives the names made up for this profile; keep it while the IDs are used
+void foldProfileIds(const ParsedProfile& profile, const FrameNameResolver& resolve, NameScope& scope,
+                    const FrameIdSink& sink);
+
+/// @brief Render folded stacks as text, one "stack value" pair per line
+std::string formatFoldedStacks(const FoldedStacks& stacks);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
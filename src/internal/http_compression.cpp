@@ -0,0 +1,208 @@
+#include "internal/http_compression.h"
+#include "internal/render_cache.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <zlib.h>
+#ifdef PROFILER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr size_t kMinCompressSize = 1024; ///< Below this the headers outweigh the savings
+constexpr size_t kChunkSize = 64 * 1024;
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+const char* contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+    case ContentEncoding::Gzip:
+        return "gzip";
+    case ContentEncoding::Zstd:
+        return "zstd";
+    default:
+        return "";
+    }
+}
+
+bool zstdAvailable() {
+#ifdef PROFILER_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+ContentEncoding negotiateEncoding(std::string_view accept_encoding, bool allow_zstd) {
+    // q-value of each coding, -1 while it is not listed; "*" only stands in
+    // for codings that are not listed themselves (RFC 9110 12.5.3)
+    double gzip = -1.0;
+    double zstd = -1.0;
+    double any = -1.0;
+    while (!accept_encoding.empty()) {
+        size_t comma = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+        // "name;q=0.5": a q-value of zero means "not acceptable"
+        size_t semicolon = item.find(';');
+        std::string_view name = trim(item.substr(0, semicolon));
+        double q = 1.0;
+        if (semicolon != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semicolon + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::clamp(std::strtod(std::string(param.substr(2)).c_str(), nullptr), 0.0, 1.0);
+            }
+        }
+        if (equalsIgnoreCase(name, "gzip") || equalsIgnoreCase(name, "x-gzip")) {
+            gzip = q;
+        } else if (equalsIgnoreCase(name, "zstd")) {
+            zstd = q;
+        } else if (name == "*") {
+            any = q;
+        }
+    }
+    gzip = gzip < 0 ? any : gzip;
+    zstd = !allow_zstd ? 0.0 : zstd < 0 ? any : zstd;
+    // Ties go to zstd, which is both smaller and faster to decode
+    if (zstd > 0 && zstd >= gzip) {
+        return ContentEncoding::Zstd;
+    }
+    if (gzip > 0) {
+        return ContentEncoding::Gzip;
+    }
+    return ContentEncoding::Identity;
+}
+
+bool gzipCompress(std::string_view data, std::string& out, int level) {
+    z_stream stream{};
+    // windowBits 15 + 16 selects the gzip wrapper instead of zlib's
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.clear();
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    int status = Z_OK;
+    while (status == Z_OK) {
+        size_t used = out.size();
+        out.resize(used + kChunkSize);
+        stream.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+        stream.avail_out = static_cast<uInt>(kChunkSize);
+        status = deflate(&stream, Z_FINISH);
+        out.resize(used + kChunkSize - stream.avail_out);
+    }
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+bool zstdCompress(std::string_view data, std::string& out, int level) {
+#ifdef PROFILER_HAVE_ZSTD
+    out.resize(ZSTD_compressBound(data.size()));
+    size_t size = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), level);
+    if (ZSTD_isError(size)) {
+        out.clear();
+        return false;
+    }
+    out.resize(size);
+    return true;
+#else
+    (void)data;
+    (void)level;
+    out.clear();
+    return false;
+#endif
+}
+
+bool compressBody(std::string_view data, ContentEncoding encoding, std::string& out) {
+    switch (encoding) {
+    case ContentEncoding::Gzip:
+        return gzipCompress(data, out);
+    case ContentEncoding::Zstd:
+        return zstdCompress(data, out);
+    default:
+        out.assign(data);
+        return true;
+    }
+}
+
+bool isCompressible(const HandlerResponse& resp) {
+    if (resp.status != 200 || resp.body.size() < kMinCompressSize || resp.headers.count("Content-Encoding")) {
+        return false;
+    }
+    const std::string& type = resp.content_type;
+    return type.starts_with("text/") || type == "application/json" || type == "image/svg+xml";
+}
+
+std::string weakEtag(const std::string& etag) {
+    return etag.starts_with("W/") ? etag : "W/" + etag;
+}
+
+PrecompressedResponse::PrecompressedResponse(HandlerResponse resp) : identity_(std::move(resp)) {
+    if (!identity_.headers.count("ETag")) {
+        identity_.headers["ETag"] = RenderCache::etagFor(RenderCache::makeKey(identity_.body, identity_.content_type));
+    }
+    if (!isCompressible(identity_)) {
+        return;
+    }
+    if (!gzipCompress(identity_.body, gzip_, Z_BEST_COMPRESSION) || gzip_.size() >= identity_.body.size()) {
+        gzip_.clear();
+    }
+    if (!zstdCompress(identity_.body, zstd_, 19) || zstd_.size() >= identity_.body.size()) {
+        zstd_.clear();
+    }
+}
+
+HandlerResponse PrecompressedResponse::select(std::string_view accept_encoding) const {
+    ContentEncoding encoding = negotiateEncoding(accept_encoding, !zstd_.empty());
+    const std::string* body = &identity_.body;
+    if (encoding == ContentEncoding::Zstd) {
+        body = &zstd_;
+    } else if (encoding == ContentEncoding::Gzip) {
+        body = &gzip_;
+    }
+    if (body->empty()) {
+        encoding = ContentEncoding::Identity;
+        body = &identity_.body;
+    }
+
+    HandlerResponse resp{identity_.status, identity_.content_type, *body, identity_.headers};
+    resp.headers["Vary"] = "Accept-Encoding";
+    if (encoding != ContentEncoding::Identity) {
+        resp.headers["Content-Encoding"] = contentEncodingName(encoding);
+        resp.headers["ETag"] = weakEtag(identity_.headers.at("ETag"));
+    }
+    return resp;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,71 @@
+/// @file http_compression.h
+/// @brief Content-Encoding negotiation and gzip/zstd compression of responses
+
+#pragma once
+
+#include "profiler/http_handlers.h"
+#include <string>
+#include <string_view>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Zstd, ///< Only negotiated when built with REMOTE_PROFILER_WITH_ZSTD
+};
+
+/// @brief Value of the Content-Encoding header ("" for Identity)
+const char* contentEncodingName(ContentEncoding encoding);
+
+/// @brief Whether the library was built with zstd support
+bool zstdAvailable();
+
+/// @brief Pick the best encoding the client accepts
+/// @param accept_encoding Value of the Accept-Encoding header (q-values honoured, q=0 excludes;
+///        "*" applies only to codings not listed by name)
+/// @param allow_zstd Whether zstd may be chosen
+/// @return The accepted coding with the higher q-value (zstd on a tie, if allowed), else Identity
+ContentEncoding negotiateEncoding(std::string_view accept_encoding, bool allow_zstd = zstdAvailable());
+
+/// @brief gzip-compress data, deflating it in fixed-size output chunks
+/// @return false on a zlib error (out is then unspecified)
+bool gzipCompress(std::string_view data, std::string& out, int level = 6);
+
+/// @brief zstd-compress data
+/// @return false on error or when built without zstd
+bool zstdCompress(std::string_view data, std::string& out, int level = 3);
+
+/// @brief Compress data with the given encoding (Identity copies it)
+bool compressBody(std::string_view data, ContentEncoding encoding, std::string& out);
+
+/// @brief Whether a response is worth compressing: 200, textual, not tiny, not already encoded
+bool isCompressible(const HandlerResponse& resp);
+
+/// @brief Turn a strong ETag into the weak one of its compressed representation
+std::string weakEtag(const std::string& etag);
+
+/// @class PrecompressedResponse
+/// @brief A static response compressed once in every supported encoding
+///
+/// Built at startup for the embedded web pages; select() then only picks the
+/// variant matching the request, and every variant carries an ETag derived
+/// from the content.
+class PrecompressedResponse {
+public:
+    explicit PrecompressedResponse(HandlerResponse resp);
+
+    /// @brief The representation to send for a request's Accept-Encoding header
+    HandlerResponse select(std::string_view accept_encoding) const;
+
+private:
+    HandlerResponse identity_;
+    std::string gzip_; ///< Empty if compression failed or did not pay off
+    std::string zstd_; ///< Empty if unavailable or did not pay off
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
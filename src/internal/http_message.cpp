@@ -0,0 +1,211 @@
+#include "internal/http_message.h"
+#include <cctype>
+#include <charconv>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+std::string lower(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return out;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+const char* reasonPhrase(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 403:
+        return "Forbidden";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 413:
+        return "Content Too Large";
+    case 429:
+        return "Too Many Requests";
+    case 500:
+        return "Internal Server Error";
+    case 501:
+        return "Not Implemented";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Unknown";
+    }
+}
+
+void parseQuery(std::string_view query, std::map<std::string, std::string>& params) {
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        if (pair.empty()) {
+            continue;
+        }
+        size_t eq = pair.find('=');
+        std::string name = urlDecode(pair.substr(0, eq), true);
+        std::string value = eq == std::string_view::npos ? std::string() : urlDecode(pair.substr(eq + 1), true);
+        params.emplace(std::move(name), std::move(value));
+    }
+}
+
+} // namespace
+
+std::string urlDecode(std::string_view text, bool plus_is_space) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            out += static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+            i += 2;
+        } else if (text[i] == '+' && plus_is_space) {
+            out += ' ';
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+HttpParseStatus parseHttpRequest(std::string_view data, size_t max_bytes, HttpRequest& request, size_t& consumed) {
+    size_t head_end = data.find("\r\n\r\n");
+    if (head_end == std::string_view::npos) {
+        return data.size() > max_bytes ? HttpParseStatus::TooLarge : HttpParseStatus::Incomplete;
+    }
+    size_t head_size = head_end + 4;
+    if (head_size > max_bytes) {
+        return HttpParseStatus::TooLarge;
+    }
+
+    request = HttpRequest();
+    std::string_view head = data.substr(0, head_end);
+    size_t line_end = head.find("\r\n");
+    std::string_view request_line = head.substr(0, line_end);
+    head = line_end == std::string_view::npos ? std::string_view() : head.substr(line_end + 2);
+
+    // METHOD SP request-target SP HTTP-version
+    size_t sp1 = request_line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : request_line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+        return HttpParseStatus::Invalid;
+    }
+    std::string_view version = request_line.substr(sp2 + 1);
+    if (!version.starts_with("HTTP/1.")) {
+        return HttpParseStatus::Invalid;
+    }
+    request.method = std::string(request_line.substr(0, sp1));
+    std::string_view target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+    if (target.starts_with("http://") || target.starts_with("https://")) {
+        // absolute-form: drop scheme and authority
+        size_t slash = target.find('/', target.find("//") + 2);
+        target = slash == std::string_view::npos ? std::string_view("/") : target.substr(slash);
+    }
+    if (!target.starts_with('/')) {
+        return HttpParseStatus::Invalid;
+    }
+    size_t question = target.find('?');
+    request.path = urlDecode(target.substr(0, question), false);
+    if (question != std::string_view::npos) {
+        parseQuery(target.substr(question + 1), request.params);
+    }
+
+    while (!head.empty()) {
+        line_end = head.find("\r\n");
+        std::string_view line = head.substr(0, line_end);
+        head = line_end == std::string_view::npos ? std::string_view() : head.substr(line_end + 2);
+        size_t colon = line.find(':');
+        if (colon == 0 || colon == std::string_view::npos ||
+            line.substr(0, colon).find_first_of(" \t") != std::string_view::npos) {
+            return HttpParseStatus::Invalid;
+        }
+        std::string& value = request.headers[lower(line.substr(0, colon))];
+        if (!value.empty()) {
+            value += ", ";
+        }
+        value += trim(line.substr(colon + 1));
+    }
+
+    std::string connection = lower(request.header("connection"));
+    if (version == "HTTP/1.0") {
+        request.keep_alive = connection.find("keep-alive") != std::string::npos;
+    } else {
+        request.keep_alive = connection.find("close") == std::string::npos;
+    }
+
+    if (request.headers.count("transfer-encoding")) {
+        return HttpParseStatus::Unsupported;
+    }
+    size_t body_size = 0;
+    auto length = request.headers.find("content-length");
+    if (length != request.headers.end()) {
+        const std::string& text = length->second;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), body_size);
+        if (ec != std::errc() || end != text.data() + text.size()) {
+            return HttpParseStatus::Invalid;
+        }
+    }
+    if (body_size > max_bytes - head_size) {
+        return HttpParseStatus::TooLarge;
+    }
+    if (data.size() - head_size < body_size) {
+        return HttpParseStatus::Incomplete;
+    }
+    request.body = std::string(data.substr(head_size, body_size));
+    consumed = head_size + body_size;
+    return HttpParseStatus::Complete;
+}
+
+std::string serializeHttpHead(const HandlerResponse& resp, bool keep_alive) {
+    std::string out;
+    out.reserve(256);
+    out += "HTTP/1.1 ";
+    out += std::to_string(resp.status);
+    out += ' ';
+    out += reasonPhrase(resp.status);
+    out += "\r\nContent-Type: ";
+    out += resp.content_type;
+    out += "\r\nContent-Length: ";
+    out += std::to_string(resp.status == 304 ? 0 : resp.body.size());
+    out += keep_alive ? "\r\nConnection: keep-alive\r\n" : "\r\nConnection: close\r\n";
+    for (const auto& [name, value] : resp.headers) {
+        out += name;
+        out += ": ";
+        out += value;
+        out += "\r\n";
+    }
+    out += "\r\n";
+    return out;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
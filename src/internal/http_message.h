@@ -0,0 +1,62 @@
+/// @file http_message.h
+/// @brief Minimal HTTP/1.1 request parsing and response serialization for the built-in server
+
+#pragma once
+
+#include "profiler/http_handlers.h"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @struct HttpRequest
+/// @brief One parsed request: what ProfilerHttpHandlers::dispatch() and the
+///        conditional/compression helpers need, nothing more
+struct HttpRequest {
+    std::string method;
+    std::string path;                           ///< Decoded path without the query string
+    std::map<std::string, std::string> params;  ///< Decoded query parameters
+    std::map<std::string, std::string> headers; ///< Header names lower-cased, values trimmed
+    std::string body;
+    bool keep_alive = true; ///< Whether the connection stays open after the response
+
+    /// @brief Value of a header, "" if absent
+    /// @param name Lower-case header name
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+/// Outcome of parseHttpRequest()
+enum class HttpParseStatus {
+    Incomplete,  ///< Need more bytes
+    Complete,    ///< `request` is filled and `consumed` bytes belong to it
+    Invalid,     ///< Malformed request (400)
+    TooLarge,    ///< Head or body beyond the byte limit (413)
+    Unsupported, ///< Valid but not handled here, e.g. chunked request bodies (501)
+};
+
+/// @brief Parse the first request in `data`
+/// @param data Bytes received on the connection, possibly holding several pipelined requests
+/// @param max_bytes Limit on head plus body of a single request
+/// @param request Filled on Complete
+/// @param consumed Bytes of `data` taken by the request on Complete
+HttpParseStatus parseHttpRequest(std::string_view data, size_t max_bytes, HttpRequest& request, size_t& consumed);
+
+/// @brief Decode %XX escapes (and '+' as space when `plus_is_space`)
+std::string urlDecode(std::string_view text, bool plus_is_space);
+
+/// @brief Serialize the status line and headers of a response, including Content-Length and Connection
+///
+/// The body is not copied in: the server sends it from the response's own
+/// buffer after the head (nothing for HEAD requests and 304).
+std::string serializeHttpHead(const HandlerResponse& resp, bool keep_alive);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,50 @@
+/// @file json_util.h
+/// @brief Minimal helpers for hand-written JSON output
+
+#pragma once
+
+#include "profiler_version.h"
+#include <string>
+#include <string_view>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief Append a JSON string literal (with quotes) for the given text
+inline void appendJsonString(std::string& out, std::string_view text) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += kHex[(c >> 4) & 0xf];
+                out += kHex[c & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
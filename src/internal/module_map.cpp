@@ -0,0 +1,394 @@
+#include "internal/module_map.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <link.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr size_t kResolveBatch = 256;    ///< Addresses per request written to addr2line
+constexpr int kResolveTimeoutMs = 10000; ///< Give up on a child that stops answering
+
+struct PhdrObject {
+    uintptr_t bias = 0;
+    uintptr_t exec_start = 0; ///< Runtime address of the first executable PT_LOAD
+    std::string build_id;
+};
+
+struct PhdrScan {
+    bool counters_only = false;
+    unsigned long long adds = 0;
+    unsigned long long subs = 0;
+    std::vector<PhdrObject> objects;
+};
+
+int phdrCallback(struct dl_phdr_info* info, size_t size, void* data) {
+    auto* scan = static_cast<PhdrScan*>(data);
+    if (size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+        scan->adds = info->dlpi_adds;
+        scan->subs = info->dlpi_subs;
+    }
+    if (scan->counters_only) {
+        return 1; // The counters are the same for every object
+    }
+
+    PhdrObject object;
+    object.bias = info->dlpi_addr;
+    bool has_exec = false;
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+        if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_X) && !has_exec) {
+            object.exec_start = info->dlpi_addr + phdr.p_vaddr;
+            has_exec = true;
+        }
+        if (phdr.p_type == PT_NOTE && object.build_id.empty()) {
+            object.build_id = buildIdFromNotes(
+                std::string_view(reinterpret_cast<const char*>(info->dlpi_addr + phdr.p_vaddr), phdr.p_memsz));
+        }
+    }
+    if (has_exec) {
+        scan->objects.push_back(std::move(object));
+    }
+    return 0;
+}
+
+bool parseHex(std::string_view text, uintptr_t& value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+// Split off the next space-delimited field
+std::string_view nextField(std::string_view& line) {
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    size_t end = line.find(' ', start);
+    if (end == std::string_view::npos) {
+        end = line.size();
+    }
+    std::string_view field = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return field;
+}
+
+std::string cacheKey(const ModuleInfo& module) {
+    return module.path + '\n' + module.build_id;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// ModuleResolver
+// ---------------------------------------------------------------------------
+
+ModuleResolver::ModuleResolver(std::string path) : path_(std::move(path)) {}
+
+ModuleResolver::~ModuleResolver() {
+    stop();
+}
+
+bool ModuleResolver::start() {
+    // A socket rather than a pipe so that writes to a dead child fail with
+    // EPIPE (MSG_NOSIGNAL) instead of raising SIGPIPE in the host process.
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    std::string exe_arg = path_;
+    char* argv[] = {const_cast<char*>("addr2line"), const_cast<char*>("-f"), const_cast<char*>("-C"),
+                    const_cast<char*>("-e"), exe_arg.data(), nullptr};
+    int rc = posix_spawnp(&pid_, "addr2line", &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(sv[1]);
+
+    if (rc != 0) {
+        close(sv[0]);
+        pid_ = -1;
+        return false;
+    }
+    fd_ = sv[0];
+    buffer_.clear();
+    return true;
+}
+
+void ModuleResolver::stop() {
+    if (fd_ >= 0) {
+        close(fd_); // addr2line exits on EOF
+        fd_ = -1;
+    }
+    if (pid_ > 0) {
+        kill(pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+    buffer_.clear();
+}
+
+bool ModuleResolver::readLine(std::string& line) {
+    while (true) {
+        size_t eol = buffer_.find('\n');
+        if (eol != std::string::npos) {
+            line.assign(buffer_, 0, eol);
+            buffer_.erase(0, eol + 1);
+            return true;
+        }
+
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        if (poll(&pfd, 1, kResolveTimeoutMs) <= 0) {
+            return false;
+        }
+        char chunk[4096];
+        ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+bool ModuleResolver::resolve(const std::vector<uintptr_t>& addresses, std::vector<Result>& results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results.assign(addresses.size(), Result{});
+    if (failed_) {
+        return false;
+    }
+    if (pid_ < 0 && !start()) {
+        failed_ = true;
+        return false;
+    }
+
+    std::string request;
+    std::string function;
+    std::string location;
+    for (size_t begin = 0; begin < addresses.size(); begin += kResolveBatch) {
+        size_t end = std::min(addresses.size(), begin + kResolveBatch);
+
+        // The whole batch fits in the socket buffer, so writing it before
+        // reading cannot deadlock against the child's output.
+        request.clear();
+        for (size_t i = begin; i < end; ++i) {
+            char buf[2 + sizeof(uintptr_t) * 2 + 2];
+            int len = snprintf(buf, sizeof(buf), "0x%lx\n", static_cast<unsigned long>(addresses[i]));
+            request.append(buf, static_cast<size_t>(len));
+        }
+        size_t sent = 0;
+        while (sent < request.size()) {
+            ssize_t n = send(fd_, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                stop();
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+
+        // Two lines per address: "function" and "file:line"
+        for (size_t i = begin; i < end; ++i) {
+            if (!readLine(function) || !readLine(location)) {
+                stop();
+                return false;
+            }
+            Result& result = results[i];
+            if (function != "??") {
+                result.function = function;
+            }
+            size_t discriminator = location.find(" (discriminator");
+            if (discriminator != std::string::npos) {
+                location.resize(discriminator);
+            }
+            size_t colon = location.rfind(':');
+            if (colon != std::string::npos && location.compare(0, colon, "??") != 0) {
+                result.file = location.substr(0, colon);
+                std::from_chars(location.data() + colon + 1, location.data() + location.size(), result.line);
+            }
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ModuleMap
+// ---------------------------------------------------------------------------
+
+std::vector<ModuleInfo> ModuleMap::parseProcMaps(std::string_view text) {
+    std::vector<ModuleInfo> modules;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) {
+            eol = text.size();
+        }
+        std::string_view line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        // start-end perms offset dev inode path
+        std::string_view range = nextField(line);
+        std::string_view perms = nextField(line);
+        std::string_view offset_text = nextField(line);
+        nextField(line); // dev
+        nextField(line); // inode
+        size_t path_start = line.find_first_not_of(' ');
+        if (path_start == std::string_view::npos || line[path_start] != '/') {
+            continue; // anonymous, [heap], [vdso], ...
+        }
+        std::string_view path = line.substr(path_start);
+        if (perms.size() < 3 || perms[2] != 'x') {
+            continue;
+        }
+
+        size_t dash = range.find('-');
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+        uintptr_t offset = 0;
+        if (dash == std::string_view::npos || !parseHex(range.substr(0, dash), start) ||
+            !parseHex(range.substr(dash + 1), end) || !parseHex(offset_text, offset)) {
+            continue;
+        }
+
+        if (!modules.empty() && modules.back().path == path && start >= modules.back().end) {
+            modules.back().end = end;
+            continue;
+        }
+
+        ModuleInfo module;
+        module.path = std::string(path);
+        module.start = start;
+        module.end = end;
+        module.offset = offset;
+        module.load_bias = start - offset;
+        modules.push_back(std::move(module));
+    }
+
+    std::sort(modules.begin(), modules.end(),
+              [](const ModuleInfo& a, const ModuleInfo& b) { return a.start < b.start; });
+    return modules;
+}
+
+void ModuleMap::refresh() {
+    PhdrScan scan;
+    scan.counters_only = true;
+    dl_iterate_phdr(phdrCallback, &scan);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (scanned_ && scan.adds == adds_ && scan.subs == subs_) {
+            return;
+        }
+    }
+
+    scan.counters_only = false;
+    dl_iterate_phdr(phdrCallback, &scan);
+
+    std::ifstream maps("/proc/self/maps");
+    std::string text((std::istreambuf_iterator<char>(maps)), std::istreambuf_iterator<char>());
+    std::vector<ModuleInfo> modules = parseProcMaps(text);
+
+    // Match loader objects by address: dlpi_name is empty for the main program
+    // and may differ from the maps path through symlinks.
+    for (auto& module : modules) {
+        for (const auto& object : scan.objects) {
+            if (module.contains(object.exec_start)) {
+                module.load_bias = object.bias;
+                module.build_id = object.build_id;
+                break;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    modules_ = std::move(modules);
+    adds_ = scan.adds;
+    subs_ = scan.subs;
+    scanned_ = true;
+
+    // Evict helpers of unmapped modules (a resolver's child exits with its last user)
+    for (auto it = caches_.begin(); it != caches_.end();) {
+        bool mapped = std::any_of(modules_.begin(), modules_.end(),
+                                  [&](const ModuleInfo& module) { return cacheKey(module) == it->first; });
+        it = mapped ? std::next(it) : caches_.erase(it);
+    }
+}
+
+bool ModuleMap::find(uintptr_t address, ModuleInfo& module) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::upper_bound(modules_.begin(), modules_.end(), address,
+                               [](uintptr_t addr, const ModuleInfo& m) { return addr < m.start; });
+    if (it == modules_.begin()) {
+        return false;
+    }
+    --it;
+    if (!it->contains(address)) {
+        return false;
+    }
+    module = *it;
+    return true;
+}
+
+std::vector<ModuleInfo> ModuleMap::modules() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return modules_;
+}
+
+std::shared_ptr<ModuleResolver> ModuleMap::resolverFor(const ModuleInfo& module) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& resolver = caches_[cacheKey(module)].resolver;
+    if (!resolver) {
+        resolver = std::make_shared<ModuleResolver>(module.path);
+    }
+    return resolver;
+}
+
+std::shared_ptr<DwarfLineTable> ModuleMap::lineTableFor(const ModuleInfo& module) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lineTable(caches_[cacheKey(module)], module);
+}
+
+std::shared_ptr<DwarfInlineIndex> ModuleMap::inlineIndexFor(const ModuleInfo& module) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ModuleCache& cache = caches_[cacheKey(module)];
+    if (!cache.inline_index) {
+        auto line_table = lineTable(cache, module);
+        cache.inline_index = std::make_shared<DwarfInlineIndex>(cache.elf, std::move(line_table));
+    }
+    return cache.inline_index;
+}
+
+std::shared_ptr<DwarfLineTable> ModuleMap::lineTable(ModuleCache& cache, const ModuleInfo& module) {
+    if (!cache.line_table) {
+        // Both DWARF readers of a module share one mapping of the file
+        auto elf = std::make_shared<ElfFile>();
+        if (elf->open(module.path)) {
+            cache.elf = std::move(elf);
+        }
+        cache.line_table = std::make_shared<DwarfLineTable>(cache.elf);
+    }
+    return cache.line_table;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,133 @@
+/// @file module_map.h
+/// @brief Table of loaded modules with cached per-module symbol resolvers
+
+#pragma once
+
+#include "internal/dwarf_inline.h"
+#include "internal/dwarf_line.h"
+#include "internal/elf_file.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief One loaded ELF object (main executable or shared library)
+struct ModuleInfo {
+    std::string path;        ///< Absolute path of the mapped file
+    uintptr_t start = 0;     ///< Lowest executable address
+    uintptr_t end = 0;       ///< One past the highest executable address
+    uintptr_t offset = 0;    ///< File offset of the first executable mapping
+    uintptr_t load_bias = 0; ///< Runtime address minus link-time address
+    std::string build_id;    ///< GNU build-id as lowercase hex, empty if absent
+
+    bool contains(uintptr_t address) const {
+        return address >= start && address < end;
+    }
+};
+
+/// @class ModuleResolver
+/// @brief Resolves link-time addresses of one module with a long-lived addr2line
+///
+/// addr2line is started on first use and kept running; it reads addresses from
+/// stdin and flushes one answer per address, so a lookup costs a round trip on
+/// a socket instead of a fork+exec.
+class ModuleResolver {
+public:
+    /// @brief Symbol information for one address
+    struct Result {
+        std::string function; ///< Demangled function name, empty if unknown
+        std::string file;     ///< Source file, empty if unknown
+        unsigned int line = 0;
+    };
+
+    explicit ModuleResolver(std::string path);
+    ~ModuleResolver();
+
+    ModuleResolver(const ModuleResolver&) = delete;
+    ModuleResolver& operator=(const ModuleResolver&) = delete;
+
+    /// @brief Resolve link-time addresses (runtime address minus load bias)
+    /// @param addresses Addresses to resolve
+    /// @param results Receives one entry per address
+    /// @return false if addr2line could not be started or died
+    bool resolve(const std::vector<uintptr_t>& addresses, std::vector<Result>& results);
+
+private:
+    bool start();
+    void stop();
+    bool readLine(std::string& line);
+
+    std::string path_;
+    std::mutex mutex_; ///< One request at a time per child
+    pid_t pid_ = -1;
+    int fd_ = -1;
+    bool failed_ = false; ///< Do not retry a resolver that could not start
+    std::string buffer_;  ///< Bytes read from the child but not consumed yet
+};
+
+/// @class ModuleMap
+/// @brief Loaded-module table built from /proc/self/maps and dl_iterate_phdr
+///
+/// The table is rebuilt only when the dynamic loader's add/remove counters
+/// change (i.e. after dlopen/dlclose). Resolvers and DWARF readers of modules
+/// that are no longer mapped are dropped on rebuild.
+class ModuleMap {
+public:
+    /// @brief Rebuild the table if modules were loaded or unloaded since the last scan
+    void refresh();
+
+    /// @brief Find the module containing an address
+    /// @param address Runtime address
+    /// @param module Receives a copy of the module entry
+    /// @return false if the address is not inside any known module
+    bool find(uintptr_t address, ModuleInfo& module) const;
+
+    /// @brief Snapshot of all modules, sorted by start address
+    std::vector<ModuleInfo> modules() const;
+
+    /// @brief Get the cached resolver of a module, creating it on first use
+    std::shared_ptr<ModuleResolver> resolverFor(const ModuleInfo& module);
+
+    /// @brief Get the cached DWARF line table of a module, creating it on first use
+    std::shared_ptr<DwarfLineTable> lineTableFor(const ModuleInfo& module);
+
+    /// @brief Get the cached DWARF inline index of a module, creating it on first use
+    std::shared_ptr<DwarfInlineIndex> inlineIndexFor(const ModuleInfo& module);
+
+    /// @brief Parse /proc/<pid>/maps text into modules (executable file mappings only)
+    ///
+    /// load_bias is estimated as start - offset; refresh() replaces it with the
+    /// exact value from the program headers when available.
+    static std::vector<ModuleInfo> parseProcMaps(std::string_view text);
+
+private:
+    /// @brief Lazily created per-module helpers
+    struct ModuleCache {
+        std::shared_ptr<ModuleResolver> resolver;
+        std::shared_ptr<ElfFile> elf; ///< nullptr if the file could not be opened
+        std::shared_ptr<DwarfLineTable> line_table;
+        std::shared_ptr<DwarfInlineIndex> inline_index;
+    };
+
+    /// @brief Line table of a cache entry, opening the module's ELF file first (mutex_ held)
+    std::shared_ptr<DwarfLineTable> lineTable(ModuleCache& cache, const ModuleInfo& module);
+
+    mutable std::mutex mutex_;
+    std::vector<ModuleInfo> modules_;
+    std::map<std::string, ModuleCache> caches_; ///< Keyed by path + build-id
+    unsigned long long adds_ = 0;
+    unsigned long long subs_ = 0;
+    bool scanned_ = false;
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
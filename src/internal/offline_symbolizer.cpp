@@ -0,0 +1,122 @@
+#include "internal/offline_symbolizer.h"
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+SymbolizedFrame hexFrame(uintptr_t address) {
+    SymbolizedFrame frame;
+    frame.setUnresolved(address);
+    frame.file_id = symbolNames().intern("??");
+    return frame;
+}
+
+} // namespace
+
+void appendDwarfFrames(DwarfLineTable& lines, DwarfInlineIndex& inlines, uintptr_t link_address,
+                       SymbolizedFrame frame, std::vector<SymbolizedFrame>& frames) {
+    StringPool& names = symbolNames();
+    uint32_t unknown_id = names.intern("??");
+    if (frame.file_id == unknown_id || frame.file_id == StringPool::kEmptyId || frame.line == 0) {
+        std::string file;
+        unsigned int line = 0;
+        if (lines.lookup(link_address, file, line)) {
+            frame.file_id = names.intern(file);
+            frame.line = line;
+        }
+    }
+
+    std::vector<InlineFrame> inlined;
+    if (!inlines.lookup(link_address, inlined)) {
+        frames.push_back(frame);
+        return;
+    }
+    // The innermost inlined function sits at the address's own file:line, each
+    // enclosing one at the call site of the function inlined into it
+    uint32_t file_id = frame.file_id;
+    unsigned int line = frame.line;
+    for (auto it = inlined.rbegin(); it != inlined.rend(); ++it) {
+        SymbolizedFrame inline_frame;
+        inline_frame.function_id = it->function.empty() ? unknown_id : names.intern(it->function);
+        inline_frame.file_id = file_id;
+        inline_frame.line = line;
+        inline_frame.is_inlined = true;
+        frames.push_back(inline_frame);
+        file_id = it->call_file.empty() ? unknown_id : names.intern(it->call_file);
+        line = it->call_line;
+    }
+    frame.file_id = file_id;
+    frame.line = line;
+    frames.push_back(frame);
+}
+
+OfflineSymbolizer::OfflineSymbolizer(std::vector<std::string> search_dirs) : search_dirs_(std::move(search_dirs)) {}
+
+OfflineSymbolizer::~OfflineSymbolizer() = default;
+
+OfflineSymbolizer::Binary& OfflineSymbolizer::binary(const ModuleInfo& module) {
+    auto [it, inserted] = binaries_.try_emplace(module.path + '\n' + module.build_id);
+    Binary& binary = it->second;
+    if (!inserted) {
+        return binary;
+    }
+
+    std::vector<std::string> candidates;
+    std::string base = module.path.substr(module.path.rfind('/') + 1);
+    for (const auto& dir : search_dirs_) {
+        if (module.build_id.size() > 2) {
+            candidates.push_back(dir + "/.build-id/" + module.build_id.substr(0, 2) + "/" +
+                                 module.build_id.substr(2) + ".debug");
+        }
+        candidates.push_back(dir + "/" + base);
+        if (!module.path.empty() && module.path[0] == '/') {
+            candidates.push_back(dir + module.path);
+        }
+    }
+    candidates.push_back(module.path);
+
+    for (const auto& candidate : candidates) {
+        auto elf = std::make_shared<ElfFile>();
+        if (!elf->open(candidate) || (!module.build_id.empty() && elf->buildId() != module.build_id)) {
+            continue;
+        }
+        binary.path = candidate;
+        binary.elf = std::move(elf);
+        break;
+    }
+    binary.symbols = std::make_shared<ElfSymbolTable>(binary.elf);
+    binary.lines = std::make_shared<DwarfLineTable>(binary.elf);
+    binary.inlines = std::make_shared<DwarfInlineIndex>(binary.elf, binary.lines);
+    return binary;
+}
+
+std::string OfflineSymbolizer::localPath(const ModuleInfo& module) {
+    return binary(module).path;
+}
+
+std::vector<SymbolizedFrame> OfflineSymbolizer::symbolize(const ModuleInfo* module, uintptr_t address) {
+    std::vector<SymbolizedFrame> frames;
+    std::string name;
+    if (!module) {
+        frames.push_back(hexFrame(address));
+        return frames;
+    }
+    Binary& local = binary(*module);
+    uintptr_t link_address = address - module->load_bias;
+    if (!local.elf || !local.symbols->lookup(link_address, name)) {
+        frames.push_back(hexFrame(address));
+        return frames;
+    }
+
+    SymbolizedFrame frame;
+    frame.function_id = symbolNames().intern(name);
+    frame.file_id = symbolNames().intern("??");
+    appendDwarfFrames(*local.lines, *local.inlines, link_address, frame, frames);
+    return frames;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,77 @@
+/// @file offline_symbolizer.h
+/// @brief Symbolization of exported addresses against binaries on the local disk
+
+#pragma once
+
+#include "internal/elf_symbols.h"
+#include "internal/module_map.h"
+#include "internal/symbolize.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief Add file:line and inlined calls from DWARF to a frame
+///
+/// Fills in the frame's source position if it has none, then appends the
+/// inlined calls covering the address (innermost first, each at the call site
+/// of the one inside it) followed by the frame itself.
+/// @param lines Line table of the module
+/// @param inlines Inline index of the module
+/// @param link_address Runtime address minus the module's load bias
+/// @param frame Frame naming the function the address belongs to
+/// @param frames Receives the frames, innermost first
+void appendDwarfFrames(DwarfLineTable& lines, DwarfInlineIndex& inlines, uintptr_t link_address,
+                       SymbolizedFrame frame, std::vector<SymbolizedFrame>& frames);
+
+/// @class OfflineSymbolizer
+/// @brief Resolves addresses of another process using unstripped copies of its modules
+///
+/// For each module of a symbol bundle the local file is looked for, in order,
+/// in every search directory as ".build-id/xx/rest.debug", as the module's
+/// base name and under the module's full path, and finally at the module's
+/// own path. A candidate is only used if its GNU build-id matches the one
+/// recorded (or none was recorded), so a rebuilt binary never yields wrong
+/// names. Symbols come from the ELF symbol table, positions and inlined calls
+/// from DWARF. Not thread-safe.
+class OfflineSymbolizer {
+public:
+    /// @param search_dirs Directories holding the binaries or separate debug files
+    explicit OfflineSymbolizer(std::vector<std::string> search_dirs);
+    ~OfflineSymbolizer();
+
+    OfflineSymbolizer(const OfflineSymbolizer&) = delete;
+    OfflineSymbolizer& operator=(const OfflineSymbolizer&) = delete;
+
+    /// @brief Symbolize one runtime address of the recorded process
+    /// @param module Module containing the address, nullptr if there was none
+    /// @param address Runtime address (return addresses already adjusted to the call)
+    /// @return Frames innermost first; a single hex-address frame if unresolved
+    std::vector<SymbolizedFrame> symbolize(const ModuleInfo* module, uintptr_t address);
+
+    /// @brief Local file used for a module, empty if no matching file was found
+    std::string localPath(const ModuleInfo& module);
+
+private:
+    struct Binary {
+        std::string path; ///< Empty if no matching file was found
+        std::shared_ptr<ElfFile> elf;
+        std::shared_ptr<ElfSymbolTable> symbols;
+        std::shared_ptr<DwarfLineTable> lines;
+        std::shared_ptr<DwarfInlineIndex> inlines;
+    };
+
+    Binary& binary(const ModuleInfo& module);
+
+    std::vector<std::string> search_dirs_;
+    std::map<std::string, Binary> binaries_; ///< Keyed by path + build-id
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,216 @@
+#include "internal/profile_merge.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr uintptr_t kPageSize = 4096;
+constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+
+struct StackHash {
+    size_t operator()(const std::vector<uintptr_t>& stack) const {
+        uint64_t hash = stack.size();
+        for (uintptr_t address : stack) {
+            hash = (hash ^ address) * kMultiplier;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+/// Unique stacks of one input with their summed values, sorted by stack
+using StackRun = std::vector<std::pair<std::vector<uintptr_t>, uint64_t>>;
+
+/// Where the addresses of one input module go in the merged bundle
+struct Relocation {
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    uintptr_t delta = 0; ///< Added modulo 2^64, so it may be "negative"
+};
+
+std::string moduleKey(const ModuleInfo& module) {
+    return module.build_id.empty() ? "path:" + module.path : module.build_id;
+}
+
+uintptr_t alignUp(uintptr_t address) {
+    return (address + kPageSize - 1) & ~(kPageSize - 1);
+}
+
+// One module per build-id, at the load address it had in the first input that
+// has it unless that range is already taken. Fills the per-input relocations.
+std::vector<ModuleInfo> unifyModules(const std::vector<SymbolBundle>& inputs,
+                                     std::vector<std::vector<Relocation>>& relocations) {
+    std::vector<ModuleInfo> modules; // First-seen order
+    std::unordered_map<std::string, size_t> index;
+    std::vector<std::vector<size_t>> canonical(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        for (const auto& module : inputs[i].modules) {
+            auto [it, inserted] = index.emplace(moduleKey(module), modules.size());
+            if (inserted) {
+                modules.push_back(module);
+            } else {
+                // Same file at another load address: cover both executable ranges
+                auto& unified = modules[it->second];
+                uintptr_t delta = unified.load_bias - module.load_bias;
+                unified.start = std::min(unified.start, module.start + delta);
+                unified.end = std::max(unified.end, module.end + delta);
+            }
+            canonical[i].push_back(it->second);
+        }
+    }
+
+    uintptr_t top = 0;
+    for (const auto& module : modules) {
+        top = std::max(top, alignUp(module.end));
+    }
+    std::map<uintptr_t, uintptr_t> placed; // start -> end
+    for (auto& module : modules) {
+        auto next = placed.lower_bound(module.start);
+        bool overlaps = (next != placed.end() && next->first < module.end) ||
+                        (next != placed.begin() && std::prev(next)->second > module.start);
+        if (overlaps) {
+            uintptr_t delta = top + (module.start & (kPageSize - 1)) - module.start;
+            module.start += delta;
+            module.end += delta;
+            module.load_bias += delta;
+            top = alignUp(module.end);
+        }
+        placed.emplace(module.start, module.end);
+    }
+
+    relocations.assign(inputs.size(), {});
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        for (size_t m = 0; m < inputs[i].modules.size(); ++m) {
+            const auto& module = inputs[i].modules[m];
+            relocations[i].push_back(
+                {module.start, module.end, modules[canonical[i][m]].load_bias - module.load_bias});
+        }
+        std::sort(relocations[i].begin(), relocations[i].end(),
+                  [](const Relocation& a, const Relocation& b) { return a.start < b.start; });
+    }
+
+    std::sort(modules.begin(), modules.end(),
+              [](const ModuleInfo& a, const ModuleInfo& b) { return a.start < b.start; });
+    return modules;
+}
+
+uintptr_t relocate(const std::vector<Relocation>& relocations, uintptr_t address) {
+    auto it = std::upper_bound(relocations.begin(), relocations.end(), address,
+                               [](uintptr_t value, const Relocation& r) { return value < r.start; });
+    if (it == relocations.begin() || address >= std::prev(it)->end) {
+        return address;
+    }
+    return address + std::prev(it)->delta;
+}
+
+StackRun foldInput(const SymbolBundle& input, const std::vector<Relocation>& relocations, double scale) {
+    std::unordered_map<std::vector<uintptr_t>, uint64_t, StackHash> stacks;
+    std::vector<uintptr_t> stack;
+    for (const auto& sample : input.samples) {
+        stack.clear();
+        for (uintptr_t address : sample.stack) {
+            stack.push_back(relocate(relocations, address));
+        }
+        stacks[stack] += sample.value;
+    }
+
+    StackRun run;
+    run.reserve(stacks.size());
+    for (auto& [key, value] : stacks) {
+        uint64_t scaled = scale == 1.0 ? value : static_cast<uint64_t>(std::llround(value * scale));
+        if (scaled > 0) {
+            run.emplace_back(key, scaled);
+        }
+    }
+    std::sort(run.begin(), run.end());
+    return run;
+}
+
+} // namespace
+
+bool mergeSymbolBundles(const std::vector<SymbolBundle>& inputs, SymbolBundle& out, std::string& error,
+                        size_t threads) {
+    out = SymbolBundle();
+    if (inputs.empty()) {
+        return true;
+    }
+    for (const auto& input : inputs) {
+        if (input.kind != inputs.front().kind) {
+            error = "cannot merge bundles of different kinds";
+            return false;
+        }
+    }
+    out.kind = inputs.front().kind;
+    out.period_us = inputs.front().period_us;
+
+    std::vector<std::vector<Relocation>> relocations;
+    out.modules = unifyModules(inputs, relocations);
+
+    std::vector<StackRun> runs(inputs.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            double scale = 1.0;
+            if (out.kind == SymbolBundle::Kind::Cpu && out.period_us > 0 && inputs[i].period_us > 0) {
+                scale = static_cast<double>(inputs[i].period_us) / static_cast<double>(out.period_us);
+            }
+            runs[i] = foldInput(inputs[i], relocations[i], scale);
+        }
+    };
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, inputs.size());
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // k-way merge of the sorted runs; each stack is moved out of its run once
+    using Cursor = std::pair<size_t, size_t>; // Run, position
+    auto later = [&](const Cursor& a, const Cursor& b) {
+        return runs[b.first][b.second].first < runs[a.first][a.second].first;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        if (!runs[r].empty()) {
+            heap.emplace(r, 0);
+        }
+    }
+    while (!heap.empty()) {
+        auto [r, pos] = heap.top();
+        heap.pop();
+        auto& entry = runs[r][pos];
+        if (!out.samples.empty() && out.samples.back().stack == entry.first) {
+            out.samples.back().value += entry.second;
+        } else {
+            SymbolBundle::Sample sample;
+            sample.value = entry.second;
+            sample.stack = std::move(entry.first);
+            out.samples.push_back(std::move(sample));
+        }
+        if (pos + 1 < runs[r].size()) {
+            heap.emplace(r, pos + 1);
+        } else {
+            StackRun().swap(runs[r]);
+        }
+    }
+    return true;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,40 @@
+/// @file profile_merge.h
+/// @brief N-way merge of unsymbolized profiles, remapping modules across processes by build-id
+
+#pragma once
+
+#include "internal/symbol_bundle.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief Merge bundles of the same kind into one
+///
+/// Inputs may come from different time slices of one process or from
+/// different processes. Each module is identified by its GNU build-id (its
+/// path when it has none) and appears once in the result; addresses of every
+/// input are moved to that module's load address, so the same code in
+/// processes with different ASLR layouts ends up at the same address. A
+/// module whose range would overlap another module of the result is relocated
+/// above all of them. Addresses outside every module are kept as recorded.
+///
+/// Each input is folded into its own sorted table of unique stacks on a
+/// separate thread, then the tables are combined in one k-way merge, so memory
+/// is bounded by the number of distinct stacks rather than by the number of
+/// samples. Equal stacks are summed; tids and thread names are dropped. CPU
+/// values are rescaled to the sampling period of the first input.
+/// @param inputs Decoded bundles, all of the same kind
+/// @param out Receives the merged bundle, samples sorted by stack
+/// @param error Set to the reason on failure
+/// @param threads Threads used to fold the inputs (0 = one per core)
+/// @return false if the inputs are of different kinds
+bool mergeSymbolBundles(const std::vector<SymbolBundle>& inputs, SymbolBundle& out, std::string& error,
+                        size_t threads = 0);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,213 @@
+#include "internal/profile_parser.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// gperftools legacy CPU profile layout (all slots are native machine words):
+//   header:  0, 3, 0, sampling_period_us, 0
+//   records: count, depth, pc[depth]
+//   trailer: 0, 1, 0
+//   followed by the text of /proc/self/maps
+constexpr size_t kWordSize = sizeof(uintptr_t);
+
+uintptr_t readWord(std::string_view data, size_t index) {
+    uintptr_t value;
+    std::memcpy(&value, data.data() + index * kWordSize, kWordSize);
+    return value;
+}
+
+// Skip blanks and parse an unsigned decimal or hex (0x-prefixed) number
+bool parseNumber(const char*& p, const char* end, uint64_t& value, int base = 10) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if (base == 16 && end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    const char* start = p;
+    value = 0;
+    while (p < end) {
+        int digit;
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        value = value * base + digit;
+        ++p;
+    }
+    return p != start;
+}
+
+bool expectChar(const char*& p, const char* end, char c) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if (p < end && *p == c) {
+        ++p;
+        return true;
+    }
+    return false;
+}
+
+// Parse "count: bytes [alloc_count: alloc_bytes] @" and leave p after '@'
+bool parseHeapCounts(const char*& p, const char* end, uint64_t& count, uint64_t& bytes) {
+    uint64_t alloc_count = 0;
+    uint64_t alloc_bytes = 0;
+    return parseNumber(p, end, count) && expectChar(p, end, ':') && parseNumber(p, end, bytes) &&
+           expectChar(p, end, '[') && parseNumber(p, end, alloc_count) && expectChar(p, end, ':') &&
+           parseNumber(p, end, alloc_bytes) && expectChar(p, end, ']') && expectChar(p, end, '@');
+}
+
+} // namespace
+
+bool parseCpuProfile(std::string_view data, ParsedProfile& out) {
+    out = ParsedProfile{};
+
+    size_t num_words = data.size() / kWordSize;
+    if (num_words < 5 || readWord(data, 0) != 0) {
+        return false;
+    }
+
+    size_t header_words = readWord(data, 1);
+    if (header_words < 3 || 2 + header_words > num_words) {
+        return false;
+    }
+    out.period_us = readWord(data, 3);
+
+    size_t i = 2 + header_words;
+    while (i + 2 <= num_words) {
+        uintptr_t count = readWord(data, i);
+        uintptr_t depth = readWord(data, i + 1);
+        i += 2;
+
+        if (depth > num_words - i) {
+            return false;
+        }
+
+        // Trailer record marks the end of the binary section
+        if (count == 0 && depth == 1 && readWord(data, i) == 0) {
+            i += 1;
+            out.mapped_libraries.assign(data.substr(i * kWordSize));
+            return true;
+        }
+
+        ProfileSample sample;
+        sample.value = count;
+        sample.stack.reserve(depth);
+        for (size_t j = 0; j < depth; ++j) {
+            sample.stack.push_back(readWord(data, i + j));
+        }
+        i += depth;
+        out.samples.push_back(std::move(sample));
+    }
+
+    // Profiles truncated before the trailer still carry usable samples
+    return true;
+}
+
+std::string encodeCpuProfile(const ParsedProfile& profile) {
+    std::string out;
+    auto append = [&out](uintptr_t word) { out.append(reinterpret_cast<const char*>(&word), kWordSize); };
+    for (uintptr_t word : {uintptr_t{0}, uintptr_t{3}, uintptr_t{0}, static_cast<uintptr_t>(profile.period_us),
+                           uintptr_t{0}}) {
+        append(word);
+    }
+    for (const auto& sample : profile.samples) {
+        append(static_cast<uintptr_t>(sample.value));
+        append(sample.stack.size());
+        for (uintptr_t pc : sample.stack) {
+            append(pc);
+        }
+    }
+    append(0);
+    append(1);
+    append(0);
+    out += profile.mapped_libraries;
+    return out;
+}
+
+bool parseHeapProfile(std::string_view text, ParsedProfile& out) {
+    out = ParsedProfile{};
+
+    size_t line_end = text.find('\n');
+    std::string_view header = text.substr(0, line_end);
+    constexpr std::string_view kHeapPrefix = "heap profile:";
+    if (header.substr(0, kHeapPrefix.size()) != kHeapPrefix) {
+        return false;
+    }
+
+    // "heap_v2/<rate>" means samples were taken every <rate> bytes on average and
+    // must be scaled back up; growth stacks and legacy heap dumps are exact.
+    uint64_t sample_rate = 0;
+    size_t rate_pos = header.find("heap_v2/");
+    if (rate_pos != std::string_view::npos) {
+        const char* p = header.data() + rate_pos + 8;
+        parseNumber(p, header.data() + header.size(), sample_rate);
+    }
+
+    size_t pos = line_end == std::string_view::npos ? text.size() : line_end + 1;
+    while (pos < text.size()) {
+        line_end = text.find('\n', pos);
+        if (line_end == std::string_view::npos) {
+            line_end = text.size();
+        }
+        std::string_view line = text.substr(pos, line_end - pos);
+        pos = line_end + 1;
+
+        if (line.substr(0, 17) == "MAPPED_LIBRARIES:") {
+            out.mapped_libraries.assign(text.substr(std::min(pos, text.size())));
+            break;
+        }
+
+        const char* p = line.data();
+        const char* end = line.data() + line.size();
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        if (!parseHeapCounts(p, end, count, bytes)) {
+            continue;
+        }
+
+        ProfileSample sample;
+        if (sample_rate > 0 && count > 0 && bytes > 0) {
+            double avg = static_cast<double>(bytes) / static_cast<double>(count);
+            double scale = 1.0 / (1.0 - std::exp(-avg / static_cast<double>(sample_rate)));
+            sample.value = static_cast<uint64_t>(static_cast<double>(bytes) * scale);
+        } else {
+            sample.value = bytes;
+        }
+
+        uint64_t address = 0;
+        while (parseNumber(p, end, address, 16)) {
+            sample.stack.push_back(static_cast<uintptr_t>(address));
+        }
+        if (!sample.stack.empty()) {
+            out.samples.push_back(std::move(sample));
+        }
+    }
+
+    return true;
+}
+
+void fixupCallerAddresses(std::vector<uintptr_t>& stack) {
+    for (size_t i = 1; i < stack.size(); ++i) {
+        if (stack[i] != 0) {
+            stack[i] -= 1;
+        }
+    }
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
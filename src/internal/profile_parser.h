@@ -0,0 +1,60 @@
+/// @file profile_parser.h
+/// @brief In-process parsers for gperftools CPU profiles and tcmalloc heap samples
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @struct ProfileSample
+/// @brief One stack from a profile together with its weight
+struct ProfileSample {
+    uint64_t value = 0;           ///< CPU: sample count; heap: in-use bytes (unsampled)
+    std::vector<uintptr_t> stack; ///< Program counters, leaf first
+};
+
+/// @struct ParsedProfile
+/// @brief Decoded profile, independent of the on-disk format it came from
+struct ParsedProfile {
+    uint64_t period_us = 0;             ///< CPU sampling period in microseconds (0 for heap)
+    std::vector<ProfileSample> samples; ///< All stacks in file order
+    std::string mapped_libraries;       ///< /proc/self/maps text recorded with the profile
+};
+
+/// @brief Parse a gperftools legacy binary CPU profile
+/// @param data Raw profile bytes as written by ProfilerStart()/ProfilerStop()
+/// @param out Receives the decoded samples
+/// @return true if the header and all records were well-formed
+bool parseCpuProfile(std::string_view data, ParsedProfile& out);
+
+/// @brief Write a profile in the gperftools legacy binary CPU format read by parseCpuProfile()
+///
+/// Lets samples taken by other CPU samplers go through pprof and every
+/// endpoint that expects a gperftools profile.
+/// @param profile Samples (values are counts), period and /proc/self/maps text
+std::string encodeCpuProfile(const ParsedProfile& profile);
+
+/// @brief Parse a tcmalloc heap sample or heap growth text profile
+/// @param text Output of MallocExtension::GetHeapSample() or GetHeapGrowthStacks()
+/// @param out Receives the decoded samples (values are in-use bytes)
+/// @return true if the "heap profile:" header was recognized
+bool parseHeapProfile(std::string_view text, ParsedProfile& out);
+
+/// @brief Turn return addresses into call-site addresses the way pprof does
+///
+/// Every frame except the leaf holds a return address, which points at the
+/// instruction after the call. Subtracting one maps it back into the call
+/// instruction so that symbolization and line lookup land on the caller.
+/// @param stack Leaf-first program counters, adjusted in place
+void fixupCallerAddresses(std::vector<uintptr_t>& stack);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
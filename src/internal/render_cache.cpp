@@ -0,0 +1,121 @@
+#include "internal/render_cache.h"
+#include <cstdio>
+#include <cstring>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string hex64(uint64_t value) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+    return buf;
+}
+
+} // namespace
+
+uint64_t contentDigest(std::string_view data) {
+    // Word-at-a-time multiply/rotate; profiles are megabytes, so byte-wise FNV would dominate a cache hit
+    uint64_t h = data.size() * kMultiplier;
+    size_t pos = 0;
+    for (; pos + 8 <= data.size(); pos += 8) {
+        uint64_t word;
+        memcpy(&word, data.data() + pos, sizeof(word));
+        h = (h ^ mix(word)) * kMultiplier;
+        h = (h << 31) | (h >> 33);
+    }
+    uint64_t tail = 0;
+    if (pos < data.size()) {
+        memcpy(&tail, data.data() + pos, data.size() - pos);
+    }
+    return mix(h ^ mix(tail));
+}
+
+RenderCache::RenderCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+std::string RenderCache::makeKey(std::string_view data, std::string_view options) {
+    std::string key = hex64(contentDigest(data));
+    key += '-';
+    key += std::to_string(data.size());
+    key += '\n';
+    key.append(options);
+    return key;
+}
+
+std::string RenderCache::etagFor(std::string_view key) {
+    // The key already starts with the data digest; fold the options in with a second digest
+    return "\"" + std::string(key.substr(0, 16)) + hex64(contentDigest(key)).substr(0, 8) + "\"";
+}
+
+std::shared_ptr<const std::string> RenderCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+std::shared_ptr<const std::string> RenderCache::put(const std::string& key, std::string value) {
+    auto shared = std::make_shared<const std::string>(std::move(value));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (shared->size() > max_bytes_) {
+        return shared;
+    }
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        bytes_ -= it->second->second->size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.emplace_front(key, shared);
+    index_.emplace(key, lru_.begin());
+    bytes_ += shared->size();
+    evict();
+    return shared;
+}
+
+void RenderCache::setMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    evict();
+}
+
+RenderCache::Stats RenderCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.entries = lru_.size();
+    stats.bytes = bytes_;
+    stats.max_bytes = max_bytes_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    return stats;
+}
+
+void RenderCache::evict() {
+    while (bytes_ > max_bytes_ && !lru_.empty()) {
+        bytes_ -= lru_.back().second->size();
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,82 @@
+/// @file render_cache.h
+/// @brief Byte-bounded LRU cache of rendered profile outputs
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief 64-bit digest of profile data, used to key renders by content
+uint64_t contentDigest(std::string_view data);
+
+/// @class RenderCache
+/// @brief Maps (profile digest, render options) to the rendered bytes
+///
+/// Entries are evicted least recently used first once their total size
+/// exceeds the byte budget; an output larger than the whole budget is not
+/// cached. Values are shared, so a lookup copies no data; a caller that
+/// needs its own buffer (an HTTP response body) copies once. Thread-safe.
+class RenderCache {
+public:
+    static constexpr size_t kDefaultMaxBytes = 32 * 1024 * 1024;
+
+    /// @brief Counters reported by /api/status
+    struct Stats {
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t max_bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    explicit RenderCache(size_t max_bytes = kDefaultMaxBytes);
+
+    RenderCache(const RenderCache&) = delete;
+    RenderCache& operator=(const RenderCache&) = delete;
+
+    /// @brief Cache key of a render: digest and size of the data plus the options
+    static std::string makeKey(std::string_view data, std::string_view options);
+
+    /// @brief Strong ETag (quoted) identifying the output stored under a key
+    static std::string etagFor(std::string_view key);
+
+    /// @brief Look up a render, marking it most recently used
+    /// @return The cached output, or nullptr on a miss
+    std::shared_ptr<const std::string> get(const std::string& key);
+
+    /// @brief Store a render, evicting older ones to stay within the budget
+    std::shared_ptr<const std::string> put(const std::string& key, std::string value);
+
+    /// @brief Change the byte budget (0 disables caching and drops all entries)
+    void setMaxBytes(size_t max_bytes);
+
+    Stats stats() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const std::string>>;
+
+    void evict(); ///< Drop LRU entries until within budget (mutex_ held)
+
+    mutable std::mutex mutex_;
+    size_t max_bytes_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    std::list<Entry> lru_; ///< Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,105 @@
+#include "internal/request_scheduler.h"
+#include <cstdio>
+#include <exception>
+#include <unistd.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+size_t currentRssBytes() {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    int fields = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    if (fields != 2) {
+        return 0;
+    }
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+RequestScheduler::RequestScheduler(SchedulerOptions options) : options_(std::move(options)) {}
+
+HandlerResponse RequestScheduler::run(const std::string& endpoint_class, const std::string& key,
+                                      const std::function<HandlerResponse()>& handler) {
+    size_t max_rss = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_rss = options_.max_rss_bytes;
+    }
+    // Read before taking the lock; /proc is slow next to the bookkeeping below
+    size_t rss = max_rss > 0 ? currentRssBytes() : 0;
+
+    std::promise<HandlerResponse> promise;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = in_flight_.find(key);
+        if (it != in_flight_.end()) {
+            auto result = it->second;
+            ++stats_.coalesced;
+            lock.unlock();
+            return result.get();
+        }
+
+        const char* reason = nullptr;
+        if (class_running_[endpoint_class] >= classLimit(endpoint_class)) {
+            reason = "Too many concurrent requests for this endpoint";
+        } else if (stats_.running >= options_.max_concurrent) {
+            reason = "Too many concurrent profiling requests";
+        } else if (max_rss > 0 && rss > max_rss) {
+            reason = "Process memory above the profiler budget";
+        }
+        if (reason) {
+            ++stats_.rejected;
+            auto resp = HandlerResponse::error(429, std::string(reason) + ", retry later");
+            resp.headers["Retry-After"] = std::to_string(options_.retry_after_seconds);
+            return resp;
+        }
+
+        in_flight_.emplace(key, promise.get_future().share());
+        ++class_running_[endpoint_class];
+        ++stats_.running;
+        ++stats_.admitted;
+    }
+
+    HandlerResponse resp;
+    try {
+        resp = handler();
+    } catch (const std::exception& e) {
+        resp = HandlerResponse::error(500, e.what());
+    } catch (...) {
+        resp = HandlerResponse::error(500, "Unknown error");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.erase(key);
+        --class_running_[endpoint_class];
+        --stats_.running;
+    }
+    promise.set_value(resp);
+    return resp;
+}
+
+void RequestScheduler::setOptions(const SchedulerOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+int RequestScheduler::classLimit(const std::string& endpoint_class) const {
+    auto it = options_.class_limits.find(endpoint_class);
+    return it != options_.class_limits.end() ? it->second : options_.default_class_limit;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
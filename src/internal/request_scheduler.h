@@ -0,0 +1,69 @@
+/// @file request_scheduler.h
+/// @brief Admission control and coalescing for heavy profiler endpoints
+
+#pragma once
+
+#include "profiler/http_handlers.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @brief Resident set size of this process in bytes (0 if /proc is unavailable)
+size_t currentRssBytes();
+
+/// @class RequestScheduler
+/// @brief Runs handlers under per-class and global limits
+///
+/// A request whose key matches one already running waits for it and gets the
+/// same response instead of doing the work again. Otherwise it is admitted if
+/// its endpoint class and the global budget have a free slot and the process
+/// RSS is within budget, and rejected with 429 + Retry-After if not. Nothing
+/// is queued: under a refresh storm the host does a bounded amount of work.
+class RequestScheduler {
+public:
+    /// @brief Counters reported by /api/status
+    struct Stats {
+        int running = 0;        ///< Requests executing now
+        uint64_t admitted = 0;  ///< Requests that ran their handler
+        uint64_t coalesced = 0; ///< Requests served by an identical in-flight one
+        uint64_t rejected = 0;  ///< Requests answered with 429
+    };
+
+    explicit RequestScheduler(SchedulerOptions options = SchedulerOptions());
+
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    /// @brief Run a handler, share an identical in-flight run, or reject it
+    /// @param endpoint_class Group sharing one concurrency limit (e.g. "cpu", "heap")
+    /// @param key Identifies the request including its parameters; equal keys coalesce
+    /// @param handler Does the work; exceptions become a 500 response
+    HandlerResponse run(const std::string& endpoint_class, const std::string& key,
+                        const std::function<HandlerResponse()>& handler);
+
+    void setOptions(const SchedulerOptions& options);
+
+    Stats stats() const;
+
+private:
+    int classLimit(const std::string& endpoint_class) const; ///< mutex_ held
+
+    mutable std::mutex mutex_;
+    SchedulerOptions options_;
+    std::unordered_map<std::string, std::shared_future<HandlerResponse>> in_flight_;
+    std::map<std::string, int> class_running_;
+    Stats stats_;
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
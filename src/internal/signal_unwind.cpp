@@ -0,0 +1,259 @@
+#include "internal/signal_unwind.h"
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <execinfo.h>
+#include <mutex>
+#include <thread>
+#include <ucontext.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// Frames of the signal handler itself (this file, the caller's handler,
+// __restore_rt) that backtrace() sees above the interrupted one
+constexpr int kHandlerFrames = 16;
+constexpr int kMaxFrames = kMaxSignalStackDepth + kHandlerFrames;
+constexpr size_t kMaxRanges = 8192;
+constexpr uintptr_t kWord = sizeof(uintptr_t);
+
+std::atomic<UnwindMethod> g_method{UnwindMethod::Backtrace};
+
+/// Writable mappings of the process, sorted, one range per mapping. Every
+/// thread stack is one of them; adjacent mappings are kept apart so a walk
+/// never runs from a stack into whatever happens to be mapped next to it.
+struct MappingSnapshot {
+    size_t count = 0;
+    uintptr_t start[kMaxRanges];
+    uintptr_t end[kMaxRanges];
+};
+
+// Two snapshots: handlers read the current one while the next is rebuilt.
+// A reader announces itself in readers[i] and re-checks that i is still
+// current, so a rebuild never overwrites a snapshot that is being read.
+MappingSnapshot g_snapshots[2];
+std::atomic<int> g_current{-1};
+std::atomic<int> g_readers[2];
+std::mutex g_refresh_mutex;
+
+struct Registers {
+    uintptr_t pc = 0;
+    uintptr_t sp = 0;
+    uintptr_t fp = 0;
+    uintptr_t lr = 0; ///< Link register (aarch64 only)
+};
+
+Registers interruptedRegisters(void* context) {
+    Registers regs;
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    regs.pc = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+    regs.sp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RSP]);
+    regs.fp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+    regs.pc = static_cast<uintptr_t>(uc->uc_mcontext.pc);
+    regs.sp = static_cast<uintptr_t>(uc->uc_mcontext.sp);
+    regs.fp = static_cast<uintptr_t>(uc->uc_mcontext.regs[29]);
+    regs.lr = static_cast<uintptr_t>(uc->uc_mcontext.regs[30]);
+#else
+    (void)uc;
+#endif
+    return regs;
+}
+
+void refreshMappings() {
+    std::lock_guard<std::mutex> lock(g_refresh_mutex);
+    int current = g_current.load();
+    int next = current == 0 ? 1 : 0;
+    while (g_readers[next].load() > 0) {
+        std::this_thread::yield();
+    }
+
+    MappingSnapshot& snapshot = g_snapshots[next];
+    snapshot.count = 0;
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps != nullptr) {
+        char line[512];
+        while (snapshot.count < kMaxRanges && fgets(line, sizeof(line), maps) != nullptr) {
+            uintptr_t start = 0;
+            uintptr_t end = 0;
+            char perms[5] = {};
+            if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s", &start, &end, perms) != 3 || perms[1] != 'w') {
+                continue;
+            }
+            snapshot.start[snapshot.count] = start;
+            snapshot.end[snapshot.count] = end;
+            ++snapshot.count;
+        }
+        fclose(maps);
+    }
+    g_current.store(next);
+}
+
+// End of the writable mapping that holds `sp` (the thread's stack), 0 if unknown
+uintptr_t stackEnd(uintptr_t sp) {
+    int current;
+    for (;;) {
+        current = g_current.load();
+        if (current < 0) {
+            return 0;
+        }
+        g_readers[current].fetch_add(1);
+        if (g_current.load() == current) {
+            break;
+        }
+        g_readers[current].fetch_sub(1);
+    }
+
+    const MappingSnapshot& snapshot = g_snapshots[current];
+    uintptr_t end = 0;
+    size_t lo = 0;
+    size_t hi = snapshot.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (snapshot.end[mid] <= sp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < snapshot.count && snapshot.start[lo] <= sp) {
+        end = snapshot.end[lo];
+    }
+    g_readers[current].fetch_sub(1);
+    return end;
+}
+
+// Return address of a function interrupted before its frame record is set up
+// or after it was torn down: the frame pointer still belongs to the caller,
+// so the walk would skip the caller. Recognizes the standard prologue and
+// epilogue instructions at the PC; 0 when the function's own record is live.
+uintptr_t unlinkedReturnAddress(const Registers& regs, uintptr_t stack_end) {
+#if defined(__x86_64__)
+    const auto* code = reinterpret_cast<const uint8_t*>(regs.pc);
+    uintptr_t slot;
+    if (code[0] == 0x55 || code[0] == 0xc3) {
+        slot = regs.sp; // push %rbp (entry) or ret: the return address is on top
+    } else if (code[0] == 0xf3 && code[1] == 0x0f && code[2] == 0x1e && code[3] == 0xfa) {
+        slot = regs.sp; // endbr64 (entry)
+    } else if (code[0] == 0x48 && code[1] == 0x89 && code[2] == 0xe5) {
+        slot = regs.sp + kWord; // mov %rsp,%rbp: the caller's %rbp was just pushed
+    } else {
+        return 0;
+    }
+    if (slot + kWord > stack_end) {
+        return 0;
+    }
+    return *reinterpret_cast<const uintptr_t*>(slot);
+#elif defined(__aarch64__)
+    (void)stack_end;
+    uint32_t insn = *reinterpret_cast<const uint32_t*>(regs.pc);
+    // stp x29, x30, [sp, #-n]! / mov x29, sp / ret: x30 still holds the return address
+    if ((insn & 0xffc07fff) == 0xa9807bfd || insn == 0x910003fd || insn == 0xd65f03c0) {
+        return regs.lr;
+    }
+    return 0;
+#else
+    (void)regs;
+    (void)stack_end;
+    return 0;
+#endif
+}
+
+int captureBacktrace(void* context, uintptr_t* out, int max_depth) {
+    // Extra slots for the handler frames that are cut off below
+    void* frames[kMaxFrames];
+    int depth = backtrace(frames, max_depth + 8 < kMaxFrames ? max_depth + 8 : kMaxFrames);
+
+    uintptr_t pc = context != nullptr ? interruptedRegisters(context).pc : 0;
+    int first = pc == 0 ? 0 : -1;
+    for (int i = 0; i < depth && first < 0; ++i) {
+        if (reinterpret_cast<uintptr_t>(frames[i]) == pc) {
+            first = i;
+        }
+    }
+    if (first < 0) {
+        // The unwinder lost track at the signal frame (no unwind info for the
+        // interrupted code), so everything it found is the handler's own
+        depth = captureFramePointerStack(context, out, max_depth);
+        if (depth > 0) {
+            return depth;
+        }
+        out[0] = pc;
+        return max_depth > 0 ? 1 : 0;
+    }
+
+    int count = 0;
+    for (int i = first; i < depth && count < max_depth; ++i) {
+        out[count++] = reinterpret_cast<uintptr_t>(frames[i]);
+    }
+    return count;
+}
+
+} // namespace
+
+void setSignalUnwindMethod(UnwindMethod method) {
+    g_method = method;
+}
+
+UnwindMethod signalUnwindMethod() {
+    return g_method.load();
+}
+
+void prepareSignalUnwind() {
+    void* warmup[2];
+    backtrace(warmup, 2);
+    refreshMappings();
+}
+
+int captureFramePointerStack(void* context, uintptr_t* out, int max_depth) {
+    if (context == nullptr || max_depth <= 0) {
+        return -1;
+    }
+    Registers regs = interruptedRegisters(context);
+    uintptr_t end = stackEnd(regs.sp);
+    if (regs.pc == 0 || end == 0) {
+        return -1;
+    }
+
+    // Each frame record is {caller's frame pointer, return address}. Records
+    // must be aligned, lie between the interrupted sp and the end of the
+    // stack, and move strictly towards the end; anything else is not a frame
+    // pointer (code built without one reuses the register) and ends the walk.
+    int count = 0;
+    out[count++] = regs.pc;
+    uintptr_t caller = unlinkedReturnAddress(regs, end);
+    if (caller != 0 && count < max_depth) {
+        out[count++] = caller;
+    }
+    uintptr_t low = regs.sp;
+    uintptr_t fp = regs.fp;
+    while (count < max_depth && fp % kWord == 0 && fp >= low && fp <= end - 2 * kWord) {
+        const auto* record = reinterpret_cast<const uintptr_t*>(fp);
+        uintptr_t ret = record[1];
+        if (ret == 0) {
+            break;
+        }
+        out[count++] = ret;
+        low = fp + 2 * kWord;
+        fp = record[0];
+    }
+    return count > 1 ? count : -1;
+}
+
+int captureSignalStack(void* context, uintptr_t* out, int max_depth) {
+    if (g_method.load(std::memory_order_relaxed) == UnwindMethod::FramePointer) {
+        int depth = captureFramePointerStack(context, out, max_depth);
+        if (depth > 0) {
+            return depth;
+        }
+    }
+    return captureBacktrace(context, out, max_depth);
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
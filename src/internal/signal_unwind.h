@@ -0,0 +1,69 @@
+/// @file signal_unwind.h
+/// @brief Stack capture from inside a signal handler
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstdint>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// Largest `max_depth` that captureSignalStack() fills completely: 256 frames plus
+/// the extra frame thread stack capture uses to detect truncation
+constexpr int kMaxSignalStackDepth = 257;
+
+/// @enum UnwindMethod
+/// @brief How captureSignalStack() walks the interrupted stack
+enum class UnwindMethod {
+    Backtrace,   ///< glibc backtrace(): libgcc's DWARF unwinder, works without frame pointers
+    FramePointer ///< Follow the saved frame pointer chain from the interrupted registers
+};
+
+/// @brief Select the unwinder of captureSignalStack() for the whole process
+void setSignalUnwindMethod(UnwindMethod method);
+
+/// @brief Currently selected unwinder (Backtrace by default)
+UnwindMethod signalUnwindMethod();
+
+/// @brief Load what the unwinders need outside of signal context
+///
+/// The first backtrace() dlopen()s libgcc_s, which is not safe inside a
+/// signal handler, and the frame-pointer walk bounds every read by the
+/// writable mapping of /proc/self/maps that holds the interrupted sp,
+/// snapshotted here. Call this before arming any sampling signal, and again
+/// once new threads have started.
+void prepareSignalUnwind();
+
+/// @brief Capture the interrupted thread's stack from a SA_SIGINFO handler
+///
+/// Uses the method set by setSignalUnwindMethod(). A frame-pointer walk
+/// stops at the first frame record that is not on the thread's stack; when
+/// not even the leaf's caller is found (code built without frame pointers,
+/// or a thread that started after the last snapshot) it falls back to
+/// backtrace(). backtrace() output is trimmed to start at the interrupted
+/// PC; if the PC is not in it (the unwinder could not cross the signal
+/// frame), the frame-pointer walk is tried and, failing that, only the PC is
+/// returned, so the handler's own frames are never reported.
+/// @param context The handler's third argument (ucontext_t*)
+/// @param out Receives program counters, leaf (the interrupted instruction) first
+/// @param max_depth Capacity of `out`; backtrace() stops at kMaxSignalStackDepth frames
+/// @return Number of frames written; the handler's own frames are left out
+int captureSignalStack(void* context, uintptr_t* out, int max_depth);
+
+/// @brief Walk the frame pointer chain of an interrupted context, without fallback
+///
+/// A leaf interrupted in its prologue (before the frame record is pushed) or
+/// at its `ret` still has the caller's frame pointer; the caller is then read
+/// from the stack top (x86_64) or the link register (aarch64) so it is not
+/// skipped.
+/// @param context The handler's third argument (ucontext_t*)
+/// @param out Receives program counters, leaf first
+/// @param max_depth Capacity of `out`
+/// @return Number of frames written, or -1 if there is no frame record on the stack below the leaf
+int captureFramePointerStack(void* context, uintptr_t* out, int max_depth);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
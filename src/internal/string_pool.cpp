@@ -0,0 +1,93 @@
+#include "internal/string_pool.h"
+#include <cstring>
+#include <mutex>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr size_t kBlockSize = 64 * 1024;
+// Larger strings get a block of their own instead of wasting the rest of one
+constexpr size_t kMaxSharedSize = kBlockSize / 4;
+
+} // namespace
+
+StringPool::StringPool() {
+    strings_.emplace_back();
+    index_.emplace(std::string_view(), kEmptyId);
+}
+
+StringPool::~StringPool() = default;
+
+char* StringPool::allocate(size_t size) {
+    if (size > kMaxSharedSize) {
+        // Keep the current block as the one to fill by inserting before it
+        auto it = blocks_.insert(blocks_.empty() ? blocks_.end() : blocks_.end() - 1,
+                                 std::make_unique<char[]>(size));
+        return it->get();
+    }
+    if (blocks_.empty() || block_size_ - block_used_ < size) {
+        blocks_.push_back(std::make_unique<char[]>(kBlockSize));
+        block_size_ = kBlockSize;
+        block_used_ = 0;
+    }
+    char* data = blocks_.back().get() + block_used_;
+    block_used_ += size;
+    return data;
+}
+
+uint32_t StringPool::intern(std::string_view str) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = index_.find(str);
+        if (it != index_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = index_.find(str);
+    if (it != index_.end()) {
+        return it->second; // Interned by another thread in the meantime
+    }
+    char* data = allocate(str.size());
+    memcpy(data, str.data(), str.size());
+    std::string_view stored(data, str.size());
+
+    uint32_t id = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(stored);
+    index_.emplace(stored, id);
+    bytes_ += str.size();
+    return id;
+}
+
+std::string_view StringPool::view(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return id < strings_.size() ? strings_[id] : std::string_view();
+}
+
+size_t StringPool::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return strings_.size();
+}
+
+size_t StringPool::bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return bytes_;
+}
+
+StringPool& symbolNames() {
+    // Never destroyed: views may still be held by threads running at exit
+    static StringPool* pool = new StringPool();
+    return *pool;
+}
+
+std::string_view NameScope::view(uint32_t id) const {
+    return (id & kScopedBit) != 0 ? pool_.view(id & ~kScopedBit) : symbolNames().view(id);
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
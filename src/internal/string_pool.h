@@ -0,0 +1,92 @@
+/// @file string_pool.h
+/// @brief Interned string storage with stable 32-bit IDs
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class StringPool
+/// @brief Append-only arena of distinct strings, addressed by dense IDs
+///
+/// Each distinct string is copied once into a block of the arena and never
+/// moved or freed, so views returned by view() stay valid for the lifetime of
+/// the pool and IDs can be compared instead of strings. Lookups of existing
+/// strings take a shared lock only. Thread-safe.
+class StringPool {
+public:
+    static constexpr uint32_t kEmptyId = 0; ///< ID of the empty string
+
+    StringPool();
+    ~StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    /// @brief Get the ID of a string, copying it into the pool on first use
+    uint32_t intern(std::string_view str);
+
+    /// @brief Contents of an interned string ("" for an unknown ID)
+    std::string_view view(uint32_t id) const;
+
+    /// @brief Number of distinct strings, including the empty string
+    size_t size() const;
+
+    /// @brief Bytes of string data held by the arena
+    size_t bytes() const;
+
+private:
+    char* allocate(size_t size);
+
+    mutable std::shared_mutex mutex_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_used_ = 0;                                ///< Bytes used in blocks_.back()
+    size_t block_size_ = 0;                                ///< Capacity of blocks_.back()
+    size_t bytes_ = 0;                                     ///< Total bytes of interned strings
+    std::vector<std::string_view> strings_;                ///< Indexed by ID
+    std::unordered_map<std::string_view, uint32_t> index_; ///< Contents -> ID
+};
+
+/// @brief Process-wide pool for symbol names and source paths
+///
+/// Shared by the symbolizers and thread dumps so that a name resolved once is
+/// stored once, however many stacks and renders use it. It is never trimmed,
+/// so only names of loaded code go here: strings made up for one render, such
+/// as unresolved addresses, belong in a NameScope.
+StringPool& symbolNames();
+
+/// @class NameScope
+/// @brief Names that live only as long as one request
+///
+/// IDs returned by intern() have kScopedBit set and refer to the scope's own
+/// pool, which is freed with the scope; view() resolves any other ID in
+/// symbolNames(), so both kinds can be mixed in one stack. Thread-safe.
+class NameScope {
+public:
+    static constexpr uint32_t kScopedBit = 0x80000000u; ///< Marks IDs of this scope
+
+    /// @brief Get the ID of a request-local string
+    uint32_t intern(std::string_view str) {
+        return pool_.intern(str) | kScopedBit;
+    }
+
+    /// @brief Contents of a scoped ID or of a symbolNames() ID
+    std::string_view view(uint32_t id) const;
+
+private:
+    StringPool pool_;
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,164 @@
+#include "internal/symbol_bundle.h"
+#include "internal/dwarf_reader.h"
+#include <algorithm>
+#include <unordered_map>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'R', 'S', 'B'};
+constexpr uint8_t kVersion = 1;
+
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void appendString(std::string& out, std::string_view str) {
+    appendVarint(out, str.size());
+    out.append(str);
+}
+
+bool readString(DwarfCursor& cursor, std::string& str) {
+    uint64_t size = cursor.uleb();
+    if (!cursor.ok() || size > cursor.data().size() - cursor.pos()) {
+        return false;
+    }
+    str.assign(cursor.data().substr(cursor.pos(), size));
+    cursor.skip(size);
+    return true;
+}
+
+// A count can never exceed the bytes left, as every element takes at least one
+bool readCount(DwarfCursor& cursor, uint64_t& count) {
+    count = cursor.uleb();
+    return cursor.ok() && count <= cursor.data().size() - cursor.pos();
+}
+
+} // namespace
+
+std::string encodeSymbolBundle(const SymbolBundle& bundle) {
+    std::vector<uintptr_t> addresses;
+    for (const auto& sample : bundle.samples) {
+        addresses.insert(addresses.end(), sample.stack.begin(), sample.stack.end());
+    }
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+    std::unordered_map<uintptr_t, uint64_t> index;
+    index.reserve(addresses.size());
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        index.emplace(addresses[i], i);
+    }
+
+    std::string out(kMagic, sizeof(kMagic));
+    out += static_cast<char>(kVersion);
+    out += static_cast<char>(bundle.kind);
+    appendVarint(out, bundle.period_us);
+
+    appendVarint(out, bundle.modules.size());
+    for (const auto& module : bundle.modules) {
+        appendString(out, module.path);
+        appendVarint(out, module.start);
+        appendVarint(out, module.end - module.start);
+        appendVarint(out, module.offset);
+        appendVarint(out, module.load_bias);
+        appendString(out, module.build_id);
+    }
+
+    appendVarint(out, addresses.size());
+    uintptr_t previous = 0;
+    for (uintptr_t address : addresses) {
+        appendVarint(out, address - previous);
+        previous = address;
+    }
+
+    appendVarint(out, bundle.samples.size());
+    for (const auto& sample : bundle.samples) {
+        appendVarint(out, sample.value);
+        appendVarint(out, sample.tid);
+        appendString(out, sample.label);
+        appendVarint(out, sample.stack.size());
+        for (uintptr_t address : sample.stack) {
+            appendVarint(out, index[address]);
+        }
+    }
+    return out;
+}
+
+bool decodeSymbolBundle(std::string_view data, SymbolBundle& bundle) {
+    bundle = SymbolBundle();
+    if (data.size() < sizeof(kMagic) + 2 || data.compare(0, sizeof(kMagic), std::string_view(kMagic, 4)) != 0) {
+        return false;
+    }
+    DwarfCursor cursor(data, sizeof(kMagic));
+    if (cursor.u8() != kVersion) {
+        return false;
+    }
+    uint8_t kind = cursor.u8();
+    if (kind < static_cast<uint8_t>(SymbolBundle::Kind::Cpu) ||
+        kind > static_cast<uint8_t>(SymbolBundle::Kind::Threads)) {
+        return false;
+    }
+    bundle.kind = static_cast<SymbolBundle::Kind>(kind);
+    bundle.period_us = cursor.uleb();
+
+    uint64_t count = 0;
+    if (!readCount(cursor, count)) {
+        return false;
+    }
+    bundle.modules.resize(count);
+    for (auto& module : bundle.modules) {
+        if (!readString(cursor, module.path)) {
+            return false;
+        }
+        module.start = cursor.uleb();
+        module.end = module.start + cursor.uleb();
+        module.offset = cursor.uleb();
+        module.load_bias = cursor.uleb();
+        if (!readString(cursor, module.build_id)) {
+            return false;
+        }
+    }
+
+    if (!readCount(cursor, count)) {
+        return false;
+    }
+    std::vector<uintptr_t> addresses(count);
+    uintptr_t previous = 0;
+    for (auto& address : addresses) {
+        address = previous + cursor.uleb();
+        previous = address;
+    }
+
+    if (!readCount(cursor, count)) {
+        return false;
+    }
+    bundle.samples.resize(count);
+    for (auto& sample : bundle.samples) {
+        sample.value = cursor.uleb();
+        sample.tid = cursor.uleb();
+        uint64_t depth = 0;
+        if (!readString(cursor, sample.label) || !readCount(cursor, depth)) {
+            return false;
+        }
+        sample.stack.resize(depth);
+        for (auto& address : sample.stack) {
+            uint64_t i = cursor.uleb();
+            if (i >= addresses.size()) {
+                return false;
+            }
+            address = addresses[i];
+        }
+    }
+    return cursor.ok() && cursor.atEnd();
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
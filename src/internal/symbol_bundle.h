@@ -0,0 +1,59 @@
+/// @file symbol_bundle.h
+/// @brief Compact binary container for unsymbolized stacks plus the module table
+
+#pragma once
+
+#include "internal/module_map.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @struct SymbolBundle
+/// @brief Profile or thread dump exported without in-process symbolization
+///
+/// Stacks hold runtime addresses exactly as recorded; the module table carries
+/// what an offline symbolizer needs to map them back into files on another
+/// machine (path, load bias, file offset and GNU build-id).
+struct SymbolBundle {
+    /// What the samples are, which decides how their values are read
+    enum class Kind : uint8_t {
+        Cpu = 1,        ///< Values are sample counts
+        Heap = 2,       ///< Values are in-use bytes
+        HeapGrowth = 3, ///< Values are bytes
+        Threads = 4,    ///< One sample per thread, value 1
+    };
+
+    /// @brief One recorded stack
+    struct Sample {
+        uint64_t value = 0;           ///< Sample count or bytes, see Kind
+        uint64_t tid = 0;             ///< Thread ID (thread dumps only)
+        std::string label;            ///< Thread name (thread dumps only)
+        std::vector<uintptr_t> stack; ///< Runtime addresses, leaf first
+    };
+
+    Kind kind = Kind::Cpu;
+    uint64_t period_us = 0;          ///< CPU sampling period in microseconds (0 otherwise)
+    std::vector<ModuleInfo> modules; ///< Sorted by start address
+    std::vector<Sample> samples;
+};
+
+/// @brief Serialize a bundle
+///
+/// Layout: "PRSB", version byte, kind byte, then LEB128-encoded fields. The
+/// distinct addresses of all stacks are stored once, sorted and delta-encoded,
+/// and stacks refer to them by index, so a bundle is typically much smaller
+/// than the raw profile it was made from.
+std::string encodeSymbolBundle(const SymbolBundle& bundle);
+
+/// @brief Parse a bundle written by encodeSymbolBundle()
+/// @return false if the data is truncated, corrupt or of an unknown version
+bool decodeSymbolBundle(std::string_view data, SymbolBundle& bundle);
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -3,22 +3,49 @@
 
 #pragma once
 
+#include "internal/string_pool.h"
 #include "profiler_version.h"
+#include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 PROFILER_NAMESPACE_BEGIN
 
+namespace internal {
+class ModuleMap;
+} // namespace internal
+
 /// @struct SymbolizedFrame
 /// @brief Result of symbolizing a single address
 ///
 /// Contains the resolved symbol information for a single instruction pointer.
+/// Names are interned in internal::symbolNames(), so frames are cheap to copy
+/// and the same function resolved at many addresses is stored once. An
+/// unresolved address is kept as hex text in the frame itself rather than in
+/// the pool, which would otherwise grow with every address ever looked up.
 struct SymbolizedFrame {
-    std::string function_name; ///< Function name (demangled)
-    std::string source_file;   ///< Source file path
-    unsigned int line = 0;     ///< Line number in source file
-    bool is_inlined = false;   ///< Whether this is an inlined function
+    uint32_t function_id = 0; ///< Interned function name (demangled)
+    uint32_t file_id = 0;     ///< Interned source file path
+    unsigned int line = 0;    ///< Line number in source file
+    bool is_inlined = false;  ///< Whether this frame was inlined into the next frame of the list
+    /// "0x..." when the address has no symbol (see setUnresolved()), else empty
+    char unresolved[2 + sizeof(uintptr_t) * 2 + 1] = {};
+
+    /// @brief Mark the frame as unresolved, named by its address
+    void setUnresolved(uintptr_t address) {
+        snprintf(unresolved, sizeof(unresolved), "0x%lx", static_cast<unsigned long>(address));
+        function_id = internal::StringPool::kEmptyId;
+    }
+
+    std::string_view functionName() const {
+        return unresolved[0] != '\0' ? std::string_view(unresolved) : internal::symbolNames().view(function_id);
+    }
+    std::string_view sourceFile() const {
+        return internal::symbolNames().view(file_id);
+    }
 };
 
 /// @class Symbolizer
@@ -32,27 +59,38 @@ public:
 
     /// @brief Symbolize a single address
     /// @param address The instruction pointer to symbolize
-    /// @return Vector of SymbolizedFrame (may contain multiple for inlined frames)
+    /// @return Vector of SymbolizedFrame, innermost first (several for inlined calls,
+    ///         the last one being the function the others were inlined into)
     virtual std::vector<SymbolizedFrame> symbolize(void* address) = 0;
 
     /// @brief Symbolize multiple addresses in batch
     /// @param addresses Vector of instruction pointers to symbolize
     /// @return Vector of symbolized frame vectors (one per input address)
     virtual std::vector<std::vector<SymbolizedFrame>> symbolizeBatch(const std::vector<void*>& addresses) = 0;
+
+    /// @brief Load whatever the backend needs to resolve these addresses, discarding the results
+    /// @param addresses One or more addresses per module of interest
+    /// @note Lets a background thread pay for lazy initialization before the first real request
+    virtual void warmup(const std::vector<void*>& addresses) {
+        symbolizeBatch(addresses);
+    }
 };
 
 /// @class BackwardSymbolizer
 /// @brief Symbolizer implementation using backward-cpp library
 ///
 /// Uses the backward-cpp library for address symbolization with support
-/// for inline function detection.
+/// for inline function detection. When a module map is supplied, frames
+/// without a source position get file:line from the module's DWARF line table,
+/// and inlined calls covering the address are expanded from .debug_info.
 class BackwardSymbolizer : public Symbolizer {
 public:
-    BackwardSymbolizer();
+    explicit BackwardSymbolizer(std::shared_ptr<internal::ModuleMap> modules = nullptr);
     ~BackwardSymbolizer() override;
 
     std::vector<SymbolizedFrame> symbolize(void* address) override;
     std::vector<std::vector<SymbolizedFrame>> symbolizeBatch(const std::vector<void*>& addresses) override;
+    void warmup(const std::vector<void*>& addresses) override;
 
 private:
     class Impl;
@@ -60,7 +98,8 @@ private:
 };
 
 /// @brief Factory function to create a Symbolizer instance
+/// @param modules Optional module map used for in-process file:line and inline-frame lookup
 /// @return Unique pointer to a new Symbolizer instance
-std::unique_ptr<Symbolizer> createSymbolizer();
+std::unique_ptr<Symbolizer> createSymbolizer(std::shared_ptr<internal::ModuleMap> modules = nullptr);
 
 PROFILER_NAMESPACE_END
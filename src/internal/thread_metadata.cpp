@@ -0,0 +1,241 @@
+#include "internal/thread_metadata.h"
+#include "internal/string_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+namespace {
+
+// Record layout of getdents64(); glibc only declares it under _GNU_SOURCE on newer versions
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Read a whole /proc file of the thread into `buf`, NUL-terminated; -1 if it is gone
+ssize_t readTaskFile(int task_fd, pid_t tid, const char* file, char* buf, size_t size) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/%s", static_cast<int>(tid), file);
+    int fd = openat(task_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+// Skip `count` space-separated fields
+const char* skipFields(const char* p, const char* end, int count) {
+    while (count > 0 && p < end) {
+        while (p < end && *p != ' ') {
+            ++p;
+        }
+        while (p < end && *p == ' ') {
+            ++p;
+        }
+        --count;
+    }
+    return p;
+}
+
+uint64_t parseField(const char*& p, const char* end) {
+    uint64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+    return value;
+}
+
+/// Fields of /proc/<pid>/task/<tid>/stat that the snapshot keeps
+struct StatFields {
+    std::string_view comm;
+    char state = '?';
+    uint64_t cpu_ticks = 0;
+    uint64_t start_time = 0;
+};
+
+// Format: tid (comm) state ppid ... utime(14) stime(15) ... starttime(22) ...
+// comm may contain spaces and ')', so it ends at the last ')'
+bool parseStat(const char* buf, size_t size, StatFields& fields) {
+    const char* end = buf + size;
+    const char* open = static_cast<const char*>(memchr(buf, '(', size));
+    const char* close = static_cast<const char*>(memrchr(buf, ')', size));
+    if (open == nullptr || close == nullptr || close < open || close + 2 >= end) {
+        return false;
+    }
+    fields.comm = std::string_view(open + 1, static_cast<size_t>(close - open - 1));
+    const char* p = close + 2;
+    fields.state = *p;
+    p = skipFields(p, end, 11); // state -> utime
+    fields.cpu_ticks = parseField(p, end);
+    p = skipFields(p, end, 1);
+    fields.cpu_ticks += parseField(p, end);
+    p = skipFields(p, end, 7); // stime -> starttime
+    fields.start_time = parseField(p, end);
+    return true;
+}
+
+} // namespace
+
+ptrdiff_t ThreadMetadataSnapshot::find(pid_t tid) const {
+    auto it = std::lower_bound(tids.begin(), tids.end(), tid);
+    return it != tids.end() && *it == tid ? it - tids.begin() : -1;
+}
+
+std::string_view ThreadMetadataSnapshot::name(size_t row) const {
+    return pool->view(names[row]);
+}
+
+std::string_view ThreadMetadataSnapshot::wchan(size_t row) const {
+    return pool->view(wchans[row]);
+}
+
+void ThreadMetadataSnapshot::clear() {
+    tids.clear();
+    states.clear();
+    names.clear();
+    wchans.clear();
+    cpu_ticks.clear();
+    start_times.clear();
+    pool.reset();
+}
+
+ThreadMetadataReader::ThreadMetadataReader() : pool_(std::make_shared<StringPool>()) {}
+
+ThreadMetadataReader::~ThreadMetadataReader() {
+    if (task_fd_ >= 0) {
+        close(task_fd_);
+    }
+}
+
+bool ThreadMetadataReader::listThreads(std::vector<pid_t>& tids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return listLocked(tids);
+}
+
+bool ThreadMetadataReader::listLocked(std::vector<pid_t>& tids) {
+    tids.clear();
+    pid_t pid = getpid();
+    if (task_fd_ >= 0 && task_pid_ != pid) {
+        // Inherited across fork(): it still refers to the parent's /proc/<pid>/task
+        close(task_fd_);
+        task_fd_ = -1;
+        names_.clear();
+    }
+    if (task_fd_ < 0) {
+        task_fd_ = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (task_fd_ < 0) {
+            return false;
+        }
+        task_pid_ = pid;
+    }
+    // procfs regenerates the listing on every read from offset 0
+    if (lseek(task_fd_, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    alignas(LinuxDirent64) char buf[16384];
+    for (;;) {
+        long n = syscall(SYS_getdents64, task_fd_, buf, sizeof(buf));
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        for (long offset = 0; offset < n;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(buf + offset);
+            pid_t tid = 0;
+            for (const char* c = entry->d_name; *c >= '0' && *c <= '9'; ++c) {
+                tid = tid * 10 + (*c - '0');
+            }
+            if (tid > 0) {
+                tids.push_back(tid);
+            }
+            offset += entry->d_reclen;
+        }
+    }
+    std::sort(tids.begin(), tids.end());
+    return true;
+}
+
+bool ThreadMetadataReader::collect(ThreadMetadataSnapshot& snapshot, bool with_wchan) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot.clear();
+    std::vector<pid_t> tids;
+    if (!listLocked(tids)) {
+        return false;
+    }
+    snapshot.tids.reserve(tids.size());
+    snapshot.states.reserve(tids.size());
+    snapshot.names.reserve(tids.size());
+    snapshot.wchans.reserve(tids.size());
+    snapshot.cpu_ticks.reserve(tids.size());
+    snapshot.start_times.reserve(tids.size());
+
+    if (pool_->bytes() > kPoolBudget) {
+        // Earlier snapshots keep the old pool alive; the cached IDs refer to it
+        pool_ = std::make_shared<StringPool>();
+        names_.clear();
+    }
+    snapshot.pool = pool_;
+    StringPool& pool = *pool_;
+    char buf[1024];
+    StatFields fields;
+    for (pid_t tid : tids) {
+        ssize_t n = readTaskFile(task_fd_, tid, "stat", buf, sizeof(buf));
+        if (n < 0 || !parseStat(buf, static_cast<size_t>(n), fields)) {
+            continue; // Exited since the listing
+        }
+        auto [it, inserted] = names_.try_emplace(tid);
+        CachedName& cached = it->second;
+        if (inserted || cached.start_time != fields.start_time || pool.view(cached.name) != fields.comm) {
+            cached.start_time = fields.start_time;
+            cached.name = pool.intern(fields.comm);
+        }
+
+        uint32_t wchan = StringPool::kEmptyId;
+        if (with_wchan) {
+            n = readTaskFile(task_fd_, tid, "wchan", buf, sizeof(buf));
+            if (n > 0) {
+                wchan = pool.intern(std::string_view(buf, strcspn(buf, "\n")));
+            }
+        }
+
+        snapshot.tids.push_back(tid);
+        snapshot.states.push_back(fields.state);
+        snapshot.names.push_back(cached.name);
+        snapshot.wchans.push_back(wchan);
+        snapshot.cpu_ticks.push_back(fields.cpu_ticks);
+        snapshot.start_times.push_back(fields.start_time);
+    }
+
+    // Forget threads that have exited
+    for (auto it = names_.begin(); it != names_.end();) {
+        if (snapshot.find(it->first) < 0) {
+            it = names_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return true;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,99 @@
+/// @file thread_metadata.h
+/// @brief Batched /proc/self/task reader for thread names, states and wait channels
+
+#pragma once
+
+#include "profiler_version.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+class StringPool;
+
+/// @struct ThreadMetadataSnapshot
+/// @brief Metadata of every thread of the process, one column per field
+///
+/// Rows are sorted by tid. Names and wait channels are IDs in the reader's
+/// string pool, which the snapshot keeps alive, so a snapshot of thousands of
+/// threads holds no per-thread strings.
+struct ThreadMetadataSnapshot {
+    std::shared_ptr<const StringPool> pool; ///< Holds names and wchans
+    std::vector<pid_t> tids;
+    std::vector<char> states;          ///< Single-letter scheduler state
+    std::vector<uint32_t> names;       ///< comm
+    std::vector<uint32_t> wchans;      ///< Kernel wait channel ("0" when running), empty if not collected
+    std::vector<uint64_t> cpu_ticks;   ///< utime + stime, in clock ticks
+    std::vector<uint64_t> start_times; ///< Clock ticks after boot; tells a reused tid apart
+
+    size_t size() const { return tids.size(); }
+
+    /// @brief Row of a thread, -1 if it was not listed
+    ptrdiff_t find(pid_t tid) const;
+
+    std::string_view name(size_t row) const;
+    std::string_view wchan(size_t row) const;
+
+    void clear();
+};
+
+/// @class ThreadMetadataReader
+/// @brief Collects ThreadMetadataSnapshot with a few syscalls per thread and no per-thread allocation
+///
+/// The /proc/self/task directory is opened once per process (a forked child
+/// inherits the parent's descriptor, which lists the parent's threads, so it
+/// is reopened when getpid() changes); each collect() rewinds it,
+/// lists it with getdents64(), opens each thread's files relative to it with
+/// openat() and reads them with a single pread() into a stack buffer. stat
+/// is parsed in place. A thread's comm is interned once per (tid, start
+/// time): later snapshots only compare the bytes with the cached name, and
+/// intern again when the thread was renamed or its tid reused. Names live in
+/// a pool of the reader rather than symbolNames(); once it holds more than
+/// kPoolBudget bytes the next collect() starts a fresh one, so renames and
+/// short-lived threads cannot grow it without bound. Thread-safe.
+class ThreadMetadataReader {
+public:
+    static constexpr size_t kPoolBudget = 1 << 20; ///< Bytes of names before the pool is replaced
+
+    ThreadMetadataReader();
+    ~ThreadMetadataReader();
+
+    ThreadMetadataReader(const ThreadMetadataReader&) = delete;
+    ThreadMetadataReader& operator=(const ThreadMetadataReader&) = delete;
+
+    /// @brief Read the metadata of all current threads
+    /// @param snapshot Replaced with one row per thread that could be read
+    /// @param with_wchan Also read wchan (one more open per thread)
+    /// @return false if /proc/self/task cannot be read
+    bool collect(ThreadMetadataSnapshot& snapshot, bool with_wchan = true);
+
+    /// @brief List the IDs of all current threads, sorted
+    /// @return false if /proc/self/task cannot be read
+    bool listThreads(std::vector<pid_t>& tids);
+
+private:
+    struct CachedName {
+        uint64_t start_time = 0;
+        uint32_t name = 0;
+    };
+
+    bool listLocked(std::vector<pid_t>& tids);
+
+    std::mutex mutex_;
+    int task_fd_ = -1;                            ///< /proc/self/task, opened on first use
+    pid_t task_pid_ = 0;                          ///< Process task_fd_ was opened in; a forked child reopens it
+    std::shared_ptr<StringPool> pool_;            ///< Names and wchans; shared with the snapshots
+    std::unordered_map<pid_t, CachedName> names_; ///< comm by tid (IDs in pool_), for the threads of the last collect()
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
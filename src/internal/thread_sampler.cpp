@@ -0,0 +1,284 @@
+#include "internal/thread_sampler.h"
+#include "internal/signal_unwind.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid // Not defined by glibc before 2.35
+#endif
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+std::atomic<ThreadCpuSampler*> ThreadCpuSampler::active_{nullptr};
+ThreadCpuSampler::Slot ThreadCpuSampler::slots_[ThreadCpuSampler::kMaxThreads];
+uintptr_t ThreadCpuSampler::next_generation_ = 0;
+
+namespace {
+
+constexpr int kMaxDepth = 64;
+
+// Kernel clockid encoding (include/linux/posix-timers.h)
+constexpr unsigned kCpuClockSched = 2;         ///< CPUCLOCK_SCHED: CPU time actually run
+constexpr unsigned kCpuClockPerThreadMask = 4; ///< CPUCLOCK_PERTHREAD_MASK: the ID is a tid, not a pid
+
+// CPU-time clock of any thread of this process, the kernel's
+// MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED); pthread_getcpuclockid() needs a
+// pthread_t, which threads discovered in /proc do not give us
+clockid_t threadCpuClock(pid_t tid) {
+    return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | kCpuClockPerThreadMask | kCpuClockSched);
+}
+
+} // namespace
+
+/// @brief Samples of one thread: written by its signal handler, read by the drain thread
+struct ThreadCpuSampler::Ring {
+    pid_t tid = 0;
+    timer_t timer{};
+    size_t slot = 0;
+    uintptr_t cookie = 0; ///< Slot and generation, as sent in the timer's sigval
+    std::unique_ptr<uintptr_t[]> words; ///< Records of depth followed by that many program counters
+    size_t mask = 0;
+    std::atomic<uint64_t> head{0}; ///< Words ever written (producer)
+    std::atomic<uint64_t> tail{0}; ///< Words ever consumed (consumer)
+    std::atomic<uint64_t> dropped{0};
+};
+
+ThreadCpuSampler::ThreadCpuSampler(const ThreadSamplerOptions& options) : options_(options) {
+    options_.frequency_hz = std::clamp(options_.frequency_hz, 1, 10000);
+    options_.drain_interval_ms = std::max(options_.drain_interval_ms, 1);
+    size_t words = std::max<size_t>(options_.ring_bytes_per_thread / sizeof(uintptr_t), 4 * (kMaxDepth + 1));
+    ring_words_ = 1;
+    while (ring_words_ < words) {
+        ring_words_ <<= 1;
+    }
+    signal_ = options_.signal > 0 ? options_.signal : SIGRTMIN + 5;
+}
+
+ThreadCpuSampler::~ThreadCpuSampler() {
+    if (running_) {
+        stop();
+    }
+}
+
+bool ThreadCpuSampler::start(std::string& error) {
+    if (running_) {
+        error = "thread sampler already running";
+        return false;
+    }
+    if (signal_ == SIGPROF) {
+        error = "SIGPROF is reserved for the gperftools CPU profiler";
+        return false;
+    }
+    prepareSignalUnwind();
+
+    ThreadCpuSampler* expected = nullptr;
+    if (!active_.compare_exchange_strong(expected, this)) {
+        error = "another thread sampler is running";
+        return false;
+    }
+    struct sigaction sa {};
+    sa.sa_sigaction = &ThreadCpuSampler::handleSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(signal_, &sa, nullptr) != 0) {
+        error = std::string("cannot install the sampling signal handler: ") + strerror(errno);
+        active_ = nullptr;
+        return false;
+    }
+
+    stacks_.clear();
+    dropped_ = 0;
+    threads_sampled_ = 0;
+    stop_ = false;
+    drain_tid_ = 0;
+    running_ = true;
+    drain_thread_ = std::thread([this] { run(); });
+    // Threads that exist now are sampled from the start, not from the first rescan
+    while (drain_tid_.load() == 0) {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+ParsedProfile ThreadCpuSampler::stop() {
+    ParsedProfile profile;
+    if (!running_) {
+        return profile;
+    }
+    stop_ = true;
+    drain_thread_.join();
+
+    for (auto& [thread, ring] : rings_) {
+        retire(*ring);
+    }
+    rings_.clear();
+    active_ = nullptr;
+    running_ = false;
+
+    profile.period_us = 1000000 / static_cast<uint64_t>(options_.frequency_hz);
+    profile.samples.reserve(stacks_.size());
+    for (auto& [stack, count] : stacks_) {
+        profile.samples.push_back({count, stack});
+    }
+    stacks_.clear();
+    std::ifstream maps("/proc/self/maps");
+    profile.mapped_libraries.assign(std::istreambuf_iterator<char>(maps), std::istreambuf_iterator<char>());
+    return profile;
+}
+
+void ThreadCpuSampler::run() {
+    drain_tid_ = static_cast<pid_t>(syscall(SYS_gettid));
+    scanThreads();
+    while (!stop_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.drain_interval_ms));
+        for (auto& [thread, ring] : rings_) {
+            drain(*ring);
+        }
+        scanThreads();
+    }
+}
+
+// Arm a timer for every new thread and retire the rings of exited ones
+void ThreadCpuSampler::scanThreads() {
+    ThreadMetadataSnapshot snapshot;
+    threads_.collect(snapshot, false);
+    auto listed = [&](const std::pair<pid_t, uint64_t>& thread) {
+        ptrdiff_t row = snapshot.find(thread.first);
+        return row >= 0 && snapshot.start_times[static_cast<size_t>(row)] == thread.second;
+    };
+    for (auto it = rings_.begin(); it != rings_.end();) {
+        if (!listed(it->first)) {
+            // Exited, or its tid now belongs to a newer thread
+            retire(*it->second);
+            it = rings_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (size_t row = 0; row < snapshot.size(); ++row) {
+        if (snapshot.tids[row] != drain_tid_ && rings_.count({snapshot.tids[row], snapshot.start_times[row]}) == 0) {
+            prepareSignalUnwind(); // Lets the frame-pointer walk trust the new threads' stacks
+            break;
+        }
+    }
+
+    long period_ns = 1000000000L / options_.frequency_hz;
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period_ns / 1000000000L;
+    spec.it_interval.tv_nsec = period_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    size_t free_slot = 0;
+    for (size_t row = 0; row < snapshot.size(); ++row) {
+        pid_t tid = snapshot.tids[row];
+        std::pair<pid_t, uint64_t> thread(tid, snapshot.start_times[row]);
+        if (tid == drain_tid_ || rings_.count(thread) > 0) {
+            continue;
+        }
+        while (free_slot < kMaxThreads && slots_[free_slot].ring.load() != nullptr) {
+            ++free_slot;
+        }
+        if (free_slot == kMaxThreads) {
+            break;
+        }
+        auto ring = std::make_unique<Ring>();
+        ring->tid = tid;
+        ring->slot = free_slot;
+        ring->cookie = ++next_generation_ * kMaxThreads + free_slot;
+        ring->words.reset(new uintptr_t[ring_words_]);
+        ring->mask = ring_words_ - 1;
+
+        sigevent sev{};
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = signal_;
+        sev.sigev_value.sival_ptr = reinterpret_cast<void*>(ring->cookie);
+        sev.sigev_notify_thread_id = tid;
+        if (timer_create(threadCpuClock(tid), &sev, &ring->timer) != 0) {
+            continue; // Exited since the listing
+        }
+        // Published before the first tick can fire
+        slots_[free_slot].ring.store(ring.get());
+        if (timer_settime(ring->timer, 0, &spec, nullptr) != 0) {
+            retire(*ring);
+            continue;
+        }
+        rings_.emplace(thread, std::move(ring));
+        ++threads_sampled_;
+    }
+}
+
+// Stop the thread's timer and unpublish its ring; returns once no handler can touch it
+void ThreadCpuSampler::retire(Ring& ring) {
+    // A tick already queued survives timer_delete(); it is delivered later and
+    // then finds the slot empty or holding a ring of another generation
+    timer_delete(ring.timer);
+    Slot& slot = slots_[ring.slot];
+    slot.ring.store(nullptr);
+    while (slot.users.load() > 0) {
+        std::this_thread::yield();
+    }
+    drain(ring);
+}
+
+void ThreadCpuSampler::drain(Ring& ring) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    std::vector<uintptr_t> stack;
+    while (tail < head) {
+        size_t depth = ring.words[tail & ring.mask];
+        stack.resize(depth);
+        for (size_t i = 0; i < depth; ++i) {
+            stack[i] = ring.words[(tail + 1 + i) & ring.mask];
+        }
+        if (depth > 0) {
+            ++stacks_[stack];
+        }
+        tail += 1 + depth;
+    }
+    ring.tail.store(tail, std::memory_order_release);
+    dropped_ += ring.dropped.exchange(0, std::memory_order_relaxed);
+}
+
+// Runs in the signal handler of the sampled thread: no locks, no allocation
+void ThreadCpuSampler::handleSignal(int signum, siginfo_t* info, void* context) {
+    (void)signum;
+    if (info->si_code != SI_TIMER) {
+        return;
+    }
+    int saved_errno = errno;
+    auto cookie = reinterpret_cast<uintptr_t>(info->si_value.sival_ptr);
+    Slot& slot = slots_[cookie & (kMaxThreads - 1)];
+    // Counted before the load: retire() clears the slot, then waits for users
+    slot.users.fetch_add(1);
+    Ring* ring = slot.ring.load();
+    if (ring != nullptr && ring->cookie == cookie) {
+        uintptr_t frames[kMaxDepth];
+        int depth = captureSignalStack(context, frames, kMaxDepth);
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        if (ring->mask + 1 - (head - tail) < static_cast<uint64_t>(depth) + 1) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ring->words[head & ring->mask] = static_cast<uintptr_t>(depth);
+            for (int i = 0; i < depth; ++i) {
+                ring->words[(head + 1 + i) & ring->mask] = frames[i];
+            }
+            ring->head.store(head + 1 + depth, std::memory_order_release);
+        }
+    }
+    slot.users.fetch_sub(1);
+    errno = saved_errno;
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
@@ -0,0 +1,121 @@
+/// @file thread_sampler.h
+/// @brief CPU sampler driven by one CPU-time timer per thread, with per-thread lock-free rings
+
+#pragma once
+
+#include "internal/profile_parser.h"
+#include "internal/thread_metadata.h"
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @struct ThreadSamplerOptions
+/// @brief Sampling rate and buffer limits of the per-thread sampler
+struct ThreadSamplerOptions {
+    int frequency_hz = 100;                   ///< Samples per second of each thread's own CPU time
+    size_t ring_bytes_per_thread = 64u << 10; ///< Ring size; samples are dropped while a ring is full
+    int drain_interval_ms = 50;               ///< How often rings are drained and /proc/self/task is rescanned
+    int signal = 0;                           ///< Sampling signal, 0 = SIGRTMIN + 5 (not SIGPROF: gperftools owns it)
+};
+
+/// @class ThreadCpuSampler
+/// @brief Samples every thread on ticks of its own CPU-time clock
+///
+/// gperftools arms one process-wide ITIMER_PROF, whose signal lands on
+/// whichever thread the kernel picks; with many busy cores ticks coalesce and
+/// samples are lost. Here a drain thread discovers threads in /proc/self/task
+/// and gives each one a timer_create() timer on its CPU-time clock with
+/// SIGEV_THREAD_ID, so every thread is interrupted only for its own CPU time.
+/// The timer's sigval names a slot of a static table and the generation of
+/// the ring published there: the signal handler appends the stack to the
+/// thread's single-producer ring without locks, and the drain thread folds the
+/// rings into unique stacks. timer_delete() does not take back a signal that
+/// is already queued (or pending on a thread that blocks it), so a ring is
+/// unpublished and its slot's users waited out before it is freed; a late
+/// signal then finds no ring or one of another generation, and is ignored.
+/// Threads are keyed by tid and start time, so a reused tid gets a new timer.
+/// Only one sampler runs at a time per process.
+class ThreadCpuSampler {
+public:
+    explicit ThreadCpuSampler(const ThreadSamplerOptions& options = ThreadSamplerOptions());
+
+    /// @brief Stops a running capture and discards it
+    ~ThreadCpuSampler();
+
+    ThreadCpuSampler(const ThreadCpuSampler&) = delete;
+    ThreadCpuSampler& operator=(const ThreadCpuSampler&) = delete;
+
+    /// @brief Install the signal handler (kept afterwards, idle outside captures) and start sampling
+    /// @param error Set to the reason on failure
+    /// @return false if another capture is running or the signal could not be set up
+    bool start(std::string& error);
+
+    /// @brief Stop all timers and return one sample per distinct stack
+    ///
+    /// The profile carries the sampling period and /proc/self/maps, so
+    /// encodeCpuProfile() turns it into a regular gperftools CPU profile.
+    ParsedProfile stop();
+
+    bool isRunning() const {
+        return running_;
+    }
+
+    /// @brief Samples lost to full rings so far
+    uint64_t dropped() const {
+        return dropped_;
+    }
+
+    /// @brief Threads that have been given a timer so far
+    size_t threadsSampled() const {
+        return threads_sampled_;
+    }
+
+private:
+    struct Ring;
+
+    /// @brief Where the handler looks up a ring; slots are never freed
+    struct Slot {
+        std::atomic<Ring*> ring{nullptr};
+        std::atomic<int> users{0}; ///< Handlers between loading `ring` and their last access to it
+    };
+
+    static constexpr size_t kMaxThreads = 8192; ///< Slots; threads beyond this many are not sampled
+
+    static void handleSignal(int signum, siginfo_t* info, void* context);
+    void run();
+    void scanThreads();
+    void retire(Ring& ring);
+    void drain(Ring& ring);
+
+    ThreadSamplerOptions options_;
+    int signal_ = 0;
+    size_t ring_words_ = 0; ///< Power of two
+    std::thread drain_thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<pid_t> drain_tid_{0};
+    ThreadMetadataReader threads_;                                      ///< Lists threads with their start times
+    std::map<std::pair<pid_t, uint64_t>, std::unique_ptr<Ring>> rings_; ///< By (tid, start time); drain thread only
+    std::map<std::vector<uintptr_t>, uint64_t> stacks_;                 ///< Drained stacks and their counts
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<size_t> threads_sampled_{0};
+    bool running_ = false;
+
+    static std::atomic<ThreadCpuSampler*> active_; ///< The running sampler, if any
+    static Slot slots_[kMaxThreads];               ///< Rings by the slot in their timer's sigval
+    static uintptr_t next_generation_;             ///< Written by the active sampler's drain thread only
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
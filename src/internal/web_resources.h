@@ -19,6 +19,9 @@ public:
 
     // 获取 Growth 火焰图查看器 HTML
     static std::string getGrowthSvgViewerPage();
+
+    // 获取 Canvas 交互式火焰图查看器 HTML（数据来自 /api/*/flamegraph_json）
+    static std::string getFlameGraphViewerPage();
 };
 
 PROFILER_NAMESPACE_END
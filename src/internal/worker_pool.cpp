@@ -0,0 +1,81 @@
+#include "internal/worker_pool.h"
+#include <pthread.h>
+#include <sched.h>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+WorkerPool::WorkerPool(size_t threads, size_t max_queued, const std::vector<int>& cpu_affinity,
+                       const std::string& name)
+    : max_queued_(max_queued) {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&WorkerPool::run, this, cpu_affinity, name);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool WorkerPool::submit(std::function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ || tasks_.size() >= max_queued_) {
+            return false;
+        }
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+size_t WorkerPool::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+void WorkerPool::run(const std::vector<int>& cpu_affinity, const std::string& name) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    if (!cpu_affinity.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpu_affinity) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        // Best effort: an invalid or offline CPU list leaves the inherited mask
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
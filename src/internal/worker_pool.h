@@ -0,0 +1,65 @@
+/// @file worker_pool.h
+/// @brief Fixed-size thread pool with a bounded queue for blocking handlers
+
+#pragma once
+
+#include "profiler_version.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+PROFILER_NAMESPACE_BEGIN
+
+namespace internal {
+
+/// @class WorkerPool
+/// @brief Runs submitted tasks on its own threads, in submission order
+///
+/// Used to keep multi-second profiler work (captures, Perl renders) off a web
+/// framework's event-loop threads. The queue is bounded so a request storm is
+/// refused at submission instead of growing without limit.
+class WorkerPool {
+public:
+    /// @param threads Worker threads to start (0 runs every task inline in submit())
+    /// @param max_queued Tasks that may wait for a worker; submit() fails beyond that
+    /// @param cpu_affinity CPUs the workers are pinned to (empty = inherit the process mask)
+    /// @param name Thread name shown in top/gdb (truncated to 15 characters)
+    WorkerPool(size_t threads, size_t max_queued, const std::vector<int>& cpu_affinity = {},
+               const std::string& name = "profiler-worker");
+
+    /// @brief Runs the tasks still queued, then joins the workers
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief Queue a task for a worker
+    /// @return false if the queue is full (the task is dropped)
+    bool submit(std::function<void()> task);
+
+    size_t threadCount() const {
+        return workers_.size();
+    }
+
+    /// @brief Tasks waiting for a worker
+    size_t queued() const;
+
+private:
+    void run(const std::vector<int>& cpu_affinity, const std::string& name);
+
+    size_t max_queued_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace internal
+
+PROFILER_NAMESPACE_END
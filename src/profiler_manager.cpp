@@ -1,31 +1,49 @@
 #include "profiler_manager.h"
 #include "absl/debugging/stacktrace.h"
 #include "absl/debugging/symbolize.h"
+#include "internal/cpu_timeline.h"
 #include "internal/embed_flamegraph.h"
 #include "internal/embed_pprof.h"
+#include "internal/flame_tree.h"
+#include "internal/folded_stacks.h"
+#include "internal/json_util.h"
 #include "internal/log_macros.h"
 #include "internal/log_manager.h"
+#include "internal/module_map.h"
+#include "internal/profile_merge.h"
+#include "internal/profile_parser.h"
+#include "internal/render_cache.h"
+#include "internal/signal_unwind.h"
+#include "internal/string_pool.h"
+#include "internal/symbol_bundle.h"
 #include "internal/symbolize.h"
+#include "internal/thread_metadata.h"
+#include "internal/thread_sampler.h"
+#include "internal/worker_pool.h"
 #include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cxxabi.h>
 #include <dirent.h>
 #include <dlfcn.h>
-#include <execinfo.h>
 #include <fcntl.h>
 #include <fstream>
 #include <gperftools/heap-profiler.h>
 #include <gperftools/malloc_extension.h>
 #include <gperftools/profiler.h>
 #include <iostream>
+#include <iterator>
 #include <limits.h>
 #include <signal.h>
+#include <span>
 #include <sstream>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -38,9 +56,14 @@
 PROFILER_NAMESPACE_BEGIN
 
 // Static member initialization
+std::mutex ProfilerManager::capture_mutex_;
 std::atomic<bool> ProfilerManager::capture_in_progress_{false};
-SharedStackTrace* ProfilerManager::shared_stacks_ = nullptr;
+std::atomic<int> ProfilerManager::capture_handlers_{0};
+std::vector<pid_t> ProfilerManager::unanswered_tids_;
+void* ProfilerManager::shared_stacks_ = nullptr;
+int ProfilerManager::shared_stack_depth_ = kDefaultThreadStackDepth;
 int ProfilerManager::stack_array_size_ = 0;
+const pid_t* ProfilerManager::slot_tids_ = nullptr;
 std::atomic<pid_t> ProfilerManager::excluded_tid_{0};
 std::atomic<int> ProfilerManager::completed_count_{0};
 int ProfilerManager::expected_count_ = 0;
@@ -52,7 +75,10 @@ struct sigaction ProfilerManager::old_action_;
 bool ProfilerManager::old_action_saved_ = false;
 bool ProfilerManager::enable_signal_chaining_ = false;
 
-ProfilerManager::ProfilerManager() : log_manager_(std::make_unique<internal::LogManager>()) {
+ProfilerManager::ProfilerManager()
+    : log_manager_(std::make_unique<internal::LogManager>()), module_map_(std::make_shared<internal::ModuleMap>()),
+      render_cache_(std::make_unique<internal::RenderCache>()),
+      thread_metadata_(std::make_unique<internal::ThreadMetadataReader>()) {
     // Write embedded pprof script to current directory
     writePprofScript("./pprof");
 
@@ -72,7 +98,7 @@ ProfilerManager::ProfilerManager() : log_manager_(std::make_unique<internal::Log
 
     // Initialize symbolizer
     try {
-        symbolizer_ = createSymbolizer();
+        symbolizer_ = createSymbolizer(module_map_);
     } catch (const std::exception& e) {
         PROFILER_ERROR("Failed to initialize symbolizer: {}", e.what());
         // Continue without symbolizer (will fall back to addr2line)
@@ -88,7 +114,11 @@ ProfilerManager::ProfilerManager() : log_manager_(std::make_unique<internal::Log
 }
 
 ProfilerManager::~ProfilerManager() {
-    if (profiler_states_[ProfilerType::CPU].is_running) {
+    // The warmup and detector threads use the symbolizer and module map, so they must exit first
+    stopSymbolWarmup();
+    stopStuckThreadDetector();
+
+    if (profiler_states_[ProfilerType::CPU].is_running && !thread_sampler_) {
         ProfilerStop();
     }
     if (profiler_states_[ProfilerType::HEAP].is_running) {
@@ -131,6 +161,16 @@ int ProfilerManager::getStackCaptureSignal() {
     return stack_capture_signal_;
 }
 
+void ProfilerManager::setStackUnwinder(StackUnwinder unwinder) {
+    internal::setSignalUnwindMethod(unwinder == StackUnwinder::FramePointer ? internal::UnwindMethod::FramePointer
+                                                                             : internal::UnwindMethod::Backtrace);
+}
+
+StackUnwinder ProfilerManager::getStackUnwinder() {
+    return internal::signalUnwindMethod() == internal::UnwindMethod::FramePointer ? StackUnwinder::FramePointer
+                                                                                  : StackUnwinder::Backtrace;
+}
+
 void ProfilerManager::setSignalChaining(bool enable) {
     enable_signal_chaining_ = enable;
     std::cout << "[INFO] Signal chaining " << (enable ? "enabled" : "disabled") << std::endl;
@@ -168,6 +208,10 @@ void ProfilerManager::restoreSignalHandler() {
 }
 
 bool ProfilerManager::startCPUProfiler(const std::string& output_path) {
+    return startCPUProfiler(output_path, cpu_backend_.load());
+}
+
+bool ProfilerManager::startCPUProfiler(const std::string& output_path, CpuProfilerBackend backend) {
     std::lock_guard<std::mutex> lock(mutex_);
 
     if (profiler_states_[ProfilerType::CPU].is_running) {
@@ -184,7 +228,21 @@ bool ProfilerManager::startCPUProfiler(const std::string& output_path) {
         }
     }
 
-    if (ProfilerStart(full_path.c_str())) {
+    bool started = false;
+    if (backend == CpuProfilerBackend::ThreadTimers) {
+        auto sampler = std::make_unique<internal::ThreadCpuSampler>();
+        std::string error;
+        started = sampler->start(error);
+        if (started) {
+            thread_sampler_ = std::move(sampler);
+        } else {
+            PROFILER_ERROR("Failed to start the thread timer sampler: {}", error);
+        }
+    } else {
+        started = ProfilerStart(full_path.c_str());
+    }
+
+    if (started) {
         auto now = std::chrono::system_clock::now();
         auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
 
@@ -203,7 +261,18 @@ bool ProfilerManager::stopCPUProfiler() {
         return false; // Not running
     }
 
-    ProfilerStop();
+    if (thread_sampler_) {
+        // Written in the gperftools format, so everything that reads cpu.prof keeps working
+        std::string data = internal::encodeCpuProfile(thread_sampler_->stop());
+        thread_sampler_.reset();
+        std::ofstream file(profiler_states_[ProfilerType::CPU].output_path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            PROFILER_ERROR("Failed to write profile file: {}", profiler_states_[ProfilerType::CPU].output_path);
+        }
+    } else {
+        ProfilerStop();
+    }
 
     // 不再使用 StackCollector
 
@@ -216,6 +285,14 @@ bool ProfilerManager::stopCPUProfiler() {
     return true;
 }
 
+void ProfilerManager::setCPUProfilerBackend(CpuProfilerBackend backend) {
+    cpu_backend_ = backend;
+}
+
+CpuProfilerBackend ProfilerManager::getCPUProfilerBackend() const {
+    return cpu_backend_.load();
+}
+
 bool ProfilerManager::startHeapProfiler(const std::string& output_path) {
     std::lock_guard<std::mutex> lock(mutex_);
 
@@ -284,6 +361,125 @@ bool ProfilerManager::isProfilerRunning(ProfilerType type) const {
     return profiler_states_.at(type).is_running;
 }
 
+namespace {
+
+uint64_t threadCpuNs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+} // namespace
+
+bool ProfilerManager::startSymbolWarmup(const SymbolWarmupOptions& options) {
+    std::lock_guard<std::mutex> lock(warmup_mutex_);
+    if (warmup_state_.running) {
+        PROFILER_WARNING("Symbol warmup is already running");
+        return false;
+    }
+    if (warmup_thread_.joinable()) {
+        warmup_thread_.join(); // A previous warmup that already finished
+    }
+    warmup_stop_ = false;
+    warmup_state_ = SymbolWarmupState();
+    warmup_state_.running = true;
+    warmup_thread_ = std::thread(&ProfilerManager::runSymbolWarmup, this, options);
+    return true;
+}
+
+void ProfilerManager::stopSymbolWarmup() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(warmup_mutex_);
+        warmup_stop_ = true;
+        thread = std::move(warmup_thread_);
+    }
+    warmup_cv_.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+SymbolWarmupState ProfilerManager::getSymbolWarmupState() const {
+    std::lock_guard<std::mutex> lock(warmup_mutex_);
+    return warmup_state_;
+}
+
+void ProfilerManager::runSymbolWarmup(SymbolWarmupOptions options) {
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [start]() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    };
+
+    // On Linux a thread ID passed to setpriority() affects only that thread
+    int nice_level = std::clamp(options.nice_level, 0, 19);
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), nice_level) != 0) {
+        PROFILER_WARNING("Symbol warmup: failed to set nice level {}: {}", nice_level, strerror(errno));
+    }
+    int cpu_percent = std::clamp(options.cpu_percent, 1, 100);
+    uint64_t cpu_start = threadCpuNs();
+
+    module_map_->refresh();
+    std::vector<internal::ModuleInfo> modules = module_map_->modules();
+    {
+        std::lock_guard<std::mutex> lock(warmup_mutex_);
+        warmup_state_.modules_total = modules.size();
+    }
+    PROFILER_INFO("Symbol warmup started: {} modules, nice {}, {}% CPU", modules.size(), nice_level, cpu_percent);
+
+    bool stopped = false;
+    for (const auto& module : modules) {
+        {
+            std::lock_guard<std::mutex> lock(warmup_mutex_);
+            if (warmup_stop_) {
+                stopped = true;
+                break;
+            }
+            warmup_state_.current_module = module.path;
+        }
+
+        uint64_t cpu_before = threadCpuNs();
+        if (symbolizer_) {
+            try {
+                symbolizer_->warmup({reinterpret_cast<void*>(module.start)});
+            } catch (const std::exception& e) {
+                PROFILER_DEBUG("Symbol warmup of {} failed: {}", module.path, e.what());
+            }
+        }
+        uint64_t cpu_used = threadCpuNs() - cpu_before;
+
+        // Idle long enough for this module's CPU time to fit in the budget
+        auto pause = std::chrono::nanoseconds(cpu_used * static_cast<uint64_t>(100 - cpu_percent) /
+                                              static_cast<uint64_t>(cpu_percent));
+        std::unique_lock<std::mutex> lock(warmup_mutex_);
+        warmup_state_.modules_done++;
+        warmup_state_.cpu_ms = (threadCpuNs() - cpu_start) / 1000000;
+        warmup_state_.elapsed_ms = elapsedMs();
+        if (warmup_cv_.wait_for(lock, pause, [this]() { return warmup_stop_; })) {
+            stopped = true;
+            break;
+        }
+        lock.unlock();
+        std::this_thread::yield();
+    }
+
+    SymbolWarmupState state;
+    {
+        std::lock_guard<std::mutex> lock(warmup_mutex_);
+        warmup_state_.running = false;
+        warmup_state_.finished = !stopped;
+        warmup_state_.current_module.clear();
+        warmup_state_.cpu_ms = (threadCpuNs() - cpu_start) / 1000000;
+        warmup_state_.elapsed_ms = elapsedMs();
+        state = warmup_state_;
+    }
+    PROFILER_INFO("Symbol warmup {}: {}/{} modules in {} ms ({} ms CPU)", stopped ? "stopped" : "finished",
+                  state.modules_done, state.modules_total, state.elapsed_ms, state.cpu_ms);
+}
+
 // 获取当前可执行文件的绝对路径
 std::string ProfilerManager::getExecutablePath() {
     char exe_path[PATH_MAX];
@@ -341,6 +537,37 @@ std::string ProfilerManager::generateFlameGraph(const std::string& collapsed_fil
     return svg_output;
 }
 
+std::shared_ptr<const std::string> ProfilerManager::findRenderedOutput(const std::string& data,
+                                                                       const std::string& options, std::string& etag) {
+    std::string key = internal::RenderCache::makeKey(data, options);
+    etag = internal::RenderCache::etagFor(key);
+    auto cached = render_cache_->get(key);
+    if (cached) {
+        PROFILER_DEBUG("Serving cached render {} ({} bytes)", etag, cached->size());
+    }
+    return cached;
+}
+
+void ProfilerManager::storeRenderedOutput(const std::string& data, const std::string& options,
+                                          const std::string& output) {
+    render_cache_->put(internal::RenderCache::makeKey(data, options), output);
+}
+
+void ProfilerManager::setRenderCacheBudget(size_t max_bytes) {
+    render_cache_->setMaxBytes(max_bytes);
+}
+
+RenderCacheState ProfilerManager::getRenderCacheState() const {
+    auto stats = render_cache_->stats();
+    RenderCacheState state;
+    state.entries = stats.entries;
+    state.bytes = stats.bytes;
+    state.max_bytes = stats.max_bytes;
+    state.hits = stats.hits;
+    state.misses = stats.misses;
+    return state;
+}
+
 std::string ProfilerManager::resolveSymbolWithBackward(void* address) {
     // 如果 symbolizer 不可用，返回地址
     if (!symbolizer_) {
@@ -353,41 +580,28 @@ std::string ProfilerManager::resolveSymbolWithBackward(void* address) {
         // 使用 backward-cpp 符号化地址
         std::vector<SymbolizedFrame> frames = symbolizer_->symbolize(address);
 
-        if (!frames.empty() && frames[0].function_name.find("0x") != 0) {
+        if (!frames.empty() && !frames[0].functionName().starts_with("0x")) {
             // 符号化成功，使用 -- 连接内联调用链
-            std::ostringstream result;
+            std::string result;
             for (size_t i = 0; i < frames.size(); ++i) {
                 if (i > 0) {
-                    result << "--";
+                    result += "--";
                 }
-                result << frames[i].function_name;
+                result += frames[i].functionName();
             }
-            return result.str();
+            return result;
         }
 
-        // backward-cpp失败，尝试使用 addr2line
-        // 需要计算相对地址（对于PIE可执行文件）
-        Dl_info info;
+        // backward-cpp失败，交给地址所在模块（可执行文件或 .so）的 addr2line 解析器
+        // 解析器按模块缓存，使用链接时地址（运行时地址减去 load bias）
         uintptr_t addr = reinterpret_cast<uintptr_t>(address);
-        uintptr_t relative_addr = addr;
-
-        if (dladdr(address, &info) && info.dli_fbase) {
-            // 计算相对地址
-            relative_addr = addr - reinterpret_cast<uintptr_t>(info.dli_fbase);
-        }
-
-        std::ostringstream cmd;
-        cmd << "addr2line -e /proc/self/exe -f -C 0x" << std::hex << relative_addr;
-
-        std::string output;
-        if (executeCommand(cmd.str(), output) && !output.empty()) {
-            // addr2line 输出格式: "function_name\nsource_file:line\n"
-            size_t newline_pos = output.find('\n');
-            if (newline_pos != std::string::npos) {
-                std::string symbol = output.substr(0, newline_pos);
-                if (symbol != "??" && !symbol.empty()) {
-                    return symbol;
-                }
+        module_map_->refresh();
+        internal::ModuleInfo module;
+        if (module_map_->find(addr, module)) {
+            std::vector<internal::ModuleResolver::Result> results;
+            if (module_map_->resolverFor(module)->resolve({addr - module.load_bias}, results) &&
+                !results[0].function.empty()) {
+                return results[0].function;
             }
         }
 
@@ -404,6 +618,205 @@ std::string ProfilerManager::resolveSymbolWithBackward(void* address) {
     }
 }
 
+namespace {
+
+constexpr size_t kMaxSymbolizeWorkers = 8;       ///< Upper bound of batch symbolization workers, the caller included
+constexpr size_t kSymbolizeChunkSize = 256;      ///< Addresses per work item
+constexpr size_t kSerialSymbolizeThreshold = 64; ///< Below this, handing work to the pool costs more than it saves
+
+std::string hexAddress(uintptr_t address) {
+    char buf[2 + sizeof(uintptr_t) * 2 + 1];
+    snprintf(buf, sizeof(buf), "0x%lx", static_cast<unsigned long>(address));
+    return buf;
+}
+
+// Same "--" inline-chain format as resolveSymbolWithBackward; empty if unresolved
+std::string joinInlineFrames(const std::vector<SymbolizedFrame>& frames) {
+    if (frames.empty() || frames[0].functionName().starts_with("0x")) {
+        return {};
+    }
+    std::string result(frames[0].functionName());
+    for (size_t i = 1; i < frames.size(); ++i) {
+        result += "--";
+        result += frames[i].functionName();
+    }
+    return result;
+}
+
+} // namespace
+
+internal::WorkerPool& ProfilerManager::symbolizePool() {
+    std::lock_guard<std::mutex> lock(symbolize_mutex_);
+    if (!symbolize_pool_) {
+        // The calling thread is a worker too
+        size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+        size_t threads = std::min(cpus, kMaxSymbolizeWorkers) - 1;
+        symbolize_pool_ = std::make_unique<internal::WorkerPool>(threads, kMaxSymbolizeWorkers * 2,
+                                                                 std::vector<int>{}, "profiler-symbol");
+    }
+    return *symbolize_pool_;
+}
+
+std::unique_ptr<Symbolizer> ProfilerManager::acquireBatchSymbolizer() {
+    {
+        std::lock_guard<std::mutex> lock(symbolize_mutex_);
+        if (!idle_symbolizers_.empty()) {
+            std::unique_ptr<Symbolizer> symbolizer = std::move(idle_symbolizers_.back());
+            idle_symbolizers_.pop_back();
+            return symbolizer;
+        }
+    }
+    try {
+        return createSymbolizer(module_map_);
+    } catch (const std::exception&) {
+        return nullptr; // Everything goes to the module resolvers
+    }
+}
+
+void ProfilerManager::releaseBatchSymbolizer(std::unique_ptr<Symbolizer> symbolizer) {
+    if (symbolizer) {
+        std::lock_guard<std::mutex> lock(symbolize_mutex_);
+        idle_symbolizers_.push_back(std::move(symbolizer));
+    }
+}
+
+std::vector<std::string> ProfilerManager::resolveSymbolsBatch(const std::vector<uintptr_t>& addresses) {
+    // pprof sends every PC of every location; resolve each distinct one once
+    std::vector<uintptr_t> unique_addrs(addresses);
+    std::sort(unique_addrs.begin(), unique_addrs.end());
+    unique_addrs.erase(std::unique(unique_addrs.begin(), unique_addrs.end()), unique_addrs.end());
+
+    // Partition by module so that each chunk's fallback lookups go to a single
+    // module resolver. Addresses outside every module stay unresolved (hex).
+    struct WorkItem {
+        internal::ModuleInfo module;
+        bool has_module = false;
+        std::vector<size_t> indexes; ///< Positions in unique_addrs
+    };
+    module_map_->refresh();
+    std::map<uintptr_t, WorkItem> by_module;
+    internal::ModuleInfo module;
+    for (size_t i = 0; i < unique_addrs.size(); ++i) {
+        bool found = module_map_->find(unique_addrs[i], module);
+        auto [it, inserted] = by_module.try_emplace(found ? module.start : 0);
+        if (inserted && found) {
+            it->second.module = module;
+            it->second.has_module = true;
+        }
+        it->second.indexes.push_back(i);
+    }
+
+    std::vector<WorkItem> work;
+    for (auto& [start, group] : by_module) {
+        for (size_t begin = 0; begin < group.indexes.size(); begin += kSymbolizeChunkSize) {
+            size_t end = std::min(group.indexes.size(), begin + kSymbolizeChunkSize);
+            work.push_back(WorkItem{group.module, group.has_module,
+                                    std::vector<size_t>(group.indexes.begin() + begin, group.indexes.begin() + end)});
+        }
+    }
+
+    std::vector<std::string> symbols(unique_addrs.size());
+    std::atomic<size_t> next_item{0};
+
+    // Each worker writes only the slots of its own work items, so no locking is
+    // needed on symbols. backward's TraceResolver is stateful, hence one
+    // symbolizer per worker instead of sharing symbolizer_; they are kept
+    // between requests so their loaded debug info is reused.
+    auto worker = [&]() {
+        std::unique_ptr<Symbolizer> symbolizer = acquireBatchSymbolizer();
+
+        std::vector<size_t> unresolved;
+        for (size_t w = next_item.fetch_add(1); w < work.size(); w = next_item.fetch_add(1)) {
+            const WorkItem& item = work[w];
+            unresolved.clear();
+            for (size_t index : item.indexes) {
+                std::string name;
+                if (symbolizer) {
+                    try {
+                        name = joinInlineFrames(symbolizer->symbolize(reinterpret_cast<void*>(unique_addrs[index])));
+                    } catch (const std::exception&) {
+                    }
+                }
+                if (name.empty()) {
+                    unresolved.push_back(index);
+                } else {
+                    symbols[index] = std::move(name);
+                }
+            }
+            if (unresolved.empty()) {
+                continue;
+            }
+
+            // One round trip to the module's cached addr2line for the whole chunk
+            std::vector<internal::ModuleResolver::Result> results;
+            if (item.has_module) {
+                std::vector<uintptr_t> link_addrs;
+                link_addrs.reserve(unresolved.size());
+                for (size_t index : unresolved) {
+                    link_addrs.push_back(unique_addrs[index] - item.module.load_bias);
+                }
+                module_map_->resolverFor(item.module)->resolve(link_addrs, results);
+            }
+            for (size_t i = 0; i < unresolved.size(); ++i) {
+                size_t index = unresolved[i];
+                if (i < results.size() && !results[i].function.empty()) {
+                    symbols[index] = std::move(results[i].function);
+                } else {
+                    symbols[index] = hexAddress(unique_addrs[index]);
+                }
+            }
+        }
+        releaseBatchSymbolizer(std::move(symbolizer));
+    };
+
+    size_t worker_count = 1;
+    if (unique_addrs.size() >= kSerialSymbolizeThreshold) {
+        worker_count = std::min({static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())),
+                                 kMaxSymbolizeWorkers, work.size()});
+    }
+
+    if (worker_count <= 1) {
+        worker();
+    } else {
+        // Helpers share the work items with the caller, so one that finds the
+        // queue full or starts late only has less (or nothing) left to do
+        internal::WorkerPool& pool = symbolizePool();
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        size_t pending = 0;
+        for (size_t i = 1; i < worker_count; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                ++pending;
+            }
+            bool queued = pool.submit([&] {
+                worker();
+                std::lock_guard<std::mutex> lock(done_mutex);
+                --pending;
+                done_cv.notify_one();
+            });
+            if (!queued) {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                --pending;
+            }
+        }
+        worker();
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&] { return pending == 0; });
+    }
+
+    PROFILER_DEBUG("Batch symbolized {} addresses ({} unique, {} modules, {} workers)", addresses.size(),
+                   unique_addrs.size(), by_module.size(), worker_count);
+
+    std::vector<std::string> result;
+    result.reserve(addresses.size());
+    for (uintptr_t address : addresses) {
+        auto it = std::lower_bound(unique_addrs.begin(), unique_addrs.end(), address);
+        result.push_back(symbols[it - unique_addrs.begin()]);
+    }
+    return result;
+}
+
 std::string ProfilerManager::analyzeCPUProfile(int duration, const std::string& output_type) {
     std::string profile_path = profile_dir_ + "/cpu_analyze.prof";
 
@@ -456,39 +869,12 @@ std::string ProfilerManager::analyzeCPUProfile(int duration, const std::string&
         // PATH 1: Generate FlameGraph using Brendan Gregg's tool
         PROFILER_INFO("Generating FlameGraph output...");
 
-        // Step 5a: Generate collapsed format using pprof --collapsed
+        // Step 5a: Fold the profile in-process; unlike pprof --collapsed this
+        // expands inlined calls from DWARF into their own frames
         std::string collapsed_file = "/tmp/cpu_collapsed.prof";
-        std::ostringstream collapsed_cmd;
-        collapsed_cmd << "./pprof --collapsed " << exe_path << " " << profile_path << " > " << collapsed_file
-                      << " 2>&1";
-
-        PROFILER_DEBUG("Running collapsed command: {}", collapsed_cmd.str());
-
-        std::string collapsed_output;
-        if (!executeCommand(collapsed_cmd.str(), collapsed_output)) {
-            return R"({"error": "Failed to execute pprof --collapsed command"})";
-        }
-
-        // Check if collapsed file was created and has content
-        std::ifstream collapsed_in(collapsed_file);
-        if (!collapsed_in.is_open()) {
-            return R"({"error": "Failed to create collapsed file"})";
-        }
-
-        // Verify file has actual data (not just "Using local file..." messages)
-        std::string line;
-        bool has_data = false;
-        while (std::getline(collapsed_in, line)) {
-            if (!line.empty() && line[0] != '#') {
-                has_data = true;
-                break;
-            }
-        }
-        collapsed_in.close();
-
-        if (!has_data) {
-            PROFILER_WARNING("pprof --collapsed produced no data");
-            return R"({"error": "pprof --collapsed produced no data"})";
+        if (!writeCollapsedStacks(ProfilerType::CPU, profile_path, collapsed_file)) {
+            PROFILER_WARNING("Folding the profile produced no data");
+            return R"({"error": "Failed to generate collapsed stacks"})";
         }
 
         PROFILER_INFO("Collapsed stacks written to {}", collapsed_file);
@@ -688,39 +1074,12 @@ std::string ProfilerManager::analyzeHeapProfile(int duration, const std::string&
         // PATH 1: Generate FlameGraph using Brendan Gregg's tool
         PROFILER_INFO("Generating Heap FlameGraph...");
 
-        // Step 9a: Generate collapsed format using pprof --collapsed
+        // Step 9a: Fold the profile in-process; unlike pprof --collapsed this
+        // expands inlined calls from DWARF into their own frames
         std::string collapsed_file = "/tmp/heap_collapsed.prof";
-        std::ostringstream collapsed_cmd;
-        collapsed_cmd << "./pprof --collapsed " << exe_path << " " << latest_heap_file << " > " << collapsed_file
-                      << " 2>&1";
-
-        PROFILER_DEBUG("Running collapsed command: {}", collapsed_cmd.str());
-
-        std::string collapsed_output;
-        if (!executeCommand(collapsed_cmd.str(), collapsed_output)) {
-            return R"({"error": "Failed to execute pprof --collapsed command"})";
-        }
-
-        // Check if collapsed file was created and has content
-        std::ifstream collapsed_in(collapsed_file);
-        if (!collapsed_in.is_open()) {
-            return R"({"error": "Failed to create collapsed file"})";
-        }
-
-        // Verify file has actual data (not just "Using local file..." messages)
-        std::string line;
-        bool has_data = false;
-        while (std::getline(collapsed_in, line)) {
-            if (!line.empty() && line[0] != '#') {
-                has_data = true;
-                break;
-            }
-        }
-        collapsed_in.close();
-
-        if (!has_data) {
-            PROFILER_WARNING("pprof --collapsed produced no data");
-            return R"({"error": "pprof --collapsed produced no data"})";
+        if (!writeCollapsedStacks(ProfilerType::HEAP, latest_heap_file, collapsed_file)) {
+            PROFILER_WARNING("Folding the profile produced no data");
+            return R"({"error": "Failed to generate collapsed stacks"})";
         }
 
         PROFILER_INFO("Collapsed stacks written to {}", collapsed_file);
@@ -839,11 +1198,14 @@ std::string ProfilerManager::getRawCPUProfile(int seconds) {
     // Stop any existing CPU profiler first
     if (profiler_states_[ProfilerType::CPU].is_running) {
         PROFILER_INFO("Stopping existing CPU profiler...");
-        ProfilerStop();
-        profiler_states_[ProfilerType::CPU].is_running = false;
+        stopCPUProfiler();
         usleep(100000); // 100ms to ensure file is written
     }
 
+    if (cpu_backend_.load() == CpuProfilerBackend::ThreadTimers) {
+        return captureThreadTimerProfile(seconds);
+    }
+
     // Start CPU profiler
     PROFILER_INFO("Starting CPU profiler for {} seconds...", seconds);
     if (!ProfilerStart(profile_path.c_str())) {
@@ -895,6 +1257,31 @@ std::string ProfilerManager::getRawCPUProfile(int seconds) {
     return profile_data;
 }
 
+std::string ProfilerManager::captureThreadTimerProfile(int seconds) {
+    internal::ThreadCpuSampler sampler;
+    std::string error;
+    PROFILER_INFO("Starting thread timer sampler for {} seconds...", seconds);
+    if (!sampler.start(error)) {
+        PROFILER_ERROR("Failed to start the thread timer sampler: {}", error);
+        return "";
+    }
+
+    auto now = std::chrono::system_clock::now();
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    profiler_states_[ProfilerType::CPU] = ProfilerState{true, "", static_cast<uint64_t>(timestamp), 0};
+
+    sleep(seconds);
+
+    internal::ParsedProfile profile = sampler.stop();
+    now = std::chrono::system_clock::now();
+    timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    profiler_states_[ProfilerType::CPU].is_running = false;
+    profiler_states_[ProfilerType::CPU].duration = timestamp - profiler_states_[ProfilerType::CPU].start_time;
+
+    PROFILER_INFO("Thread timer sampler: {} threads, {} samples dropped", sampler.threadsSampled(), sampler.dropped());
+    return internal::encodeCpuProfile(profile);
+}
+
 std::string ProfilerManager::getRawHeapSample() {
     // Get heap sample from tcmalloc
     // MallocExtensionWriter is typedef'd as std::string
@@ -929,128 +1316,341 @@ std::string ProfilerManager::getRawHeapGrowthStacks() {
     return heap_growth_stacks;
 }
 
-std::string ProfilerManager::getThreadStacks() {
-    std::ostringstream result;
+std::vector<uint32_t> ProfilerManager::resolveFrameName(uintptr_t address, internal::NameScope& scope) {
+    std::vector<uint32_t> names;
+    if (symbolizer_) {
+        try {
+            std::vector<SymbolizedFrame> frames = symbolizer_->symbolize(reinterpret_cast<void*>(address));
+            if (!frames.empty() && !frames[0].functionName().starts_with("0x")) {
+                // flamegraph.pl convention: "_[i]" marks a frame that was inlined into its caller
+                for (const auto& frame : frames) {
+                    names.push_back(frame.is_inlined ? scope.intern(std::string(frame.functionName()) + "_[i]")
+                                                     : frame.function_id);
+                }
+                return names;
+            }
+        } catch (const std::exception& e) {
+            PROFILER_DEBUG("Symbolizer failed for 0x{:x}: {}", address, e.what());
+        }
+    }
 
-    // Open /proc/self/task directory to list all threads
-    DIR* task_dir = opendir("/proc/self/task");
-    if (!task_dir) {
-        PROFILER_ERROR("Failed to open /proc/self/task");
+    names.push_back(scope.intern(hexAddress(address)));
+    return names;
+}
+
+bool ProfilerManager::parseProfileData(ProfilerType type, const std::string& data, internal::ParsedProfile& profile) {
+    if (type == ProfilerType::CPU) {
+        if (!internal::parseCpuProfile(data, profile)) {
+            PROFILER_ERROR("Failed to parse CPU profile ({} bytes)", data.size());
+            return false;
+        }
+    } else if (!internal::parseHeapProfile(data, profile)) {
+        PROFILER_ERROR("Failed to parse heap profile ({} bytes)", data.size());
+        return false;
+    }
+    return true;
+}
+
+bool ProfilerManager::foldProfileData(ProfilerType type, const std::string& data,
+                                      std::map<std::string, uint64_t>& folded) {
+    internal::ParsedProfile profile;
+    if (!parseProfileData(type, data, profile)) {
+        return false;
+    }
+
+    folded = internal::foldProfile(
+        profile, [this](uintptr_t address, internal::NameScope& scope) { return resolveFrameName(address, scope); });
+    PROFILER_INFO("Folded {} samples into {} distinct stacks", profile.samples.size(), folded.size());
+    return !folded.empty();
+}
+
+std::string ProfilerManager::collectProfileData(ProfilerType type, int seconds) {
+    if (type == ProfilerType::CPU) {
+        return getRawCPUProfile(seconds);
+    }
+    return type == ProfilerType::HEAP ? getRawHeapSample() : getRawHeapGrowthStacks();
+}
+
+bool ProfilerManager::collectFoldedStacks(ProfilerType type, int seconds, std::map<std::string, uint64_t>& folded) {
+    std::string data = collectProfileData(type, seconds);
+    if (data.empty()) {
+        return false;
+    }
+    return foldProfileData(type, data, folded);
+}
+
+std::string ProfilerManager::flameGraphJson(const internal::ParsedProfile& profile, const std::string& type,
+                                            const std::string& unit) {
+    internal::NameScope scope;
+    internal::FlameTree tree;
+    internal::foldProfileIds(
+        profile, [this](uintptr_t address, internal::NameScope& names) { return resolveFrameName(address, names); },
+        scope, [&](std::span<const uint32_t> frames, uint64_t value) { tree.add(frames, value, scope); });
+    PROFILER_INFO("Built a flame graph of {} samples with {} nodes", profile.samples.size(), tree.nodes().size());
+    return tree.total() > 0 ? tree.toJson(type, unit) : "";
+}
+
+bool ProfilerManager::writeCollapsedStacks(ProfilerType type, const std::string& profile_path,
+                                           const std::string& collapsed_file) {
+    std::ifstream in(profile_path, std::ios::binary);
+    if (!in.is_open()) {
+        PROFILER_ERROR("Failed to open profile file: {}", profile_path);
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    internal::FoldedStacks folded;
+    if (!foldProfileData(type, data, folded)) {
+        return false;
+    }
+
+    std::ofstream out(collapsed_file, std::ios::binary | std::ios::trunc);
+    out << internal::formatFoldedStacks(folded);
+    return static_cast<bool>(out);
+}
+
+std::string ProfilerManager::getFoldedCPUProfile(int seconds) {
+    internal::FoldedStacks folded;
+    if (!collectFoldedStacks(ProfilerType::CPU, seconds, folded)) {
         return "";
     }
+    return internal::formatFoldedStacks(folded);
+}
 
-    result << "Thread Stacks Snapshot\n";
-    result << "======================\n\n";
+std::string ProfilerManager::getFoldedHeapSample() {
+    internal::FoldedStacks folded;
+    if (!collectFoldedStacks(ProfilerType::HEAP, 0, folded)) {
+        return "";
+    }
+    return internal::formatFoldedStacks(folded);
+}
 
-    // Iterate through all thread directories
-    struct dirent* entry;
-    int thread_count = 0;
+std::string ProfilerManager::getFoldedHeapGrowthStacks() {
+    internal::FoldedStacks folded;
+    if (!collectFoldedStacks(ProfilerType::HEAP_GROWTH, 0, folded)) {
+        return "";
+    }
+    return internal::formatFoldedStacks(folded);
+}
 
-    while ((entry = readdir(task_dir)) != nullptr) {
-        // Skip "." and ".." entries
-        if (entry->d_name[0] == '.') {
-            continue;
-        }
+std::string ProfilerManager::getCPUFlameGraphJson(int seconds) {
+    std::string data = collectProfileData(ProfilerType::CPU, seconds);
+    internal::ParsedProfile profile;
+    if (data.empty() || !parseProfileData(ProfilerType::CPU, data, profile)) {
+        return "";
+    }
+    return flameGraphJson(profile, "cpu", "samples");
+}
 
-        // Get thread ID
-        pid_t tid = atoi(entry->d_name);
-        if (tid == 0) {
-            continue;
-        }
+std::string ProfilerManager::getHeapFlameGraphJson() {
+    std::string data = collectProfileData(ProfilerType::HEAP, 0);
+    internal::ParsedProfile profile;
+    if (data.empty() || !parseProfileData(ProfilerType::HEAP, data, profile)) {
+        return "";
+    }
+    return flameGraphJson(profile, "heap", "bytes");
+}
 
-        thread_count++;
-
-        result << "Thread " << tid << ":\n";
-
-        // Read thread stat to get state and name
-        std::string stat_file = std::string("/proc/self/task/") + entry->d_name + "/stat";
-        std::ifstream stat_stream(stat_file);
-
-        if (stat_stream.is_open()) {
-            std::string line;
-            if (std::getline(stat_stream, line)) {
-                // Parse stat file (format: pid (comm) state ...)
-                size_t open_paren = line.find('(');
-                size_t close_paren = line.find(')', open_paren);
-
-                if (open_paren != std::string::npos && close_paren != std::string::npos) {
-                    std::string name = line.substr(open_paren + 1, close_paren - open_paren - 1);
-
-                    // Get state character (after close_paren + 2)
-                    if (close_paren + 2 < line.length()) {
-                        char state = line[close_paren + 2];
-
-                        // Convert state to readable format
-                        const char* state_str = "Unknown";
-                        switch (state) {
-                        case 'R':
-                            state_str = "Running";
-                            break;
-                        case 'S':
-                            state_str = "Sleeping";
-                            break;
-                        case 'D':
-                            state_str = "Disk sleep";
-                            break;
-                        case 'Z':
-                            state_str = "Zombie";
-                            break;
-                        case 'T':
-                            state_str = "Stopped";
-                            break;
-                        case 't':
-                            state_str = "Tracing stop";
-                            break;
-                        case 'X':
-                            state_str = "Dead";
-                            break;
-                        case 'x':
-                            state_str = "Dead";
-                            break;
-                        case 'K':
-                            state_str = "Wakekill";
-                            break;
-                        case 'W':
-                            state_str = "Waking";
-                            break;
-                        case 'P':
-                            state_str = "Parked";
-                            break;
-                        }
-
-                        result << "  Name: " << name << "\n";
-                        result << "  State: " << state_str << " (" << state << ")\n";
-                    }
-                }
-            }
-            stat_stream.close();
-        }
+std::string ProfilerManager::getHeapGrowthFlameGraphJson() {
+    std::string data = collectProfileData(ProfilerType::HEAP_GROWTH, 0);
+    internal::ParsedProfile profile;
+    if (data.empty() || !parseProfileData(ProfilerType::HEAP_GROWTH, data, profile)) {
+        return "";
+    }
+    return flameGraphJson(profile, "growth", "bytes");
+}
 
-        // Try to read wchan (what thread is waiting on)
-        std::string wchan_file = std::string("/proc/self/task/") + entry->d_name + "/wchan";
-        std::ifstream wchan_stream(wchan_file);
+std::string ProfilerManager::getCPUTimelineTrace(int seconds) {
+    if (seconds < 1 || seconds > 300) {
+        PROFILER_ERROR("Invalid seconds parameter: {}. Must be between 1 and 300.", seconds);
+        return "";
+    }
 
-        if (wchan_stream.is_open()) {
-            std::string wchan;
-            if (std::getline(wchan_stream, wchan) && !wchan.empty()) {
-                result << "  Waiting in: " << wchan << "\n";
-            }
-            wchan_stream.close();
+    internal::TimelineSampler sampler;
+    std::string error;
+    if (!sampler.start(error)) {
+        PROFILER_ERROR("Failed to start CPU timeline: {}", error);
+        return "";
+    }
+    PROFILER_INFO("Recording CPU timeline for {} seconds...", seconds);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    auto timeline = std::make_shared<const internal::CpuTimeline>(sampler.stop());
+    PROFILER_INFO("CPU timeline: {} samples of {} threads, {} dropped", timeline->samples.size(),
+                  timeline->thread_names.size(), timeline->dropped);
+    if (timeline->samples.empty()) {
+        return "";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(timeline_mutex_);
+        last_timeline_ = timeline;
+    }
+    return internal::formatChromeTrace(
+        *timeline, [this](uintptr_t address, internal::NameScope& scope) { return resolveFrameName(address, scope); });
+}
+
+bool ProfilerManager::hasCPUTimeline() const {
+    std::lock_guard<std::mutex> lock(timeline_mutex_);
+    return last_timeline_ != nullptr;
+}
+
+bool ProfilerManager::timelineSamples(double from_ms, double to_ms, internal::ParsedProfile& profile) {
+    std::shared_ptr<const internal::CpuTimeline> timeline;
+    {
+        std::lock_guard<std::mutex> lock(timeline_mutex_);
+        timeline = last_timeline_;
+    }
+    if (!timeline) {
+        return false;
+    }
+
+    auto from_ns = static_cast<uint64_t>(std::max(0.0, from_ms) * 1e6);
+    uint64_t to_ns = to_ms < 0 ? UINT64_MAX : static_cast<uint64_t>(to_ms * 1e6);
+    profile = internal::timelineProfile(*timeline, from_ns, to_ns);
+    return true;
+}
+
+bool ProfilerManager::foldTimeline(double from_ms, double to_ms, std::map<std::string, uint64_t>& folded) {
+    internal::ParsedProfile profile;
+    if (!timelineSamples(from_ms, to_ms, profile)) {
+        return false;
+    }
+    folded = internal::foldProfile(
+        profile, [this](uintptr_t address, internal::NameScope& scope) { return resolveFrameName(address, scope); });
+    PROFILER_INFO("Folded {} timeline samples in [{}, {}) ms into {} distinct stacks", profile.samples.size(),
+                  from_ms, to_ms, folded.size());
+    return !folded.empty();
+}
+
+std::string ProfilerManager::getTimelineFolded(double from_ms, double to_ms) {
+    internal::FoldedStacks folded;
+    if (!foldTimeline(from_ms, to_ms, folded)) {
+        return "";
+    }
+    return internal::formatFoldedStacks(folded);
+}
+
+std::string ProfilerManager::getTimelineFlameGraphJson(double from_ms, double to_ms) {
+    internal::ParsedProfile profile;
+    if (!timelineSamples(from_ms, to_ms, profile)) {
+        return "";
+    }
+    return flameGraphJson(profile, "cpu", "samples");
+}
+
+std::string ProfilerManager::getThreadStacks() {
+    internal::ThreadMetadataSnapshot threads;
+    if (!thread_metadata_->collect(threads)) {
+        PROFILER_ERROR("Failed to open /proc/self/task");
+        return "";
+    }
+
+    std::string result;
+    result.reserve(64 + threads.size() * 96);
+    result += "Thread Stacks Snapshot\n";
+    result += "======================\n\n";
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        // Convert state to readable format
+        const char* state_str = "Unknown";
+        switch (threads.states[i]) {
+        case 'R':
+            state_str = "Running";
+            break;
+        case 'S':
+            state_str = "Sleeping";
+            break;
+        case 'D':
+            state_str = "Disk sleep";
+            break;
+        case 'Z':
+            state_str = "Zombie";
+            break;
+        case 'T':
+            state_str = "Stopped";
+            break;
+        case 't':
+            state_str = "Tracing stop";
+            break;
+        case 'X':
+            state_str = "Dead";
+            break;
+        case 'x':
+            state_str = "Dead";
+            break;
+        case 'K':
+            state_str = "Wakekill";
+            break;
+        case 'W':
+            state_str = "Waking";
+            break;
+        case 'P':
+            state_str = "Parked";
+            break;
         }
 
-        result << "\n";
+        result += "Thread ";
+        result += std::to_string(threads.tids[i]);
+        result += ":\n  Name: ";
+        result += threads.name(i);
+        result += "\n  State: ";
+        result += state_str;
+        result += " (";
+        result += threads.states[i];
+        result += ")\n";
+        // What the thread is waiting on
+        std::string_view wchan = threads.wchan(i);
+        if (!wchan.empty()) {
+            result += "  Waiting in: ";
+            result += wchan;
+            result += "\n";
+        }
+        result += "\n";
     }
 
-    closedir(task_dir);
+    result += "Total threads: " + std::to_string(threads.size()) + "\n";
+    PROFILER_INFO("Thread stacks collected, size: {} bytes", result.size());
+
+    return result;
+}
+
+namespace {
 
-    result << "Total threads: " << thread_count << "\n";
+// Capture one more frame than the slot keeps: if it is filled, the stack was
+// deeper and its outermost slot becomes the truncation marker
+template <int MaxDepth>
+void captureIntoSlot(BasicSharedStackTrace<MaxDepth>& slot, pid_t tid, void* context) {
+    static_assert(MaxDepth + 1 <= internal::kMaxSignalStackDepth, "deeper than captureSignalStack() unwinds");
+    // Starts at the interrupted instruction, not in this handler
+    auto* out = reinterpret_cast<uintptr_t*>(slot.addresses);
+    int depth = internal::captureSignalStack(context, out, MaxDepth + 1);
+    if (depth > MaxDepth) {
+        slot.addresses[MaxDepth] = reinterpret_cast<void*>(kTruncatedStackFrame);
+    }
 
-    std::string output = result.str();
-    PROFILER_INFO("Thread stacks collected, size: {} bytes", output.size());
+    // Store metadata
+    slot.tid = tid;
+    slot.depth = depth;
 
-    return output;
+    // Mark as ready
+    slot.ready.store(true, std::memory_order_release);
 }
 
+// Whether `signum` is pending on the thread itself (SigPnd in its status file)
+bool signalPending(pid_t tid, int signum) {
+    std::ifstream status("/proc/self/task/" + std::to_string(tid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 7, "SigPnd:") == 0) {
+            uint64_t mask = std::strtoull(line.c_str() + 7, nullptr, 16);
+            return signum >= 1 && signum <= 64 && ((mask >> (signum - 1)) & 1) != 0;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
 // Signal handler for capturing stack traces (signal-safe)
 void ProfilerManager::signalHandler(int signum, siginfo_t* info, void* context) {
     // Check if this is our configured signal
@@ -1062,8 +1662,11 @@ void ProfilerManager::signalHandler(int signum, siginfo_t* info, void* context)
         return;
     }
 
-    // Check if we should capture
-    if (!capture_in_progress_.load(std::memory_order_relaxed)) {
+    // Counted before the flag is checked: the capturing thread clears the flag,
+    // then waits for this count to drop before it frees the slots
+    capture_handlers_.fetch_add(1);
+    if (!capture_in_progress_.load()) {
+        capture_handlers_.fetch_sub(1);
         // If signal chaining is enabled, call the old handler
         if (enable_signal_chaining_ && old_action_saved_ && old_action_.sa_sigaction) {
             old_action_.sa_sigaction(signum, info, context);
@@ -1071,110 +1674,124 @@ void ProfilerManager::signalHandler(int signum, siginfo_t* info, void* context)
         return;
     }
 
-    // Check shared memory
-    if (!shared_stacks_) {
-        return;
-    }
-
     // Get current thread ID
     pid_t tid = gettid();
 
-    // Boundary check: skip if thread ID exceeds array size
-    if (tid >= stack_array_size_) {
-        return;
-    }
-
-    // Skip excluded thread (the one handling the HTTP request)
+    // Find this thread's slot: slot_tids_ is sorted, so a binary search (no locks, no allocation)
+    const pid_t* slot_end = slot_tids_ + stack_array_size_;
+    const pid_t* slot_tid = std::lower_bound(slot_tids_, slot_end, tid);
+    // Skip threads started after the listing and the excluded one (handling the HTTP request)
     pid_t excluded = excluded_tid_.load(std::memory_order_relaxed);
-    if (excluded != 0 && tid == excluded) {
-        return;
-    }
-
-    // Use tid directly as array index
-    int depth = backtrace(shared_stacks_[tid].addresses, 64);
-
-    // Store metadata
-    shared_stacks_[tid].tid = tid;
-    shared_stacks_[tid].depth = depth;
-
-    // Mark as ready
-    shared_stacks_[tid].ready.store(true, std::memory_order_release);
+    if (slot_tid != slot_end && *slot_tid == tid && tid != excluded) {
+        size_t slot = static_cast<size_t>(slot_tid - slot_tids_);
+        switch (shared_stack_depth_) {
+        case 32:
+            captureIntoSlot(static_cast<BasicSharedStackTrace<32>*>(shared_stacks_)[slot], tid, context);
+            break;
+        case 128:
+            captureIntoSlot(static_cast<BasicSharedStackTrace<128>*>(shared_stacks_)[slot], tid, context);
+            break;
+        case 256:
+            captureIntoSlot(static_cast<BasicSharedStackTrace<256>*>(shared_stacks_)[slot], tid, context);
+            break;
+        default:
+            captureIntoSlot(static_cast<SharedStackTrace*>(shared_stacks_)[slot], tid, context);
+            break;
+        }
 
-    // Increment completed counter
-    completed_count_.fetch_add(1, std::memory_order_release);
+        // Increment completed counter
+        completed_count_.fetch_add(1, std::memory_order_release);
+    }
+    capture_handlers_.fetch_sub(1);
 
     // Note: We don't call old handler here to avoid interfering with stack capture
     // If signal chaining is needed, the user should use a different signal
     (void)info;
-    (void)context;
 }
 
-std::string ProfilerManager::symbolizeAddress(void* addr) {
+void ProfilerManager::waitForCaptureHandlers() {
+    while (capture_handlers_.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+uint32_t ProfilerManager::symbolizeAddressId(void* addr, internal::NameScope& scope) {
+    internal::StringPool& pool = internal::symbolNames();
+    if (reinterpret_cast<uintptr_t>(addr) == kTruncatedStackFrame) {
+        return pool.intern("[truncated]");
+    }
+
     // Try to symbolize using abseil
     char symbol_buf[1024];
     if (absl::Symbolize(addr, symbol_buf, sizeof(symbol_buf))) {
-        return std::string(symbol_buf);
+        return pool.intern(symbol_buf);
     }
 
     // Fallback to backward-cpp
-    return resolveSymbolWithBackward(addr);
+    std::string symbolized = resolveSymbolWithBackward(addr);
+    if (symbolized.empty() || symbolized[0] == '0') {
+        return scope.intern(hexAddress(reinterpret_cast<uintptr_t>(addr)));
+    }
+    return pool.intern(symbolized);
 }
 
-std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
-    std::vector<ThreadStackTrace> result;
+template <int MaxDepth>
+std::vector<BasicThreadStackTrace<MaxDepth>> ProfilerManager::captureAllThreadStacks() {
+    using Slot = BasicSharedStackTrace<MaxDepth>;
+    std::vector<BasicThreadStackTrace<MaxDepth>> result;
+    // HTTP requests and the stuck-thread detector may capture at the same time
+    std::lock_guard<std::mutex> capture_lock(capture_mutex_);
 
     // Lazily install signal handler on first use
     installSignalHandler();
 
-    // 1. Read all thread IDs and find maximum
+    // 1. Read all thread IDs (sorted, so the handler can find its slot by binary search)
     std::vector<pid_t> tids;
-    pid_t max_tid = 0;
-    DIR* task_dir = opendir("/proc/self/task");
-    if (!task_dir) {
+    if (!thread_metadata_->listThreads(tids) || tids.empty()) {
         PROFILER_ERROR("Failed to open /proc/self/task");
         return result;
     }
 
-    struct dirent* entry;
-    while ((entry = readdir(task_dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        pid_t tid = atoi(entry->d_name);
-        if (tid > 0) {
-            tids.push_back(tid);
-            if (tid > max_tid) {
-                max_tid = tid;
-            }
+    PROFILER_DEBUG("Found {} threads", tids.size());
+
+    // A thread that did not answer an earlier capture blocks the signal: it is
+    // skipped (no slot, no signal) for as long as that signal is still pending
+    std::vector<pid_t> still_unanswered;
+    for (pid_t tid : unanswered_tids_) {
+        auto it = std::lower_bound(tids.begin(), tids.end(), tid);
+        if (it != tids.end() && *it == tid && signalPending(tid, stack_capture_signal_)) {
+            tids.erase(it);
+            still_unanswered.push_back(tid);
         }
     }
-    closedir(task_dir);
+    unanswered_tids_.swap(still_unanswered);
 
-    PROFILER_INFO("Found {} threads, max_tid = {}", tids.size(), max_tid);
+    // Loads libgcc_s for backtrace() and snapshots the stacks the frame-pointer walk may read
+    internal::prepareSignalUnwind();
 
-    // 2. Allocate array based on max_tid (tid as direct index)
-    int array_size = max_tid + 1;
-    size_t shared_size = sizeof(SharedStackTrace) * array_size;
+    // 2. One slot per listed thread: the cost follows the thread count, not the largest tid.
+    //    The sorted tids the handler searches live in the same mapping, after the slots, so
+    //    they stay valid exactly as long as the slots do
+    static_assert(sizeof(Slot) % alignof(pid_t) == 0, "tids follow the slots");
+    int array_size = static_cast<int>(tids.size());
+    size_t shared_size = sizeof(Slot) * array_size + sizeof(pid_t) * array_size;
 
-    SharedStackTrace* temp_stacks =
-        (SharedStackTrace*)mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Slot* temp_stacks = (Slot*)mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
     if (temp_stacks == MAP_FAILED) {
         PROFILER_ERROR("Failed to allocate shared memory for stack traces");
         return result;
     }
 
-    // Initialize array
-    for (int i = 0; i < array_size; ++i) {
-        temp_stacks[i].ready = false;
-        temp_stacks[i].depth = 0;
-        temp_stacks[i].tid = 0;
-        for (int j = 0; j < 64; ++j) {
-            temp_stacks[i].addresses[j] = nullptr;
-        }
-    }
+    // Fresh anonymous pages are already zero: every slot starts not ready, with depth 0
+    auto* mapped_tids = reinterpret_cast<pid_t*>(temp_stacks + array_size);
+    std::copy(tids.begin(), tids.end(), mapped_tids);
 
-    // Save to static variables (signal handler needs access)
+    // Save to static variables (signal handler needs access); unpublished only once
+    // waitForCaptureHandlers() has seen the last handler leave
     shared_stacks_ = temp_stacks;
+    shared_stack_depth_ = MaxDepth;
+    slot_tids_ = mapped_tids;
     stack_array_size_ = array_size;
 
     __sync_synchronize();
@@ -1192,30 +1809,28 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
     // 4. Send signal to all threads EXCEPT current thread
     int signals_sent = 0;
     int signals_failed = 0;
+    std::vector<char> signalled(tids.size(), 0);
 
-    for (pid_t tid : tids) {
+    for (size_t i = 0; i < tids.size(); ++i) {
+        pid_t tid = tids[i];
         // Skip the HTTP request handling thread
         if (tid == current_tid) {
             continue;
         }
 
-        int ret = syscall(SYS_tgkill, current_pid, tid, stack_capture_signal_);
-        if (ret == 0) {
+        // A kernel tid is not a pthread_t, so there is no pthread_kill() fallback
+        if (syscall(SYS_tgkill, current_pid, tid, stack_capture_signal_) == 0) {
+            signalled[i] = 1;
             signals_sent++;
-        } else if (ret == ESRCH) {
-            signals_failed++;
         } else {
-            // Try pthread_kill as fallback
-            ret = pthread_kill(tid, stack_capture_signal_);
-            if (ret == 0) {
-                signals_sent++;
-            } else {
-                signals_failed++;
+            if (errno != ESRCH) { // ESRCH: exited since the listing
+                PROFILER_WARNING("Failed to signal thread {}: {}", tid, strerror(errno));
             }
+            signals_failed++;
         }
     }
 
-    PROFILER_INFO("Sent signal to {} threads ({} failed)", signals_sent, signals_failed);
+    PROFILER_DEBUG("Sent signal to {} threads ({} failed)", signals_sent, signals_failed);
 
     // Set expected count based on ACTUAL signals sent (not original thread count)
     // This handles the case where threads exit between enumerating and sending signals
@@ -1224,11 +1839,13 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
     // If no threads were signaled, nothing to do
     if (expected_count_ == 0) {
         PROFILER_INFO("No threads to capture (all may have exited)");
-        capture_in_progress_.store(false, std::memory_order_release);
+        capture_in_progress_.store(false);
         excluded_tid_.store(0, std::memory_order_release);
-        munmap(temp_stacks, shared_size);
+        waitForCaptureHandlers();
         shared_stacks_ = nullptr;
+        slot_tids_ = nullptr;
         stack_array_size_ = 0;
+        munmap(temp_stacks, shared_size);
         return result;
     }
 
@@ -1242,7 +1859,7 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
         int completed = completed_count_.load(std::memory_order_acquire);
 
         if (completed >= expected_count_) {
-            PROFILER_INFO("All threads completed stack capture in {}ms", elapsed);
+            PROFILER_DEBUG("All threads completed stack capture in {}ms", elapsed);
             break;
         }
 
@@ -1250,17 +1867,25 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
         elapsed += CHECK_INTERVAL_MS;
     }
 
+    // Handlers that already passed the flag check may still be writing their slots
+    capture_in_progress_.store(false);
+    excluded_tid_.store(0, std::memory_order_release);
+    waitForCaptureHandlers();
+
     if (elapsed >= MAX_WAIT_MS) {
         int completed = completed_count_.load(std::memory_order_acquire);
-        PROFILER_WARNING("Timeout waiting for threads to complete. Expected {}, got {}", expected_count_, completed);
+        size_t unanswered_before = unanswered_tids_.size();
+        for (int i = 0; i < array_size; ++i) {
+            if (signalled[i] && !temp_stacks[i].ready) {
+                unanswered_tids_.push_back(tids[i]);
+            }
+        }
+        PROFILER_WARNING("Timeout waiting for threads to complete. Expected {}, got {}; {} threads that did not "
+                         "answer are skipped while signal {} stays pending on them",
+                         expected_count_, completed, unanswered_tids_.size() - unanswered_before,
+                         stack_capture_signal_);
     }
 
-    // Now safe to clear flags
-    capture_in_progress_.store(false, std::memory_order_release);
-    excluded_tid_.store(0, std::memory_order_release);
-
-    __sync_synchronize();
-
     // 6. Collect results from shared memory (filter valid elements)
     int collected = 0;
     for (int i = 0; i < array_size; ++i) {
@@ -1268,12 +1893,13 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
 
         // Filter: only collect valid entries (ready=true and depth>0)
         if (temp_stacks[i].ready && temp_stacks[i].depth > 0) {
-            ThreadStackTrace trace;
+            BasicThreadStackTrace<MaxDepth> trace;
             trace.tid = temp_stacks[i].tid;
-            trace.depth = temp_stacks[i].depth;
+            trace.depth = std::min(temp_stacks[i].depth, MaxDepth + 1);
             trace.captured = true;
+            trace.truncated = temp_stacks[i].depth > MaxDepth;
 
-            for (int j = 0; j < trace.depth && j < 64; ++j) {
+            for (int j = 0; j < trace.depth; ++j) {
                 trace.addresses[j] = temp_stacks[i].addresses[j];
             }
 
@@ -1282,26 +1908,57 @@ std::vector<ThreadStackTrace> ProfilerManager::captureAllThreadStacks() {
         }
     }
 
-    PROFILER_INFO("Collected {} thread stacks from {} slots ({} threads total)", collected, array_size, tids.size());
+    PROFILER_DEBUG("Collected {} thread stacks from {} slots ({} threads total)", collected, array_size, tids.size());
 
     // 7. Clean up
-    munmap(temp_stacks, shared_size);
     shared_stacks_ = nullptr;
+    slot_tids_ = nullptr;
     stack_array_size_ = 0;
+    munmap(temp_stacks, shared_size);
 
     return result;
 }
 
+void ProfilerManager::setThreadStackDepth(int depth) {
+    int rounded = 32;
+    while (rounded < depth && rounded < 256) {
+        rounded *= 2;
+    }
+    thread_stack_depth_ = rounded;
+}
+
+int ProfilerManager::getThreadStackDepth() const {
+    return thread_stack_depth_.load();
+}
+
+template <typename Fn>
+auto ProfilerManager::withThreadStacks(Fn&& fn) {
+    // One instantiation of the capture path per supported depth
+    switch (thread_stack_depth_.load()) {
+    case 32:
+        return fn(captureAllThreadStacks<32>());
+    case 128:
+        return fn(captureAllThreadStacks<128>());
+    case 256:
+        return fn(captureAllThreadStacks<256>());
+    default:
+        return fn(captureAllThreadStacks<kDefaultThreadStackDepth>());
+    }
+}
+
 std::string ProfilerManager::getThreadCallStacks() {
+    return withThreadStacks([this](const auto& stacks) { return formatThreadCallStacks(stacks); });
+}
+
+template <int MaxDepth>
+std::string ProfilerManager::formatThreadCallStacks(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks) {
     std::ostringstream result;
 
     result << "Thread Call Stacks (via Signal Handler)\n";
     result << "=========================================\n\n";
 
-    // Capture all thread stacks via signal handler
-    auto stacks = captureAllThreadStacks();
-
     result << "Total threads captured: " << stacks.size() << "\n\n";
+    internal::NameScope scope;
 
     // Process each thread's stack
     for (const auto& trace : stacks) {
@@ -1311,15 +1968,14 @@ std::string ProfilerManager::getThreadCallStacks() {
         // Symbolize and print each frame using abseil
         for (int i = 0; i < trace.depth; ++i) {
             void* addr = trace.addresses[i];
-            std::string symbolized = symbolizeAddress(addr);
+            result << "    #" << i << " " << scope.view(symbolizeAddressId(addr, scope));
 
-            result << "    #" << i << " ";
-
-            if (symbolized.empty() || symbolized[0] == '0') {
-                result << "0x" << std::hex << reinterpret_cast<uintptr_t>(addr) << std::dec << "\n";
-            } else {
-                result << symbolized << "\n";
+            // Frames above the innermost hold return addresses; look up the call instruction
+            std::string location = sourceLocation(reinterpret_cast<uintptr_t>(addr) - (i > 0 ? 1 : 0));
+            if (!location.empty()) {
+                result << " at " << location;
             }
+            result << "\n";
         }
 
         result << "\n";
@@ -1331,4 +1987,469 @@ std::string ProfilerManager::getThreadCallStacks() {
     return output;
 }
 
+std::string ProfilerManager::sourceLocation(uintptr_t address) {
+    module_map_->refresh();
+    internal::ModuleInfo module;
+    if (!module_map_->find(address, module)) {
+        return {};
+    }
+    std::string file;
+    unsigned int line = 0;
+    if (!module_map_->lineTableFor(module)->lookup(address - module.load_bias, file, line)) {
+        return {};
+    }
+    return file + ":" + std::to_string(line);
+}
+
+std::string ProfilerManager::getThreadCallStacksJson() {
+    return withThreadStacks([this](const auto& stacks) { return formatThreadCallStacksJson(stacks); });
+}
+
+template <int MaxDepth>
+std::string ProfilerManager::formatThreadCallStacksJson(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks) {
+    // Symbol table: each distinct address is symbolized once and each distinct
+    // name listed once; nodes of the prefix tree refer to names by index.
+    // Names are views into the process-wide symbol name pool, or into `scope`
+    // for unresolved addresses.
+    internal::NameScope scope;
+    std::unordered_map<void*, uint32_t> address_to_frame;
+    std::unordered_map<uint32_t, uint32_t> name_to_frame; // Name ID -> frame index
+    std::vector<std::string_view> frame_names;
+
+    // Prefix tree keyed by (parent node + 1) << 32 | frame, so that the
+    // shared outer frames (start_thread, clone, event loops...) appear once.
+    std::unordered_map<uint64_t, uint32_t> child_index;
+    std::vector<std::pair<int64_t, uint32_t>> nodes;
+
+    std::string json;
+    std::string threads_json;
+    internal::ThreadMetadataSnapshot threads;
+    thread_metadata_->collect(threads);
+
+    for (const auto& trace : stacks) {
+        int64_t node = -1;
+        for (int i = trace.depth - 1; i >= 0; --i) {
+            void* addr = trace.addresses[i];
+            auto [addr_it, new_addr] = address_to_frame.try_emplace(addr, 0);
+            if (new_addr) {
+                uint32_t name_id = symbolizeAddressId(addr, scope);
+                auto [name_it, new_name] = name_to_frame.try_emplace(name_id, static_cast<uint32_t>(frame_names.size()));
+                if (new_name) {
+                    frame_names.push_back(scope.view(name_id));
+                }
+                addr_it->second = name_it->second;
+            }
+
+            uint64_t key = (static_cast<uint64_t>(node + 1) << 32) | addr_it->second;
+            auto [node_it, new_node] = child_index.try_emplace(key, static_cast<uint32_t>(nodes.size()));
+            if (new_node) {
+                nodes.emplace_back(node, addr_it->second);
+            }
+            node = node_it->second;
+        }
+
+        ptrdiff_t row = threads.find(trace.tid);
+        char state = row >= 0 ? threads.states[row] : '?';
+
+        if (!threads_json.empty()) {
+            threads_json += ',';
+        }
+        threads_json += "{\"tid\":" + std::to_string(trace.tid) + ",\"name\":";
+        internal::appendJsonString(threads_json, row >= 0 ? threads.name(row) : std::string_view());
+        threads_json += ",\"state\":";
+        internal::appendJsonString(threads_json, std::string_view(&state, 1));
+        threads_json += ",\"wchan\":";
+        internal::appendJsonString(threads_json, row >= 0 ? threads.wchan(row) : std::string_view());
+        threads_json += ",\"node\":" + std::to_string(node) + "}";
+    }
+
+    json.reserve(threads_json.size() + nodes.size() * 12 + frame_names.size() * 48);
+    json += "{\"frames\":[";
+    for (size_t i = 0; i < frame_names.size(); ++i) {
+        if (i > 0) {
+            json += ',';
+        }
+        internal::appendJsonString(json, frame_names[i]);
+    }
+    json += "],\"nodes\":[";
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (i > 0) {
+            json += ',';
+        }
+        json += '[';
+        json += std::to_string(nodes[i].first);
+        json += ',';
+        json += std::to_string(nodes[i].second);
+        json += ']';
+    }
+    json += "],\"threads\":[";
+    json += threads_json;
+    json += "]}";
+
+    PROFILER_INFO("Thread callstacks JSON: {} threads, {} frames, {} nodes, {} bytes", stacks.size(),
+                  frame_names.size(), nodes.size(), json.size());
+    return json;
+}
+
+std::string ProfilerManager::getProfileBundle(ProfilerType type, int seconds) {
+    std::string data;
+    internal::ParsedProfile profile;
+    internal::SymbolBundle bundle;
+    if (type == ProfilerType::CPU) {
+        data = getRawCPUProfile(seconds);
+        if (data.empty()) {
+            return "";
+        }
+        if (!internal::parseCpuProfile(data, profile)) {
+            PROFILER_ERROR("Failed to parse CPU profile ({} bytes)", data.size());
+            return "";
+        }
+        bundle.kind = internal::SymbolBundle::Kind::Cpu;
+    } else {
+        data = type == ProfilerType::HEAP ? getRawHeapSample() : getRawHeapGrowthStacks();
+        if (data.empty()) {
+            return "";
+        }
+        if (!internal::parseHeapProfile(data, profile)) {
+            PROFILER_ERROR("Failed to parse heap profile ({} bytes)", data.size());
+            return "";
+        }
+        bundle.kind =
+            type == ProfilerType::HEAP ? internal::SymbolBundle::Kind::Heap : internal::SymbolBundle::Kind::HeapGrowth;
+    }
+
+    bundle.period_us = profile.period_us;
+    bundle.samples.reserve(profile.samples.size());
+    for (auto& sample : profile.samples) {
+        if (sample.value > 0 && !sample.stack.empty()) {
+            internal::SymbolBundle::Sample out;
+            out.value = sample.value;
+            out.stack = std::move(sample.stack);
+            bundle.samples.push_back(std::move(out));
+        }
+    }
+    return encodeBundle(bundle);
+}
+
+std::string ProfilerManager::encodeBundle(internal::SymbolBundle& bundle) {
+    std::vector<uintptr_t> addresses;
+    for (const auto& sample : bundle.samples) {
+        addresses.insert(addresses.end(), sample.stack.begin(), sample.stack.end());
+    }
+    std::sort(addresses.begin(), addresses.end());
+
+    // Only ship the modules that are actually referenced
+    module_map_->refresh();
+    for (auto& module : module_map_->modules()) {
+        auto it = std::lower_bound(addresses.begin(), addresses.end(), module.start);
+        if (it != addresses.end() && *it < module.end) {
+            bundle.modules.push_back(std::move(module));
+        }
+    }
+
+    std::string data = internal::encodeSymbolBundle(bundle);
+    PROFILER_INFO("Symbol bundle: {} samples, {} modules, {} bytes", bundle.samples.size(), bundle.modules.size(),
+                  data.size());
+    return data;
+}
+
+std::string ProfilerManager::getCPUProfileBundle(int seconds) {
+    return getProfileBundle(ProfilerType::CPU, seconds);
+}
+
+std::string ProfilerManager::getHeapSampleBundle() {
+    return getProfileBundle(ProfilerType::HEAP, 0);
+}
+
+std::string ProfilerManager::getHeapGrowthBundle() {
+    return getProfileBundle(ProfilerType::HEAP_GROWTH, 0);
+}
+
+std::string ProfilerManager::getThreadStacksBundle() {
+    return withThreadStacks([this](const auto& stacks) { return encodeThreadStacksBundle(stacks); });
+}
+
+template <int MaxDepth>
+std::string ProfilerManager::encodeThreadStacksBundle(const std::vector<BasicThreadStackTrace<MaxDepth>>& stacks) {
+    internal::SymbolBundle bundle;
+    bundle.kind = internal::SymbolBundle::Kind::Threads;
+    bundle.samples.reserve(stacks.size());
+    internal::ThreadMetadataSnapshot threads;
+    thread_metadata_->collect(threads, false);
+    for (const auto& trace : stacks) {
+        internal::SymbolBundle::Sample sample;
+        sample.value = 1;
+        sample.tid = static_cast<uint64_t>(trace.tid);
+        ptrdiff_t row = threads.find(trace.tid);
+        if (row >= 0) {
+            sample.label = threads.name(row);
+        }
+        // The marker is not an address the offline symbolizer could resolve
+        for (int i = 0; i < trace.depth - (trace.truncated ? 1 : 0); ++i) {
+            sample.stack.push_back(reinterpret_cast<uintptr_t>(trace.addresses[i]));
+        }
+        bundle.samples.push_back(std::move(sample));
+    }
+    return encodeBundle(bundle);
+}
+
+// --- Stuck-thread detector ---
+
+namespace {
+
+// Frames captured per thread by the detector: enough to tell stacks apart and
+// to show where a thread blocks, at the smallest capture buffers
+constexpr int kStuckThreadStackDepth = 32;
+
+template <int MaxDepth>
+uint64_t stackHash(const BasicThreadStackTrace<MaxDepth>& trace) {
+    // FNV-1a over the return addresses
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < trace.depth; ++i) {
+        hash = (hash ^ reinterpret_cast<uintptr_t>(trace.addresses[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+bool ProfilerManager::startStuckThreadDetector(const StuckThreadOptions& options) {
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    if (watchdog_running_) {
+        PROFILER_WARNING("Stuck-thread detector is already running");
+        return false;
+    }
+    watchdog_options_ = options;
+    watchdog_options_.interval_ms = std::max(options.interval_ms, 10);
+    watchdog_options_.samples = std::max(options.samples, 2);
+    watchdog_stop_ = false;
+    watchdog_running_ = true;
+    stuck_threads_.clear();
+    watchdog_thread_ = std::thread(&ProfilerManager::runStuckThreadDetector, this, watchdog_options_);
+    return true;
+}
+
+void ProfilerManager::stopStuckThreadDetector() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(watchdog_mutex_);
+        watchdog_stop_ = true;
+        thread = std::move(watchdog_thread_);
+    }
+    watchdog_cv_.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    watchdog_running_ = false;
+}
+
+bool ProfilerManager::isStuckThreadDetectorRunning() const {
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    return watchdog_running_;
+}
+
+std::vector<StuckThread> ProfilerManager::getStuckThreads() const {
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    std::vector<StuckThread> threads;
+    threads.reserve(stuck_threads_.size());
+    for (const auto& [tid, thread] : stuck_threads_) {
+        threads.push_back(thread);
+    }
+    return threads;
+}
+
+std::string ProfilerManager::getStuckThreadsJson() const {
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    std::string json = "{\"running\":";
+    json += watchdog_running_ ? "true" : "false";
+    json += ",\"interval_ms\":" + std::to_string(watchdog_options_.interval_ms);
+    json += ",\"samples\":" + std::to_string(watchdog_options_.samples);
+    json += ",\"threads\":[";
+    bool first = true;
+    for (const auto& [tid, thread] : stuck_threads_) {
+        if (!first) {
+            json += ',';
+        }
+        first = false;
+        json += "{\"tid\":" + std::to_string(tid) + ",\"name\":";
+        internal::appendJsonString(json, thread.name);
+        json += ",\"state\":";
+        internal::appendJsonString(json, std::string_view(&thread.state, 1));
+        json += ",\"wchan\":";
+        internal::appendJsonString(json, thread.wchan);
+        json += ",\"stuck_ms\":" + std::to_string(thread.stuck_ms);
+        json += ",\"samples\":" + std::to_string(thread.samples);
+        json += ",\"frames\":[";
+        for (size_t i = 0; i < thread.frames.size(); ++i) {
+            if (i > 0) {
+                json += ',';
+            }
+            internal::appendJsonString(json, thread.frames[i]);
+        }
+        json += "]}";
+    }
+    json += "]}";
+    return json;
+}
+
+void ProfilerManager::runStuckThreadDetector(StuckThreadOptions options) {
+    using Clock = std::chrono::steady_clock;
+    struct Track {
+        uint64_t hash = 0;       ///< Stack of the last capture
+        int samples = 0;         ///< Consecutive captures with that stack
+        Clock::time_point since; ///< Capture that first saw that stack
+        bool checked = false;    ///< Reached options.samples and was classified
+        bool stuck = false;      ///< Classified as not idle
+    };
+    // Per-thread state lives on this thread only; a round touches each thread once
+    std::unordered_map<pid_t, Track> tracks;
+    std::unordered_map<uint64_t, bool> idle_stacks; // Stack hash -> has an idle frame
+
+    auto isIdle = [&](const BasicThreadStackTrace<kStuckThreadStackDepth>& trace) {
+        int depth = std::min(trace.depth, options.idle_frame_depth);
+        internal::NameScope scope;
+        for (int i = 0; i < depth; ++i) {
+            std::string_view name = scope.view(symbolizeAddressId(trace.addresses[i], scope));
+            for (const auto& idle : options.idle_frames) {
+                if (!idle.empty() && name.find(idle) != std::string_view::npos) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    auto msSince = [](Clock::time_point since, Clock::time_point now) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - since).count());
+    };
+
+    PROFILER_INFO("Stuck-thread detector started: {} captures {}ms apart", options.samples, options.interval_ms);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(watchdog_mutex_);
+            if (watchdog_cv_.wait_for(lock, std::chrono::milliseconds(options.interval_ms),
+                                      [this] { return watchdog_stop_; })) {
+                break;
+            }
+        }
+
+        auto stacks = captureAllThreadStacks<kStuckThreadStackDepth>();
+        Clock::time_point now = Clock::now();
+        std::unordered_map<pid_t, Track> next;
+        next.reserve(stacks.size());
+        std::vector<const BasicThreadStackTrace<kStuckThreadStackDepth>*> newly_stuck;
+        for (const auto& trace : stacks) {
+            uint64_t hash = stackHash(trace);
+            Track track;
+            auto it = tracks.find(trace.tid);
+            if (it != tracks.end() && it->second.hash == hash) {
+                track = it->second;
+            } else {
+                track.hash = hash;
+                track.since = now;
+            }
+            ++track.samples;
+            if (!track.checked && track.samples >= options.samples) {
+                // Only stacks that stayed put are symbolized, once per distinct stack
+                auto [idle_it, inserted] = idle_stacks.try_emplace(hash, false);
+                if (inserted) {
+                    idle_it->second = isIdle(trace);
+                }
+                track.checked = true;
+                track.stuck = !idle_it->second;
+                if (track.stuck) {
+                    newly_stuck.push_back(&trace);
+                }
+            }
+            next.emplace(trace.tid, track);
+        }
+        tracks.swap(next); // Threads that exited or were not captured are forgotten
+
+        if (idle_stacks.size() > 2 * tracks.size() + 64) {
+            std::unordered_map<uint64_t, bool> live;
+            for (const auto& [tid, track] : tracks) {
+                auto it = idle_stacks.find(track.hash);
+                if (it != idle_stacks.end()) {
+                    live.emplace(*it);
+                }
+            }
+            idle_stacks.swap(live);
+        }
+
+        std::vector<StuckThread> reports;
+        if (!newly_stuck.empty()) {
+            internal::ThreadMetadataSnapshot threads;
+            thread_metadata_->collect(threads);
+            internal::NameScope scope;
+            for (const auto* trace : newly_stuck) {
+                StuckThread report;
+                report.tid = trace->tid;
+                ptrdiff_t row = threads.find(trace->tid);
+                if (row >= 0) {
+                    report.name = threads.name(row);
+                    report.state = threads.states[row];
+                    report.wchan = threads.wchan(row);
+                }
+                const Track& track = tracks[trace->tid];
+                report.samples = track.samples;
+                report.stuck_ms = msSince(track.since, now);
+                for (int i = 0; i < trace->depth; ++i) {
+                    report.frames.emplace_back(scope.view(symbolizeAddressId(trace->addresses[i], scope)));
+                }
+                reports.push_back(std::move(report));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(watchdog_mutex_);
+            for (auto it = stuck_threads_.begin(); it != stuck_threads_.end();) {
+                auto track = tracks.find(it->first);
+                if (track == tracks.end() || !track->second.stuck) {
+                    PROFILER_INFO("Thread {} ({}) is no longer stuck", it->first, it->second.name);
+                    it = stuck_threads_.erase(it);
+                } else {
+                    it->second.samples = track->second.samples;
+                    it->second.stuck_ms = msSince(track->second.since, now);
+                    ++it;
+                }
+            }
+            for (const auto& report : reports) {
+                stuck_threads_[report.tid] = report;
+            }
+        }
+
+        for (const auto& report : reports) {
+            std::string stack;
+            for (size_t i = 0; i < report.frames.size(); ++i) {
+                stack += "\n    #" + std::to_string(i) + " " + report.frames[i];
+            }
+            PROFILER_WARNING("Thread {} ({}) stuck for {}ms, state {}, waiting in {}:{}", report.tid, report.name,
+                             report.stuck_ms, report.state, report.wchan, stack);
+            if (options.on_stuck) {
+                options.on_stuck(report);
+            }
+        }
+    }
+    PROFILER_INFO("Stuck-thread detector stopped");
+}
+
+std::string ProfilerManager::mergeProfileBundles(const std::vector<std::string>& bundles) {
+    std::vector<internal::SymbolBundle> inputs(bundles.size());
+    for (size_t i = 0; i < bundles.size(); ++i) {
+        if (!internal::decodeSymbolBundle(bundles[i], inputs[i])) {
+            PROFILER_ERROR("Cannot merge bundles: bundle {} is corrupt", i);
+            return "";
+        }
+    }
+    internal::SymbolBundle merged;
+    std::string error;
+    if (!internal::mergeSymbolBundles(inputs, merged, error)) {
+        PROFILER_ERROR("Cannot merge bundles: {}", error);
+        return "";
+    }
+    PROFILER_INFO("Merged {} bundles: {} unique stacks, {} modules", bundles.size(), merged.samples.size(),
+                  merged.modules.size());
+    return internal::encodeSymbolBundle(merged);
+}
+
 PROFILER_NAMESPACE_END
@@ -1,10 +1,12 @@
 #include "internal/symbolize.h"
+#include "internal/module_map.h"
+#include "internal/offline_symbolizer.h"
 #include <absl/debugging/symbolize.h>
 #include <algorithm>
 #include <backward.hpp>
 #include <cxxabi.h>
 #include <dlfcn.h>
-#include <sstream>
+#include <mutex>
 
 PROFILER_NAMESPACE_BEGIN
 
@@ -12,28 +14,50 @@ PROFILER_NAMESPACE_BEGIN
 class BackwardSymbolizer::Impl {
 public:
     backward::TraceResolver resolver_;
+    std::mutex resolver_mutex_; // TraceResolver 有内部状态，warmup 线程与请求线程共用
+    std::shared_ptr<internal::ModuleMap> modules_;
+    uint32_t unknown_id_ = internal::symbolNames().intern("??");
 
-    Impl() : resolver_() {
+    explicit Impl(std::shared_ptr<internal::ModuleMap> modules) : resolver_(), modules_(std::move(modules)) {
         // TraceResolver will be initialized when needed
     }
+
+    // 用 DWARF 补全 absl/dladdr 的结果（进程内，无子进程）：缺失的 file:line，
+    // 以及覆盖该地址的内联调用链。按最内层在前的顺序追加到 frames
+    void appendFrames(void* address, SymbolizedFrame frame, std::vector<SymbolizedFrame>& frames) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(address);
+        internal::ModuleInfo module;
+        if (modules_) {
+            modules_->refresh();
+        }
+        if (!modules_ || !modules_->find(addr, module)) {
+            frames.push_back(frame);
+            return;
+        }
+
+        internal::appendDwarfFrames(*modules_->lineTableFor(module), *modules_->inlineIndexFor(module),
+                                    addr - module.load_bias, frame, frames);
+    }
 };
 
-BackwardSymbolizer::BackwardSymbolizer() : impl_(std::make_unique<Impl>()) {}
+BackwardSymbolizer::BackwardSymbolizer(std::shared_ptr<internal::ModuleMap> modules)
+    : impl_(std::make_unique<Impl>(std::move(modules))) {}
 
 BackwardSymbolizer::~BackwardSymbolizer() = default;
 
 std::vector<SymbolizedFrame> BackwardSymbolizer::symbolize(void* address) {
     std::vector<SymbolizedFrame> frames;
+    internal::StringPool& names = internal::symbolNames();
 
     // 首先尝试使用 absl::Symbolize (最可靠)
     char symbol_buffer[512];
     if (absl::Symbolize(address, symbol_buffer, sizeof(symbol_buffer))) {
         SymbolizedFrame frame;
-        frame.function_name = symbol_buffer;
-        frame.source_file = "??";
+        frame.function_id = names.intern(symbol_buffer);
+        frame.file_id = impl_->unknown_id_;
         frame.line = 0;
         frame.is_inlined = false;
-        frames.push_back(frame);
+        impl_->appendFrames(address, frame, frames);
         return frames;
     }
 
@@ -44,53 +68,60 @@ std::vector<SymbolizedFrame> BackwardSymbolizer::symbolize(void* address) {
 
         if (info.dli_sname) {
             // dladdr找到了符号
-            frame.function_name = info.dli_sname;
-
             // 如果有C++函数名，尝试demangle（dladdr通常已经demangle了）
             int status = 0;
             char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
             if (status == 0 && demangled) {
-                frame.function_name = demangled;
-                free(demangled);
+                frame.function_id = names.intern(demangled);
+            } else {
+                frame.function_id = names.intern(info.dli_sname);
             }
+            free(demangled);
 
-            frame.source_file = info.dli_fname ? info.dli_fname : "??";
+            frame.file_id = info.dli_fname ? names.intern(info.dli_fname) : impl_->unknown_id_;
             frame.line = 0;
             frame.is_inlined = false;
-            frames.push_back(frame);
+            impl_->appendFrames(address, frame, frames);
             return frames;
         }
     }
 
     // 如果dladdr失败，尝试backward-cpp
     try {
-        impl_->resolver_.load_addresses(&address, 1);
+        backward::ResolvedTrace resolved;
+        {
+            std::lock_guard<std::mutex> lock(impl_->resolver_mutex_);
+            impl_->resolver_.load_addresses(&address, 1);
 
-        backward::Trace trace;
-        trace.addr = address;
-        trace.idx = 0;
+            backward::Trace trace;
+            trace.addr = address;
+            trace.idx = 0;
 
-        backward::ResolvedTrace resolved = impl_->resolver_.resolve(trace);
+            resolved = impl_->resolver_.resolve(trace);
+        }
 
         if (!resolved.source.function.empty() && resolved.source.function != "??") {
             SymbolizedFrame frame;
-            frame.function_name = resolved.source.function;
-            frame.source_file = resolved.source.filename;
+            frame.function_id = names.intern(resolved.source.function);
+            frame.file_id = names.intern(resolved.source.filename);
             frame.line = resolved.source.line;
             frame.is_inlined = false;
             frames.push_back(frame);
 
-            // 内联函数
+            // 内联函数（backward-cpp 按由内到外排列）
             for (const auto& inlined : resolved.inliners) {
                 if (!inlined.function.empty() && inlined.function != "??") {
                     SymbolizedFrame inline_frame;
-                    inline_frame.function_name = inlined.function;
-                    inline_frame.source_file = inlined.filename;
+                    inline_frame.function_id = names.intern(inlined.function);
+                    inline_frame.file_id = names.intern(inlined.filename);
                     inline_frame.line = inlined.line;
-                    inline_frame.is_inlined = true;
                     frames.push_back(inline_frame);
                 }
             }
+            // 除最外层外，每一帧都被内联进了下一帧
+            for (size_t i = 0; i + 1 < frames.size(); ++i) {
+                frames[i].is_inlined = true;
+            }
             return frames;
         }
     } catch (const std::exception& e) {
@@ -99,10 +130,8 @@ std::vector<SymbolizedFrame> BackwardSymbolizer::symbolize(void* address) {
 
     // 如果所有方法都失败，返回地址
     SymbolizedFrame frame;
-    std::ostringstream oss;
-    oss << "0x" << std::hex << reinterpret_cast<unsigned long long>(address);
-    frame.function_name = oss.str();
-    frame.source_file = "??";
+    frame.setUnresolved(reinterpret_cast<uintptr_t>(address));
+    frame.file_id = impl_->unknown_id_;
     frame.line = 0;
     frame.is_inlined = false;
     frames.push_back(frame);
@@ -121,9 +150,31 @@ std::vector<std::vector<SymbolizedFrame>> BackwardSymbolizer::symbolizeBatch(con
     return results;
 }
 
+void BackwardSymbolizer::warmup(const std::vector<void*>& addresses) {
+    for (void* address : addresses) {
+        // absl 缓存模块的符号表位置，DWARF 读取器建立行号表和内联函数的地址索引
+        char symbol_buffer[512];
+        absl::Symbolize(address, symbol_buffer, sizeof(symbol_buffer));
+        std::vector<SymbolizedFrame> frames;
+        impl_->appendFrames(address, SymbolizedFrame(), frames);
+
+        // backward-cpp 在第一次解析某个模块的地址时才加载它的调试信息
+        try {
+            std::lock_guard<std::mutex> lock(impl_->resolver_mutex_);
+            impl_->resolver_.load_addresses(&address, 1);
+            backward::Trace trace;
+            trace.addr = address;
+            trace.idx = 0;
+            impl_->resolver_.resolve(trace);
+        } catch (const std::exception&) {
+            // 预热失败不影响之后的正常符号化
+        }
+    }
+}
+
 // 工厂函数
-std::unique_ptr<Symbolizer> createSymbolizer() {
-    return std::make_unique<BackwardSymbolizer>();
+std::unique_ptr<Symbolizer> createSymbolizer(std::shared_ptr<internal::ModuleMap> modules) {
+    return std::make_unique<BackwardSymbolizer>(std::move(modules));
 }
 
 PROFILER_NAMESPACE_END
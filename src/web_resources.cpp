@@ -173,6 +173,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     <select id="cpu-chart-type">
                         <option value="pprof">pprof SVG</option>
                         <option value="flamegraph">FlameGraph (Brendan Gregg)</option>
+                        <option value="canvas">FlameGraph (Canvas 交互式)</option>
                     </select>
                 </div>
                 <button class="analyze-btn" onclick="analyzeCPU()">⚡ 一键分析并生成火焰图</button>
@@ -188,6 +189,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     <select id="heap-chart-type">
                         <option value="pprof">pprof SVG</option>
                         <option value="flamegraph">FlameGraph (Brendan Gregg)</option>
+                        <option value="canvas">FlameGraph (Canvas 交互式)</option>
                     </select>
                 </div>
                 <button class="analyze-btn" onclick="analyzeHeap()">⚡ 一键分析并生成Heap火焰图</button>
@@ -203,6 +205,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     <select id="growth-chart-type">
                         <option value="pprof">pprof SVG</option>
                         <option value="flamegraph">FlameGraph (Brendan Gregg)</option>
+                        <option value="canvas">FlameGraph (Canvas 交互式)</option>
                     </select>
                 </div>
                 <button class="analyze-btn" onclick="analyzeGrowth()">⚡ 一键分析并生成Growth火焰图</button>
@@ -230,11 +233,15 @@ static const char INDEX_PAGE[] = R"HTML(
             log(`🚀 正在进行CPU分析，采样时长: ${duration}秒, 图表类型: ${chartType}...\n(这可能需要一些时间，请耐心等待)`);
             document.getElementById('cpu-duration').disabled = true;
 
-            // 打开独立的SVG查看器页面，传递 output_type 参数
-            window.open(`/show_svg.html?duration=${duration}&output_type=${chartType}`, '_blank');
+            // 打开独立的查看器页面：canvas 模式使用 JSON 数据在浏览器端绘制
+            if (chartType === 'canvas') {
+                window.open(`/flamegraph.html?type=cpu&duration=${duration}`, '_blank');
+            } else {
+                window.open(`/show_svg.html?duration=${duration}&output_type=${chartType}`, '_blank');
+            }
 
             log('✅ 火焰图查看器已在新标签页打开');
-            log(`💡 提示：当前使用 ${chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
+            log(`💡 提示：当前使用 ${chartType === 'canvas' ? 'Canvas FlameGraph' : chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
 
             document.getElementById('cpu-duration').disabled = false;
         }
@@ -242,19 +249,27 @@ static const char INDEX_PAGE[] = R"HTML(
         function analyzeHeap() {
             const chartType = document.getElementById('heap-chart-type').value;
             log(`🚀 正在获取Heap火焰图 (图表类型: ${chartType})...`);
-            // 打开独立的SVG查看器页面，传递 output_type 参数
-            window.open(`/show_heap_svg.html?output_type=${chartType}`, '_blank');
+            // 打开独立的查看器页面：canvas 模式使用 JSON 数据在浏览器端绘制
+            if (chartType === 'canvas') {
+                window.open('/flamegraph.html?type=heap', '_blank');
+            } else {
+                window.open(`/show_heap_svg.html?output_type=${chartType}`, '_blank');
+            }
             log('✅ Heap火焰图查看器已在新标签页打开');
-            log(`💡 提示：当前使用 ${chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
+            log(`💡 提示：当前使用 ${chartType === 'canvas' ? 'Canvas FlameGraph' : chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
         }
 
         function analyzeGrowth() {
             const chartType = document.getElementById('growth-chart-type').value;
             log(`🚀 正在获取Heap Growth火焰图 (图表类型: ${chartType})...`);
-            // 打开独立的SVG查看器页面，传递 output_type 参数
-            window.open(`/show_growth_svg.html?output_type=${chartType}`, '_blank');
+            // 打开独立的查看器页面：canvas 模式使用 JSON 数据在浏览器端绘制
+            if (chartType === 'canvas') {
+                window.open('/flamegraph.html?type=growth', '_blank');
+            } else {
+                window.open(`/show_growth_svg.html?output_type=${chartType}`, '_blank');
+            }
             log('✅ Heap Growth火焰图查看器已在新标签页打开');
-            log(`💡 提示：当前使用 ${chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
+            log(`💡 提示：当前使用 ${chartType === 'canvas' ? 'Canvas FlameGraph' : chartType === 'flamegraph' ? 'Brendan Gregg FlameGraph' : 'pprof SVG'}`);
         }
 
         function log(message) {
@@ -273,9 +288,14 @@ static const char INDEX_PAGE[] = R"HTML(
             btn.textContent = '⏳ 准备下载...';
 
             // 根据图表类型选择端点和文件名
-            const endpoint = chartType === 'flamegraph' ? '/api/cpu/flamegraph_raw' : '/api/cpu/svg_raw';
-            const chartTypeName = chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
-            const filenamePrefix = chartType === 'flamegraph' ? 'cpu_flamegraph' : 'cpu_profile';
+            // Canvas 模式下载折叠栈文本（可导入 speedscope / flamegraph.pl）
+            const endpoint = chartType === 'canvas' ? '/api/cpu/folded'
+                : chartType === 'flamegraph' ? '/api/cpu/flamegraph_raw' : '/api/cpu/svg_raw';
+            const chartTypeName = chartType === 'canvas' ? 'Folded Stacks'
+                : chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
+            const filenamePrefix = chartType === 'canvas' ? 'cpu_folded'
+                : chartType === 'flamegraph' ? 'cpu_flamegraph' : 'cpu_profile';
+            const extension = chartType === 'canvas' ? 'txt' : 'svg';
 
             log(`📥 开始下载 CPU ${chartTypeName} (采样时长: ${duration}秒)...`);
 
@@ -308,7 +328,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     const url = URL.createObjectURL(blob);
                     const a = document.createElement('a');
                     a.href = url;
-                    a.download = `${filenamePrefix}_${duration}s.svg`;
+                    a.download = `${filenamePrefix}_${duration}s.${extension}`;
                     a.click();
                     URL.revokeObjectURL(url);
 
@@ -337,9 +357,14 @@ static const char INDEX_PAGE[] = R"HTML(
             btn.textContent = '⏳ 准备下载...';
 
             // 根据图表类型选择端点和文件名
-            const endpoint = chartType === 'flamegraph' ? '/api/heap/flamegraph_raw' : '/api/heap/svg_raw';
-            const chartTypeName = chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
-            const filenamePrefix = chartType === 'flamegraph' ? 'heap_flamegraph' : 'heap_profile';
+            // Canvas 模式下载折叠栈文本（可导入 speedscope / flamegraph.pl）
+            const endpoint = chartType === 'canvas' ? '/api/heap/folded'
+                : chartType === 'flamegraph' ? '/api/heap/flamegraph_raw' : '/api/heap/svg_raw';
+            const chartTypeName = chartType === 'canvas' ? 'Folded Stacks'
+                : chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
+            const filenamePrefix = chartType === 'canvas' ? 'heap_folded'
+                : chartType === 'flamegraph' ? 'heap_flamegraph' : 'heap_profile';
+            const extension = chartType === 'canvas' ? 'txt' : 'svg';
 
             log(`📥 开始下载 Heap ${chartTypeName}...`);
 
@@ -373,7 +398,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     const a = document.createElement('a');
                     a.href = url;
                     const timestamp = new Date().toISOString().replace(/[:.]/g, '-').slice(0, -5);
-                    a.download = `${filenamePrefix}_${timestamp}.svg`;
+                    a.download = `${filenamePrefix}_${timestamp}.${extension}`;
                     a.click();
                     URL.revokeObjectURL(url);
 
@@ -402,9 +427,14 @@ static const char INDEX_PAGE[] = R"HTML(
             btn.textContent = '⏳ 准备下载...';
 
             // 根据图表类型选择端点和文件名
-            const endpoint = chartType === 'flamegraph' ? '/api/growth/flamegraph_raw' : '/api/growth/svg_raw';
-            const chartTypeName = chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
-            const filenamePrefix = chartType === 'flamegraph' ? 'growth_flamegraph' : 'growth_profile';
+            // Canvas 模式下载折叠栈文本（可导入 speedscope / flamegraph.pl）
+            const endpoint = chartType === 'canvas' ? '/api/growth/folded'
+                : chartType === 'flamegraph' ? '/api/growth/flamegraph_raw' : '/api/growth/svg_raw';
+            const chartTypeName = chartType === 'canvas' ? 'Folded Stacks'
+                : chartType === 'flamegraph' ? 'FlameGraph' : 'pprof SVG';
+            const filenamePrefix = chartType === 'canvas' ? 'growth_folded'
+                : chartType === 'flamegraph' ? 'growth_flamegraph' : 'growth_profile';
+            const extension = chartType === 'canvas' ? 'txt' : 'svg';
 
             log(`📥 开始下载 Growth ${chartTypeName}...`);
 
@@ -438,7 +468,7 @@ static const char INDEX_PAGE[] = R"HTML(
                     const a = document.createElement('a');
                     a.href = url;
                     const timestamp = new Date().toISOString().replace(/[:.]/g, '-').slice(0, -5);
-                    a.download = `${filenamePrefix}_${timestamp}.svg`;
+                    a.download = `${filenamePrefix}_${timestamp}.${extension}`;
                     a.click();
                     URL.revokeObjectURL(url);
 
@@ -1004,6 +1034,276 @@ static const char GROWTH_SVG_VIEWER_PAGE[] = R"HTML(
 </html>
 )HTML";
 
+static const char FLAMEGRAPH_VIEWER_PAGE[] = R"HTML(
+<!DOCTYPE html>
+<html>
+<head>
+    <title>Flame Graph Viewer</title>
+    <style>
+        body { margin: 0; padding: 20px; font-family: Arial, sans-serif; background: #f5f5f5; }
+        h1 { color: #333; margin-bottom: 10px; }
+        .toolbar { margin-bottom: 10px; }
+        button { padding: 8px 16px; margin-right: 8px; cursor: pointer; font-size: 14px; }
+        input[type=text] { padding: 7px; width: 260px; border: 1px solid #ddd; border-radius: 4px; }
+        #status { color: #555; font-size: 13px; margin: 8px 0; min-height: 18px; }
+        #details { font-family: monospace; font-size: 12px; min-height: 18px; margin-bottom: 8px; color: #333; }
+        #scroller {
+            background: white;
+            border: 1px solid #ddd;
+            border-radius: 5px;
+            overflow-y: auto;
+            height: 75vh;
+            position: relative;
+            box-shadow: 0 2px 4px rgba(0,0,0,0.1);
+        }
+        #spacer { position: relative; }
+        #canvas { position: sticky; top: 0; left: 0; display: block; }
+    </style>
+</head>
+<body>
+    <h1 id="title">🔥 火焰图</h1>
+    <div class="toolbar">
+        <button onclick="loadData()">🔄 重新采样</button>
+        <button onclick="resetZoom()">⤢ 重置缩放</button>
+        <input type="text" id="search" placeholder="搜索函数 (支持正则)" onkeydown="if (event.key === 'Enter') search()">
+        <button onclick="search()">🔍 搜索</button>
+        <button onclick="clearSearch()">✖ 清除</button>
+    </div>
+    <div id="status">加载中...</div>
+    <div id="details">&nbsp;</div>
+    <div id="scroller"><div id="spacer"><canvas id="canvas"></canvas></div></div>
+
+    <script>
+        // 服务端只返回聚合后的调用树，浏览器仅绘制当前可见且宽度 >= 1px 的帧
+        const ROW_HEIGHT = 18;
+        const urlParams = new URLSearchParams(window.location.search);
+        const type = urlParams.get('type') || 'cpu';
+        const duration = urlParams.get('duration') || '10';
+
+        let names = [];
+        let unit = 'samples';
+        let root = null;
+        let maxDepth = 0;
+        let zoomNode = null;
+        let searchRegex = null;
+        let matchedValue = 0;
+        let hoverNode = null;
+
+        const scroller = document.getElementById('scroller');
+        const spacer = document.getElementById('spacer');
+        const canvas = document.getElementById('canvas');
+        const ctx = canvas.getContext('2d');
+
+        // 将 [name, value, [children]] 数组转换为带布局信息的节点
+        function buildNode(arr, parent, depth, start) {
+            const node = { name: arr[0], value: arr[1], depth: depth, start: start, parent: parent, children: [] };
+            if (depth > maxDepth) maxDepth = depth;
+            if (arr.length > 2) {
+                let offset = start;
+                for (const child of arr[2]) {
+                    const c = buildNode(child, node, depth + 1, offset);
+                    node.children.push(c);
+                    offset += c.value;
+                }
+            }
+            return node;
+        }
+
+        function formatValue(v) {
+            if (unit === 'bytes') {
+                if (v >= 1 << 30) return (v / (1 << 30)).toFixed(2) + ' GiB';
+                if (v >= 1 << 20) return (v / (1 << 20)).toFixed(2) + ' MiB';
+                if (v >= 1 << 10) return (v / (1 << 10)).toFixed(2) + ' KiB';
+                return v + ' B';
+            }
+            return v + ' samples';
+        }
+
+        function colorFor(name, highlighted) {
+            if (highlighted) return 'rgb(230,0,230)';
+            let hash = 0;
+            for (let i = 0; i < name.length; i++) hash = (hash * 31 + name.charCodeAt(i)) | 0;
+            // Inlined calls ("_[i]" suffix) use flamegraph.pl's aqua palette
+            if (name.endsWith('_[i]')) {
+                const v = Math.abs(hash) % 55;
+                return `rgb(${80 + v},${190 + v},${190 + v})`;
+            }
+            const r = 205 + (Math.abs(hash) % 50);
+            const g = 80 + (Math.abs(hash >> 8) % 130);
+            const b = Math.abs(hash >> 16) % 55;
+            return `rgb(${r},${g},${b})`;
+        }
+
+        function resize() {
+            const width = scroller.clientWidth;
+            const height = Math.min(scroller.clientHeight, (maxDepth + 1) * ROW_HEIGHT);
+            const dpr = window.devicePixelRatio || 1;
+            canvas.width = width * dpr;
+            canvas.height = height * dpr;
+            canvas.style.width = width + 'px';
+            canvas.style.height = height + 'px';
+            ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+            spacer.style.height = ((maxDepth + 1) * ROW_HEIGHT) + 'px';
+            render();
+        }
+
+        function render() {
+            if (!root) return;
+            const width = canvas.clientWidth;
+            const height = canvas.clientHeight;
+            ctx.clearRect(0, 0, width, height);
+            ctx.font = '12px monospace';
+            ctx.textBaseline = 'middle';
+
+            const focus = zoomNode || root;
+            const scale = width / focus.value;
+            const firstRow = Math.floor(scroller.scrollTop / ROW_HEIGHT);
+            const lastRow = firstRow + Math.ceil(height / ROW_HEIGHT);
+            const topOffset = scroller.scrollTop;
+
+            // 缩放节点的祖先占满整行
+            for (let n = focus.parent; n; n = n.parent) {
+                drawFrame(n, 0, width, topOffset, firstRow, lastRow);
+            }
+
+            const stack = [focus];
+            while (stack.length > 0) {
+                const node = stack.pop();
+                const x = (node.start - focus.start) * scale;
+                const w = node.value * scale;
+                if (w < 1 || node.depth > lastRow) continue;
+                drawFrame(node, x, w, topOffset, firstRow, lastRow);
+                for (const child of node.children) stack.push(child);
+            }
+        }
+
+        function drawFrame(node, x, w, topOffset, firstRow, lastRow) {
+            if (node.depth < firstRow || node.depth > lastRow) return;
+            const y = node.depth * ROW_HEIGHT - topOffset;
+            const name = names[node.name];
+            const highlighted = searchRegex !== null && searchRegex.test(name);
+            ctx.fillStyle = node === hoverNode ? 'rgb(255,255,160)' : colorFor(name, highlighted);
+            ctx.fillRect(x, y, Math.max(w - 0.5, 0.5), ROW_HEIGHT - 1);
+            if (w > 30) {
+                ctx.fillStyle = '#000';
+                const maxChars = Math.floor((w - 6) / 7);
+                const label = name.length > maxChars ? name.substring(0, Math.max(maxChars - 2, 0)) + '..' : name;
+                ctx.fillText(label, x + 3, y + ROW_HEIGHT / 2);
+            }
+        }
+
+        // 根据坐标查找节点，只遍历覆盖该 x 的分支
+        function nodeAt(px, py) {
+            const focus = zoomNode || root;
+            const depth = Math.floor((py + scroller.scrollTop) / ROW_HEIGHT);
+            if (depth < focus.depth) {
+                let n = focus;
+                while (n && n.depth > depth) n = n.parent;
+                return n;
+            }
+            const value = focus.start + px / canvas.clientWidth * focus.value;
+            let node = focus;
+            while (node && node.depth < depth) {
+                node = node.children.find(c => value >= c.start && value < c.start + c.value);
+            }
+            return node || null;
+        }
+
+        canvas.addEventListener('mousemove', e => {
+            const rect = canvas.getBoundingClientRect();
+            const node = nodeAt(e.clientX - rect.left, e.clientY - rect.top);
+            if (node !== hoverNode) {
+                hoverNode = node;
+                render();
+            }
+            document.getElementById('details').textContent = node
+                ? `${names[node.name]} — ${formatValue(node.value)} (${(node.value * 100 / root.value).toFixed(2)}%)`
+                : ' ';
+        });
+
+        canvas.addEventListener('click', e => {
+            const rect = canvas.getBoundingClientRect();
+            const node = nodeAt(e.clientX - rect.left, e.clientY - rect.top);
+            if (node) {
+                zoomNode = node === root ? null : node;
+                render();
+            }
+        });
+
+        scroller.addEventListener('scroll', () => render());
+        window.addEventListener('resize', () => resize());
+
+        function resetZoom() {
+            zoomNode = null;
+            render();
+        }
+
+        function search() {
+            const term = document.getElementById('search').value;
+            if (!term) return clearSearch();
+            try {
+                searchRegex = new RegExp(term);
+            } catch (e) {
+                searchRegex = new RegExp(term.replace(/[.*+?^${}()|[\]\\]/g, '\\$&'));
+            }
+            // 统计匹配值时不重复计算嵌套（递归）匹配
+            matchedValue = 0;
+            const walk = (node, counted) => {
+                const match = searchRegex.test(names[node.name]);
+                if (match && !counted) matchedValue += node.value;
+                for (const c of node.children) walk(c, counted || match);
+            };
+            walk(root, false);
+            document.getElementById('status').textContent =
+                `匹配: ${formatValue(matchedValue)} (${(matchedValue * 100 / root.value).toFixed(2)}%)`;
+            render();
+        }
+
+        function clearSearch() {
+            searchRegex = null;
+            document.getElementById('search').value = '';
+            showSummary();
+            render();
+        }
+
+        function showSummary() {
+            document.getElementById('status').textContent =
+                `总计: ${formatValue(root.value)}，${names.length} 个不同函数，最大深度 ${maxDepth}。点击帧可放大，点击 root 还原。`;
+        }
+
+        function loadData() {
+            const titles = { cpu: '🔥 CPU 火焰图', heap: '🔥 Heap 内存火焰图', growth: '🔥 Heap Growth 火焰图' };
+            document.getElementById('title').textContent = titles[type] || titles.cpu;
+            const url = type === 'cpu' ? `/api/cpu/flamegraph_json?duration=${duration}` : `/api/${type}/flamegraph_json`;
+            document.getElementById('status').textContent =
+                type === 'cpu' ? `正在采样 ${duration} 秒...` : '正在加载...';
+
+            fetch(url)
+                .then(response => response.json().then(data => {
+                    if (!response.ok) throw new Error(data.error || `HTTP ${response.status}`);
+                    return data;
+                }))
+                .then(data => {
+                    names = data.names;
+                    unit = data.unit;
+                    maxDepth = 0;
+                    zoomNode = null;
+                    hoverNode = null;
+                    root = buildNode(data.tree, null, 0, 0);
+                    showSummary();
+                    resize();
+                })
+                .catch(error => {
+                    document.getElementById('status').textContent = `❌ 加载失败: ${error.message}`;
+                });
+        }
+
+        window.addEventListener('load', loadData);
+    </script>
+</body>
+</html>
+)HTML";
+
 std::string WebResources::getIndexPage() {
     return std::string(INDEX_PAGE);
 }
@@ -1020,4 +1320,8 @@ std::string WebResources::getGrowthSvgViewerPage() {
     return std::string(GROWTH_SVG_VIEWER_PAGE);
 }
 
+std::string WebResources::getFlameGraphViewerPage() {
+    return std::string(FLAMEGRAPH_VIEWER_PAGE);
+}
+
 PROFILER_NAMESPACE_END
@@ -130,3 +130,69 @@ TEST(ProfilerManagerTest, ResolveSymbol) {
 
     SUCCEED() << "Symbol resolution test completed";
 }
+
+// Test 5b: Batch symbol resolution keeps input order and deduplicates
+TEST(ProfilerManagerTest, ResolveSymbolsBatch) {
+    profiler::ProfilerManager profiler;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto helper = reinterpret_cast<uintptr_t>(&helperFunctionForAddrTest);
+    std::vector<uintptr_t> addresses = {helper, 0x10, helper};
+
+    std::vector<std::string> symbols = profiler.resolveSymbolsBatch(addresses);
+
+    ASSERT_EQ(symbols.size(), addresses.size());
+    EXPECT_FALSE(symbols[0].empty());
+    EXPECT_EQ(symbols[0], symbols[2]);
+    // Unmapped addresses come back as hex
+    EXPECT_EQ(symbols[1], "0x10");
+
+    // Enough addresses for several work items: spread over the pool, with the
+    // same answers on a second request that reuses its symbolizers
+    std::vector<uintptr_t> many;
+    for (uintptr_t i = 0; i < 2048; ++i) {
+        many.push_back(helper + i % 16);
+    }
+    for (uintptr_t i = 0; i < 1024; ++i) {
+        many.push_back(0x1000 + i);
+    }
+    std::vector<std::string> first = profiler.resolveSymbolsBatch(many);
+    std::vector<std::string> second = profiler.resolveSymbolsBatch(many);
+    ASSERT_EQ(first.size(), many.size());
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first[0], symbols[0]);
+    EXPECT_EQ(first[2048], "0x1000");
+}
+
+// Test 5c: Background symbol warmup walks every module and reports progress
+TEST(ProfilerManagerTest, SymbolWarmup) {
+    profiler::ProfilerManager profiler;
+    EXPECT_FALSE(profiler.getSymbolWarmupState().running);
+
+    profiler::SymbolWarmupOptions options;
+    options.cpu_percent = 100; // No pauses, keep the test fast
+    ASSERT_TRUE(profiler.startSymbolWarmup(options));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (profiler.getSymbolWarmupState().running && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    profiler::SymbolWarmupState state = profiler.getSymbolWarmupState();
+    EXPECT_FALSE(state.running);
+    EXPECT_TRUE(state.finished);
+    EXPECT_GT(state.modules_total, 0u);
+    EXPECT_EQ(state.modules_done, state.modules_total);
+    EXPECT_TRUE(state.current_module.empty());
+
+    // Symbolization still works after (and is served from) the warmed-up caches
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    void* test_addr = reinterpret_cast<void*>(&helperFunctionForAddrTest);
+    EXPECT_FALSE(profiler.resolveSymbolWithBackward(test_addr).empty());
+
+    // Stopping waits for the thread to exit
+    ASSERT_TRUE(profiler.startSymbolWarmup(profiler::SymbolWarmupOptions()));
+    profiler.stopSymbolWarmup();
+    state = profiler.getSymbolWarmupState();
+    EXPECT_FALSE(state.running);
+    EXPECT_LE(state.modules_done, state.modules_total);
+}
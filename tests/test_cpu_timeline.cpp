@@ -0,0 +1,151 @@
+/// @file test_cpu_timeline.cpp
+/// @brief Tests for timestamped CPU sampling and the Chrome trace view
+
+#include "internal/cpu_timeline.h"
+#include "internal/string_pool.h"
+#include "profiler_manager.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using profiler::internal::CpuTimeline;
+using profiler::internal::formatChromeTrace;
+using profiler::internal::TimelineSample;
+using profiler::internal::TimelineSampler;
+using profiler::internal::timelineProfile;
+
+namespace {
+[[gnu::noinline]] uint64_t timelineSpin(std::chrono::milliseconds duration) {
+    volatile uint64_t sum = 0;
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i) {
+            sum = sum + static_cast<uint64_t>(i);
+        }
+    }
+    return sum;
+}
+
+// Names every address "f<address>" so expected slices can be spelled out
+std::vector<uint32_t> fakeNames(uintptr_t address, profiler::internal::NameScope&) {
+    return {profiler::internal::symbolNames().intern("f" + std::to_string(address))};
+}
+} // namespace
+
+TEST(CpuTimelineTest, SamplesRunningThreads) {
+    TimelineSampler sampler;
+    std::string error;
+    ASSERT_TRUE(sampler.start(error)) << error;
+    EXPECT_TRUE(sampler.isRunning());
+
+    TimelineSampler second;
+    EXPECT_FALSE(second.start(error));
+
+    std::thread worker([] {
+        pthread_setname_np(pthread_self(), "tl-worker");
+        timelineSpin(std::chrono::milliseconds(300));
+    });
+    timelineSpin(std::chrono::milliseconds(300));
+    worker.join();
+    CpuTimeline timeline = sampler.stop();
+    EXPECT_FALSE(sampler.isRunning());
+
+    EXPECT_EQ(timeline.period_us, 10000u);
+    ASSERT_GT(timeline.samples.size(), 10u);
+    bool worker_named = false;
+    for (const auto& [tid, name] : timeline.thread_names) {
+        worker_named = worker_named || name == "tl-worker";
+    }
+    EXPECT_TRUE(worker_named);
+
+    // Samples are in time order and most are taken inside the spin loop
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto spin = reinterpret_cast<uintptr_t>(&timelineSpin);
+    size_t in_spin = 0;
+    for (size_t i = 0; i < timeline.samples.size(); ++i) {
+        const auto& sample = timeline.samples[i];
+        ASSERT_FALSE(sample.stack.empty());
+        EXPECT_LE(sample.time_ns, timeline.duration_ns);
+        if (i > 0) {
+            EXPECT_LE(timeline.samples[i - 1].time_ns, sample.time_ns);
+        }
+        for (uintptr_t pc : sample.stack) {
+            if (pc >= spin && pc < spin + 512) {
+                ++in_spin;
+                break;
+            }
+        }
+    }
+    EXPECT_GT(in_spin, timeline.samples.size() / 2);
+
+    // The sampler can be started again once stopped
+    ASSERT_TRUE(second.start(error)) << error;
+    second.stop();
+}
+
+TEST(CpuTimelineTest, FormatsFlameChartSlices) {
+    CpuTimeline timeline;
+    timeline.period_us = 10000;
+    timeline.thread_names[7] = "main";
+    // Leaf first; callers are return addresses, shown as address - 1
+    timeline.samples = {
+        TimelineSample{0, 7, {0x10, 0x21}},
+        TimelineSample{10000000, 7, {0x10, 0x21}},
+        TimelineSample{20000000, 7, {0x30, 0x21}},
+        TimelineSample{100000000, 7, {0x30, 0x21}}, // After a gap: new slices
+    };
+    std::string trace = formatChromeTrace(timeline, fakeNames);
+    EXPECT_NE(trace.find("\"name\":\"thread_name\",\"pid\":"), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"main\"}"), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"f16\",\"pid\":"), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"f32\",\"pid\":"), std::string::npos); // 0x21 - 1
+    EXPECT_NE(trace.find("\"tid\":7,\"ts\":0.000,\"dur\":20000.000}"), std::string::npos);  // f16
+    EXPECT_NE(trace.find("\"tid\":7,\"ts\":0.000,\"dur\":30000.000}"), std::string::npos);  // f32 before the gap
+    EXPECT_NE(trace.find("\"tid\":7,\"ts\":20000.000,\"dur\":10000.000}"), std::string::npos);
+    EXPECT_NE(trace.find("\"tid\":7,\"ts\":100000.000,\"dur\":10000.000}"), std::string::npos);
+    EXPECT_EQ(trace.back(), '}');
+}
+
+TEST(CpuTimelineTest, FiltersByTimeRange) {
+    CpuTimeline timeline;
+    timeline.period_us = 10000;
+    for (uint64_t i = 0; i < 10; ++i) {
+        timeline.samples.push_back({i * 10000000, 1, {0x10 + i}});
+    }
+    auto profile = timelineProfile(timeline, 20000000, 50000000);
+    ASSERT_EQ(profile.samples.size(), 3u);
+    EXPECT_EQ(profile.samples[0].stack[0], 0x12u);
+    EXPECT_EQ(profile.samples[0].value, 1u);
+    EXPECT_EQ(profile.period_us, 10000u);
+    EXPECT_TRUE(timelineProfile(timeline, 200000000, 300000000).samples.empty());
+}
+
+TEST(CpuTimelineTest, ManagerKeepsTimelineForZooming) {
+    profiler::ProfilerManager profiler;
+    EXPECT_FALSE(profiler.hasCPUTimeline());
+    EXPECT_TRUE(profiler.getTimelineFolded(0, -1).empty());
+
+    std::atomic<bool> stop{false};
+    std::thread busy([&] {
+        while (!stop) {
+            timelineSpin(std::chrono::milliseconds(10));
+        }
+    });
+    std::string trace = profiler.getCPUTimelineTrace(1);
+    stop = true;
+    busy.join();
+
+    ASSERT_FALSE(trace.empty());
+    EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\""), 0u);
+    EXPECT_NE(trace.find("\"ph\":\"X\""), std::string::npos);
+    ASSERT_TRUE(profiler.hasCPUTimeline());
+
+    std::string all = profiler.getTimelineFolded(0, -1);
+    EXPECT_NE(all.find("timelineSpin"), std::string::npos);
+    EXPECT_NE(profiler.getTimelineFlameGraphJson(0, 500).find("\"unit\":\"samples\""), std::string::npos);
+    EXPECT_TRUE(profiler.getTimelineFolded(5000, 6000).empty());
+}
@@ -0,0 +1,88 @@
+/// @file test_fleet_merge.cpp
+/// @brief Tests for merging folded-stack profiles across instances
+
+#include "internal/fleet_merge.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using profiler::internal::FleetInstance;
+using profiler::internal::FleetMergeOptions;
+using profiler::internal::FoldedStacks;
+using profiler::internal::mergeFleetProfiles;
+using profiler::internal::parseFoldedStacks;
+
+namespace {
+FleetInstance instance(const std::string& name, const FoldedStacks& stacks, double weight = 1.0) {
+    return {name, stacks, weight};
+}
+} // namespace
+
+TEST(FleetMergeTest, ParsesFoldedStacks) {
+    FoldedStacks stacks;
+    ASSERT_TRUE(parseFoldedStacks("main;work 10\nmain;idle 3\r\n\nmain;work 5\n", stacks));
+    EXPECT_EQ(stacks.size(), 2u);
+    EXPECT_EQ(stacks["main;work"], 15u);
+    EXPECT_EQ(stacks["main;idle"], 3u);
+
+    // Frame names may contain spaces; the value is after the last one
+    ASSERT_TRUE(parseFoldedStacks("main;operator new(unsigned long) 7", stacks));
+    EXPECT_EQ(stacks["main;operator new(unsigned long)"], 7u);
+
+    EXPECT_FALSE(parseFoldedStacks("main;work\n", stacks));
+    EXPECT_FALSE(parseFoldedStacks("main;work ten\n", stacks));
+    EXPECT_FALSE(parseFoldedStacks("{\"error\":\"x\"}", stacks));
+}
+
+TEST(FleetMergeTest, NormalizesAndWeightsInstances) {
+    std::vector<FleetInstance> fleet = {
+        instance("a", {{"main;x", 100}, {"main;y", 50}}),
+        instance("b", {{"main;x", 200}, {"main;y", 100}}), // Twice as busy, same mix
+        instance("c", {}),                                  // Nothing sampled
+    };
+    FleetMergeOptions options;
+    auto result = mergeFleetProfiles(fleet, options);
+    // Both scaled to the median total (225)
+    EXPECT_EQ(result.merged["main;x"], 300u);
+    EXPECT_EQ(result.merged["main;y"], 150u);
+    EXPECT_TRUE(result.instances[0].merged);
+    EXPECT_FALSE(result.instances[2].merged);
+    EXPECT_EQ(result.instances[1].total, 300u);
+
+    options.normalize = false;
+    fleet[0].weight = 2.0;
+    result = mergeFleetProfiles(fleet, options);
+    EXPECT_EQ(result.merged["main;x"], 400u);
+    EXPECT_EQ(result.merged["main;y"], 200u);
+}
+
+TEST(FleetMergeTest, DetectsOutliers) {
+    std::vector<FleetInstance> fleet;
+    for (int i = 0; i < 6; ++i) {
+        fleet.push_back(instance("ok" + std::to_string(i), {{"main;x", 90u + i * 4}, {"main;y", 50u + i}}));
+    }
+    // Same volume, but spinning in a stack nobody else has
+    fleet.push_back(instance("spinning", {{"main;spin", 140}, {"main;x", 5}}));
+
+    auto result = mergeFleetProfiles(fleet, FleetMergeOptions());
+    for (size_t i = 0; i < 6; ++i) {
+        EXPECT_FALSE(result.instances[i].outlier) << result.instances[i].score;
+        EXPECT_LT(result.instances[i].distance, 0.2); // The mix includes the spinning share
+    }
+    EXPECT_TRUE(result.instances[6].outlier);
+    EXPECT_FALSE(result.instances[6].merged);
+    EXPECT_GT(result.instances[6].distance, 0.8);
+    EXPECT_EQ(result.merged.count("main;spin"), 0u);
+
+    FleetMergeOptions keep;
+    keep.drop_outliers = false;
+    result = mergeFleetProfiles(fleet, keep);
+    EXPECT_TRUE(result.instances[6].outlier);
+    EXPECT_GT(result.merged["main;spin"], 0u);
+
+    // Too few instances to tell what is normal
+    fleet.erase(fleet.begin() + 1, fleet.begin() + 6);
+    result = mergeFleetProfiles(fleet, FleetMergeOptions());
+    EXPECT_FALSE(result.instances[1].outlier);
+    EXPECT_GT(result.merged["main;spin"], 0u);
+}
@@ -0,0 +1,118 @@
+/// @file test_http_compression.cpp
+/// @brief Tests for Accept-Encoding negotiation and response compression
+
+#include "internal/http_compression.h"
+#include "profiler/http_handlers.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <zlib.h>
+
+using profiler::HandlerResponse;
+using profiler::ProfilerHttpHandlers;
+using profiler::internal::ContentEncoding;
+using profiler::internal::negotiateEncoding;
+
+namespace {
+std::string gunzip(const std::string& data) {
+    z_stream stream{};
+    EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    std::string out;
+    char buffer[4096];
+    int status = Z_OK;
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    EXPECT_EQ(status, Z_STREAM_END);
+    return out;
+}
+
+// A folded-stack-like body: repetitive, as profiles are
+std::string sampleBody() {
+    std::string body;
+    for (int i = 0; i < 20000; ++i) {
+        body += "main;worker_loop;process_request;parse_header " + std::to_string(i % 97) + "\n";
+    }
+    return body;
+}
+} // namespace
+
+TEST(HttpCompressionTest, NegotiatesEncoding) {
+    EXPECT_EQ(negotiateEncoding("", true), ContentEncoding::Identity);
+    EXPECT_EQ(negotiateEncoding("gzip, deflate, br", true), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiateEncoding("GZIP", true), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiateEncoding("gzip;q=0, deflate", true), ContentEncoding::Identity);
+    EXPECT_EQ(negotiateEncoding("gzip;q=0.5, zstd", true), ContentEncoding::Zstd);
+    EXPECT_EQ(negotiateEncoding("gzip;q=0.5, zstd", false), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiateEncoding("zstd", false), ContentEncoding::Identity);
+    EXPECT_EQ(negotiateEncoding("*", false), ContentEncoding::Gzip);
+
+    // "*" does not override a coding refused by name
+    EXPECT_EQ(negotiateEncoding("gzip;q=0, *", false), ContentEncoding::Identity);
+    EXPECT_EQ(negotiateEncoding("zstd;q=0, *", true), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiateEncoding("*;q=0, gzip", true), ContentEncoding::Gzip);
+
+    // The client's preference decides between gzip and zstd
+    EXPECT_EQ(negotiateEncoding("gzip;q=1, zstd;q=0.5", true), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiateEncoding("gzip;q=0.5, *;q=0.8", true), ContentEncoding::Zstd);
+    EXPECT_EQ(negotiateEncoding("gzip, zstd", true), ContentEncoding::Zstd);
+}
+
+TEST(HttpCompressionTest, GzipRoundTrip) {
+    std::string body = sampleBody();
+    std::string compressed;
+    ASSERT_TRUE(profiler::internal::gzipCompress(body, compressed));
+    EXPECT_LT(compressed.size() * 10, body.size());
+    EXPECT_EQ(gunzip(compressed), body);
+
+    ASSERT_TRUE(profiler::internal::gzipCompress("", compressed));
+    EXPECT_EQ(gunzip(compressed), "");
+}
+
+TEST(HttpCompressionTest, CompressesTextualResponses) {
+    auto resp = HandlerResponse::text(sampleBody());
+    resp.headers["ETag"] = "\"abc\"";
+
+    auto gzipped = ProfilerHttpHandlers::compress(resp, "gzip");
+    EXPECT_EQ(gzipped.headers["Content-Encoding"], "gzip");
+    EXPECT_EQ(gzipped.headers["Vary"], "Accept-Encoding");
+    EXPECT_EQ(gzipped.headers["ETag"], "W/\"abc\"");
+    EXPECT_EQ(gunzip(gzipped.body), resp.body);
+
+    // The weak tag of the compressed representation still revalidates
+    EXPECT_EQ(ProfilerHttpHandlers::conditional(gzipped, "W/\"abc\"").status, 304);
+
+    EXPECT_EQ(ProfilerHttpHandlers::compress(resp, "").body, resp.body);
+    EXPECT_EQ(ProfilerHttpHandlers::compress(HandlerResponse::text("short"), "gzip").body, "short");
+    EXPECT_EQ(ProfilerHttpHandlers::compress(HandlerResponse::binary(resp.body, "profile"), "gzip").body, resp.body);
+    auto error = HandlerResponse::error(500, resp.body);
+    EXPECT_EQ(ProfilerHttpHandlers::compress(error, "gzip").body, error.body);
+}
+
+TEST(HttpCompressionTest, PrecompressedPages) {
+    std::string html = "<html><body>" + sampleBody() + "</body></html>";
+    profiler::internal::PrecompressedResponse page(HandlerResponse::html(html));
+
+    auto plain = page.select("");
+    EXPECT_EQ(plain.body, html);
+    EXPECT_EQ(plain.content_type, "text/html");
+    EXPECT_EQ(plain.headers.count("Content-Encoding"), 0u);
+    ASSERT_EQ(plain.headers.count("ETag"), 1u);
+
+    auto gzipped = page.select("gzip, deflate");
+    EXPECT_EQ(gzipped.headers["Content-Encoding"], "gzip");
+    EXPECT_EQ(gzipped.headers["ETag"], "W/" + plain.headers["ETag"]);
+    EXPECT_EQ(gunzip(gzipped.body), html);
+
+    auto zstd = page.select("zstd");
+    if (profiler::internal::zstdAvailable()) {
+        EXPECT_EQ(zstd.headers["Content-Encoding"], "zstd");
+    } else {
+        EXPECT_EQ(zstd.body, html);
+    }
+}
@@ -0,0 +1,242 @@
+/// @file test_http_server.cpp
+/// @brief Tests for the built-in HTTP/1.1 server and request dispatch
+
+#include "internal/http_message.h"
+#include "profiler/http_server.h"
+#include "profiler_manager.h"
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+using profiler::HttpServerOptions;
+using profiler::ProfilerHttpHandlers;
+using profiler::ProfilerHttpServer;
+using profiler::internal::HttpParseStatus;
+using profiler::internal::HttpRequest;
+using profiler::internal::parseHttpRequest;
+
+namespace {
+int connectTo(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+int connectUnix(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    bool abstract = path.front() == '@';
+    if (abstract) {
+        addr.sun_path[0] = '\0';
+    }
+    auto len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (abstract ? 0 : 1));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+        close(fd);
+        return -1;
+    }
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+void sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+// Read one response (head plus Content-Length bytes of body, none for HEAD); bytes
+// of the following pipelined responses stay in `data`
+std::string readResponse(int fd, std::string& data, bool head_only = false) {
+    char buffer[4096];
+    for (;;) {
+        size_t head_end = data.find("\r\n\r\n");
+        if (head_end != std::string::npos) {
+            size_t pos = data.find("Content-Length: ");
+            size_t length = pos == std::string::npos || head_only ? 0 : std::stoul(data.substr(pos + 16));
+            if (data.size() >= head_end + 4 + length) {
+                std::string response = data.substr(0, head_end + 4 + length);
+                data.erase(0, response.size());
+                return response;
+            }
+        }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return std::exchange(data, std::string());
+        }
+        data.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+int statusOf(const std::string& response) {
+    return response.size() > 12 ? std::stoi(response.substr(9, 3)) : 0;
+}
+} // namespace
+
+TEST(HttpServerTest, ParsesRequests) {
+    HttpRequest request;
+    size_t consumed = 0;
+    std::string data = "GET /api/cpu/folded?duration=5&x=a%20b+c HTTP/1.1\r\nHost: h\r\nAccept-Encoding: gzip\r\n\r\n";
+    ASSERT_EQ(parseHttpRequest(data + "GET /next", 4096, request, consumed), HttpParseStatus::Complete);
+    EXPECT_EQ(consumed, data.size());
+    EXPECT_EQ(request.method, "GET");
+    EXPECT_EQ(request.path, "/api/cpu/folded");
+    EXPECT_EQ(request.params["duration"], "5");
+    EXPECT_EQ(request.params["x"], "a b c");
+    EXPECT_EQ(request.header("accept-encoding"), "gzip");
+    EXPECT_TRUE(request.keep_alive);
+
+    data = "POST /pprof/symbol HTTP/1.0\r\nContent-Length: 5\r\n\r\n0x123";
+    EXPECT_EQ(parseHttpRequest(data.substr(0, data.size() - 1), 4096, request, consumed),
+              HttpParseStatus::Incomplete);
+    ASSERT_EQ(parseHttpRequest(data, 4096, request, consumed), HttpParseStatus::Complete);
+    EXPECT_EQ(request.body, "0x123");
+    EXPECT_FALSE(request.keep_alive);
+
+    EXPECT_EQ(parseHttpRequest("GET / HTTP/1.1\r\n", 4096, request, consumed), HttpParseStatus::Incomplete);
+    EXPECT_EQ(parseHttpRequest("garbage\r\n\r\n", 4096, request, consumed), HttpParseStatus::Invalid);
+    EXPECT_EQ(parseHttpRequest("GET / HTTP/1.1\r\nbad header\r\n\r\n", 4096, request, consumed),
+              HttpParseStatus::Invalid);
+    EXPECT_EQ(parseHttpRequest("POST / HTTP/1.1\r\nContent-Length: 9999\r\n\r\n", 4096, request, consumed),
+              HttpParseStatus::TooLarge);
+    EXPECT_EQ(parseHttpRequest("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", 4096, request, consumed),
+              HttpParseStatus::Unsupported);
+}
+
+TEST(HttpServerTest, DispatchRoutesByPathAndMethod) {
+    profiler::ProfilerManager profiler;
+    ProfilerHttpHandlers handlers(profiler);
+    EXPECT_EQ(handlers.dispatch("GET", "/api/status").status, 200);
+    EXPECT_EQ(handlers.dispatch("GET", "/no/such/path").status, 404);
+
+    auto resp = handlers.dispatch("GET", "/pprof/symbol");
+    EXPECT_EQ(resp.status, 405);
+    EXPECT_EQ(resp.headers["Allow"], "POST");
+    EXPECT_EQ(handlers.dispatch("POST", "/api/status").status, 405);
+    EXPECT_EQ(handlers.dispatch("GET", "/api/heap/analyze", {{"output_type", "bogus"}}).status, 400);
+    // Zooming needs a /api/cpu/timeline capture first
+    EXPECT_EQ(handlers.dispatch("GET", "/api/cpu/folded", {{"from", "100"}, {"to", "300"}}).status, 404);
+}
+
+TEST(HttpServerTest, ServesKeepAliveAndPipelinedRequests) {
+    profiler::ProfilerManager profiler;
+    HttpServerOptions options;
+    options.host = "127.0.0.1";
+    options.port = 0;
+    ProfilerHttpServer server(profiler, options);
+    ASSERT_TRUE(server.start()) << server.lastError();
+    uint16_t port = server.port();
+    ASSERT_NE(port, 0);
+    EXPECT_FALSE(server.start());
+
+    int fd = connectTo(port);
+    ASSERT_GE(fd, 0);
+    std::string pending;
+    sendAll(fd, "GET /api/status HTTP/1.1\r\nHost: x\r\n\r\n");
+    std::string first = readResponse(fd, pending);
+    EXPECT_EQ(statusOf(first), 200);
+    EXPECT_NE(first.find("Content-Type: application/json"), std::string::npos);
+    EXPECT_NE(first.find("Connection: keep-alive"), std::string::npos);
+
+    // Two pipelined requests on the same connection come back in order
+    sendAll(fd, "GET /missing HTTP/1.1\r\n\r\nHEAD /api/status HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_EQ(statusOf(readResponse(fd, pending)), 404);
+    std::string head = readResponse(fd, pending, true);
+    EXPECT_EQ(statusOf(head), 200);
+    EXPECT_NE(head.find("Connection: close"), std::string::npos);
+    char byte;
+    EXPECT_TRUE(pending.empty());
+    EXPECT_EQ(recv(fd, &byte, 1, 0), 0); // Body omitted for HEAD, then closed
+    close(fd);
+
+    server.stop();
+    EXPECT_FALSE(server.isRunning());
+    EXPECT_EQ(server.port(), 0);
+    EXPECT_LT(connectTo(port), 0);
+}
+
+TEST(HttpServerTest, RejectsMalformedAndOversizedRequests) {
+    profiler::ProfilerManager profiler;
+    HttpServerOptions options;
+    options.host = "127.0.0.1";
+    options.port = 0;
+    options.max_request_bytes = 1024;
+    ProfilerHttpServer server(profiler, options);
+    ASSERT_TRUE(server.start()) << server.lastError();
+
+    std::string pending;
+    int fd = connectTo(server.port());
+    sendAll(fd, "NONSENSE\r\n\r\n");
+    EXPECT_EQ(statusOf(readResponse(fd, pending)), 400);
+    close(fd);
+
+    fd = connectTo(server.port());
+    sendAll(fd, "POST /pprof/symbol HTTP/1.1\r\nContent-Length: 4096\r\n\r\n");
+    EXPECT_EQ(statusOf(readResponse(fd, pending)), 413);
+    close(fd);
+
+    options.host = "not an address";
+    ProfilerHttpServer bad(profiler, options);
+    EXPECT_FALSE(bad.start());
+    EXPECT_FALSE(bad.lastError().empty());
+}
+
+TEST(HttpServerTest, ServesOverUnixSockets) {
+    profiler::ProfilerManager profiler;
+    std::string file = "/tmp/profiler-test-" + std::to_string(getpid()) + ".sock";
+    for (const std::string& path : {"@profiler-test-" + std::to_string(getpid()), file}) {
+        HttpServerOptions options;
+        options.host.clear();
+        options.unix_socket = path;
+        ProfilerHttpServer server(profiler, options);
+        ASSERT_TRUE(server.start()) << server.lastError();
+        EXPECT_EQ(server.port(), 0);
+
+        // A second server cannot take over a socket that is still served
+        ProfilerHttpServer second(profiler, options);
+        EXPECT_FALSE(second.start());
+
+        int fd = connectUnix(path);
+        ASSERT_GE(fd, 0) << path;
+        std::string pending;
+        sendAll(fd, "GET /api/status HTTP/1.1\r\n\r\n");
+        std::string response = readResponse(fd, pending);
+        EXPECT_EQ(statusOf(response), 200) << path;
+        EXPECT_NE(response.find("\"cpu\""), std::string::npos);
+        close(fd);
+        server.stop();
+    }
+
+    // The socket file is removed on stop
+    struct stat st;
+    EXPECT_NE(lstat(file.c_str(), &st), 0);
+
+    HttpServerOptions none;
+    none.host.clear();
+    ProfilerHttpServer server(profiler, none);
+    EXPECT_FALSE(server.start());
+}
@@ -0,0 +1,167 @@
+/// @file test_module_map.cpp
+/// @brief Tests for the loaded-module table and per-module resolvers
+
+#include "internal/dwarf_inline.h"
+#include "internal/dwarf_line.h"
+#include "internal/elf_file.h"
+#include "internal/module_map.h"
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using profiler::internal::ModuleInfo;
+using profiler::internal::ModuleMap;
+
+namespace {
+constexpr unsigned int kProbeLine = __LINE__ + 1;
+int moduleMapProbe(int x) {
+    return x + 1;
+}
+
+[[gnu::noinline]] uintptr_t probeReturnAddress() {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+}
+
+[[gnu::always_inline]] inline uintptr_t inlinedProbe() {
+    uintptr_t pc = probeReturnAddress();
+    asm volatile("" ::: "memory"); // Keep the call from becoming a tail call
+    return pc;
+}
+
+constexpr unsigned int kInlineCallLine = __LINE__ + 2;
+[[gnu::noinline]] uintptr_t inlineProbeCaller() {
+    uintptr_t pc = inlinedProbe();
+    asm volatile("" ::: "memory");
+    return pc;
+}
+} // namespace
+
+TEST(ModuleMapTest, ParsesExecutableMappings) {
+    std::string maps = "55d0c0000000-55d0c0001000 r--p 00000000 08:01 1234 /usr/bin/app\n"
+                       "55d0c0001000-55d0c0005000 r-xp 00001000 08:01 1234 /usr/bin/app\n"
+                       "55d0c0005000-55d0c0006000 rw-p 00005000 08:01 1234 /usr/bin/app\n"
+                       "55d0c1000000-55d0c1021000 rw-p 00000000 00:00 0    [heap]\n"
+                       "7f0000000000-7f0000100000 r-xp 00028000 08:01 99   /usr/lib/libc.so.6\n"
+                       "7ffd00000000-7ffd00002000 r-xp 00000000 00:00 0    [vdso]\n";
+
+    std::vector<ModuleInfo> modules = ModuleMap::parseProcMaps(maps);
+    ASSERT_EQ(modules.size(), 2u);
+    EXPECT_EQ(modules[0].path, "/usr/bin/app");
+    EXPECT_EQ(modules[0].start, 0x55d0c0001000u);
+    EXPECT_EQ(modules[0].end, 0x55d0c0005000u);
+    EXPECT_EQ(modules[0].load_bias, 0x55d0c0000000u);
+    EXPECT_EQ(modules[1].path, "/usr/lib/libc.so.6");
+    EXPECT_EQ(modules[1].offset, 0x28000u);
+}
+
+TEST(ModuleMapTest, FindsOwnExecutable) {
+    ModuleMap map;
+    map.refresh();
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto probe = reinterpret_cast<uintptr_t>(&moduleMapProbe);
+    ModuleInfo module;
+    ASSERT_TRUE(map.find(probe, module));
+    EXPECT_TRUE(module.contains(probe));
+    EXPECT_FALSE(module.path.empty());
+    EXPECT_FALSE(map.find(0x10, module));
+
+    // A second refresh without dlopen/dlclose keeps the same table
+    size_t count = map.modules().size();
+    map.refresh();
+    EXPECT_EQ(map.modules().size(), count);
+}
+
+TEST(ModuleMapTest, ResolverNamesOwnFunction) {
+    ModuleMap map;
+    map.refresh();
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto probe = reinterpret_cast<uintptr_t>(&moduleMapProbe);
+    ModuleInfo module;
+    ASSERT_TRUE(map.find(probe, module));
+
+    std::vector<profiler::internal::ModuleResolver::Result> results;
+    if (!map.resolverFor(module)->resolve({probe - module.load_bias, probe - module.load_bias}, results)) {
+        GTEST_SKIP() << "addr2line not available";
+    }
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_NE(results[0].function.find("moduleMapProbe"), std::string::npos);
+    EXPECT_EQ(results[0].function, results[1].function);
+    // The resolver is cached per module
+    EXPECT_EQ(map.resolverFor(module), map.resolverFor(module));
+}
+
+TEST(ModuleMapTest, DwarfLineTableFindsProbeLine) {
+    ModuleMap map;
+    map.refresh();
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto probe = reinterpret_cast<uintptr_t>(&moduleMapProbe);
+    ModuleInfo module;
+    ASSERT_TRUE(map.find(probe, module));
+
+    std::string file;
+    unsigned int line = 0;
+    if (!map.lineTableFor(module)->lookup(probe - module.load_bias, file, line)) {
+        GTEST_SKIP() << "test binary built without debug info";
+    }
+    EXPECT_NE(file.find("test_module_map.cpp"), std::string::npos) << file;
+    // The entry maps to the signature, or to the body when the prologue is optimized away
+    EXPECT_GE(line, kProbeLine);
+    EXPECT_LE(line, kProbeLine + 2);
+
+    // Not covered by any compilation unit
+    EXPECT_FALSE(map.lineTableFor(module)->lookup(0x10, file, line));
+}
+
+TEST(ModuleMapTest, DwarfInlineIndexExpandsInlinedCall) {
+    ModuleMap map;
+    map.refresh();
+
+    // The return address of the call made by inlinedProbe() lies inside its inlined copy
+    uintptr_t pc = inlineProbeCaller() - 1;
+    ModuleInfo module;
+    ASSERT_TRUE(map.find(pc, module));
+
+    std::vector<profiler::internal::InlineFrame> frames;
+    if (!map.inlineIndexFor(module)->lookup(pc - module.load_bias, frames)) {
+        GTEST_SKIP() << "test binary built without debug info";
+    }
+    ASSERT_FALSE(frames.empty());
+    EXPECT_NE(frames.back().function.find("inlinedProbe"), std::string::npos) << frames.back().function;
+    EXPECT_NE(frames.back().call_file.find("test_module_map.cpp"), std::string::npos) << frames.back().call_file;
+    EXPECT_EQ(frames.back().call_line, kInlineCallLine);
+
+    // A function that is not inlined anywhere has no inline frames
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto probe = reinterpret_cast<uintptr_t>(&moduleMapProbe);
+    EXPECT_FALSE(map.inlineIndexFor(module)->lookup(probe - module.load_bias, frames));
+}
+
+TEST(ModuleMapTest, DwarfLineTableResolvesCompDirWithoutAranges) {
+    // A DWARF 4 library without .debug_aranges: its line program names the
+    // source relative to DW_AT_comp_dir, which only the unit DIE records
+    char dir_template[] = "/tmp/dwarf_comp_dir_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string dir = dir_template;
+    std::ofstream(dir + "/probe.c") << "int probe(int x) { return x + 1; }\n";
+    std::string build = "cd " + dir + " && cc -shared -fPIC -gdwarf-4 -o probe.so probe.c 2>/dev/null && " +
+                        "objcopy --remove-section=.debug_aranges probe.so 2>/dev/null";
+    if (std::system(build.c_str()) != 0) {
+        std::system(("rm -rf " + dir).c_str());
+        GTEST_SKIP() << "cc or objcopy not available";
+    }
+
+    auto elf = std::make_shared<profiler::internal::ElfFile>();
+    ASSERT_TRUE(elf->open(dir + "/probe.so"));
+    EXPECT_TRUE(elf->section(".debug_aranges").empty());
+    profiler::internal::DwarfLineTable table(elf);
+    // The only unit's program is the first one; file 1 is probe.c in directory 0
+    EXPECT_EQ(table.fileName(0, 1), dir + "/probe.c");
+    std::system(("rm -rf " + dir).c_str());
+}
@@ -0,0 +1,138 @@
+/// @file test_profile_merge.cpp
+/// @brief Tests for merging unsymbolized profiles across time slices and processes
+
+#include "internal/profile_merge.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using profiler::internal::mergeSymbolBundles;
+using profiler::internal::ModuleInfo;
+using profiler::internal::SymbolBundle;
+
+namespace {
+ModuleInfo module(const std::string& path, uintptr_t start, uintptr_t end, const std::string& build_id) {
+    ModuleInfo info;
+    info.path = path;
+    info.start = start;
+    info.end = end;
+    info.offset = 0x1000;
+    info.load_bias = start - 0x1000;
+    info.build_id = build_id;
+    return info;
+}
+
+SymbolBundle bundle(std::vector<ModuleInfo> modules, std::vector<SymbolBundle::Sample> samples) {
+    SymbolBundle out;
+    out.kind = SymbolBundle::Kind::Cpu;
+    out.period_us = 10000;
+    out.modules = std::move(modules);
+    out.samples = std::move(samples);
+    return out;
+}
+
+uint64_t valueOf(const SymbolBundle& merged, const std::vector<uintptr_t>& stack) {
+    for (const auto& sample : merged.samples) {
+        if (sample.stack == stack) {
+            return sample.value;
+        }
+    }
+    return 0;
+}
+} // namespace
+
+TEST(ProfileMergeTest, RemapsModulesByBuildId) {
+    // The same executable and library in two processes with different ASLR layouts
+    auto app_a = module("/usr/bin/app", 0x555500001000, 0x555500009000, "aaaa");
+    auto lib_a = module("/usr/lib/libx.so", 0x7f0000001000, 0x7f0000003000, "bbbb");
+    auto app_b = module("/usr/bin/app", 0x560000001000, 0x560000009000, "aaaa");
+    auto lib_b = module("/opt/libx.so", 0x7f1000001000, 0x7f1000003000, "bbbb");
+    std::vector<SymbolBundle> inputs = {
+        bundle({app_a, lib_a}, {{3, 0, "", {0x7f0000001100, 0x555500002000}}, {1, 0, "", {0x555500002000}}}),
+        bundle({app_b, lib_b},
+               {{4, 1, "t", {0x7f1000001100, 0x560000002000}}, {2, 2, "", {0x7f1000001100, 0x560000002000}}}),
+    };
+
+    SymbolBundle merged;
+    std::string error;
+    ASSERT_TRUE(mergeSymbolBundles(inputs, merged, error));
+    EXPECT_EQ(merged.kind, SymbolBundle::Kind::Cpu);
+    ASSERT_EQ(merged.modules.size(), 2u);
+    EXPECT_EQ(merged.modules[0].start, app_a.start);
+    EXPECT_EQ(merged.modules[1].load_bias, lib_a.load_bias);
+    ASSERT_EQ(merged.samples.size(), 2u);
+    EXPECT_EQ(valueOf(merged, {0x7f0000001100, 0x555500002000}), 9u);
+    EXPECT_EQ(valueOf(merged, {0x555500002000}), 1u);
+    EXPECT_EQ(merged.samples[0].tid, 0u);
+}
+
+TEST(ProfileMergeTest, RelocatesOverlappingModules) {
+    // Two different libraries loaded at the same address in two processes
+    auto first = module("/usr/lib/liba.so", 0x7f0000001000, 0x7f0000005000, "1111");
+    auto second = module("/usr/lib/libb.so", 0x7f0000001000, 0x7f0000003000, "2222");
+    std::vector<SymbolBundle> inputs = {
+        bundle({first}, {{1, 0, "", {0x7f0000001234}}}),
+        bundle({second}, {{1, 0, "", {0x7f0000001234, 0x400000}}}), // 0x400000 is outside every module
+    };
+    SymbolBundle merged;
+    std::string error;
+    ASSERT_TRUE(mergeSymbolBundles(inputs, merged, error));
+    ASSERT_EQ(merged.modules.size(), 2u);
+    const auto& moved = merged.modules[1];
+    EXPECT_EQ(moved.path, "/usr/lib/libb.so");
+    EXPECT_GE(moved.start, merged.modules[0].end);
+    EXPECT_EQ(moved.end - moved.start, second.end - second.start);
+    EXPECT_EQ(moved.start - moved.load_bias, second.start - second.load_bias);
+
+    // The link-time address within the library is unchanged
+    EXPECT_EQ(valueOf(merged, {0x7f0000001234}), 1u);
+    EXPECT_EQ(valueOf(merged, {0x7f0000001234 - second.load_bias + moved.load_bias, 0x400000}), 1u);
+}
+
+TEST(ProfileMergeTest, MergesManyInputsInParallel) {
+    auto app = module("/usr/bin/app", 0x1000, 0x100000, "");
+    std::vector<SymbolBundle> inputs;
+    for (int i = 0; i < 32; ++i) {
+        std::vector<SymbolBundle::Sample> samples;
+        for (uintptr_t leaf = 0; leaf < 50; ++leaf) {
+            samples.push_back({1, 0, "", {0x2000 + leaf, 0x1500}});
+            samples.push_back({2, 0, "", {0x3000 + (leaf + static_cast<uintptr_t>(i)) % 50}});
+        }
+        inputs.push_back(bundle({app}, samples));
+    }
+    inputs[1].period_us = 20000; // Each of its samples stands for twice the CPU time
+
+    SymbolBundle merged;
+    std::string error;
+    ASSERT_TRUE(mergeSymbolBundles(inputs, merged, error, 4));
+    ASSERT_EQ(merged.samples.size(), 100u);
+    uint64_t total = 0;
+    for (size_t i = 0; i < merged.samples.size(); ++i) {
+        total += merged.samples[i].value;
+        if (i > 0) {
+            EXPECT_LT(merged.samples[i - 1].stack, merged.samples[i].stack);
+        }
+    }
+    EXPECT_EQ(total, 33u * 150u);
+    EXPECT_EQ(valueOf(merged, {0x2000, 0x1500}), 33u);
+
+    SymbolBundle serial;
+    ASSERT_TRUE(mergeSymbolBundles(inputs, serial, error, 1));
+    ASSERT_EQ(serial.samples.size(), merged.samples.size());
+    for (size_t i = 0; i < serial.samples.size(); ++i) {
+        EXPECT_EQ(serial.samples[i].stack, merged.samples[i].stack);
+        EXPECT_EQ(serial.samples[i].value, merged.samples[i].value);
+    }
+}
+
+TEST(ProfileMergeTest, RejectsMixedKinds) {
+    std::vector<SymbolBundle> inputs(2);
+    inputs[1].kind = SymbolBundle::Kind::Heap;
+    SymbolBundle merged;
+    std::string error;
+    EXPECT_FALSE(mergeSymbolBundles(inputs, merged, error));
+    EXPECT_FALSE(error.empty());
+
+    EXPECT_TRUE(mergeSymbolBundles({}, merged, error));
+    EXPECT_TRUE(merged.samples.empty());
+}
@@ -0,0 +1,192 @@
+/// @file test_profile_parser.cpp
+/// @brief Tests for in-process profile parsing and folded stack output
+
+#include "internal/flame_tree.h"
+#include "internal/folded_stacks.h"
+#include "internal/profile_parser.h"
+#include "internal/string_pool.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+using profiler::internal::ParsedProfile;
+
+namespace {
+
+// Build a gperftools legacy CPU profile from (count, stack) records
+std::string makeCpuProfile(const std::vector<std::pair<uintptr_t, std::vector<uintptr_t>>>& records) {
+    std::vector<uintptr_t> words = {0, 3, 0, 10000, 0};
+    for (const auto& [count, stack] : records) {
+        words.push_back(count);
+        words.push_back(stack.size());
+        words.insert(words.end(), stack.begin(), stack.end());
+    }
+    words.insert(words.end(), {0, 1, 0});
+
+    std::string data(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uintptr_t));
+    data += "00400000-00401000 r-xp 00000000 08:01 1234 /usr/bin/app\n";
+    return data;
+}
+
+std::vector<uint32_t> fakeResolver(uintptr_t address, profiler::internal::NameScope&) {
+    return {profiler::internal::symbolNames().intern("fn_" + std::to_string(address))};
+}
+
+// Inclusive value of every node, by its "root-first;path" of names
+std::map<std::string, uint64_t> nodeValues(const profiler::internal::FlameTree& tree) {
+    std::map<std::string, uint64_t> values;
+    std::vector<std::pair<uint32_t, std::string>> pending = {{0, ""}};
+    while (!pending.empty()) {
+        auto [index, path] = pending.back();
+        pending.pop_back();
+        for (uint32_t child : tree.nodes()[index].children) {
+            std::string name(tree.names()[tree.nodes()[child].name]);
+            std::string child_path = path.empty() ? name : path + ";" + name;
+            values[child_path] = tree.nodes()[child].value;
+            pending.emplace_back(child, child_path);
+        }
+    }
+    return values;
+}
+
+} // namespace
+
+TEST(ProfileParserTest, ParsesCpuProfile) {
+    std::string data = makeCpuProfile({{3, {0x100, 0x201}}, {2, {0x300}}});
+
+    ParsedProfile profile;
+    ASSERT_TRUE(profiler::internal::parseCpuProfile(data, profile));
+    EXPECT_EQ(profile.period_us, 10000u);
+    ASSERT_EQ(profile.samples.size(), 2u);
+    EXPECT_EQ(profile.samples[0].value, 3u);
+    EXPECT_EQ(profile.samples[0].stack, (std::vector<uintptr_t>{0x100, 0x201}));
+    EXPECT_EQ(profile.samples[1].value, 2u);
+    EXPECT_NE(profile.mapped_libraries.find("/usr/bin/app"), std::string::npos);
+}
+
+TEST(ProfileParserTest, EncodesCpuProfile) {
+    std::string data = makeCpuProfile({{3, {0x100, 0x201}}, {2, {0x300}}});
+    ParsedProfile profile;
+    ASSERT_TRUE(profiler::internal::parseCpuProfile(data, profile));
+    EXPECT_EQ(profiler::internal::encodeCpuProfile(profile), data);
+}
+
+TEST(ProfileParserTest, RejectsGarbage) {
+    ParsedProfile profile;
+    EXPECT_FALSE(profiler::internal::parseCpuProfile("not a profile", profile));
+    EXPECT_FALSE(profiler::internal::parseHeapProfile("not a profile", profile));
+}
+
+TEST(ProfileParserTest, ParsesHeapGrowthStacks) {
+    std::string text = "heap profile:    2:   3072 [     2:   3072] @ growthz\n"
+                       "     1:   1024 [     1:   1024] @ 0x10 0x21\n"
+                       "     1:   2048 [     1:   2048] @ 0x10 0x31\n"
+                       "\n"
+                       "MAPPED_LIBRARIES:\n"
+                       "00400000-00401000 r-xp 00000000 08:01 1234 /usr/bin/app\n";
+
+    ParsedProfile profile;
+    ASSERT_TRUE(profiler::internal::parseHeapProfile(text, profile));
+    ASSERT_EQ(profile.samples.size(), 2u);
+    EXPECT_EQ(profile.samples[0].value, 1024u);
+    EXPECT_EQ(profile.samples[1].stack, (std::vector<uintptr_t>{0x10, 0x31}));
+    EXPECT_NE(profile.mapped_libraries.find("/usr/bin/app"), std::string::npos);
+}
+
+TEST(ProfileParserTest, UnsamplesHeapV2) {
+    std::string text = "heap profile:    1:   100 [     1:   100] @ heap_v2/524288\n"
+                       "     1:   100 [     1:   100] @ 0x10\n";
+
+    ParsedProfile profile;
+    ASSERT_TRUE(profiler::internal::parseHeapProfile(text, profile));
+    ASSERT_EQ(profile.samples.size(), 1u);
+    // A 100-byte object sampled every 512KiB stands for ~524K bytes
+    EXPECT_GT(profile.samples[0].value, 500000u);
+}
+
+TEST(FoldedStacksTest, FoldsRootFirstAndMergesStacks) {
+    ParsedProfile profile;
+    profile.samples.push_back({3, {100, 201}});
+    profile.samples.push_back({2, {100, 201}});
+    profile.samples.push_back({1, {300}});
+
+    auto folded = profiler::internal::foldProfile(profile, fakeResolver);
+    ASSERT_EQ(folded.size(), 2u);
+    // Caller addresses are adjusted by one to point into the call instruction
+    EXPECT_EQ(folded["fn_200;fn_100"], 5u);
+    EXPECT_EQ(folded["fn_300"], 1u);
+
+    std::string text = profiler::internal::formatFoldedStacks(folded);
+    EXPECT_EQ(text, "fn_200;fn_100 5\nfn_300 1\n");
+}
+
+TEST(FoldedStacksTest, ExpandsInlinedFramesRootFirst) {
+    ParsedProfile profile;
+    profile.samples.push_back({4, {100, 201}});
+
+    // 100 is inside "inner", which was inlined into "outer"
+    auto resolver = [](uintptr_t address, profiler::internal::NameScope& scope) -> std::vector<uint32_t> {
+        if (address == 100) {
+            return {scope.intern("inner_[i]"), profiler::internal::symbolNames().intern("outer")};
+        }
+        return fakeResolver(address, scope);
+    };
+    auto folded = profiler::internal::foldProfile(profile, resolver);
+    ASSERT_EQ(folded.size(), 1u);
+    EXPECT_EQ(folded["fn_200;outer;inner_[i]"], 4u);
+}
+
+TEST(FlameTreeTest, BuildsPrefixTreeAndSerializes) {
+    profiler::internal::FoldedStacks folded;
+    folded["main;b"] = 2;
+    folded["main;a;leaf"] = 3;
+    folded["other"] = 1;
+
+    profiler::internal::FlameTree tree;
+    tree.addAll(folded);
+    EXPECT_EQ(tree.total(), 6u);
+    // root, main, a, leaf, b, other
+    EXPECT_EQ(tree.nodes().size(), 6u);
+
+    std::string json = tree.toJson("cpu", "samples");
+    EXPECT_EQ(json, "{\"type\":\"cpu\",\"unit\":\"samples\",\"total\":6,"
+                    "\"names\":[\"root\",\"main\",\"a\",\"leaf\",\"b\",\"other\"],"
+                    "\"tree\":[0,6,[[1,5,[[2,3,[[3,3]]],[4,2]]],[5,1]]]}");
+}
+
+TEST(FlameTreeTest, BuildsFromNameIdsLikeFoldedText) {
+    ParsedProfile profile;
+    profile.samples.push_back({3, {100, 201}});
+    profile.samples.push_back({2, {100, 201}});
+    profile.samples.push_back({1, {300, 201}});
+    profile.samples.push_back({4, {400}});
+
+    // Mixes symbolNames() IDs with names made up in the scope
+    auto resolver = [](uintptr_t address, profiler::internal::NameScope& scope) -> std::vector<uint32_t> {
+        if (address == 400) {
+            return {scope.intern("0x190")};
+        }
+        return fakeResolver(address, scope);
+    };
+
+    profiler::internal::FlameTree from_text;
+    from_text.addAll(profiler::internal::foldProfile(profile, resolver));
+
+    profiler::internal::FlameTree from_ids;
+    {
+        profiler::internal::NameScope scope;
+        profiler::internal::foldProfileIds(profile, resolver, scope,
+                                           [&](std::span<const uint32_t> frames, uint64_t value) {
+                                               from_ids.add(frames, value, scope);
+                                           });
+    }
+    // Scoped names were copied into the tree: still readable once the scope is gone
+    EXPECT_EQ(from_ids.total(), 10u);
+    EXPECT_EQ(from_ids.nodes().size(), from_text.nodes().size());
+    // Name indexes follow insertion order, which differs; the trees do not
+    EXPECT_EQ(nodeValues(from_ids), nodeValues(from_text));
+    EXPECT_EQ(nodeValues(from_ids)["0x190"], 4u);
+    EXPECT_EQ(nodeValues(from_ids)["fn_200;fn_100"], 5u);
+}
@@ -0,0 +1,84 @@
+/// @file test_render_cache.cpp
+/// @brief Tests for the rendered-output LRU cache
+
+#include "internal/render_cache.h"
+#include "profiler/http_handlers.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using profiler::HandlerResponse;
+using profiler::ProfilerHttpHandlers;
+using profiler::internal::RenderCache;
+
+TEST(RenderCacheTest, KeyDependsOnDataAndOptions) {
+    std::string data(1000, 'a');
+    std::string other = data;
+    other[999] = 'b';
+
+    EXPECT_EQ(RenderCache::makeKey(data, "svg"), RenderCache::makeKey(std::string(1000, 'a'), "svg"));
+    EXPECT_NE(RenderCache::makeKey(data, "svg"), RenderCache::makeKey(other, "svg"));
+    EXPECT_NE(RenderCache::makeKey(data, "svg"), RenderCache::makeKey(data, "flamegraph"));
+    EXPECT_NE(RenderCache::makeKey("ab", "svg"), RenderCache::makeKey("abc", "svg"));
+
+    std::string etag = RenderCache::etagFor(RenderCache::makeKey(data, "svg"));
+    EXPECT_EQ(etag.front(), '"');
+    EXPECT_EQ(etag.back(), '"');
+    EXPECT_NE(etag, RenderCache::etagFor(RenderCache::makeKey(data, "flamegraph")));
+}
+
+TEST(RenderCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+    RenderCache cache(250);
+    cache.put("a", std::string(100, 'a'));
+    cache.put("b", std::string(100, 'b'));
+    ASSERT_NE(cache.get("a"), nullptr); // "b" is now least recently used
+
+    cache.put("c", std::string(100, 'c'));
+    EXPECT_NE(cache.get("a"), nullptr);
+    EXPECT_EQ(cache.get("b"), nullptr);
+    EXPECT_EQ(*cache.get("c"), std::string(100, 'c'));
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.entries, 2u);
+    EXPECT_EQ(stats.bytes, 200u);
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 1u);
+
+    // Replacing an entry updates the byte count
+    cache.put("a", std::string(10, 'x'));
+    EXPECT_EQ(cache.stats().bytes, 110u);
+    EXPECT_EQ(*cache.get("a"), std::string(10, 'x'));
+}
+
+TEST(RenderCacheTest, OversizeAndDisabled) {
+    RenderCache cache(100);
+    auto value = cache.put("big", std::string(101, 'x'));
+    EXPECT_EQ(value->size(), 101u);
+    EXPECT_EQ(cache.get("big"), nullptr);
+
+    cache.put("small", "svg");
+    cache.setMaxBytes(0);
+    EXPECT_EQ(cache.stats().entries, 0u);
+    cache.put("small", "svg");
+    EXPECT_EQ(cache.get("small"), nullptr);
+}
+
+TEST(RenderCacheTest, ConditionalResponses) {
+    auto resp = HandlerResponse::svg("<svg/>");
+    resp.headers["ETag"] = "\"abc\"";
+
+    for (const char* header : {"\"abc\"", "W/\"abc\"", "\"x\", \"abc\"", "*"}) {
+        auto result = ProfilerHttpHandlers::conditional(resp, header);
+        EXPECT_EQ(result.status, 304) << header;
+        EXPECT_TRUE(result.body.empty());
+        EXPECT_EQ(result.headers["ETag"], "\"abc\"");
+    }
+    for (const char* header : {"", "\"abcd\"", "\"ab\""}) {
+        EXPECT_EQ(ProfilerHttpHandlers::conditional(resp, header).status, 200) << header;
+    }
+
+    // Errors and responses without an ETag are never turned into 304
+    EXPECT_EQ(ProfilerHttpHandlers::conditional(HandlerResponse::svg("<svg/>"), "*").status, 200);
+    auto error = HandlerResponse::error(500, "failed");
+    error.headers["ETag"] = "\"abc\"";
+    EXPECT_EQ(ProfilerHttpHandlers::conditional(error, "\"abc\"").status, 500);
+}
@@ -0,0 +1,108 @@
+/// @file test_request_scheduler.cpp
+/// @brief Tests for admission control and coalescing of heavy endpoints
+
+#include "internal/request_scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+
+using profiler::HandlerResponse;
+using profiler::SchedulerOptions;
+using profiler::internal::RequestScheduler;
+
+namespace {
+// Handler that blocks until released, so tests control what is in flight
+struct BlockingHandler {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> calls{0};
+
+    HandlerResponse operator()() {
+        ++calls;
+        released.wait();
+        return HandlerResponse::text("done");
+    }
+};
+
+void waitForRunning(const RequestScheduler& scheduler, int running) {
+    while (scheduler.stats().running < running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+} // namespace
+
+TEST(RequestSchedulerTest, CoalescesIdenticalRequests) {
+    RequestScheduler scheduler;
+    BlockingHandler handler;
+    auto run = [&] { return scheduler.run("heap", "heap/svg_raw", [&] { return handler(); }); };
+
+    auto first = std::async(std::launch::async, run);
+    waitForRunning(scheduler, 1);
+    auto second = std::async(std::launch::async, run);
+    while (scheduler.stats().coalesced < 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    handler.release.set_value();
+
+    EXPECT_EQ(first.get().body, "done");
+    EXPECT_EQ(second.get().body, "done");
+    EXPECT_EQ(handler.calls, 1);
+    auto stats = scheduler.stats();
+    EXPECT_EQ(stats.admitted, 1u);
+    EXPECT_EQ(stats.coalesced, 1u);
+    EXPECT_EQ(stats.running, 0);
+}
+
+TEST(RequestSchedulerTest, RejectsWhenClassOrGlobalBudgetIsFull) {
+    SchedulerOptions options;
+    options.max_concurrent = 2;
+    options.class_limits["threads"] = 2;
+    options.retry_after_seconds = 7;
+    RequestScheduler scheduler(options);
+    BlockingHandler handler;
+    auto start = [&](const std::string& endpoint_class, const std::string& key) {
+        return std::async(std::launch::async,
+                          [&, endpoint_class, key] { return scheduler.run(endpoint_class, key, std::ref(handler)); });
+    };
+
+    auto cpu = start("cpu", "cpu/a");
+    waitForRunning(scheduler, 1);
+
+    // Same class, different parameters: the class limit (1) is reached
+    auto rejected = scheduler.run("cpu", "cpu/b", [] { return HandlerResponse::text("unexpected"); });
+    EXPECT_EQ(rejected.status, 429);
+    EXPECT_EQ(rejected.headers["Retry-After"], "7");
+
+    auto threads = start("threads", "threads/a");
+    waitForRunning(scheduler, 2);
+
+    // The class has room but the global budget does not
+    EXPECT_EQ(scheduler.run("threads", "threads/b", [] { return HandlerResponse::text("unexpected"); }).status, 429);
+    EXPECT_EQ(scheduler.stats().rejected, 2u);
+
+    handler.release.set_value();
+    EXPECT_EQ(cpu.get().status, 200);
+    EXPECT_EQ(threads.get().status, 200);
+
+    // Slots are released once the handlers finish
+    EXPECT_EQ(scheduler.run("cpu", "cpu/b", [] { return HandlerResponse::text("ok"); }).body, "ok");
+}
+
+TEST(RequestSchedulerTest, MemoryBudgetAndExceptions) {
+    ASSERT_GT(profiler::internal::currentRssBytes(), 0u);
+
+    SchedulerOptions options;
+    options.max_rss_bytes = 1;
+    RequestScheduler scheduler(options);
+    EXPECT_EQ(scheduler.run("heap", "heap/folded", [] { return HandlerResponse::text("ok"); }).status, 429);
+
+    options.max_rss_bytes = 0;
+    scheduler.setOptions(options);
+    auto resp = scheduler.run("heap", "heap/folded", []() -> HandlerResponse { throw std::runtime_error("boom"); });
+    EXPECT_EQ(resp.status, 500);
+    EXPECT_NE(resp.body.find("boom"), std::string::npos);
+    EXPECT_EQ(scheduler.stats().running, 0);
+}
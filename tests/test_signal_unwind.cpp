@@ -0,0 +1,275 @@
+/// @file test_signal_unwind.cpp
+/// @brief Tests for the frame-pointer stack walk and unwinder selection
+
+#include "internal/signal_unwind.h"
+#include "profiler_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+using profiler::internal::captureFramePointerStack;
+using profiler::internal::captureSignalStack;
+using profiler::internal::prepareSignalUnwind;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+namespace {
+// An interrupted context whose registers point into a hand-built stack
+ucontext_t fakeContext(uintptr_t pc, const uintptr_t* sp, const uintptr_t* fp, uintptr_t lr = 0) {
+    ucontext_t uc{};
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+#if defined(__x86_64__)
+    uc.uc_mcontext.gregs[REG_RIP] = static_cast<greg_t>(pc);
+    uc.uc_mcontext.gregs[REG_RSP] = reinterpret_cast<greg_t>(sp);
+    uc.uc_mcontext.gregs[REG_RBP] = reinterpret_cast<greg_t>(fp);
+    (void)lr;
+#else
+    uc.uc_mcontext.pc = pc;
+    uc.uc_mcontext.sp = reinterpret_cast<uintptr_t>(sp);
+    uc.uc_mcontext.regs[29] = reinterpret_cast<uintptr_t>(fp);
+    uc.uc_mcontext.regs[30] = lr;
+#endif
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    return uc;
+}
+
+uintptr_t addressOf(const void* pointer) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<uintptr_t>(pointer);
+}
+
+// Instruction bytes the interrupted PC points at; the walk inspects them for
+// prologues and epilogues
+#if defined(__x86_64__)
+const uint8_t kBody[] = {0x90, 0x90, 0x90, 0x90};             // nop
+const uint8_t kEntry[] = {0x55, 0x48, 0x89, 0xe5};            // push %rbp; mov %rsp,%rbp
+const uint8_t kEndbrEntry[] = {0xf3, 0x0f, 0x1e, 0xfa, 0x55}; // endbr64; push %rbp
+const uint8_t kReturn[] = {0xc3};                             // ret
+#else
+const uint32_t kBody[] = {0xd503201f};              // nop
+const uint32_t kEntry[] = {0xa9bf7bfd, 0x910003fd}; // stp x29, x30, [sp, #-16]!; mov x29, sp
+const uint32_t kReturn[] = {0xd65f03c0};            // ret
+#endif
+const uintptr_t kPc = addressOf(kBody);
+} // namespace
+
+TEST(SignalUnwindTest, WalksFrameRecords) {
+    prepareSignalUnwind(); // The fake stack lives on this thread's real stack
+    alignas(16) uintptr_t stack[32] = {};
+    // {caller's frame pointer, return address}, outermost record ends the chain with 0
+    stack[4] = addressOf(&stack[10]);
+    stack[5] = 0x1111;
+    stack[10] = addressOf(&stack[20]);
+    stack[11] = 0x2222;
+    stack[20] = 0;
+    stack[21] = 0x3333;
+    ucontext_t uc = fakeContext(kPc, &stack[0], &stack[4]);
+
+    uintptr_t out[8] = {};
+    ASSERT_EQ(captureFramePointerStack(&uc, out, 8), 4);
+    EXPECT_EQ(out[0], kPc);
+    EXPECT_EQ(out[1], 0x1111u);
+    EXPECT_EQ(out[2], 0x2222u);
+    EXPECT_EQ(out[3], 0x3333u);
+
+    EXPECT_EQ(captureFramePointerStack(&uc, out, 2), 2);
+}
+
+TEST(SignalUnwindTest, RecoversCallerInPrologueAndEpilogue) {
+    prepareSignalUnwind();
+    alignas(16) uintptr_t stack[32] = {};
+    // The interrupted function has no frame record yet: the frame pointer is
+    // still its caller's, whose record returns into the caller's caller
+    stack[0] = addressOf(&stack[10]); // %rbp pushed by the prologue
+    stack[1] = 0xaaaa;                // Return address into the immediate caller
+    stack[10] = 0;
+    stack[11] = 0x1111;
+    uintptr_t out[8] = {};
+    auto callers = [&](const void* code, const uintptr_t* sp) {
+        ucontext_t uc = fakeContext(addressOf(code), sp, &stack[10], 0xaaaa);
+        int depth = captureFramePointerStack(&uc, out, 8);
+        return std::vector<uintptr_t>(out + 1, out + std::max(depth, 1));
+    };
+
+    const std::vector<uintptr_t> recovered = {0xaaaa, 0x1111};
+#if defined(__x86_64__)
+    EXPECT_EQ(callers(kEntry, &stack[1]), recovered);     // At push %rbp
+    EXPECT_EQ(callers(kEntry + 1, &stack[0]), recovered); // At mov %rsp,%rbp
+    EXPECT_EQ(callers(kEndbrEntry, &stack[1]), recovered);
+    EXPECT_EQ(callers(kReturn, &stack[1]), recovered);
+#else
+    EXPECT_EQ(callers(kEntry, &stack[0]), recovered);     // At stp x29, x30
+    EXPECT_EQ(callers(kEntry + 1, &stack[0]), recovered); // At mov x29, sp
+    EXPECT_EQ(callers(kReturn, &stack[0]), recovered);
+#endif
+    // In the body the frame pointer is the function's own: nothing to recover
+    EXPECT_EQ(callers(kBody, &stack[0]), std::vector<uintptr_t>{0x1111});
+}
+
+TEST(SignalUnwindTest, StopsAtInvalidRecords) {
+    prepareSignalUnwind();
+    alignas(16) uintptr_t stack[32] = {};
+    uintptr_t out[8] = {};
+
+    // A record that points back at itself must not loop
+    stack[4] = addressOf(&stack[4]);
+    stack[5] = 0x1111;
+    ucontext_t loop = fakeContext(kPc, &stack[0], &stack[4]);
+    EXPECT_EQ(captureFramePointerStack(&loop, out, 8), 2);
+
+    // Records below the interrupted sp or misaligned are not frames
+    stack[4] = addressOf(&stack[10]);
+    ucontext_t below = fakeContext(kPc, &stack[8], &stack[4]);
+    EXPECT_EQ(captureFramePointerStack(&below, out, 8), -1);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* misaligned = reinterpret_cast<const uintptr_t*>(addressOf(&stack[4]) + 1);
+    ucontext_t odd = fakeContext(kPc, &stack[0], misaligned);
+    EXPECT_EQ(captureFramePointerStack(&odd, out, 8), -1);
+
+    // A frame pointer that is just a small integer (register reused by code
+    // without frame pointers) or a stack outside any mapping
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    ucontext_t garbage = fakeContext(kPc, &stack[0], reinterpret_cast<const uintptr_t*>(0x10));
+    EXPECT_EQ(captureFramePointerStack(&garbage, out, 8), -1);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    ucontext_t unmapped = fakeContext(kPc, reinterpret_cast<const uintptr_t*>(0x2000), &stack[4]);
+    EXPECT_EQ(captureFramePointerStack(&unmapped, out, 8), -1);
+
+    // captureSignalStack() still returns a stack by falling back to backtrace()
+    profiler::internal::setSignalUnwindMethod(profiler::internal::UnwindMethod::FramePointer);
+    EXPECT_GT(captureSignalStack(&garbage, out, 8), 0);
+    profiler::internal::setSignalUnwindMethod(profiler::internal::UnwindMethod::Backtrace);
+}
+
+TEST(SignalUnwindTest, StaysInTheMappingHoldingSp) {
+    // Two adjacent writable mappings the kernel keeps apart (private, then shared)
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* base = mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(base, MAP_FAILED);
+    auto* low = static_cast<uintptr_t*>(base);
+    uintptr_t* high = low + page / sizeof(uintptr_t);
+    ASSERT_EQ(mmap(high, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1, 0), high);
+    prepareSignalUnwind();
+
+    // A chain that continues into the next mapping ends at the first one's end
+    low[4] = addressOf(&high[0]);
+    low[5] = 0x1111;
+    high[0] = 0;
+    high[1] = 0x2222;
+    ucontext_t uc = fakeContext(kPc, &low[0], &low[4]);
+    uintptr_t out[8] = {};
+    EXPECT_EQ(captureFramePointerStack(&uc, out, 8), 2);
+    EXPECT_EQ(out[1], 0x1111u);
+
+    munmap(base, 2 * page);
+}
+
+#endif
+
+TEST(SignalUnwindTest, ManagerCapturesThreadStacksWithFramePointers) {
+    EXPECT_EQ(profiler::ProfilerManager::getStackUnwinder(), profiler::StackUnwinder::Backtrace);
+    profiler::ProfilerManager::setStackUnwinder(profiler::StackUnwinder::FramePointer);
+    EXPECT_EQ(profiler::ProfilerManager::getStackUnwinder(), profiler::StackUnwinder::FramePointer);
+
+    profiler::ProfilerManager profiler;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+    for (int i = 0; i < 2; ++i) {
+        threads.emplace_back([&] {
+            while (!stop) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    std::string stacks = profiler.getThreadCallStacks();
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    profiler::ProfilerManager::setStackUnwinder(profiler::StackUnwinder::Backtrace);
+
+    const std::string total = "Total threads captured: ";
+    auto pos = stacks.find(total);
+    ASSERT_NE(pos, std::string::npos);
+    EXPECT_GE(std::stoi(stacks.substr(pos + total.size())), 2);
+    EXPECT_EQ(stacks.find("Frames: 0\n"), std::string::npos);
+}
+
+namespace {
+// Recurses `depth` frames, then parks until `release` is set
+[[gnu::noinline]] int parkDeep(int depth, const std::atomic<bool>& release) {
+    if (depth == 0) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return 0;
+    }
+    volatile int keep_frame = parkDeep(depth - 1, release);
+    return keep_frame + 1;
+}
+
+// Frame count of the deepest thread in a getThreadCallStacks() report
+int deepestThread(const std::string& report) {
+    int deepest = 0;
+    for (size_t pos = report.find("Frames: "); pos != std::string::npos; pos = report.find("Frames: ", pos + 1)) {
+        deepest = std::max(deepest, std::stoi(report.substr(pos + 8)));
+    }
+    return deepest;
+}
+} // namespace
+
+TEST(SignalUnwindTest, ThreadStackDepthIsConfigurable) {
+    profiler::ProfilerManager profiler;
+    EXPECT_EQ(profiler.getThreadStackDepth(), profiler::kDefaultThreadStackDepth);
+    profiler.setThreadStackDepth(40);
+    EXPECT_EQ(profiler.getThreadStackDepth(), 64);
+    profiler.setThreadStackDepth(1);
+    EXPECT_EQ(profiler.getThreadStackDepth(), 32);
+    profiler.setThreadStackDepth(100000);
+    EXPECT_EQ(profiler.getThreadStackDepth(), 256);
+
+    std::atomic<bool> release{false};
+    std::thread deep([&] { parkDeep(150, release); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Too shallow: the stack is cut and says so
+    profiler.setThreadStackDepth(32);
+    std::string shallow = profiler.getThreadCallStacks();
+    EXPECT_EQ(deepestThread(shallow), 33); // 32 frames and the marker
+    EXPECT_NE(shallow.find("[truncated]"), std::string::npos);
+    EXPECT_NE(profiler.getThreadCallStacksJson().find("\"[truncated]\""), std::string::npos);
+
+    // Deep enough: the whole chain, down to the thread entry
+    profiler.setThreadStackDepth(256);
+    std::string full = profiler.getThreadCallStacks();
+    EXPECT_GT(deepestThread(full), 150);
+    EXPECT_EQ(full.find("[truncated]"), std::string::npos);
+
+    release = true;
+    deep.join();
+}
+
+TEST(SignalUnwindTest, MaxThreadStackDepthStillMarksTruncation) {
+    profiler::ProfilerManager profiler;
+    profiler.setThreadStackDepth(256);
+
+    std::atomic<bool> release{false};
+    std::thread deep([&] { parkDeep(300, release); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // 300 frames do not fit: all 256 are kept and the marker follows
+    std::string report = profiler.getThreadCallStacks();
+    EXPECT_EQ(deepestThread(report), 257);
+    EXPECT_NE(report.find("[truncated]"), std::string::npos);
+
+    release = true;
+    deep.join();
+}
@@ -0,0 +1,77 @@
+/// @file test_string_pool.cpp
+/// @brief Tests for the interned symbol name pool
+
+#include "internal/string_pool.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using profiler::internal::StringPool;
+
+TEST(StringPoolTest, InternsEqualStringsOnce) {
+    StringPool pool;
+    EXPECT_EQ(pool.intern(""), StringPool::kEmptyId);
+
+    uint32_t a = pool.intern("ns::Widget::draw() const");
+    uint32_t b = pool.intern(std::string("ns::Widget::draw() const"));
+    uint32_t c = pool.intern("ns::Widget::draw()");
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(pool.view(a), "ns::Widget::draw() const");
+    EXPECT_EQ(pool.view(c), "ns::Widget::draw()");
+    EXPECT_EQ(pool.size(), 3u);
+    EXPECT_EQ(pool.view(12345), "");
+}
+
+TEST(StringPoolTest, ViewsStayValidAsPoolGrows) {
+    StringPool pool;
+    std::string big(100000, 'x'); // Larger than an arena block
+    uint32_t first = pool.intern("first");
+    std::string_view first_view = pool.view(first);
+    uint32_t big_id = pool.intern(big);
+    for (int i = 0; i < 20000; ++i) {
+        pool.intern("name_" + std::to_string(i));
+    }
+    EXPECT_EQ(first_view.data(), pool.view(first).data());
+    EXPECT_EQ(first_view, "first");
+    EXPECT_EQ(pool.view(big_id), big);
+    EXPECT_EQ(pool.intern("name_123"), pool.intern("name_123"));
+}
+
+TEST(StringPoolTest, ConcurrentInternAgreesOnIds) {
+    StringPool pool;
+    constexpr int kThreads = 8;
+    constexpr int kNames = 2000;
+    std::vector<std::vector<uint32_t>> ids(kThreads, std::vector<uint32_t>(kNames));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&pool, &ids, t]() {
+            for (int i = 0; i < kNames; ++i) {
+                ids[t][i] = pool.intern("fn_" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 1; t < kThreads; ++t) {
+        EXPECT_EQ(ids[t], ids[0]);
+    }
+    EXPECT_EQ(pool.size(), static_cast<size_t>(kNames) + 1);
+}
+
+TEST(StringPoolTest, NameScopeKeepsRequestNamesOutOfSymbolNames) {
+    auto& names = profiler::internal::symbolNames();
+    uint32_t shared = names.intern("scope_test::shared()");
+    size_t before = names.size();
+    {
+        profiler::internal::NameScope scope;
+        uint32_t local = scope.intern("0xdeadbeef");
+        EXPECT_NE(local & profiler::internal::NameScope::kScopedBit, 0u);
+        EXPECT_EQ(scope.intern("0xdeadbeef"), local);
+        EXPECT_EQ(scope.view(local), "0xdeadbeef");
+        EXPECT_EQ(scope.view(shared), "scope_test::shared()");
+    }
+    EXPECT_EQ(names.size(), before);
+}
@@ -0,0 +1,157 @@
+/// @file test_stuck_threads.cpp
+/// @brief Tests for the stuck-thread detector and /api/thread/stuck
+
+#include "profiler/http_handlers.h"
+#include "profiler_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+pid_t currentTid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// Waits for a report on `tid`, up to `timeout`
+bool waitForStuck(profiler::ProfilerManager& profiler, pid_t tid, std::chrono::milliseconds timeout) {
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < end) {
+        auto stuck = profiler.getStuckThreads();
+        if (std::any_of(stuck.begin(), stuck.end(), [tid](const auto& thread) { return thread.tid == tid; })) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+} // namespace
+
+TEST(StuckThreadTest, ReportsBlockedButNotIdleThreads) {
+    profiler::ProfilerManager profiler;
+    EXPECT_FALSE(profiler.isStuckThreadDetectorRunning());
+
+    // One thread blocked on a mutex that is never released while it waits, one sleeping idle
+    std::mutex held;
+    held.lock();
+    std::atomic<pid_t> blocked_tid{0};
+    std::thread blocked([&] {
+        blocked_tid = currentTid();
+        std::lock_guard<std::mutex> lock(held);
+    });
+    std::atomic<bool> release{false};
+    std::atomic<pid_t> idle_tid{0};
+    std::thread idle([&] {
+        idle_tid = currentTid();
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    while (blocked_tid.load() == 0 || idle_tid.load() == 0) {
+        std::this_thread::yield();
+    }
+
+    std::mutex reported_mutex;
+    std::vector<profiler::StuckThread> reported;
+    profiler::StuckThreadOptions options;
+    options.interval_ms = 50;
+    options.samples = 3;
+    options.on_stuck = [&](const profiler::StuckThread& thread) {
+        std::lock_guard<std::mutex> lock(reported_mutex);
+        reported.push_back(thread);
+    };
+    ASSERT_TRUE(profiler.startStuckThreadDetector(options));
+    EXPECT_FALSE(profiler.startStuckThreadDetector(options));
+    EXPECT_TRUE(profiler.isStuckThreadDetectorRunning());
+
+    EXPECT_TRUE(waitForStuck(profiler, blocked_tid, std::chrono::seconds(5)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // Several more rounds
+
+    auto stuck = profiler.getStuckThreads();
+    auto it = std::find_if(stuck.begin(), stuck.end(), [&](const auto& thread) { return thread.tid == blocked_tid; });
+    ASSERT_NE(it, stuck.end());
+    EXPECT_GE(it->samples, 3);
+    EXPECT_GE(it->stuck_ms, 100u);
+    EXPECT_FALSE(it->frames.empty());
+    EXPECT_TRUE(std::none_of(stuck.begin(), stuck.end(), [&](const auto& thread) { return thread.tid == idle_tid; }));
+    {
+        // Reported once, not on every round
+        std::lock_guard<std::mutex> lock(reported_mutex);
+        EXPECT_EQ(std::count_if(reported.begin(), reported.end(),
+                                [&](const auto& thread) { return thread.tid == blocked_tid; }),
+                  1);
+    }
+
+    profiler::ProfilerHttpHandlers handlers(profiler);
+    auto resp = handlers.dispatch("GET", "/api/thread/stuck", {}, "");
+    EXPECT_EQ(resp.status, 200);
+    EXPECT_NE(resp.body.find("\"running\":true"), std::string::npos);
+    EXPECT_NE(resp.body.find("{\"tid\":" + std::to_string(blocked_tid) + ","), std::string::npos);
+
+    // Once the lock is released the thread exits and is no longer stuck
+    held.unlock();
+    blocked.join();
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!profiler.getStuckThreads().empty() && std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_TRUE(profiler.getStuckThreads().empty());
+
+    profiler.stopStuckThreadDetector();
+    EXPECT_FALSE(profiler.isStuckThreadDetectorRunning());
+    EXPECT_NE(profiler.getStuckThreadsJson().find("\"running\":false"), std::string::npos);
+    release = true;
+    idle.join();
+}
+
+TEST(StuckThreadTest, SkipsThreadsThatBlockTheCaptureSignal) {
+    profiler::ProfilerManager profiler;
+    std::atomic<pid_t> masked_tid{0};
+    std::atomic<bool> unblock{false};
+    std::atomic<bool> release{false};
+    std::thread masked([&] {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+        masked_tid = currentTid();
+        while (!unblock) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    while (masked_tid.load() == 0) {
+        std::this_thread::yield();
+    }
+    std::string marker = "Thread " + std::to_string(masked_tid) + ":";
+
+    // The first capture waits out the timeout for the thread that never answers
+    EXPECT_EQ(profiler.getThreadCallStacks().find(marker), std::string::npos);
+
+    // Later ones skip it while the signal is still pending on it
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(profiler.getThreadCallStacks().find(marker), std::string::npos);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1500));
+
+    // Once it takes the pending signal it is captured again
+    unblock = true;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    bool captured = false;
+    while (!captured && std::chrono::steady_clock::now() < end) {
+        captured = profiler.getThreadCallStacks().find(marker) != std::string::npos;
+    }
+    EXPECT_TRUE(captured);
+    release = true;
+    masked.join();
+}
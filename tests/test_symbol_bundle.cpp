@@ -0,0 +1,130 @@
+/// @file test_symbol_bundle.cpp
+/// @brief Tests for unsymbolized profile bundles and their offline symbolization
+
+#include "internal/module_map.h"
+#include "internal/offline_symbolizer.h"
+#include "internal/symbol_bundle.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using profiler::internal::ModuleInfo;
+using profiler::internal::ModuleMap;
+using profiler::internal::OfflineSymbolizer;
+using profiler::internal::SymbolBundle;
+
+namespace {
+constexpr unsigned int kProbeLine = __LINE__ + 1;
+[[gnu::noinline]] int bundleProbe(int x) {
+    asm volatile("" ::: "memory");
+    return x * 3;
+}
+
+// The module of the probe function, as an exporting process would record it
+bool probeModule(uintptr_t& probe, ModuleInfo& module) {
+    ModuleMap map;
+    map.refresh();
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    probe = reinterpret_cast<uintptr_t>(&bundleProbe);
+    return map.find(probe, module);
+}
+
+std::string ownDirectory() {
+    char path[4096];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        return ".";
+    }
+    std::string exe(path, static_cast<size_t>(len));
+    return exe.substr(0, exe.rfind('/'));
+}
+} // namespace
+
+TEST(SymbolBundleTest, RoundTrip) {
+    SymbolBundle bundle;
+    bundle.kind = SymbolBundle::Kind::Threads;
+    bundle.period_us = 10000;
+    ModuleInfo module;
+    module.path = "/usr/bin/app";
+    module.start = 0x55d0c0001000;
+    module.end = 0x55d0c0005000;
+    module.offset = 0x1000;
+    module.load_bias = 0x55d0c0000000;
+    module.build_id = "0123456789abcdef0123456789abcdef01234567";
+    bundle.modules.push_back(module);
+    bundle.samples.push_back({1, 42, "worker", {0x55d0c0001234, 0x55d0c0002000, 0x7f0000000010}});
+    bundle.samples.push_back({7, 43, "", {0x55d0c0002000}});
+
+    std::string data = profiler::internal::encodeSymbolBundle(bundle);
+    SymbolBundle decoded;
+    ASSERT_TRUE(profiler::internal::decodeSymbolBundle(data, decoded));
+    EXPECT_EQ(decoded.kind, SymbolBundle::Kind::Threads);
+    EXPECT_EQ(decoded.period_us, 10000u);
+    ASSERT_EQ(decoded.modules.size(), 1u);
+    EXPECT_EQ(decoded.modules[0].path, module.path);
+    EXPECT_EQ(decoded.modules[0].start, module.start);
+    EXPECT_EQ(decoded.modules[0].end, module.end);
+    EXPECT_EQ(decoded.modules[0].offset, module.offset);
+    EXPECT_EQ(decoded.modules[0].load_bias, module.load_bias);
+    EXPECT_EQ(decoded.modules[0].build_id, module.build_id);
+    ASSERT_EQ(decoded.samples.size(), 2u);
+    EXPECT_EQ(decoded.samples[0].tid, 42u);
+    EXPECT_EQ(decoded.samples[0].label, "worker");
+    EXPECT_EQ(decoded.samples[0].stack, bundle.samples[0].stack);
+    EXPECT_EQ(decoded.samples[1].value, 7u);
+    EXPECT_EQ(decoded.samples[1].stack, bundle.samples[1].stack);
+}
+
+TEST(SymbolBundleTest, RejectsCorruptData) {
+    SymbolBundle bundle;
+    bundle.samples.push_back({5, 0, "", {0x1000, 0x2000}});
+    std::string data = profiler::internal::encodeSymbolBundle(bundle);
+
+    SymbolBundle decoded;
+    EXPECT_FALSE(profiler::internal::decodeSymbolBundle("", decoded));
+    EXPECT_FALSE(profiler::internal::decodeSymbolBundle("not a bundle", decoded));
+    for (size_t size = 0; size < data.size(); ++size) {
+        EXPECT_FALSE(profiler::internal::decodeSymbolBundle(data.substr(0, size), decoded)) << size;
+    }
+    EXPECT_FALSE(profiler::internal::decodeSymbolBundle(data + '\0', decoded));
+}
+
+TEST(SymbolBundleTest, OfflineSymbolizerResolvesOwnFunction) {
+    uintptr_t probe = 0;
+    ModuleInfo module;
+    ASSERT_TRUE(probeModule(probe, module));
+
+    // Found via the search directory by base name, and via the recorded path
+    for (const auto& dirs : {std::vector<std::string>{ownDirectory()}, std::vector<std::string>{}}) {
+        OfflineSymbolizer symbolizer(dirs);
+        EXPECT_FALSE(symbolizer.localPath(module).empty());
+        auto frames = symbolizer.symbolize(&module, probe);
+        ASSERT_FALSE(frames.empty());
+        EXPECT_NE(frames.back().functionName().find("bundleProbe"), std::string::npos) << frames.back().functionName();
+        if (frames.back().line == 0) {
+            continue; // Built without debug info
+        }
+        EXPECT_NE(frames.back().sourceFile().find("test_symbol_bundle.cpp"), std::string::npos);
+        EXPECT_GE(frames.back().line, kProbeLine);
+        EXPECT_LE(frames.back().line, kProbeLine + 3);
+    }
+}
+
+TEST(SymbolBundleTest, OfflineSymbolizerRejectsBuildIdMismatch) {
+    uintptr_t probe = 0;
+    ModuleInfo module;
+    ASSERT_TRUE(probeModule(probe, module));
+    module.build_id = "00";
+
+    OfflineSymbolizer symbolizer({ownDirectory()});
+    EXPECT_TRUE(symbolizer.localPath(module).empty());
+    auto frames = symbolizer.symbolize(&module, probe);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_TRUE(frames[0].functionName().starts_with("0x"));
+
+    // Addresses outside every module stay as hex
+    frames = symbolizer.symbolize(nullptr, 0x10);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].functionName(), "0x10");
+}
@@ -0,0 +1,183 @@
+/// @file test_thread_metadata.cpp
+/// @brief Tests for the batched /proc/self/task metadata reader
+
+#include "internal/thread_metadata.h"
+#include "profiler_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using profiler::internal::ThreadMetadataReader;
+using profiler::internal::ThreadMetadataSnapshot;
+
+namespace {
+pid_t currentTid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// Scheduler state of a thread of this process, read independently of the reader under test
+char threadState(pid_t tid) {
+    std::ifstream stat("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string line;
+    std::getline(stat, line);
+    size_t close = line.rfind(')');
+    return close != std::string::npos && close + 2 < line.size() ? line[close + 2] : '?';
+}
+
+// Threads that block until released, named "meta-<i>"
+class SleepingThreads {
+public:
+    explicit SleepingThreads(int count) {
+        for (int i = 0; i < count; ++i) {
+            threads_.emplace_back([this, i] {
+                pthread_setname_np(pthread_self(), ("meta-" + std::to_string(i)).c_str());
+                tids_[i] = currentTid();
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return release_; });
+            });
+        }
+        for (int i = 0; i < count; ++i) {
+            while (tids_[i].load() == 0) {
+                std::this_thread::yield();
+            }
+        }
+        // Until each one is asleep in the wait (bounded, so a stuck one fails the test instead)
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (int i = 0; i < count; ++i) {
+            while (threadState(tids_[i]) != 'S' && std::chrono::steady_clock::now() < end) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+
+    ~SleepingThreads() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            release_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    pid_t tid(int i) const { return tids_[i]; }
+
+private:
+    std::vector<std::thread> threads_;
+    std::atomic<pid_t> tids_[16] = {};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool release_ = false;
+};
+} // namespace
+
+TEST(ThreadMetadataTest, SnapshotsEveryThread) {
+    SleepingThreads sleepers(4);
+    ThreadMetadataReader reader;
+    ThreadMetadataSnapshot snapshot;
+    ASSERT_TRUE(reader.collect(snapshot));
+
+    EXPECT_GE(snapshot.size(), 5u);
+    EXPECT_TRUE(std::is_sorted(snapshot.tids.begin(), snapshot.tids.end()));
+    EXPECT_EQ(snapshot.states.size(), snapshot.size());
+    EXPECT_EQ(snapshot.names.size(), snapshot.size());
+    EXPECT_EQ(snapshot.wchans.size(), snapshot.size());
+    EXPECT_EQ(snapshot.cpu_ticks.size(), snapshot.size());
+    EXPECT_EQ(snapshot.start_times.size(), snapshot.size());
+
+    ptrdiff_t self = snapshot.find(currentTid());
+    ASSERT_GE(self, 0);
+    EXPECT_EQ(snapshot.states[self], 'R');
+    for (int i = 0; i < 4; ++i) {
+        ptrdiff_t row = snapshot.find(sleepers.tid(i));
+        ASSERT_GE(row, 0);
+        EXPECT_EQ(snapshot.name(row), "meta-" + std::to_string(i));
+        EXPECT_EQ(snapshot.states[row], 'S');
+        EXPECT_FALSE(snapshot.wchan(row).empty());
+    }
+    EXPECT_EQ(snapshot.find(0), -1);
+
+    std::vector<pid_t> tids;
+    ASSERT_TRUE(reader.listThreads(tids));
+    EXPECT_TRUE(std::find(tids.begin(), tids.end(), sleepers.tid(3)) != tids.end());
+
+    // Without wchan nothing else changes
+    ThreadMetadataSnapshot light;
+    ASSERT_TRUE(reader.collect(light, false));
+    ptrdiff_t row = light.find(sleepers.tid(0));
+    ASSERT_GE(row, 0);
+    EXPECT_EQ(light.name(row), "meta-0");
+    EXPECT_TRUE(light.wchan(row).empty());
+}
+
+TEST(ThreadMetadataTest, SeesRenamesAndExits) {
+    ThreadMetadataReader reader;
+    ThreadMetadataSnapshot snapshot;
+    pid_t gone = 0;
+    {
+        SleepingThreads sleepers(1);
+        gone = sleepers.tid(0);
+        ASSERT_TRUE(reader.collect(snapshot));
+        ASSERT_GE(snapshot.find(gone), 0);
+    }
+    ASSERT_TRUE(reader.collect(snapshot));
+    EXPECT_EQ(snapshot.find(gone), -1);
+
+    // The cached name is only reused while the comm is unchanged
+    pthread_setname_np(pthread_self(), "meta-before");
+    ASSERT_TRUE(reader.collect(snapshot));
+    EXPECT_EQ(snapshot.name(snapshot.find(currentTid())), "meta-before");
+    pthread_setname_np(pthread_self(), "meta-after");
+    ASSERT_TRUE(reader.collect(snapshot));
+    EXPECT_EQ(snapshot.name(snapshot.find(currentTid())), "meta-after");
+}
+
+TEST(ThreadMetadataTest, ForkedChildListsItsOwnThreads) {
+    SleepingThreads sleepers(2);
+    ThreadMetadataReader reader;
+    std::vector<pid_t> tids;
+    ASSERT_TRUE(reader.listThreads(tids)); // Opens /proc/self/task in the parent
+    ASSERT_GE(tids.size(), 3u);
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        // Only the forking thread exists in the child
+        std::vector<pid_t> own;
+        bool ok = reader.listThreads(own) && own.size() == 1 && own[0] == getpid();
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    // The parent's descriptor is unaffected
+    ASSERT_TRUE(reader.listThreads(tids));
+    EXPECT_TRUE(std::find(tids.begin(), tids.end(), sleepers.tid(1)) != tids.end());
+}
+
+TEST(ThreadMetadataTest, ManagerReportsThreadMetadata) {
+    SleepingThreads sleepers(2);
+    profiler::ProfilerManager profiler;
+
+    std::string report = profiler.getThreadStacks();
+    EXPECT_NE(report.find("Thread " + std::to_string(sleepers.tid(1)) + ":\n  Name: meta-1\n  State: Sleeping (S)"),
+              std::string::npos);
+    EXPECT_NE(report.find("Total threads: "), std::string::npos);
+
+    std::string json = profiler.getThreadCallStacksJson();
+    EXPECT_NE(json.find("{\"tid\":" + std::to_string(sleepers.tid(0)) + ",\"name\":\"meta-0\""), std::string::npos);
+}
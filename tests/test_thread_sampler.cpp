@@ -0,0 +1,197 @@
+/// @file test_thread_sampler.cpp
+/// @brief Tests for the per-thread CPU-time timer sampler and its ProfilerManager backend
+
+#include "internal/profile_parser.h"
+#include "internal/thread_sampler.h"
+#include "profiler_manager.h"
+#include <atomic>
+#include <csignal>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using profiler::internal::ParsedProfile;
+using profiler::internal::ThreadCpuSampler;
+using profiler::internal::ThreadSamplerOptions;
+
+namespace {
+[[gnu::noinline]] uint64_t samplerSpin(std::chrono::milliseconds duration) {
+    volatile uint64_t sum = 0;
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i) {
+            sum = sum + static_cast<uint64_t>(i);
+        }
+    }
+    return sum;
+}
+
+// Spins until the calling thread itself has used `cpu` of CPU time, however many cores there are
+void burnThreadCpu(std::chrono::milliseconds cpu) {
+    auto used = [] {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    };
+    auto end = used() + cpu;
+    while (used() < end) {
+        samplerSpin(std::chrono::milliseconds(1));
+    }
+}
+
+uint64_t countInSpin(const ParsedProfile& profile) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto spin = reinterpret_cast<uintptr_t>(&samplerSpin);
+    uint64_t count = 0;
+    for (const auto& sample : profile.samples) {
+        for (uintptr_t pc : sample.stack) {
+            if (pc >= spin && pc < spin + 512) {
+                count += sample.value;
+                break;
+            }
+        }
+    }
+    return count;
+}
+} // namespace
+
+TEST(ThreadSamplerTest, SamplesEveryBusyThread) {
+    ThreadCpuSampler sampler;
+    std::string error;
+    ASSERT_TRUE(sampler.start(error)) << error;
+    EXPECT_TRUE(sampler.isRunning());
+
+    ThreadCpuSampler second;
+    EXPECT_FALSE(second.start(error));
+
+    // Threads started after the sampler are picked up by the rescan
+    constexpr int kThreads = 4;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < kThreads; ++i) {
+        workers.emplace_back([] { burnThreadCpu(std::chrono::milliseconds(300)); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ParsedProfile profile = sampler.stop();
+    EXPECT_FALSE(sampler.isRunning());
+
+    EXPECT_EQ(profile.period_us, 10000u);
+    EXPECT_GE(sampler.threadsSampled(), static_cast<size_t>(kThreads));
+    EXPECT_FALSE(profile.mapped_libraries.empty());
+    // Each thread burns 300ms of its own CPU time: ~30 samples apiece at 100 Hz.
+    // Expiry is only checked on scheduler ticks, so threads time-sliced on few
+    // cores lose some ticks in the kernel; ask for a third.
+    EXPECT_GT(countInSpin(profile), static_cast<uint64_t>(kThreads) * 10);
+
+    ASSERT_TRUE(second.start(error)) << error;
+    second.stop();
+}
+
+TEST(ThreadSamplerTest, EncodesAsGperftoolsProfile) {
+    ThreadCpuSampler sampler;
+    std::string error;
+    ASSERT_TRUE(sampler.start(error)) << error;
+    samplerSpin(std::chrono::milliseconds(200));
+    ParsedProfile profile = sampler.stop();
+    ASSERT_FALSE(profile.samples.empty());
+
+    ParsedProfile decoded;
+    ASSERT_TRUE(profiler::internal::parseCpuProfile(profiler::internal::encodeCpuProfile(profile), decoded));
+    EXPECT_EQ(decoded.period_us, profile.period_us);
+    EXPECT_EQ(countInSpin(decoded), countInSpin(profile));
+}
+
+TEST(ThreadSamplerTest, ManagerUsesThreadTimerBackend) {
+    profiler::ProfilerManager profiler;
+    EXPECT_EQ(profiler.getCPUProfilerBackend(), profiler::CpuProfilerBackend::Gperftools);
+
+    std::string path = "/tmp/test_thread_sampler_" + std::to_string(getpid()) + ".prof";
+    ASSERT_TRUE(profiler.startCPUProfiler(path, profiler::CpuProfilerBackend::ThreadTimers));
+    EXPECT_TRUE(profiler.isProfilerRunning(profiler::ProfilerType::CPU));
+    EXPECT_FALSE(profiler.startCPUProfiler(path, profiler::CpuProfilerBackend::ThreadTimers));
+    samplerSpin(std::chrono::milliseconds(200));
+    ASSERT_TRUE(profiler.stopCPUProfiler());
+
+    std::ifstream file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::remove(path.c_str());
+    ParsedProfile decoded;
+    ASSERT_TRUE(profiler::internal::parseCpuProfile(data, decoded));
+    EXPECT_GT(countInSpin(decoded), 5u);
+
+    // The configured backend also drives /pprof/profile
+    profiler.setCPUProfilerBackend(profiler::CpuProfilerBackend::ThreadTimers);
+    std::atomic<bool> stop{false};
+    std::thread busy([&] {
+        while (!stop) {
+            samplerSpin(std::chrono::milliseconds(10));
+        }
+    });
+    std::string raw = profiler.getRawCPUProfile(1);
+    stop = true;
+    busy.join();
+    ASSERT_TRUE(profiler::internal::parseCpuProfile(raw, decoded));
+    EXPECT_GT(countInSpin(decoded), 20u);
+}
+
+TEST(ThreadSamplerTest, IgnoresStaleTimerSignals) {
+    // Timer signals whose sigval names no live ring, as a tick queued before
+    // timer_delete() and delivered afterwards would; forged with
+    // rt_tgsigqueueinfo(), which lets a process send itself any si_code
+    auto sendTick = [](uintptr_t value) {
+        siginfo_t info{};
+        info.si_signo = SIGRTMIN + 5;
+        info.si_code = SI_TIMER;
+        info.si_value.sival_ptr = reinterpret_cast<void*>(value); // NOLINT(performance-no-int-to-ptr)
+        syscall(SYS_rt_tgsigqueueinfo, getpid(), static_cast<pid_t>(syscall(SYS_gettid)), SIGRTMIN + 5, &info);
+    };
+    const uintptr_t stale[] = {0, 1, 8191, 8192 * 1000 + 3, 0xdeadbeef, ~uintptr_t{0}};
+
+    ThreadCpuSampler sampler;
+    std::string error;
+    ASSERT_TRUE(sampler.start(error)) << error;
+    for (uintptr_t value : stale) {
+        sendTick(value);
+    }
+    samplerSpin(std::chrono::milliseconds(200));
+    ParsedProfile profile = sampler.stop();
+    EXPECT_GT(countInSpin(profile), 0u);
+
+    // Rings are gone once stopped; late ticks must not reach them
+    for (uintptr_t value : stale) {
+        sendTick(value);
+    }
+    ASSERT_TRUE(sampler.start(error)) << error;
+    samplerSpin(std::chrono::milliseconds(100));
+    sampler.stop();
+}
+
+TEST(ThreadSamplerTest, RetiresExitedThreads) {
+    ThreadSamplerOptions options;
+    options.drain_interval_ms = 5;
+    ThreadCpuSampler sampler(options);
+    std::string error;
+    ASSERT_TRUE(sampler.start(error)) << error;
+    // Short-lived threads: their rings are retired and their tids may be reused
+    for (int round = 0; round < 20; ++round) {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < 4; ++i) {
+            workers.emplace_back([] { burnThreadCpu(std::chrono::milliseconds(15)); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    ParsedProfile profile = sampler.stop();
+    EXPECT_GT(sampler.threadsSampled(), 4u);
+    EXPECT_GT(countInSpin(profile), 0u);
+}
@@ -0,0 +1,240 @@
+/// @file test_thread_stacks_json.cpp
+/// @brief Tests for the prefix-compressed JSON thread dump (/api/thread/stacks?format=json)
+
+#include "profiler/http_handlers.h"
+#include "profiler_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <pthread.h>
+#include <regex>
+#include <set>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+pid_t currentTid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// Scheduler state of a thread of this process from /proc ('?' if it is gone)
+char threadState(pid_t tid) {
+    std::ifstream stat("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string line;
+    std::getline(stat, line);
+    size_t close = line.rfind(')');
+    return close != std::string::npos && close + 2 < line.size() ? line[close + 2] : '?';
+}
+
+// Waits until every thread sleeps, up to `timeout`
+bool waitUntilSleeping(const std::vector<pid_t>& tids, std::chrono::milliseconds timeout) {
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < end) {
+        if (std::all_of(tids.begin(), tids.end(), [](pid_t tid) { return threadState(tid) == 'S'; })) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+}
+
+constexpr int kSharedDepth = 20; ///< Recursive frames every parked thread has in common
+
+// Blocks threads until opened
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool open = false;
+};
+
+[[gnu::noinline]] void waitInLeafA(Gate& gate) {
+    std::unique_lock<std::mutex> lock(gate.mutex);
+    gate.cv.wait(lock, [&] { return gate.open; });
+}
+
+[[gnu::noinline]] void waitInLeafB(Gate& gate) {
+    std::unique_lock<std::mutex> lock(gate.mutex);
+    while (!gate.open) {
+        gate.cv.wait_for(lock, std::chrono::seconds(60));
+    }
+}
+
+// Recurses `depth` frames through one call site, then blocks in leaf A or B
+[[gnu::noinline]] int descend(int depth, bool leaf_a, Gate& gate) {
+    if (depth == 0) {
+        if (leaf_a) {
+            waitInLeafA(gate);
+        } else {
+            waitInLeafB(gate);
+        }
+        return 0;
+    }
+    volatile int keep_frame = descend(depth - 1, leaf_a, gate);
+    return keep_frame + 1;
+}
+
+/// A thread of the parsed document
+struct ThreadEntry {
+    std::string name;
+    std::string state;
+    std::string wchan;
+    int64_t node = -1;
+};
+
+/// Minimal reader for {"frames":[..],"nodes":[[parent,frame],..],"threads":[..]}
+struct StacksJson {
+    std::vector<std::string> frames;
+    std::vector<std::pair<int64_t, uint32_t>> nodes;
+    std::vector<std::pair<pid_t, ThreadEntry>> threads;
+
+    bool parse(const std::string& json) {
+        size_t pos = json.find("{\"frames\":[");
+        if (pos != 0) {
+            return false;
+        }
+        pos += 11;
+        while (pos < json.size() && json[pos] == '"') {
+            size_t end = pos + 1;
+            while (end < json.size() && json[end] != '"') {
+                end += json[end] == '\\' ? 2 : 1;
+            }
+            frames.push_back(json.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+            if (pos < json.size() && json[pos] == ',') {
+                ++pos;
+            }
+        }
+        if (json.compare(pos, 11, "],\"nodes\":[") != 0) {
+            return false;
+        }
+        pos += 11;
+        while (pos < json.size() && json[pos] == '[') {
+            char* end = nullptr;
+            int64_t parent = std::strtoll(json.c_str() + pos + 1, &end, 10);
+            uint32_t frame = static_cast<uint32_t>(std::strtoul(end + 1, &end, 10));
+            nodes.emplace_back(parent, frame);
+            pos = static_cast<size_t>(end - json.c_str()) + 1;
+            if (pos < json.size() && json[pos] == ',') {
+                ++pos;
+            }
+        }
+        if (json.compare(pos, 13, "],\"threads\":[") != 0) {
+            return false;
+        }
+        static const std::regex thread_re(
+            R"re(\{"tid":(\d+),"name":"([^"]*)","state":"(.)","wchan":"([^"]*)","node":(-?\d+)\})re");
+        std::string rest = json.substr(pos);
+        for (std::sregex_iterator it(rest.begin(), rest.end(), thread_re), end; it != end; ++it) {
+            ThreadEntry entry{(*it)[2], (*it)[3], (*it)[4], std::stoll((*it)[5])};
+            threads.emplace_back(static_cast<pid_t>(std::stol((*it)[1])), entry);
+        }
+        return true;
+    }
+
+    const ThreadEntry* thread(pid_t tid) const {
+        auto it = std::find_if(threads.begin(), threads.end(), [tid](const auto& entry) { return entry.first == tid; });
+        return it != threads.end() ? &it->second : nullptr;
+    }
+
+    /// Nodes from the root down to `node`
+    std::vector<int64_t> chain(int64_t node) const {
+        std::vector<int64_t> out;
+        for (; node >= 0; node = nodes[static_cast<size_t>(node)].first) {
+            out.push_back(node);
+        }
+        std::reverse(out.begin(), out.end());
+        return out;
+    }
+};
+} // namespace
+
+TEST(ThreadStacksJsonTest, SharesPrefixesAndInternsFramesOnce) {
+    Gate gate;
+    std::atomic<pid_t> tids[4] = {};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] {
+            pthread_setname_np(pthread_self(), ("json-" + std::to_string(i)).c_str());
+            tids[i] = currentTid();
+            descend(kSharedDepth, i % 2 == 0, gate);
+        });
+    }
+    std::vector<pid_t> parked;
+    for (auto& tid : tids) {
+        while (tid.load() == 0) {
+            std::this_thread::yield();
+        }
+        parked.push_back(tid);
+    }
+    ASSERT_TRUE(waitUntilSleeping(parked, std::chrono::seconds(10)));
+
+    profiler::ProfilerManager profiler;
+    profiler::ProfilerHttpHandlers handlers(profiler);
+    auto resp = handlers.dispatch("GET", "/api/thread/stacks", {{"format", "json"}});
+    {
+        std::lock_guard<std::mutex> lock(gate.mutex);
+        gate.open = true;
+    }
+    gate.cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(resp.status, 200);
+    StacksJson doc;
+    ASSERT_TRUE(doc.parse(resp.body)) << resp.body.substr(0, 200);
+
+    // Each frame is listed once, and each (parent, frame) edge once
+    EXPECT_EQ(std::set<std::string>(doc.frames.begin(), doc.frames.end()).size(), doc.frames.size());
+    std::set<std::pair<int64_t, uint32_t>> edges(doc.nodes.begin(), doc.nodes.end());
+    EXPECT_EQ(edges.size(), doc.nodes.size());
+    for (const auto& [parent, frame] : doc.nodes) {
+        EXPECT_LT(parent, static_cast<int64_t>(doc.nodes.size()));
+        EXPECT_LT(frame, doc.frames.size());
+    }
+
+    // Leaves carry the thread's metadata
+    const ThreadEntry* entries[4] = {};
+    for (int i = 0; i < 4; ++i) {
+        entries[i] = doc.thread(tids[i]);
+        ASSERT_NE(entries[i], nullptr) << "thread " << tids[i];
+        EXPECT_EQ(entries[i]->name, "json-" + std::to_string(i));
+        EXPECT_EQ(entries[i]->state, "S");
+        EXPECT_FALSE(entries[i]->wchan.empty());
+        ASSERT_GE(entries[i]->node, 0);
+    }
+
+    // Threads parked on the same path end at the same node; the two leaves differ
+    EXPECT_EQ(entries[0]->node, entries[2]->node);
+    EXPECT_EQ(entries[1]->node, entries[3]->node);
+    EXPECT_NE(entries[0]->node, entries[1]->node);
+
+    // Both paths share the outer frames and the recursion, as the same nodes
+    std::vector<int64_t> a = doc.chain(entries[0]->node);
+    std::vector<int64_t> b = doc.chain(entries[1]->node);
+    size_t shared = 0;
+    while (shared < a.size() && shared < b.size() && a[shared] == b[shared]) {
+        ++shared;
+    }
+    EXPECT_GE(shared, static_cast<size_t>(kSharedDepth));
+
+    // The recursive call site is one frame, repeated along the path
+    std::vector<uint32_t> path;
+    for (int64_t node : a) {
+        path.push_back(doc.nodes[static_cast<size_t>(node)].second);
+    }
+    size_t most_repeated = 0;
+    for (uint32_t frame : path) {
+        most_repeated = std::max(most_repeated, static_cast<size_t>(std::count(path.begin(), path.end(), frame)));
+    }
+    EXPECT_GE(most_repeated, static_cast<size_t>(kSharedDepth));
+}
@@ -0,0 +1,67 @@
+/// @file test_worker_pool.cpp
+/// @brief Tests for the handler worker pool
+
+#include "internal/worker_pool.h"
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <sched.h>
+#include <thread>
+
+using profiler::internal::WorkerPool;
+
+TEST(WorkerPoolTest, RunsTasksOffTheCallerThread) {
+    WorkerPool pool(2, 16);
+    EXPECT_EQ(pool.threadCount(), 2u);
+
+    std::promise<std::thread::id> ran_on;
+    ASSERT_TRUE(pool.submit([&] { ran_on.set_value(std::this_thread::get_id()); }));
+    EXPECT_NE(ran_on.get_future().get(), std::this_thread::get_id());
+}
+
+TEST(WorkerPoolTest, RefusesTasksBeyondTheQueueBound) {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+    std::atomic<int> done{0};
+    {
+        WorkerPool pool(1, 2);
+        ASSERT_TRUE(pool.submit([&] {
+            started.set_value();
+            released.wait();
+            ++done;
+        }));
+        started.get_future().wait(); // The only worker is busy, so the next tasks queue up
+
+        EXPECT_TRUE(pool.submit([&] { ++done; }));
+        EXPECT_TRUE(pool.submit([&] { ++done; }));
+        EXPECT_FALSE(pool.submit([&] { ++done; }));
+        EXPECT_EQ(pool.queued(), 2u);
+        release.set_value();
+    }
+    // The destructor runs what was queued before joining
+    EXPECT_EQ(done, 3);
+}
+
+TEST(WorkerPoolTest, InlineWithoutThreadsAndAffinity) {
+    WorkerPool inline_pool(0, 0);
+    std::thread::id ran_on;
+    EXPECT_TRUE(inline_pool.submit([&] { ran_on = std::this_thread::get_id(); }));
+    EXPECT_EQ(ran_on, std::this_thread::get_id());
+
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) {
+        ++cpu;
+    }
+
+    WorkerPool pinned(1, 4, {cpu});
+    std::promise<int> count;
+    pinned.submit([&] {
+        cpu_set_t set;
+        sched_getaffinity(0, sizeof(set), &set);
+        count.set_value(CPU_COUNT(&set));
+    });
+    EXPECT_EQ(count.get_future().get(), 1);
+}
@@ -0,0 +1,440 @@
+/// @file profiler_collector.cpp
+/// @brief Fleet collector: pulls profiles from many instances and merges them
+///
+/// Usage: profiler_collector [options] ENDPOINT[=WEIGHT]...
+///
+/// Fetches the in-process symbolized folded stacks (/api/{cpu,heap,growth}/folded)
+/// of every endpoint in parallel, flags instances whose volume or stack mix is
+/// far from the rest, and writes one merged profile as folded stacks, flame
+/// graph JSON (for /flamegraph.html) or a flamegraph.pl SVG.
+
+#include "internal/embed_flamegraph.h"
+#include "internal/fleet_merge.h"
+#include "internal/flame_tree.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <netdb.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+namespace internal = profiler::internal;
+
+void printUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] ENDPOINT[=WEIGHT]...\n"
+              << "\n"
+              << "  -k KIND       cpu (default), heap or growth\n"
+              << "  -s SECONDS    CPU sampling duration on every instance (default: 10)\n"
+              << "  -j N          Instances fetched at once (default: 16)\n"
+              << "  -t SECONDS    Connect and transfer timeout, on top of the sampling time (default: 10)\n"
+              << "  -f FORMAT     folded (default), json or svg\n"
+              << "  -o OUTPUT     Output file (default: stdout)\n"
+              << "  -e FILE       Read more endpoints from FILE, one 'ENDPOINT [WEIGHT]' per line\n"
+              << "  -z SCORE      Outlier threshold as a robust z-score, 0 = off (default: 3.5)\n"
+              << "  --raw         Sum raw values instead of normalizing every instance to the median total\n"
+              << "  --keep-outliers  Report outliers but merge them anyway\n"
+              << "\n"
+              << "  ENDPOINT      host:port, http://host:port[/prefix], unix:/path/to.sock or unix:@abstract-name\n";
+}
+
+/// Where and how to reach one instance
+struct Endpoint {
+    std::string name;        ///< As given on the command line
+    std::string host;        ///< TCP host (empty for Unix sockets)
+    std::string port = "80"; ///< TCP port
+    std::string unix_path;   ///< Unix socket path ("@name" = abstract namespace)
+    std::string prefix;      ///< Path prefix in front of /api/...
+    double weight = 1.0;
+};
+
+bool parseEndpoint(std::string spec, Endpoint& endpoint) {
+    size_t eq = spec.rfind('=');
+    if (eq != std::string::npos) {
+        try {
+            endpoint.weight = std::stod(spec.substr(eq + 1));
+        } catch (...) {
+            return false;
+        }
+        spec.resize(eq);
+    }
+    endpoint.name = spec;
+    if (spec.rfind("unix:", 0) == 0) {
+        endpoint.unix_path = spec.substr(5);
+        return !endpoint.unix_path.empty() && endpoint.unix_path.size() < sizeof(sockaddr_un::sun_path);
+    }
+    if (spec.rfind("http://", 0) == 0) {
+        spec = spec.substr(7);
+    }
+    size_t slash = spec.find('/');
+    if (slash != std::string::npos) {
+        endpoint.prefix = spec.substr(slash);
+        while (!endpoint.prefix.empty() && endpoint.prefix.back() == '/') {
+            endpoint.prefix.pop_back();
+        }
+        spec.resize(slash);
+    }
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos) {
+        endpoint.port = spec.substr(colon + 1);
+        spec.resize(colon);
+    }
+    endpoint.host = spec;
+    return !endpoint.host.empty() && !endpoint.port.empty();
+}
+
+// Wait for a non-blocking connect to finish
+bool finishConnect(int fd, int timeout_ms) {
+    pollfd pfd{fd, POLLOUT, 0};
+    if (poll(&pfd, 1, timeout_ms) != 1) {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    errno = error;
+    return error == 0;
+}
+
+int connectEndpoint(const Endpoint& endpoint, int timeout_ms, std::string& error) {
+    if (!endpoint.unix_path.empty()) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, endpoint.unix_path.data(), endpoint.unix_path.size());
+        bool abstract = endpoint.unix_path.front() == '@';
+        if (abstract) {
+            addr.sun_path[0] = '\0';
+        }
+        auto len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + endpoint.unix_path.size() + !abstract);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+            error = std::string("connect: ") + strerror(errno);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    int rc = getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &addrs);
+    if (rc != 0) {
+        error = std::string("resolve: ") + gai_strerror(rc);
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* ai = addrs; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        bool connected =
+            connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || (errno == EINPROGRESS && finishConnect(fd, timeout_ms));
+        if (connected && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) == 0) {
+            break;
+        }
+        error = std::string("connect: ") + strerror(errno);
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+    return fd;
+}
+
+// Body of a chunked transfer encoding, or false if it is malformed
+bool decodeChunked(const std::string& data, std::string& body) {
+    size_t pos = 0;
+    for (;;) {
+        size_t line_end = data.find("\r\n", pos);
+        if (line_end == std::string::npos) {
+            return false;
+        }
+        size_t size = 0;
+        try {
+            size = std::stoul(data.substr(pos, line_end - pos), nullptr, 16);
+        } catch (...) {
+            return false;
+        }
+        pos = line_end + 2;
+        if (size == 0) {
+            return true;
+        }
+        if (data.size() - pos < size) {
+            return false;
+        }
+        body.append(data, pos, size);
+        pos += size + 2;
+    }
+}
+
+/// GET `target`, requiring a 200 response; one request per connection
+bool httpGet(const Endpoint& endpoint, const std::string& target, int timeout_s, std::string& body,
+             std::string& error) {
+    int fd = connectEndpoint(endpoint, timeout_s * 1000, error);
+    if (fd < 0) {
+        return false;
+    }
+    timeval timeout{timeout_s, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request = "GET " + endpoint.prefix + target + " HTTP/1.1\r\nHost: " +
+                          (endpoint.host.empty() ? "localhost" : endpoint.host) + "\r\nConnection: close\r\n\r\n";
+    bool sent = send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+    std::string response;
+    char buffer[65536];
+    ssize_t n = 0;
+    while (sent && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, static_cast<size_t>(n));
+    }
+    close(fd);
+    if (!sent || n < 0) {
+        error = errno == EAGAIN || errno == EWOULDBLOCK ? "timed out" : std::string("transfer: ") + strerror(errno);
+        return false;
+    }
+
+    size_t head_end = response.find("\r\n\r\n");
+    if (head_end == std::string::npos || response.compare(0, 5, "HTTP/") != 0) {
+        error = "malformed response";
+        return false;
+    }
+    std::string head = response.substr(0, head_end);
+    std::string payload = response.substr(head_end + 4);
+    int status = std::atoi(head.c_str() + head.find(' ') + 1);
+    for (char& c : head) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (head.find("\r\ntransfer-encoding: chunked") != std::string::npos) {
+        if (!decodeChunked(payload, body)) {
+            error = "malformed chunked body";
+            return false;
+        }
+    } else {
+        body = std::move(payload);
+    }
+    if (status != 200) {
+        error = "HTTP " + std::to_string(status) + ": " + body.substr(0, 200);
+        return false;
+    }
+    return true;
+}
+
+bool readEndpointFile(const std::string& path, std::vector<std::string>& specs) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string endpoint;
+        std::string weight;
+        if (!(fields >> endpoint) || endpoint[0] == '#') {
+            continue;
+        }
+        specs.push_back(fields >> weight ? endpoint + "=" + weight : endpoint);
+    }
+    return true;
+}
+
+// flamegraph.pl on the merged stacks, from a private temporary directory
+bool renderSvg(const std::string& folded, const std::string& title, std::string& svg) {
+    char dir[] = "/tmp/profiler_collector.XXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+        return false;
+    }
+    std::string script = std::string(dir) + "/flamegraph.pl";
+    std::string input = std::string(dir) + "/merged.folded";
+    bool ok = profiler::writeFlamegraphScript(script);
+    std::ofstream(input, std::ios::binary) << folded;
+    if (ok) {
+        std::string cmd = "perl " + script + " --title=\"" + title + "\" --width=1200 " + input + " 2>/dev/null";
+        FILE* pipe = popen(cmd.c_str(), "r");
+        ok = pipe != nullptr;
+        if (ok) {
+            char buffer[65536];
+            size_t n = 0;
+            while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+                svg.append(buffer, n);
+            }
+            ok = pclose(pipe) == 0 && svg.find("<svg") != std::string::npos;
+        }
+    }
+    unlink(script.c_str());
+    unlink(input.c_str());
+    rmdir(dir);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string kind = "cpu";
+    int seconds = 10;
+    size_t jobs = 16;
+    int timeout_s = 10;
+    std::string format = "folded";
+    std::string output_path;
+    internal::FleetMergeOptions options;
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        try {
+            if (arg == "-k" && has_value) {
+                kind = argv[++i];
+            } else if (arg == "-s" && has_value) {
+                seconds = std::stoi(argv[++i]);
+            } else if (arg == "-j" && has_value) {
+                jobs = std::stoul(argv[++i]);
+            } else if (arg == "-t" && has_value) {
+                timeout_s = std::stoi(argv[++i]);
+            } else if (arg == "-f" && has_value) {
+                format = argv[++i];
+            } else if (arg == "-o" && has_value) {
+                output_path = argv[++i];
+            } else if (arg == "-z" && has_value) {
+                options.outlier_threshold = std::stod(argv[++i]);
+            } else if (arg == "-e" && has_value) {
+                if (!readEndpointFile(argv[++i], specs)) {
+                    std::cerr << "error: cannot read " << argv[i] << "\n";
+                    return 1;
+                }
+            } else if (arg == "--raw") {
+                options.normalize = false;
+            } else if (arg == "--keep-outliers") {
+                options.drop_outliers = false;
+            } else if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (!arg.empty() && arg[0] != '-') {
+                specs.push_back(arg);
+            } else {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } catch (...) {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (specs.empty() || jobs == 0 || timeout_s <= 0 || (kind != "cpu" && kind != "heap" && kind != "growth") ||
+        (format != "folded" && format != "json" && format != "svg")) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Endpoint> endpoints(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (!parseEndpoint(specs[i], endpoints[i])) {
+            std::cerr << "error: invalid endpoint " << specs[i] << "\n";
+            return 2;
+        }
+    }
+
+    // Same clamping as the server, so the transfer timeout covers the real sampling time
+    seconds = std::max(1, std::min(seconds, 300));
+    std::string target = "/api/" + kind + "/folded" + (kind == "cpu" ? "?duration=" + std::to_string(seconds) : "");
+    int transfer_timeout = timeout_s + (kind == "cpu" ? seconds : 0);
+
+    std::vector<internal::FleetInstance> instances(endpoints.size());
+    std::vector<uint8_t> fetched(endpoints.size(), 0); // Not vector<bool>: workers write neighbouring flags
+    std::atomic<size_t> next{0};
+    std::mutex log_mutex;
+    auto worker = [&] {
+        for (size_t i = next++; i < endpoints.size(); i = next++) {
+            std::string body;
+            std::string error;
+            bool ok = httpGet(endpoints[i], target, transfer_timeout, body, error);
+            if (ok && !internal::parseFoldedStacks(body, instances[i].stacks)) {
+                ok = false;
+                error = "response is not folded stacks";
+            }
+            instances[i].name = endpoints[i].name;
+            instances[i].weight = endpoints[i].weight;
+            fetched[i] = ok;
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cerr << "warning: " << endpoints[i].name << ": " << error << "\n";
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < std::min(jobs, endpoints.size()); ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<internal::FleetInstance> usable;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        if (fetched[i]) {
+            usable.push_back(std::move(instances[i]));
+        }
+    }
+    if (usable.empty()) {
+        std::cerr << "error: no instance returned a profile\n";
+        return 1;
+    }
+
+    auto result = internal::mergeFleetProfiles(usable, options);
+    size_t merged_count = 0;
+    for (const auto& report : result.instances) {
+        merged_count += report.merged ? 1 : 0;
+        if (report.outlier) {
+            std::cerr << "outlier: " << report.name << " total=" << report.total << std::fixed << std::setprecision(3)
+                      << " distance=" << report.distance << " score=" << std::setprecision(1) << report.score
+                      << (report.merged ? " (kept)" : " (excluded)") << "\n";
+        }
+    }
+    std::cerr << "merged " << merged_count << " of " << endpoints.size() << " instances\n";
+
+    std::string output;
+    std::string folded = internal::formatFoldedStacks(result.merged);
+    if (format == "folded") {
+        output = std::move(folded);
+    } else if (format == "json") {
+        internal::FlameTree tree;
+        tree.addAll(result.merged);
+        output = tree.toJson(kind, kind == "cpu" ? "samples" : "bytes");
+    } else {
+        std::string title = "Fleet " + kind + " (" + std::to_string(merged_count) + " instances)";
+        if (!renderSvg(folded, title, output)) {
+            std::cerr << "error: flamegraph.pl failed (is perl installed?)\n";
+            return 1;
+        }
+    }
+
+    if (output_path.empty()) {
+        std::cout << output;
+        return std::cout ? 0 : 1;
+    }
+    std::ofstream out(output_path, std::ios::binary | std::ios::trunc);
+    out << output;
+    if (!out) {
+        std::cerr << "error: cannot write " << output_path << "\n";
+        return 1;
+    }
+    return 0;
+}
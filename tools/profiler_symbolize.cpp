@@ -0,0 +1,204 @@
+/// @file profiler_symbolize.cpp
+/// @brief Offline symbolizer for bundles exported by the /api/.../bundle endpoints
+///
+/// Usage: profiler_symbolize [-d DIR]... [-m BUNDLE]... [-f folded|text] BUNDLE [OUTPUT]
+///
+/// Resolves the raw addresses of a bundle against unstripped copies of the
+/// recorded modules found in the -d directories (see OfflineSymbolizer for the
+/// lookup order), so the profiled host never spends time on symbolization.
+/// Bundles given with -m are merged in first (see mergeSymbolBundles()).
+
+#include "internal/folded_stacks.h"
+#include "internal/offline_symbolizer.h"
+#include "internal/profile_merge.h"
+#include "internal/symbol_bundle.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+namespace internal = profiler::internal;
+
+void printUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [-d DIR]... [-m BUNDLE]... [-f folded|text] BUNDLE [OUTPUT]\n"
+              << "\n"
+              << "  -d DIR     Directory with unstripped binaries or .build-id/ debug files (repeatable)\n"
+              << "  -m BUNDLE  Merge another bundle of the same kind, e.g. from another process (repeatable)\n"
+              << "  -f FORMAT  'folded' (default for profiles) or 'text' (default for thread dumps)\n"
+              << "  BUNDLE     File saved from /api/cpu/bundle, /api/heap/bundle, /api/growth/bundle\n"
+              << "             or /api/thread/stacks?format=bundle\n"
+              << "  OUTPUT     Output file (default: stdout)\n";
+}
+
+/// Symbolizes the addresses of one bundle, each distinct address once
+class BundleSymbolizer {
+public:
+    BundleSymbolizer(const internal::SymbolBundle& bundle, std::vector<std::string> dirs)
+        : bundle_(bundle), symbolizer_(std::move(dirs)) {}
+
+    const std::vector<profiler::SymbolizedFrame>& frames(uintptr_t address) {
+        auto [it, inserted] = cache_.try_emplace(address);
+        if (inserted) {
+            it->second = symbolizer_.symbolize(findModule(address), address);
+        }
+        return it->second;
+    }
+
+    /// Report the modules for which no matching local file exists
+    void warnMissing() {
+        for (const auto& module : bundle_.modules) {
+            if (symbolizer_.localPath(module).empty()) {
+                std::cerr << "warning: no local binary matching " << module.path
+                          << (module.build_id.empty() ? "" : " (build-id " + module.build_id + ")") << "\n";
+            }
+        }
+    }
+
+private:
+    const internal::ModuleInfo* findModule(uintptr_t address) const {
+        const auto& modules = bundle_.modules;
+        auto it = std::upper_bound(modules.begin(), modules.end(), address,
+                                   [](uintptr_t addr, const internal::ModuleInfo& m) { return addr < m.start; });
+        if (it == modules.begin() || !(it - 1)->contains(address)) {
+            return nullptr;
+        }
+        return &*(it - 1);
+    }
+
+    const internal::SymbolBundle& bundle_;
+    internal::OfflineSymbolizer symbolizer_;
+    std::unordered_map<uintptr_t, std::vector<profiler::SymbolizedFrame>> cache_;
+};
+
+std::string formatFolded(const internal::SymbolBundle& bundle, BundleSymbolizer& symbolizer) {
+    internal::ParsedProfile profile;
+    profile.period_us = bundle.period_us;
+    for (const auto& sample : bundle.samples) {
+        profile.samples.push_back({sample.value, sample.stack});
+    }
+
+    internal::StringPool& pool = internal::symbolNames();
+    auto resolve = [&](uintptr_t address) {
+        std::vector<uint32_t> names;
+        for (const auto& frame : symbolizer.frames(address)) {
+            // flamegraph.pl convention: "_[i]" marks a frame that was inlined into its caller
+            names.push_back(frame.is_inlined ? pool.intern(std::string(frame.functionName()) + "_[i]")
+                                             : frame.function_id);
+        }
+        return names;
+    };
+    return internal::formatFoldedStacks(internal::foldProfile(profile, resolve));
+}
+
+std::string formatText(const internal::SymbolBundle& bundle, BundleSymbolizer& symbolizer) {
+    std::ostringstream out;
+    for (const auto& sample : bundle.samples) {
+        if (bundle.kind == internal::SymbolBundle::Kind::Threads) {
+            out << "Thread " << sample.tid << " (" << sample.label << "):\n";
+        } else {
+            out << sample.value << (bundle.kind == internal::SymbolBundle::Kind::Cpu ? " samples" : " bytes") << ":\n";
+        }
+
+        std::vector<uintptr_t> stack = sample.stack;
+        internal::fixupCallerAddresses(stack);
+        int index = 0;
+        for (uintptr_t address : stack) {
+            for (const auto& frame : symbolizer.frames(address)) {
+                out << "    #" << index++ << " " << frame.functionName();
+                if (frame.line > 0) {
+                    out << " at " << frame.sourceFile() << ":" << frame.line;
+                }
+                if (frame.is_inlined) {
+                    out << " [inlined]";
+                }
+                out << "\n";
+            }
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+bool readBundle(const std::string& path, internal::SymbolBundle& bundle) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "error: cannot open " << path << "\n";
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!internal::decodeSymbolBundle(data, bundle)) {
+        std::cerr << "error: " << path << " is not a valid symbol bundle\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> dirs;
+    std::vector<std::string> merge;
+    std::string format;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dirs.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            merge.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.empty() || positional.size() > 2 || (!format.empty() && format != "folded" && format != "text")) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    internal::SymbolBundle bundle;
+    if (!readBundle(positional[0], bundle)) {
+        return 1;
+    }
+    if (!merge.empty()) {
+        std::vector<internal::SymbolBundle> inputs(merge.size() + 1);
+        inputs[0] = std::move(bundle);
+        for (size_t i = 0; i < merge.size(); ++i) {
+            if (!readBundle(merge[i], inputs[i + 1])) {
+                return 1;
+            }
+        }
+        std::string error;
+        if (!internal::mergeSymbolBundles(inputs, bundle, error)) {
+            std::cerr << "error: " << error << "\n";
+            return 1;
+        }
+    }
+
+    if (format.empty()) {
+        format = bundle.kind == internal::SymbolBundle::Kind::Threads ? "text" : "folded";
+    }
+    BundleSymbolizer symbolizer(bundle, std::move(dirs));
+    symbolizer.warnMissing();
+    std::string output = format == "text" ? formatText(bundle, symbolizer) : formatFolded(bundle, symbolizer);
+
+    if (positional.size() == 1) {
+        std::cout << output;
+        return std::cout ? 0 : 1;
+    }
+    std::ofstream out(positional[1], std::ios::binary | std::ios::trunc);
+    out << output;
+    if (!out) {
+        std::cerr << "error: cannot write " << positional[1] << "\n";
+        return 1;
+    }
+    return 0;
+}